@@ -0,0 +1,162 @@
+/* bufvsgd.c ---- compare the libmsvg native renderer with the GD backend
+ * 
+ * This is a dirty hack to test the libmsvg librarie with the GD
+ * graphics library. It is NOT part of the libmsvg librarie really.
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gd.h>
+#include <msvg.h>
+#include "rendgd.h"
+
+static int savePng(gdImagePtr im, char *fname)
+{
+    FILE *pngout;
+
+    pngout = fopen(fname, "wb");
+    if (pngout == NULL) {
+        printf("Error creating %s\n", fname);
+        return 0;
+    }
+    gdImagePng(im, pngout);
+    fclose(pngout);
+
+    return 1;
+}
+
+static void bufferToImage(uint32_t *pixels, int width, int height, gdImagePtr im)
+{
+    uint32_t p;
+    int x, y;
+
+    for (y=0; y<height; y++) {
+        for (x=0; x<width; x++) {
+            p = pixels[y*width+x];
+            gdImageSetPixel(im, x, y, gdTrueColorAlpha((p >> 16) & 0xFF,
+                            (p >> 8) & 0xFF, p & 0xFF, 127 - (p >> 25)));
+        }
+    }
+}
+
+int main(int argc,char **argv)
+{
+    GDSVGDrawMode sdm = {SVGDRAWMODE_PAR, SVGDRAWADJ_CENTER, 1.0, 0, 0, 0, 0xFFFFFF};
+    MsvgRenderMode rm = {MSVGRENDER_PAR, MSVGRENDER_CENTER, 1.0, 0, 0, 0, 0xFFFFFF};
+    MsvgElement *root;
+    gdImagePtr im;
+    uint32_t *pixels;
+    clock_t t0;
+    double tgd, tbuf;
+    int width = 1024;
+    int height = 768;
+    int nloops = 10;
+    int error, i;
+
+    // Get parameters
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strcmp(argv[0], "-gd") == 0) {
+            if (argc > 2) {
+                width = atoi(argv[1]);
+                height = atoi(argv[2]);
+                argv += 2;
+                argc -= 2;
+            }
+        } else if (strcmp(argv[0], "-n") == 0) {
+            if (argc > 1) {
+                nloops = atoi(argv[1]);
+                argv += 1;
+                argc -= 1;
+            }
+        }
+        argv++;
+        argc--;
+    }
+
+    if (argc < 1 || width < 1 || height < 1 || nloops < 1) {
+        printf("Usage: bufvsgd [-gd width height] [-n nloops] file.svg\n");
+        return EXIT_FAILURE;
+    }
+
+    // Load svg file and prepare it
+    error = 0;
+    root = MsvgReadSvgFile(argv[0], &error);
+    if (root == NULL) {
+        printf("Error %d opening %s\n", error, argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (MsvgRaw2CookedTree(root) != 1) {
+        printf("Error cooking root element\n");
+        return EXIT_FAILURE;
+    }
+
+    im = gdImageCreateTrueColor(width, height);
+    pixels = malloc(sizeof(uint32_t) * width * height);
+    if (im == NULL || pixels == NULL) {
+        printf("Error creating the images\n");
+        return EXIT_FAILURE;
+    }
+
+    // the same drawing nloops times with each backend
+    t0 = clock();
+    for (i=0; i<nloops; i++) {
+        error = GDDrawSVGtree(root, &sdm, im);
+        if (error) {
+            printf("Error %d rendering with GD\n", error);
+            return EXIT_FAILURE;
+        }
+    }
+    tgd = (double)(clock() - t0) / CLOCKS_PER_SEC / nloops;
+    savePng(im, "rgd.png");
+
+    t0 = clock();
+    for (i=0; i<nloops; i++) {
+        error = MsvgRenderToBuffer(root, &rm, pixels, width, height, width);
+        if (error) {
+            printf("Error %d rendering to the buffer\n", error);
+            return EXIT_FAILURE;
+        }
+    }
+    tbuf = (double)(clock() - t0) / CLOCKS_PER_SEC / nloops;
+    bufferToImage(pixels, width, height, im);
+    savePng(im, "rbuf.png");
+
+    printf("%s %dx%d: GD %.2f ms, buffer %.2f ms, ratio %.2f\n", argv[0],
+           width, height, tgd * 1000, tbuf * 1000, tgd > 0 ? tbuf / tgd : 0);
+
+    gdImageDestroy(im);
+    free(pixels);
+    MsvgDeleteElement(root);
+
+    return EXIT_SUCCESS;
+}
@@ -165,48 +165,15 @@ static void DrawPolygonElement(MsvgElement *el, MsvgPaintCtx *pctx)
     }
     free(points);
 }
-/*
-static int InsidePolygonTest(int npoints, double *points, double x, double y)
-{
-    int i, ytest0, ytest1, xtest0, inside;
-    double *edge0, *edge1;
-
-    if (npoints < 3) return 0;
-
-    edge0 = &points[npoints*2-2];
-    edge1 = &points[0];
-    ytest0 = (edge0[1] >= y);
-    inside = 0;
-
-    for (i=0; i<npoints; i++) {
-        ytest1 = (edge1[1] >= y);
-
-        if (ytest0 != ytest1) {
-            xtest0 = (edge0[0] >= x);
-            if (xtest0 == (edge1[0] >= x)) {
-                if (xtest0) inside = !inside;
-            } else {
-                if ((edge1[0] - (edge1[1] - y) *
-                    (edge0[0] - edge1[0]) / (edge0[1] - edge1[1])) >= x) {
-                    inside = !inside;
-                }
-            }
-        }
-
-        ytest0 = ytest1;
-        edge0 = edge1;
-        edge1 += 2;
-    }
 
-    return inside;
-}
-*/
 static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
 {
     MsvgElement *newel2;
+    MsvgPackedPath *pp;
     int i, nsp;
 
-    nsp = MsvgCountSubPaths(el->ppathattr->sp);
+    pp = MsvgGetPackedPath(el);
+    nsp = pp ? pp->nsubpaths : 0;
     for (i=0; i<nsp; i++) {
         newel2 = MsvgSubPathToPoly(el, i, glob_px_x_unit);
         if (newel2) {
@@ -267,7 +234,7 @@ int GDDrawSVGtree(MsvgElement *root, GDSVGDrawMode *sdm, gdImagePtr im)
     double ratiow, ratioh, rvb_width, rvb_height;
     int ret;
     double cx, cy;
-    TMatrix taux1, taux2, taux3, tsave;
+    TMatrix taux1, taux2, taux3;
     double scale_x, scale_y;
 
     if (root == NULL) return -1;
@@ -347,11 +314,8 @@ int GDDrawSVGtree(MsvgElement *root, GDSVGDrawMode *sdm, gdImagePtr im)
     TMSetTranslation(&taux2, -root->psvgattr->vb_min_x, -root->psvgattr->vb_min_y);
     TMMpy(&taux3, &taux1, &taux2);
 
-    tsave = root->pctx->tmatrix;
-    TMMpy(&(root->pctx->tmatrix), &taux3, &tsave);
-
-    ret = MsvgSerCookedTree(root, sufn, NULL, 0);
-    root->pctx->tmatrix = tsave;
+    // the view is not set in the tree, it can be frozen
+    ret = MsvgSerCookedTreeView(root, sufn, NULL, 0, NULL, &taux3);
     if (ret != 1) return -6;
 
     return 0;
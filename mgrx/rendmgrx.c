@@ -46,8 +46,12 @@ typedef struct {
     GrPattern *stroke_grd;
     GrLinePattern lpat;
     int istroke_width;
+    MsvgBPServer *fill_bps;  /* paint servers of the current gradients */
+    MsvgBPServer *stroke_bps;
 } RenderCtx;
 
+#define MAX_BATCH_ITEMS 256
+
 static double glob_xorg;
 static double glob_yorg;
 static GrColor glob_bg;
@@ -85,25 +89,49 @@ static GrPattern *convert_gradient(MsvgBPServer *bps)
     return grd;
 }
 
-static void build_renderctx(RenderCtx *r, MsvgPaintCtx *pctx)
+static void init_renderctx(RenderCtx *r, MsvgPaintCtx *pctx)
 {
+    // the colors are shared by all the elements of a batch
     r->fill_grd = NULL;
     r->stroke_grd = NULL;
+    r->fill_bps = NULL;
+    r->stroke_bps = NULL;
 
-    if (pctx->fill != NO_COLOR) {
-        if (pctx->fill_bps) {
-            r->fill_grd = convert_gradient(pctx->fill_bps);
-        } else {
-            r->cfill = GrAllocColor2(pctx->fill);
-        }
+    if (pctx->fill != NO_COLOR && pctx->fill_bps == NULL) {
+        r->cfill = GrAllocColor2(pctx->fill);
     }
     if (pctx->stroke != NO_COLOR) {
         if (pctx->stroke_bps) {
-            r->stroke_grd = convert_gradient(pctx->stroke_bps);
             r->cstroke = GrBlack();
         } else {
             r->cstroke = GrAllocColor2(pctx->stroke);
         }
+    }
+}
+
+static void set_renderctx(RenderCtx *r, MsvgPaintCtx *pctx)
+{
+    // gradients and stroke width depend on the element transformation,
+    // a gradient is converted again only if it changed
+    if (pctx->fill != NO_COLOR && pctx->fill_bps) {
+        if (r->fill_grd == NULL ||
+            !MsvgEqualBPServer(r->fill_bps, pctx->fill_bps)) {
+            if (r->fill_grd) GrDestroyPattern(r->fill_grd);
+            r->fill_grd = convert_gradient(pctx->fill_bps);
+            if (r->fill_bps) MsvgDestroyBPServer(r->fill_bps);
+            r->fill_bps = MsvgRefBPServer(pctx->fill_bps);
+        }
+    }
+    if (pctx->stroke != NO_COLOR) {
+        if (pctx->stroke_bps) {
+            if (r->stroke_grd == NULL ||
+                !MsvgEqualBPServer(r->stroke_bps, pctx->stroke_bps)) {
+                if (r->stroke_grd) GrDestroyPattern(r->stroke_grd);
+                r->stroke_grd = convert_gradient(pctx->stroke_bps);
+                if (r->stroke_bps) MsvgDestroyBPServer(r->stroke_bps);
+                r->stroke_bps = MsvgRefBPServer(pctx->stroke_bps);
+            }
+        }
         r->istroke_width = pctx->stroke_width + 0.5;
         if (r->istroke_width < 1) r->istroke_width = 1;
         r->lopt.lno_color = r->cstroke;
@@ -121,66 +149,64 @@ static void free_renderctx(RenderCtx *r)
 {
     if (r->fill_grd) GrDestroyPattern(r->fill_grd);
     if (r->stroke_grd) GrDestroyPattern(r->stroke_grd);
+    if (r->fill_bps) MsvgDestroyBPServer(r->fill_bps);
+    if (r->stroke_bps) MsvgDestroyBPServer(r->stroke_bps);
 }
 
-static void DrawRectElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawRectElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                            RenderCtx *r)
 {
-    RenderCtx r;
     int x1, y1, x2, y2;
 
     get_icoord(&x1, &y1, el->prectattr->x, el->prectattr->y);
     get_icoord(&x2, &y2,
                el->prectattr->x+el->prectattr->width,
                el->prectattr->y+el->prectattr->height);
-    build_renderctx(&r, pctx);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledBox(x1, y1, x2, y2, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledBox(x1, y1, x2, y2, r->fill_grd);
         } else {
-            GrFilledBox(x1, y1, x2, y2, r.cfill);
+            GrFilledBox(x1, y1, x2, y2, r->cfill);
         }
     }
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedBox(x1, y1, x2, y2, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedBox(x1, y1, x2, y2, &(r->lpat));
         } else {
-            GrCustomBox(x1, y1, x2, y2, &(r.lopt));
+            GrCustomBox(x1, y1, x2, y2, &(r->lopt));
         }
     }
-    free_renderctx(&r);
 }
 
-static void DrawCircleElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawCircleElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                              RenderCtx *r)
 {
-    RenderCtx r;
     int cx, cy, rx, ry;
 
     get_icoord(&cx, &cy, el->pcircleattr->cx, el->pcircleattr->cy);
     rx = el->pcircleattr->r + 0.5;
     ry = el->pcircleattr->r + 0.5;
-    build_renderctx(&r, pctx);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledEllipse(cx, cy, rx, ry, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledEllipse(cx, cy, rx, ry, r->fill_grd);
         } else {
-            GrFilledEllipse(cx, cy, rx, ry, r.cfill);
+            GrFilledEllipse(cx, cy, rx, ry, r->cfill);
         }
     }
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedEllipse(cx, cy, rx, ry, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedEllipse(cx, cy, rx, ry, &(r->lpat));
         } else {
-            GrCustomEllipse(cx, cy, rx, ry, &(r.lopt));
+            GrCustomEllipse(cx, cy, rx, ry, &(r->lopt));
         }
     } 
-    free_renderctx(&r);
 }
 
-static void DrawEllipseElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawEllipseElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                               RenderCtx *r)
 {
-    RenderCtx r;
     int points[GR_MAX_ELLIPSE_POINTS][2];
     int npoints;
     int i, x, y;
@@ -210,47 +236,43 @@ static void DrawEllipseElement(MsvgElement *el, MsvgPaintCtx *pctx)
         points[i][0] = (cosang * x + sinang * y) + icx + 0.5;
         points[i][1] = (-sinang * x + cosang * y) + icy + 0.5;
     }
-    build_renderctx(&r, pctx);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledPolygon(npoints, points, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledPolygon(npoints, points, r->fill_grd);
         } else {
-            GrFilledPolygon(npoints, points, r.cfill);
+            GrFilledPolygon(npoints, points, r->cfill);
         }
     }
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedPolygon(npoints, points, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedPolygon(npoints, points, &(r->lpat));
         } else {
-            GrCustomPolygon(npoints, points, &(r.lopt));
+            GrCustomPolygon(npoints, points, &(r->lopt));
         }
     }
-    free_renderctx(&r);
 }
 
-static void DrawLineElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawLineElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                            RenderCtx *r)
 {
-    RenderCtx r;
     int x1, y1, x2, y2;
 
     get_icoord(&x1, &y1, el->plineattr->x1, el->plineattr->y1);
     get_icoord(&x2, &y2, el->plineattr->x2, el->plineattr->y2);
-    build_renderctx(&r, pctx);
 
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedLine(x1, y1, x2, y2, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedLine(x1, y1, x2, y2, &(r->lpat));
         } else {
-            GrCustomLine(x1, y1, x2, y2, &(r.lopt));
+            GrCustomLine(x1, y1, x2, y2, &(r->lopt));
         }
     }
-    free_renderctx(&r);
 }
 
-static void DrawPolylineElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawPolylineElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                                RenderCtx *r)
 {
-    RenderCtx r;
     int i, npoints, (*points)[2];
     
     npoints = el->ppolylineattr->npoints;
@@ -262,29 +284,27 @@ static void DrawPolylineElement(MsvgElement *el, MsvgPaintCtx *pctx)
                    el->ppolylineattr->points[i*2],
                    el->ppolylineattr->points[i*2+1]);
     }
-    build_renderctx(&r, pctx);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledPolygon(npoints, points, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledPolygon(npoints, points, r->fill_grd);
         } else {
-            GrFilledPolygon(npoints, points, r.cfill);
+            GrFilledPolygon(npoints, points, r->cfill);
         }
     }
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedPolyLine(npoints, points, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedPolyLine(npoints, points, &(r->lpat));
         } else {
-            GrCustomPolyLine(npoints, points, &(r.lopt));
+            GrCustomPolyLine(npoints, points, &(r->lopt));
         }
     }
-    free_renderctx(&r);
     free(points);
 }
 
-static void DrawPolygonElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawPolygonElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                               RenderCtx *r)
 {
-    RenderCtx r;
     int i, npoints, (*points)[2];
     
     npoints = el->ppolygonattr->npoints;
@@ -296,45 +316,50 @@ static void DrawPolygonElement(MsvgElement *el, MsvgPaintCtx *pctx)
                    el->ppolygonattr->points[i*2],
                    el->ppolygonattr->points[i*2+1]);
     }
-    build_renderctx(&r, pctx);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledPolygon(npoints, points, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledPolygon(npoints, points, r->fill_grd);
         } else {
-            GrFilledPolygon(npoints, points, r.cfill);
+            GrFilledPolygon(npoints, points, r->cfill);
         }
     }
     if (pctx->stroke != NO_COLOR) {
-        if (r.stroke_grd) {
-            GrPatternedPolygon(npoints, points, &(r.lpat));
+        if (r->stroke_grd) {
+            GrPatternedPolygon(npoints, points, &(r->lpat));
         } else {
-            GrCustomPolygon(npoints, points, &(r.lopt));
+            GrCustomPolygon(npoints, points, &(r->lopt));
         }
     }
-    free_renderctx(&r);
     free(points);
 }
 
 #if MGRX_VERSION_API >= 0x0143
-static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                            RenderCtx *r)
 {
 /* we have MGRX multipolygons :-) */
-    RenderCtx r;
-    MsvgSubPath *sp;
+    MsvgSubPath *sp, *sp0;
     GrPath *gp;
     GrExpPointArray *pa;
     int x, y, i, k, nsp;
     GrMultiPointArray *mpa = NULL;
 
-    nsp = MsvgCountSubPaths(el->ppathattr->sp);
-    if (nsp < 1) return;
+    sp0 = MsvgReadSubPath(el);
+    nsp = MsvgCountSubPaths(sp0);
+    if (nsp < 1) {
+        MsvgDestroySubPath(sp0);
+        return;
+    }
 
     mpa = malloc(sizeof(GrMultiPointArray)+sizeof(GrPointArray)*(nsp-1));
-    if (mpa == NULL) return;
+    if (mpa == NULL) {
+        MsvgDestroySubPath(sp0);
+        return;
+    }
     mpa->npa = nsp;
 
-    sp = el->ppathattr->sp;
+    sp = sp0;
     for (k=0; k<nsp; k++) {
         mpa->p[k].npoints = 0;
         mpa->p[k].points = NULL;
@@ -356,30 +381,29 @@ static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
         }
         sp = sp->next;
     }
-
-    build_renderctx(&r, pctx);
+    MsvgDestroySubPath(sp0);
 
     if (pctx->fill != NO_COLOR) {
-        if (r.fill_grd) {
-            GrPatternFilledMultiPolygon(mpa, r.fill_grd);
+        if (r->fill_grd) {
+            GrPatternFilledMultiPolygon(mpa, r->fill_grd);
         } else {
-            GrFilledMultiPolygon(mpa, r.cfill);
+            GrFilledMultiPolygon(mpa, r->cfill);
         }
     }
 
     if (pctx->stroke != NO_COLOR) {
         for (k=0; k<nsp; k++) {
             if (mpa->p[k].closed) {
-                if (r.stroke_grd) {
-                    GrPatternedPolygon(mpa->p[k].npoints, mpa->p[k].points, &(r.lpat));
+                if (r->stroke_grd) {
+                    GrPatternedPolygon(mpa->p[k].npoints, mpa->p[k].points, &(r->lpat));
                 } else {
-                    GrCustomPolygon(mpa->p[k].npoints, mpa->p[k].points, &(r.lopt));
+                    GrCustomPolygon(mpa->p[k].npoints, mpa->p[k].points, &(r->lopt));
                 }
             } else {
-                if (r.stroke_grd) {
-                    GrPatternedPolyLine(mpa->p[k].npoints, mpa->p[k].points, &(r.lpat));
+                if (r->stroke_grd) {
+                    GrPatternedPolyLine(mpa->p[k].npoints, mpa->p[k].points, &(r->lpat));
                 } else {
-                    GrCustomPolyLine(mpa->p[k].npoints, mpa->p[k].points, &(r.lopt));
+                    GrCustomPolyLine(mpa->p[k].npoints, mpa->p[k].points, &(r->lopt));
                 }
             }
         }
@@ -388,30 +412,27 @@ static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
     for (k=0; k<nsp; k++)
         if (mpa->p[k].points) free(mpa->p[k].points);
     free(mpa);
-
-    free_renderctx(&r);
 }
 
 #else
 
-static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
+static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx,
+                            RenderCtx *r)
 {
 /* if we don't have MGRX multipolygons we use a hack to detect if a polygon is
  * inside of another one and fill with the backgroud color, at least it works
  * ok drawing glyphs like "ià"
  */
-    RenderCtx r;
     GrColor rcfill, bg;
-    MsvgSubPath *sp;
+    MsvgSubPath *sp, *sp0;
     GrPath *gp;
     GrExpPointArray *pa, *fpa;
     int x, y, i, inside;
 
-    build_renderctx(&r, pctx);
-
     fpa = NULL;
     bg = glob_bg;
-    sp = el->ppathattr->sp;
+    sp0 = MsvgReadSubPath(el);
+    sp = sp0;
     while (sp) {
         gp = GrNewPath(sp->npoints);
         if (gp) {
@@ -427,33 +448,33 @@ static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
                         inside = GrInsidePolygonTest(fpa->npoints, fpa->points, 
                                                      pa->points[0][0],
                                                      pa->points[0][1]);
-                        rcfill = inside ? bg : r.cfill;
+                        rcfill = inside ? bg : r->cfill;
                         if (!inside) {
                             GrDestroyExpPointArray(fpa);
                             fpa = NULL;
                         }
                     } else {
                         //bg = GrPixel(pa->points[0][0], pa->points[0][1]);
-                        rcfill = r.cfill;
+                        rcfill = r->cfill;
                     }
-                    if (r.fill_grd) {
-                        GrPatternFilledPolygon(pa->npoints, pa->points, r.fill_grd);
+                    if (r->fill_grd) {
+                        GrPatternFilledPolygon(pa->npoints, pa->points, r->fill_grd);
                     } else {
                         GrFilledPolygon(pa->npoints, pa->points, rcfill);
                     }
                 }
                 if (pctx->stroke != NO_COLOR) {
                     if (pa->closed) {
-                        if (r.stroke_grd) {
-                            GrPatternedPolygon(pa->npoints, pa->points, &(r.lpat));
+                        if (r->stroke_grd) {
+                            GrPatternedPolygon(pa->npoints, pa->points, &(r->lpat));
                         } else {
-                            GrCustomPolygon(pa->npoints, pa->points, &(r.lopt));
+                            GrCustomPolygon(pa->npoints, pa->points, &(r->lopt));
                         }
                     } else {
-                        if (r.stroke_grd) {
-                            GrPatternedPolyLine(pa->npoints, pa->points, &(r.lpat));
+                        if (r->stroke_grd) {
+                            GrPatternedPolyLine(pa->npoints, pa->points, &(r->lpat));
                         } else {
-                            GrCustomPolyLine(pa->npoints, pa->points, &(r.lopt));
+                            GrCustomPolyLine(pa->npoints, pa->points, &(r->lopt));
                         }
                     }
                 }
@@ -468,48 +489,59 @@ static void DrawPathElement(MsvgElement *el, MsvgPaintCtx *pctx)
         }
         sp = sp->next;
     }
+    MsvgDestroySubPath(sp0);
     if (fpa) {
         GrDestroyExpPointArray(fpa);
     }
-    free_renderctx(&r);
 }
 
 #endif
 
-static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+static void sbufn(MsvgSerItem *item, int nitems, void *udata)
 {
+    RenderCtx r;
     MsvgElement *newel;
+    int i;
+
+    // all the items share the paint state
+    init_renderctx(&r, &(item[0].pctx));
+
+    for (i=0; i<nitems; i++) {
+        newel = MsvgTransformCookedElement(item[i].el, &(item[i].pctx), 0);
+        if (newel == NULL) continue;
+
+        set_renderctx(&r, newel->pctx);
+
+        switch (newel->eid) {
+            case EID_RECT :
+                DrawRectElement(newel, newel->pctx, &r);
+                break;
+            case EID_CIRCLE :
+                DrawCircleElement(newel, newel->pctx, &r);
+                break;
+            case EID_ELLIPSE :
+                DrawEllipseElement(newel, newel->pctx, &r);
+                break;
+            case EID_LINE :
+                DrawLineElement(newel, newel->pctx, &r);
+                break;
+            case EID_POLYLINE :
+                DrawPolylineElement(newel, newel->pctx, &r);
+                break;
+            case EID_POLYGON :
+                DrawPolygonElement(newel, newel->pctx, &r);
+                break;
+            case EID_PATH :
+                DrawPathElement(newel, newel->pctx, &r);
+                break;
+            default :
+                break;
+        }
 
-    newel = MsvgTransformCookedElement(el, pctx, 0);
-    if (newel == NULL) return;
-
-    switch (newel->eid) {
-        case EID_RECT :
-            DrawRectElement(newel, newel->pctx);
-            break;
-        case EID_CIRCLE :
-            DrawCircleElement(newel, newel->pctx);
-            break;
-        case EID_ELLIPSE :
-            DrawEllipseElement(newel, newel->pctx);
-            break;
-        case EID_LINE :
-            DrawLineElement(newel, newel->pctx);
-            break;
-        case EID_POLYLINE :
-            DrawPolylineElement(newel, newel->pctx);
-            break;
-        case EID_POLYGON :
-            DrawPolygonElement(newel, newel->pctx);
-            break;
-        case EID_PATH :
-            DrawPathElement(newel, newel->pctx);
-            break;
-        default :
-            break;
+        MsvgDeleteElement(newel);
     }
 
-    MsvgDeleteElement(newel);
+    free_renderctx(&r);
 }
 
 int GrDrawSVGtree(MsvgElement *root, GrSVGDrawMode *sdm)
@@ -518,7 +550,7 @@ int GrDrawSVGtree(MsvgElement *root, GrSVGDrawMode *sdm)
     double ratiow, ratioh, rvb_width, rvb_height;
     int ret;
     double cx, cy;
-    TMatrix taux1, taux2, taux3, tsave;
+    TMatrix taux1, taux2, taux3;
     double scale_x, scale_y;
 
     if (root == NULL) return -1;
@@ -592,11 +624,9 @@ int GrDrawSVGtree(MsvgElement *root, GrSVGDrawMode *sdm)
     TMSetTranslation(&taux2, -root->psvgattr->vb_min_x, -root->psvgattr->vb_min_y);
     TMMpy(&glob_tuser, &taux1, &taux2);
 
-    tsave = root->pctx->tmatrix;
-    TMMpy(&(root->pctx->tmatrix), &glob_tuser, &tsave);
-
-    ret = MsvgSerCookedTree(root, sufn, NULL, 1);
-    root->pctx->tmatrix = tsave;
+    // the view is not set in the tree, it can be frozen
+    ret = MsvgSerCookedTreeBatchView(root, sbufn, NULL, 1, MAX_BATCH_ITEMS,
+                                     NULL, &glob_tuser);
     if (ret != 1) return -6;
 
     return 0;
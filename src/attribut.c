@@ -31,11 +31,57 @@
 #include "msvg.h"
 #include "util.h"
 
+static void releaseRawAttributes(MsvgRawAttribute *cattr)
+{
+    MsvgRawAttribute *nattr;
+
+    // a node is freed with the last list that has it
+    while (cattr && --(cattr->nrefs) <= 0) {
+        if (cattr->key) free(cattr->key);
+        if (cattr->value) free(cattr->value);
+        nattr = cattr->nrattr;
+        free(cattr);
+        cattr = nattr;
+    }
+}
+
+static int ownRawAttributes(MsvgElement *el)
+{
+    MsvgRawAttribute *cattr, *first, **dptr;
+
+    // only whole lists are shared, by MsvgDupElement, and they are copied
+    // before the first change
+    if (el->frattr == NULL || el->frattr->nrefs < 2) return 1;
+
+    first = NULL;
+    dptr = &first;
+    for (cattr=el->frattr; cattr!=NULL; cattr=cattr->nrattr) {
+        *dptr = calloc(1, sizeof(MsvgRawAttribute));
+        if (*dptr == NULL) break;
+        (*dptr)->nrefs = 1;
+        (*dptr)->key = strdup(cattr->key);
+        (*dptr)->value = strdup(cattr->value);
+        if ((*dptr)->key == NULL || (*dptr)->value == NULL) break;
+        dptr = &((*dptr)->nrattr);
+    }
+    if (cattr != NULL) {
+        releaseRawAttributes(first);
+        return 0;
+    }
+
+    releaseRawAttributes(el->frattr);
+    el->frattr = first;
+
+    return 1;
+}
+
 static int addRawAttribute(MsvgElement *el, const char *key, const char *value)
 {
     MsvgRawAttribute **dptr;
     MsvgRawAttribute *pattr;
     
+    if (!ownRawAttributes(el)) return 0;
+
     dptr = &(el->frattr);
     while (*dptr)
         dptr = &((*dptr)->nrattr);
@@ -57,6 +103,7 @@ static int addRawAttribute(MsvgElement *el, const char *key, const char *value)
     }
     
     pattr->nrattr = NULL;
+    pattr->nrefs = 1;
     
     *dptr = pattr;
     return 1;
@@ -111,6 +158,9 @@ int MsvgDelRawAttribute(MsvgElement *el, const char *key)
     MsvgRawAttribute **dptr;
     MsvgRawAttribute *nattr;
 
+    if (MsvgFindRawAttribute(el, key) == NULL) return 0;
+    if (!ownRawAttributes(el)) return 0;
+
     dptr = &(el->frattr);
     while (*dptr) {
         if (strcmp((*dptr)->key, key) == 0) {
@@ -129,18 +179,12 @@ int MsvgDelRawAttribute(MsvgElement *el, const char *key)
 
 int MsvgDelAllRawAttributes(MsvgElement *el)
 {
-    MsvgRawAttribute *cattr, *nattr;
+    MsvgRawAttribute *cattr;
     int deleted = 0;
     
-    cattr = el->frattr;
-    while (cattr) {
-        if (cattr->key) free(cattr->key);
-        if (cattr->value) free(cattr->value);
-        nattr = cattr->nrattr;
-        free(cattr);
+    for (cattr=el->frattr; cattr!=NULL; cattr=cattr->nrattr)
         deleted++;
-        cattr = nattr;
-    }
+    releaseRawAttributes(el->frattr);
     
     el->frattr = NULL;
     return deleted;
@@ -151,11 +195,15 @@ int MsvgDelAllTreeRawAttributes(MsvgElement *el)
     MsvgElement *ptr;
     int deleted = 0;
     
-    deleted = MsvgDelAllRawAttributes(el);
-
-    ptr = el->fson;
-    while (ptr) {
-        deleted += MsvgDelAllTreeRawAttributes(ptr);
+    ptr = el;
+    for (;;) {
+        deleted += MsvgDelAllRawAttributes(ptr);
+        if (ptr->fson) {
+            ptr = ptr->fson;
+            continue;
+        }
+        while (ptr != el && ptr->nsibling == NULL) ptr = ptr->father;
+        if (ptr == el) break;
         ptr = ptr->nsibling;
     }
 
@@ -176,19 +224,60 @@ int MsvgCopyRawAttributes(MsvgElement *desel, const MsvgElement *srcel)
     return copied;
 }
 
-int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
+int MsvgI_ShareRawAttributes(MsvgElement *desel, MsvgElement *srcel)
+{
+    MsvgRawAttribute *cattr;
+    int shared = 0;
+
+    if (desel->frattr) return MsvgCopyRawAttributes(desel, srcel);
+
+    desel->frattr = srcel->frattr;
+    if (desel->frattr) desel->frattr->nrefs++;
+    for (cattr=desel->frattr; cattr!=NULL; cattr=cattr->nrattr)
+        shared++;
+
+    return shared;
+}
+
+static MsvgPackedPath *sharePath(MsvgElement *srcel, char *d, MsvgSubPath *sp,
+                                 MsvgPackedPath *pp)
+{
+    // the pending path-data is scanned in the source
+    if (d) pp = MsvgGetPackedPath(srcel);
+    if (pp) {
+        pp->nrefs++;
+        return pp;
+    }
+
+    // the subpaths set by program are packed for the copy only
+    return sp ? MsvgPackSubPath(sp) : NULL;
+}
+
+static int copyCookedAttributes(MsvgElement *desel, MsvgElement *srcel, int share)
 {
     int i;
 
     if (srcel->eid != desel->eid) return 0;
 
-    if (desel->id) free(desel->id);
-    if (srcel->id) desel->id = strdup(srcel->id);
+    // the id index of the desel tree is kept updated
+    MsvgI_ReplaceElementId(desel, srcel->id ? strdup(srcel->id) : NULL);
     if (srcel->pctx && desel->pctx) MsvgCopyPaintCtx(desel->pctx, srcel->pctx);
 
     switch (srcel->eid) {
         case EID_SVG :
+            // the indexes and the use cache are not copied
+            MsvgDestroyRTree(desel);
+            MsvgDestroyUseCache(desel);
+            MsvgDestroyIdIndex(desel);
+            MsvgDestroyPaintCtxCache(desel);
+            MsvgDestroyChangeJournal(desel);
             *(desel->psvgattr) = *(srcel->psvgattr);
+            desel->psvgattr->rtree = NULL;
+            desel->psvgattr->usecache = NULL;
+            desel->psvgattr->idindex = NULL;
+            desel->psvgattr->pctxcache = 0;
+            desel->psvgattr->journal = NULL;
+            desel->psvgattr->frozen = 0;
             break;
         case EID_DEFS :
             *(desel->pdefsattr) = *(srcel->pdefsattr);
@@ -216,6 +305,13 @@ int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
             *(desel->plineattr) = *(srcel->plineattr);
             break;
         case EID_POLYLINE :
+            if (share) {
+                if (!MsvgI_SharePoints(&(desel->ppolylineattr->points),
+                    &(desel->ppolylineattr->nrefs), srcel->ppolylineattr->points,
+                    &(srcel->ppolylineattr->nrefs))) return 0;
+                desel->ppolylineattr->npoints = srcel->ppolylineattr->npoints;
+                break;
+            }
             if (!MsvgAllocPointsToPolylineElement(desel,
                 srcel->ppolylineattr->npoints)) return 0;
             desel->ppolylineattr->npoints = srcel->ppolylineattr->npoints;
@@ -227,6 +323,13 @@ int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
             }
             break;
         case EID_POLYGON :
+            if (share) {
+                if (!MsvgI_SharePoints(&(desel->ppolygonattr->points),
+                    &(desel->ppolygonattr->nrefs), srcel->ppolygonattr->points,
+                    &(srcel->ppolygonattr->nrefs))) return 0;
+                desel->ppolygonattr->npoints = srcel->ppolygonattr->npoints;
+                break;
+            }
             if (!MsvgAllocPointsToPolygonElement(desel,
                 srcel->ppolygonattr->npoints)) return 0;
             desel->ppolygonattr->npoints = srcel->ppolygonattr->npoints;
@@ -239,19 +342,38 @@ int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
             break;
         case EID_PATH :
             if (desel->ppathattr->sp) MsvgDestroySubPath(desel->ppathattr->sp);
+            if (desel->ppathattr->d) free(desel->ppathattr->d);
+            if (desel->ppathattr->pp) MsvgDestroyPackedPath(desel->ppathattr->pp);
             *(desel->ppathattr) = *(srcel->ppathattr);
+            if (share) {
+                desel->ppathattr->sp = NULL;
+                desel->ppathattr->d = NULL;
+                desel->ppathattr->pp = sharePath(srcel, srcel->ppathattr->d,
+                    srcel->ppathattr->sp, srcel->ppathattr->pp);
+                break;
+            }
             if (srcel->ppathattr->sp) {
                 desel->ppathattr->sp = MsvgDupSubPath(srcel->ppathattr->sp);
             }
+            if (srcel->ppathattr->d) {
+                desel->ppathattr->d = strdup(srcel->ppathattr->d);
+            }
+            if (srcel->ppathattr->pp) {
+                desel->ppathattr->pp = MsvgDupPackedPath(srcel->ppathattr->pp);
+            }
             break;
         case EID_TEXT :
             *(desel->ptextattr) = *(srcel->ptextattr);
             break;
         case EID_LINEARGRADIENT :
+            if (desel->plgradattr->bps) MsvgDestroyBPServer(desel->plgradattr->bps);
             *(desel->plgradattr) = *(srcel->plgradattr);
+            desel->plgradattr->bps = NULL; // compiled again from its own stops
             break;
         case EID_RADIALGRADIENT :
+            if (desel->prgradattr->bps) MsvgDestroyBPServer(desel->prgradattr->bps);
             *(desel->prgradattr) = *(srcel->prgradattr);
+            desel->prgradattr->bps = NULL;
             break;
         case EID_STOP :
             *(desel->pstopattr) = *(srcel->pstopattr);
@@ -271,10 +393,25 @@ int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
         case EID_MISSINGGLYPH :
         case EID_GLYPH :
             if (desel->pglyphattr->sp) MsvgDestroySubPath(desel->pglyphattr->sp);
+            if (desel->pglyphattr->d) free(desel->pglyphattr->d);
+            if (desel->pglyphattr->pp) MsvgDestroyPackedPath(desel->pglyphattr->pp);
             *(desel->pglyphattr) = *(srcel->pglyphattr);
+            if (share) {
+                desel->pglyphattr->sp = NULL;
+                desel->pglyphattr->d = NULL;
+                desel->pglyphattr->pp = sharePath(srcel, srcel->pglyphattr->d,
+                    srcel->pglyphattr->sp, srcel->pglyphattr->pp);
+                break;
+            }
             if (srcel->pglyphattr->sp) {
                 desel->pglyphattr->sp = MsvgDupSubPath(srcel->pglyphattr->sp);
             }
+            if (srcel->pglyphattr->d) {
+                desel->pglyphattr->d = strdup(srcel->pglyphattr->d);
+            }
+            if (srcel->pglyphattr->pp) {
+                desel->pglyphattr->pp = MsvgDupPackedPath(srcel->pglyphattr->pp);
+            }
             break;
         default :
             break;
@@ -282,3 +419,14 @@ int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
 
     return 1;
 }
+
+int MsvgCopyCookedAttributes(MsvgElement *desel, const MsvgElement *srcel)
+{
+    // srcel is changed only to share its geometry
+    return copyCookedAttributes(desel, (MsvgElement *)srcel, 0);
+}
+
+int MsvgI_ShareCookedAttributes(MsvgElement *desel, MsvgElement *srcel)
+{
+    return copyCookedAttributes(desel, srcel, 1);
+}
@@ -87,12 +87,12 @@ MsvgBFont *MsvgNewBFont(MsvgElement *el)
             bfont->descent = nson->pfontfaceattr->descent;
         } else if (nson->eid == EID_MISSINGGLYPH) {
             bfont->missing.horiz_adv_x = nson->pglyphattr->horiz_adv_x;
-            bfont->missing.sp = MsvgDupSubPath(nson->pglyphattr->sp);
+            bfont->missing.sp = MsvgUnpackPath(MsvgGetPackedPath(nson));
         } else if (nson->eid == EID_GLYPH) {
             if (nson->pglyphattr->unicode >= 0 && bfont->num_glyphs < ng) {
                 bfont->glyph[bfont->num_glyphs].unicode = nson->pglyphattr->unicode;
                 bfont->glyph[bfont->num_glyphs].horiz_adv_x = nson->pglyphattr->horiz_adv_x;
-                bfont->glyph[bfont->num_glyphs].sp = MsvgDupSubPath(nson->pglyphattr->sp);
+                bfont->glyph[bfont->num_glyphs].sp = MsvgUnpackPath(MsvgGetPackedPath(nson));
                 bfont->num_glyphs++;
             }
         }
@@ -201,14 +201,17 @@ MsvgElement *MsvgCharToPath(long unicode, double font_size, double *advx, MsvgBF
     return path;
 }
 
+#define TPCACHE 64
+
 MsvgElement *MsvgTextToPathGroup(MsvgElement *el, MsvgBFont *bfont)
 {
     MsvgElement *group, *path;
-    TMatrix trans;
-    MsvgSubPath *sp;
+    MsvgElement *cpath[TPCACHE];
+    long cucp[TPCACHE];
+    double cadvx[TPCACHE];
     unsigned char *p;
     double x, y, advx, font_size;
-    int i, nb, text_anchor;
+    int k, nb, text_anchor;
     long ucp;
 
     if (el->eid != EID_TEXT) return NULL;
@@ -234,18 +237,31 @@ MsvgElement *MsvgTextToPathGroup(MsvgElement *el, MsvgBFont *bfont)
             x -= advx;
     }
 
+    // every char is placed with a translation, so the paths of the same
+    // char share the packed outline, the last ones are kept by unicode
+    for (k=0; k<TPCACHE; k++) cpath[k] = NULL;
+
     while (*p) {
         ucp = MsvgI_NextUCPfromUTF8Str(p, &nb);
-        path = MsvgCharToPath(ucp, font_size, &advx, bfont);
-        if (path) {
-            TMSetTranslation(&trans, x, y);
-            sp = path->ppathattr->sp;
-            while (sp) {
-                for (i=0; i<sp->npoints; i++) {
-                    TMTransformCoord(&(sp->spp[i].x), &(sp->spp[i].y), &trans);
+        k = ucp & (TPCACHE - 1);
+        if (cpath[k] && cucp[k] == ucp) {
+            path = MsvgDupElement(cpath[k], 0);
+            advx = cadvx[k];
+        } else {
+            path = MsvgCharToPath(ucp, font_size, &advx, bfont);
+            if (path && path->ppathattr->sp) {
+                path->ppathattr->pp = MsvgPackSubPath(path->ppathattr->sp);
+                if (path->ppathattr->pp) {
+                    MsvgDestroySubPath(path->ppathattr->sp);
+                    path->ppathattr->sp = NULL;
+                    cpath[k] = path;
+                    cucp[k] = ucp;
+                    cadvx[k] = advx;
                 }
-                sp = sp->next;
             }
+        }
+        if (path) {
+            TMSetTranslation(&(path->pctx->tmatrix), x, y);
             x += advx;
             MsvgInsertSonElement(path, group);
         }
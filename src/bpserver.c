@@ -32,16 +32,82 @@
 #include "msvg.h"
 #include "util.h"
 
-MsvgBPServer *MsvgNewBPServer(MsvgElement *el)
+/* A gradient element is compiled once to a binary paint server cached in
+ * the element, with the stops arrays in the same allocation. It is never
+ * changed after, the copies made for every shape (to calculate the units
+ * or apply a matrix) share its stops and hold a reference to it. A struct
+ * copy keeps the stops owner too, so it can be specialized again.
+ *
+ * The servers cached in a frozen tree are pinned, their counter is not
+ * changed, so the readers can share them without locks. The copies and
+ * references taken from a pinned server get their own stops, so they
+ * don't depend on it after the tree is thawed.
+ */
+
+static MsvgBPServer **cached_bps(MsvgElement *el)
+{
+    if (el->eid == EID_LINEARGRADIENT) return &(el->plgradattr->bps);
+    if (el->eid == EID_RADIALGRADIENT) return &(el->prgradattr->bps);
+    return NULL;
+}
+
+static MsvgBGradientStops *stops_of(MsvgBPServer *bps)
+{
+    if (bps->type == BPSERVER_LINEARGRADIENT) return &(bps->blg.stops);
+    return &(bps->brg.stops);
+}
+
+static MsvgBPServer *alloc_bps(int nst, MsvgBGradientStops *bstops)
 {
-    MsvgBPServer *bpser;
+    MsvgBPServer *bps;
+    char *data;
+
+    // the doubles go first after the header, that is a multiple of the
+    // double size because it has doubles
+    bps = (MsvgBPServer *)malloc(sizeof(MsvgBPServer) +
+                                 nst * (2 * sizeof(double) + sizeof(rgbcolor)));
+    if (bps == NULL) return NULL;
+
+    data = (char *)(bps + 1);
+    bstops->offset = (double *)data;
+    bstops->sopacity = (double *)(data + nst * sizeof(double));
+    bstops->scolor = (rgbcolor *)(data + nst * 2 * sizeof(double));
+
+    return bps;
+}
+
+static MsvgBPServer *own_stops_copy(const MsvgBPServer *bps)
+{
+    MsvgBPServer *newbps;
+    MsvgBGradientStops st, *bstops;
+    int nst;
+
+    nst = stops_of((MsvgBPServer *)bps)->nstops;
+    newbps = alloc_bps(nst, &st);
+    if (newbps == NULL) return NULL;
+
+    *newbps = *bps;
+    bstops = stops_of(newbps);
+    memcpy(st.offset, bstops->offset, nst * sizeof(double));
+    memcpy(st.sopacity, bstops->sopacity, nst * sizeof(double));
+    memcpy(st.scolor, bstops->scolor, nst * sizeof(rgbcolor));
+    st.nstops = nst;
+    *bstops = st;
+    newbps->refcount = 1;
+    newbps->pinned = 0;
+    newbps->stops_owner = newbps;
+
+    return newbps;
+}
+
+static MsvgBPServer *compile_bps(MsvgElement *el)
+{
+    MsvgBPServer *bps;
     MsvgBGradientStops *bstops;
+    MsvgBGradientStops st;
     MsvgElement *nson;
     int nst = 0;
 
-    if (el->eid != EID_LINEARGRADIENT &&
-        el->eid != EID_RADIALGRADIENT) return NULL;
-
     nson = el->fson;
     while (nson) {
         if (nson->eid == EID_STOP) {
@@ -51,50 +117,139 @@ MsvgBPServer *MsvgNewBPServer(MsvgElement *el)
     }
 
     if (nst < 2) return NULL;
-    if (nst > BGRADIENT_MAXSTOPS) nst = BGRADIENT_MAXSTOPS;
 
-    bpser = calloc(1, sizeof(MsvgBPServer));
-    if (bpser == NULL) return NULL;
+    bps = alloc_bps(nst, &st);
+    if (bps == NULL) return NULL;
 
     if (el->eid == EID_LINEARGRADIENT) {
-        bpser->type = BPSERVER_LINEARGRADIENT;
-        bpser->blg.gradunits = el->plgradattr->gradunits;
-        bpser->blg.x1 = el->plgradattr->x1;
-        bpser->blg.y1 = el->plgradattr->y1;
-        bpser->blg.x2 = el->plgradattr->x2;
-        bpser->blg.y2 = el->plgradattr->y2;
-        bstops = &(bpser->blg.stops);
-    } else if (el->eid == EID_RADIALGRADIENT) {
-        bpser->type = BPSERVER_RADIALGRADIENT;
-        bpser->brg.gradunits = el->prgradattr->gradunits;
-        bpser->brg.cx = el->prgradattr->cx;
-        bpser->brg.cy = el->prgradattr->cy;
-        bpser->brg.r = el->prgradattr->r;
-        bstops = &(bpser->brg.stops);
+        bps->type = BPSERVER_LINEARGRADIENT;
+        bps->blg.gradunits = el->plgradattr->gradunits;
+        bps->blg.x1 = el->plgradattr->x1;
+        bps->blg.y1 = el->plgradattr->y1;
+        bps->blg.x2 = el->plgradattr->x2;
+        bps->blg.y2 = el->plgradattr->y2;
+        bstops = &(bps->blg.stops);
     } else {
-        free(bpser);
-        return NULL;
+        bps->type = BPSERVER_RADIALGRADIENT;
+        bps->brg.gradunits = el->prgradattr->gradunits;
+        bps->brg.cx = el->prgradattr->cx;
+        bps->brg.cy = el->prgradattr->cy;
+        bps->brg.r = el->prgradattr->r;
+        bstops = &(bps->brg.stops);
     }
+    bps->refcount = 1;
+    bps->pinned = 0;
+    bps->stops_owner = bps;
 
+    *bstops = st;
     bstops->nstops = 0;
     nson = el->fson;
     while (nson) {
         if (nson->eid == EID_STOP) {
-            if (bstops->nstops < nst) {
-                bstops->offset[bstops->nstops] = nson->pstopattr->offset;
-                bstops->sopacity[bstops->nstops] = nson->pstopattr->sopacity;
-                bstops->scolor[bstops->nstops] = nson->pstopattr->scolor;
-                bstops->nstops++;
-            }
+            bstops->offset[bstops->nstops] = nson->pstopattr->offset;
+            bstops->sopacity[bstops->nstops] = nson->pstopattr->sopacity;
+            bstops->scolor[bstops->nstops] = nson->pstopattr->scolor;
+            bstops->nstops++;
         }
         nson = nson->nsibling;
     }
 
-    return bpser;
+    return bps;
+}
+
+MsvgBPServer *MsvgGetBPServer(MsvgElement *el)
+{
+    MsvgBPServer **pbps, *bps;
+
+    pbps = cached_bps(el);
+    if (pbps == NULL) return NULL;
+
+    // a gradient without enough stops is not written, it can be in a
+    // frozen tree
+    if (*pbps == NULL) {
+        bps = compile_bps(el);
+        if (bps) *pbps = bps;
+    }
+
+    return *pbps;
+}
+
+int MsvgI_PinBPServerCache(MsvgElement *el, int pin)
+{
+    MsvgBPServer *bps;
+
+    if (pin) {
+        bps = MsvgGetBPServer(el);
+    } else {
+        bps = *(cached_bps(el));
+    }
+    if (bps == NULL) return 0;
+    bps->pinned = pin ? 1 : 0;
+
+    return 1;
+}
+
+void MsvgI_ClearBPServerCache(MsvgElement *el)
+{
+    MsvgBPServer **pbps;
+
+    pbps = cached_bps(el);
+    if (pbps == NULL) return;
+
+    // the copies in use keep it alive
+    if (*pbps) MsvgDestroyBPServer(*pbps);
+    *pbps = NULL;
+}
+
+MsvgBPServer *MsvgRefBPServer(MsvgBPServer *bps)
+{
+    // a pinned server can't be counted, the reference is a copy
+    if (bps->pinned) return own_stops_copy(bps);
+    bps->refcount++;
+
+    return bps;
+}
+
+MsvgBPServer *MsvgSpecializeBPServer(const MsvgBPServer *bps, MsvgBox *bbox,
+                                     TMatrix *t)
+{
+    MsvgBPServer *newbps;
+
+    if (bps->stops_owner->pinned) {
+        newbps = own_stops_copy(bps);
+        if (newbps == NULL) return NULL;
+    } else {
+        newbps = (MsvgBPServer *)malloc(sizeof(MsvgBPServer));
+        if (newbps == NULL) return NULL;
+        *newbps = *bps;
+        newbps->refcount = 1;
+        newbps->pinned = 0;
+        MsvgRefBPServer(newbps->stops_owner);
+    }
+
+    if (bbox || t) MsvgCalcUnitsBPServer(newbps, bbox, t);
+
+    return newbps;
+}
+
+MsvgBPServer *MsvgNewBPServer(MsvgElement *el)
+{
+    MsvgBPServer *bps;
+
+    bps = MsvgGetBPServer(el);
+    if (bps == NULL) return NULL;
+
+    return MsvgSpecializeBPServer(bps, NULL, NULL);
 }
 
 void MsvgDestroyBPServer(MsvgBPServer *bps)
 {
+    // the copies made before the freeze still release a pinned server,
+    // it is freed after the thaw
+    bps->refcount--;
+    if (bps->refcount > 0 || bps->pinned) return;
+
+    if (bps->stops_owner != bps) MsvgDestroyBPServer(bps->stops_owner);
     free(bps);
 }
 
@@ -146,3 +301,39 @@ int MsvgCalcUnitsBPServer(MsvgBPServer *bps, MsvgBox *bbox, TMatrix *t)
 
     return 0;
 }
+
+static int equal_stops(const MsvgBGradientStops *s1,
+                       const MsvgBGradientStops *s2)
+{
+    int i;
+
+    if (s1->nstops != s2->nstops) return 0;
+    if (s1->offset == s2->offset) return 1; // shared stops
+    for (i=0; i<s1->nstops; i++) {
+        if (s1->offset[i] != s2->offset[i]) return 0;
+        if (s1->sopacity[i] != s2->sopacity[i]) return 0;
+        if (s1->scolor[i] != s2->scolor[i]) return 0;
+    }
+
+    return 1;
+}
+
+int MsvgEqualBPServer(const MsvgBPServer *bps1, const MsvgBPServer *bps2)
+{
+    // field by field, the padding and the refcounts don't matter
+    if (bps1->type != bps2->type) return 0;
+
+    if (bps1->type == BPSERVER_LINEARGRADIENT) {
+        if (bps1->blg.gradunits != bps2->blg.gradunits) return 0;
+        if (bps1->blg.x1 != bps2->blg.x1 || bps1->blg.y1 != bps2->blg.y1) return 0;
+        if (bps1->blg.x2 != bps2->blg.x2 || bps1->blg.y2 != bps2->blg.y2) return 0;
+        return equal_stops(&(bps1->blg.stops), &(bps2->blg.stops));
+    } else if (bps1->type == BPSERVER_RADIALGRADIENT) {
+        if (bps1->brg.gradunits != bps2->brg.gradunits) return 0;
+        if (bps1->brg.cx != bps2->brg.cx || bps1->brg.cy != bps2->brg.cy) return 0;
+        if (bps1->brg.r != bps2->brg.r) return 0;
+        return equal_stops(&(bps1->brg.stops), &(bps2->brg.stops));
+    }
+
+    return 1;
+}
@@ -28,7 +28,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "msvg.h"
+#include "util.h"
 
 static void iniboxmaxmin(MsvgBox *box)
 {
@@ -48,7 +50,7 @@ static void setboxmaxmin(MsvgBox *box, double dx, double dy)
 
 int MsvgGetCookedBoundingBox(MsvgElement *el, MsvgBox *box, int inibox)
 {
-    MsvgSubPath *sp;
+    MsvgPackedPath *pp;
     int i, dx, dy;
 
     if (inibox) iniboxmaxmin(box);
@@ -89,12 +91,10 @@ int MsvgGetCookedBoundingBox(MsvgElement *el, MsvgBox *box, int inibox)
             break;
         case EID_PATH :
             // TODO do it right
-            sp = el->ppathattr->sp;
-            while (sp) {
-                for (i=0; i<sp->npoints; i++) {
-                    setboxmaxmin(box, sp->spp[i].x, sp->spp[i].y);
-                }
-                sp = sp->next;
+            pp = MsvgGetPackedPath(el);
+            if (pp == NULL) break;
+            for (i=0; i<pp->npoints; i++) {
+                setboxmaxmin(box, pp->x[i], pp->y[i]);
             }
             break;
         case EID_TEXT :
@@ -140,3 +140,238 @@ int MsvgGetCookedDims(MsvgElement *root, double *minx, double *maxx,
         return 0;
     }
 }
+
+/* world bounding boxes, in the root user space (without the root matrix),
+ * used to cull elements when serializing */
+
+typedef struct {
+    MsvgElement *root;      // to get tid when needed
+    MsvgTableId *tid;
+    int own_tid;            // tid is not the root id index
+    MsvgI_UseChain *uses;   // referenced elements being expanded
+} WBBoxData;
+
+static void calcWorldBBox(MsvgElement *el, const MsvgPaintCtx *fath,
+                          WBBoxData *wd, MsvgBox *box, int store);
+
+static void unionbox(MsvgBox *box, const MsvgBox *box2)
+{
+    if (box2->gminx > box2->gmaxx) return; // empty box
+    setboxmaxmin(box, box2->gminx, box2->gminy);
+    setboxmaxmin(box, box2->gmaxx, box2->gmaxy);
+}
+
+static void calcLeafWorldBBox(MsvgElement *el, MsvgPaintCtx *pctx, MsvgBox *box)
+{
+    MsvgElement *newel;
+    MsvgEllipseAttributes *pea;
+    double dx, dy, pad = 0;
+
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+
+    switch (newel->eid) {
+        case EID_ELLIPSE :
+            // it can be rotated, use the two semi-axis
+            pea = newel->pellipseattr;
+            dx = sqrt(pow(pea->rx_x-pea->cx, 2) + pow(pea->ry_x-pea->cx, 2));
+            dy = sqrt(pow(pea->rx_y-pea->cy, 2) + pow(pea->ry_y-pea->cy, 2));
+            setboxmaxmin(box, pea->cx-dx, pea->cy-dy);
+            setboxmaxmin(box, pea->cx+dx, pea->cy+dy);
+            break;
+        case EID_TEXT :
+            // rough, the text can be rotated and anchored anywhere
+            if (el->fcontent)
+                pad = newel->pctx->font_size * el->fcontent->len;
+            if (pad < newel->pctx->font_size) pad = newel->pctx->font_size;
+            setboxmaxmin(box, newel->ptextattr->x-pad, newel->ptextattr->y-pad);
+            setboxmaxmin(box, newel->ptextattr->x+pad, newel->ptextattr->y+pad);
+            pad = 0;
+            break;
+        default :
+            MsvgGetCookedBoundingBox(newel, box, 0);
+            break;
+    }
+
+    // enough for the stroke width and most joins
+    if (newel->pctx->stroke != NO_COLOR && newel->pctx->stroke_width > 0)
+        pad = newel->pctx->stroke_width;
+
+    if (box->gminx <= box->gmaxx) {
+        box->gminx -= pad;
+        box->gmaxx += pad;
+        box->gminy -= pad;
+        box->gmaxy += pad;
+    }
+
+    MsvgDeleteElement(newel);
+}
+
+static void calcUseWorldBBox(MsvgElement *el, const MsvgPaintCtx *fath,
+                             WBBoxData *wd, MsvgBox *box)
+{
+    MsvgElement *refel, *ghostg;
+    MsvgI_UseChain link;
+    TMatrix uset;
+
+    if (wd->tid == NULL && wd->root != NULL) {
+        wd->tid = MsvgI_GetTableId(wd->root, &(wd->own_tid));
+        wd->root = NULL; // only one try
+    }
+    if (wd->tid == NULL) return;
+
+    refel = MsvgFindIdTableId(wd->tid, el->puseattr->refel);
+    if (refel == NULL) return;
+    if (MsvgI_InUseChain(wd->uses, refel)) return; // reference cycle
+
+    // the ghost G element holds the use context
+    ghostg = MsvgNewElement(EID_G, NULL);
+    if (ghostg == NULL) return;
+
+    link.refel = refel;
+    link.prev = wd->uses;
+    wd->uses = &link;
+
+    MsvgCopyPaintCtx(ghostg->pctx, el->pctx);
+    TMSetTranslation(&uset, el->puseattr->x, el->puseattr->y);
+    TMMpy(&(ghostg->pctx->tmatrix), &(el->pctx->tmatrix), &uset);
+    MsvgProcPaintCtxInheritance(ghostg->pctx, fath);
+
+    // the referenced element boxes are not stored, they are not in
+    // their tree position
+    calcWorldBBox(refel, ghostg->pctx, wd, box, 0);
+
+    MsvgDeleteElement(ghostg);
+
+    wd->uses = link.prev;
+}
+
+static void calcWorldBBox(MsvgElement *el, const MsvgPaintCtx *fath,
+                          WBBoxData *wd, MsvgBox *box, int store)
+{
+    MsvgPaintCtx *pctx;
+    MsvgElement *pel;
+    MsvgBox sonbox;
+
+    iniboxmaxmin(box);
+
+    switch (el->eid) {
+        case EID_SVG :
+        case EID_G :
+            if (el->eid == EID_SVG && fath != NULL) return;
+            pctx = MsvgNewPaintCtx(el->pctx);
+            if (pctx == NULL) return;
+            if (fath)
+                MsvgProcPaintCtxInheritance(pctx, fath);
+            else
+                TMSetIdentity(&(pctx->tmatrix));
+            pel = el->fson;
+            while (pel) {
+                calcWorldBBox(pel, pctx, wd, &sonbox, store);
+                unionbox(box, &sonbox);
+                pel = pel->nsibling;
+            }
+            MsvgDestroyPaintCtx(pctx);
+            break;
+        case EID_USE :
+            calcUseWorldBBox(el, fath, wd, box);
+            break;
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            pctx = MsvgNewPaintCtx(el->pctx);
+            if (pctx == NULL) return;
+            MsvgProcPaintCtxInheritance(pctx, fath);
+            MsvgProcPaintCtxDefaults(pctx);
+            calcLeafWorldBBox(el, pctx, box);
+            MsvgDestroyPaintCtx(pctx);
+            break;
+        default :
+            return;
+    }
+
+    if (store) {
+        el->wbbox = *box;
+        el->wbbox_ok = 1;
+    }
+}
+
+int MsvgCalcCookedWorldBBoxes(MsvgElement *root)
+{
+    WBBoxData wd;
+    MsvgBox box;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    wd.root = root;
+    wd.tid = NULL;
+    wd.own_tid = 0;
+    wd.uses = NULL;
+
+    calcWorldBBox(root, NULL, &wd, &box, 1);
+
+    if (wd.own_tid && wd.tid) MsvgDestroyTableId(wd.tid);
+
+    return 1;
+}
+
+MsvgPaintCtx *MsvgI_BuildWorldPaintCtx(MsvgElement *el)
+{
+    MsvgPaintCtx *pctx, *fath;
+
+    if (el->cpctx_ok) return MsvgNewPaintCtx(el->cpctx);
+
+    pctx = MsvgNewPaintCtx(el->pctx);
+    if (pctx == NULL) return NULL;
+
+    if (el->father == NULL) {
+        TMSetIdentity(&(pctx->tmatrix));
+    } else {
+        fath = MsvgI_BuildWorldPaintCtx(el->father);
+        if (fath == NULL) {
+            MsvgDestroyPaintCtx(pctx);
+            return NULL;
+        }
+        MsvgProcPaintCtxInheritance(pctx, fath);
+        MsvgDestroyPaintCtx(fath);
+    }
+
+    return pctx;
+}
+
+int MsvgI_CalcSubtreeWorldBBoxes(MsvgElement *root, MsvgElement *el)
+{
+    WBBoxData wd;
+    MsvgPaintCtx *pctx;
+    MsvgElement *pel;
+    MsvgBox box;
+
+    if (el->father == NULL) return 0;
+
+    pctx = MsvgI_BuildWorldPaintCtx(el->father);
+    if (pctx == NULL) return 0;
+
+    wd.root = root;
+    wd.tid = NULL;
+    wd.own_tid = 0;
+    wd.uses = NULL;
+
+    calcWorldBBox(el, pctx, &wd, &box, 1);
+
+    if (wd.own_tid && wd.tid) MsvgDestroyTableId(wd.tid);
+    MsvgDestroyPaintCtx(pctx);
+
+    // the ancestors boxes only grow, they are not exact after a deletion
+    for (pel=el->father; pel!=NULL; pel=pel->father) {
+        if (pel->wbbox_ok) unionbox(&(pel->wbbox), &box);
+    }
+
+    return 1;
+}
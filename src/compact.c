@@ -0,0 +1,1090 @@
+/* compact.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "msvg.h"
+#include "util.h"
+
+/* A compact tree stores the elements of a cooked tree in preorder in only
+ * one array of nodes, so the sweeps over the whole tree (serialization,
+ * counts or id scans) read the memory in order. The links are indexes, the
+ * first son is always the next node and a subtree goes from its node to the
+ * "end" one. The specific attributes are stored inline in the nodes, and
+ * the strings, the points arrays, the packed paths and the contents in two
+ * pools sized by a first pass, so a compact tree has only six allocations.
+ * The paint contexts are split in a style and a matrix, stored only if
+ * something is set and interned in two tables, most elements share them.
+ * The paint servers of the styles are resolved when compacting, and the
+ * EID_USE references too.
+ *
+ * A compact tree is read only, it can be expanded to a new cooked tree to
+ * change it. The raw attributes and the cached values are not kept.
+ */
+
+#define DALIGN(n) (((n) + sizeof(double) - 1) / sizeof(double) * sizeof(double))
+
+/* The strings, the paint styles (paint contexts without matrix) and the
+ * matrices are interned in the first pass, so every distinct one is stored
+ * only once. The intern tables are hash tables with open addressing and
+ * linear probing, half full at most, like the id tables in find.c, with
+ * the first occurrence as key. */
+
+#define CI_STRING 0
+#define CI_STYLE  1
+#define CI_MATRIX 2
+
+typedef struct {
+    const void *key;        /* first occurrence, NULL = free slot */
+    int index;              /* offset in the strings pool or table index */
+} CInternItem;
+
+typedef struct {
+    int kind;               /* CI_STRING, CI_STYLE or CI_MATRIX */
+    int nitems;
+    int nslots;
+    CInternItem *item;
+    int next;               /* next offset or index to give */
+} CIntern;
+
+typedef struct {
+    MsvgCTree *ct;
+    MsvgTableId *tid;       /* to resolve the paint servers */
+    CIntern strs;
+    CIntern styles;
+    CIntern mats;
+    int dataoff;            /* first free byte of the data pool */
+} CBuild;
+
+static unsigned int hashBytes(unsigned int h, const void *p, int size)
+{
+    const unsigned char *b = (const unsigned char *)p;
+
+    while (size-- > 0) {
+        h ^= *b++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static unsigned int hashString(unsigned int h, const char *s)
+{
+    return s ? hashBytes(h, s, strlen(s)) : hashBytes(h, "", 1);
+}
+
+static int sameString(const char *s1, const char *s2)
+{
+    if (s1 == s2) return 1;
+    if (s1 == NULL || s2 == NULL) return 0;
+    return strcmp(s1, s2) == 0;
+}
+
+/* the style fields are compared bit to bit, like they are hashed */
+
+#define SAMEFIELD(p1, p2, f) (memcmp(&((p1)->f), &((p2)->f), sizeof((p1)->f)) == 0)
+#define HASHFIELD(h, p, f) hashBytes(h, &((p)->f), sizeof((p)->f))
+
+static unsigned int hashStyle(const MsvgPaintCtx *p)
+{
+    unsigned int h = 2166136261u;
+
+    h = HASHFIELD(h, p, fill);
+    h = hashString(h, p->fill_iri);
+    h = HASHFIELD(h, p, fill_opacity);
+    h = HASHFIELD(h, p, fill_rule);
+    h = HASHFIELD(h, p, stroke);
+    h = hashString(h, p->stroke_iri);
+    h = HASHFIELD(h, p, stroke_width);
+    h = HASHFIELD(h, p, stroke_opacity);
+    h = HASHFIELD(h, p, text_anchor);
+    h = hashString(h, p->sfont_family);
+    h = HASHFIELD(h, p, ifont_family);
+    h = HASHFIELD(h, p, font_style);
+    h = HASHFIELD(h, p, font_weight);
+    h = HASHFIELD(h, p, font_size);
+
+    return h;
+}
+
+static int sameStyle(const MsvgPaintCtx *p1, const MsvgPaintCtx *p2)
+{
+    return SAMEFIELD(p1, p2, fill) && sameString(p1->fill_iri, p2->fill_iri) &&
+           SAMEFIELD(p1, p2, fill_opacity) && SAMEFIELD(p1, p2, fill_rule) &&
+           SAMEFIELD(p1, p2, stroke) &&
+           sameString(p1->stroke_iri, p2->stroke_iri) &&
+           SAMEFIELD(p1, p2, stroke_width) && SAMEFIELD(p1, p2, stroke_opacity) &&
+           SAMEFIELD(p1, p2, text_anchor) &&
+           sameString(p1->sfont_family, p2->sfont_family) &&
+           SAMEFIELD(p1, p2, ifont_family) && SAMEFIELD(p1, p2, font_style) &&
+           SAMEFIELD(p1, p2, font_weight) && SAMEFIELD(p1, p2, font_size);
+}
+
+static unsigned int hashKey(const CIntern *ci, const void *key)
+{
+    switch (ci->kind) {
+        case CI_STRING :
+            return hashString(2166136261u, (const char *)key);
+        case CI_STYLE :
+            return hashStyle((const MsvgPaintCtx *)key);
+        default :
+            return hashBytes(2166136261u, key, sizeof(TMatrix));
+    }
+}
+
+static int sameKey(const CIntern *ci, const void *key1, const void *key2)
+{
+    switch (ci->kind) {
+        case CI_STRING :
+            return strcmp((const char *)key1, (const char *)key2) == 0;
+        case CI_STYLE :
+            return sameStyle((const MsvgPaintCtx *)key1,
+                             (const MsvgPaintCtx *)key2);
+        default :
+            return memcmp(key1, key2, sizeof(TMatrix)) == 0;
+    }
+}
+
+static int initIntern(CIntern *ci, int kind)
+{
+    ci->kind = kind;
+    ci->nitems = 0;
+    ci->nslots = 64;
+    ci->next = 0;
+    ci->item = (CInternItem *)calloc(ci->nslots, sizeof(CInternItem));
+
+    return ci->item != NULL;
+}
+
+static void freeIntern(CIntern *ci)
+{
+    if (ci->item) free(ci->item);
+    ci->item = NULL;
+}
+
+static CInternItem *findSlot(const CIntern *ci, const void *key)
+{
+    unsigned int i, mask;
+
+    mask = ci->nslots - 1;
+    i = hashKey(ci, key) & mask;
+    while (ci->item[i].key != NULL && !sameKey(ci, ci->item[i].key, key))
+        i = (i + 1) & mask;
+
+    return &(ci->item[i]);
+}
+
+static int growIntern(CIntern *ci)
+{
+    CInternItem *olditem, *slot;
+    int i, oldnslots;
+
+    olditem = ci->item;
+    oldnslots = ci->nslots;
+    ci->item = (CInternItem *)calloc(oldnslots * 2, sizeof(CInternItem));
+    if (ci->item == NULL) {
+        ci->item = olditem;
+        return 0;
+    }
+    ci->nslots = oldnslots * 2;
+    for (i=0; i<oldnslots; i++) {
+        if (olditem[i].key == NULL) continue;
+        slot = findSlot(ci, olditem[i].key);
+        *slot = olditem[i];
+    }
+    free(olditem);
+
+    return 1;
+}
+
+static int addIntern(CIntern *ci, const void *key)
+{
+    CInternItem *slot;
+
+    if (key == NULL) return 1;
+
+    if ((ci->nitems + 1) * 2 > ci->nslots && !growIntern(ci)) return 0;
+
+    slot = findSlot(ci, key);
+    if (slot->key) return 1;
+
+    slot->key = key;
+    slot->index = ci->next;
+    ci->next += ci->kind == CI_STRING ? strlen((const char *)key) + 1 : 1;
+    ci->nitems++;
+
+    return 1;
+}
+
+static int findIntern(const CIntern *ci, const void *key)
+{
+    return findSlot(ci, key)->index;
+}
+
+static MsvgElement *nextPreorder(MsvgElement *el, MsvgElement *root, int *depth)
+{
+    if (el->fson) {
+        (*depth)++;
+        return el->fson;
+    }
+
+    while (el != root) {
+        if (el->nsibling) return el->nsibling;
+        el = el->father;
+        (*depth)--;
+    }
+
+    return NULL;
+}
+
+static int hasPaintCtx(enum EID eid)
+{
+    return eid >= EID_SVG && eid <= EID_TEXT && eid != EID_DEFS;
+}
+
+static int styleSet(const MsvgPaintCtx *pctx)
+{
+    return (MsvgPaintCtxFieldsSet(pctx) & ~PCTX_TMATRIX) != 0;
+}
+
+static int internElement(CBuild *cb, MsvgElement *el)
+{
+    MsvgCTree *ct;
+    MsvgPackedPath *pp;
+    int ok = 1;
+
+    ct = cb->ct;
+    ct->nnodes++;
+    ok &= addIntern(&(cb->strs), el->id);
+    if (el->fcontent)
+        ct->datasize += DALIGN(sizeof(MsvgContent) + el->fcontent->len);
+
+    if (el->pctx && hasPaintCtx(el->eid)) {
+        if (styleSet(el->pctx)) {
+            ok &= addIntern(&(cb->styles), el->pctx);
+            ok &= addIntern(&(cb->strs), el->pctx->fill_iri);
+            ok &= addIntern(&(cb->strs), el->pctx->stroke_iri);
+            ok &= addIntern(&(cb->strs), el->pctx->sfont_family);
+        }
+        if (!TMIsIdentity(&(el->pctx->tmatrix)))
+            ok &= addIntern(&(cb->mats), &(el->pctx->tmatrix));
+    }
+
+    switch (el->eid) {
+        case EID_USE :
+            ok &= addIntern(&(cb->strs), el->puseattr->refel);
+            break;
+        case EID_POLYLINE :
+            ct->datasize += DALIGN(sizeof(MsvgCoord) * 2 * el->ppolylineattr->npoints);
+            break;
+        case EID_POLYGON :
+            ct->datasize += DALIGN(sizeof(MsvgCoord) * 2 * el->ppolygonattr->npoints);
+            break;
+        case EID_PATH :
+        case EID_MISSINGGLYPH :
+        case EID_GLYPH :
+            pp = MsvgGetPackedPath(el);
+            if (pp) ct->datasize += DALIGN(MsvgI_PackedPathSize(pp));
+            break;
+        case EID_FONTFACE :
+            ok &= addIntern(&(cb->strs), el->pfontfaceattr->sfont_family);
+            break;
+        default :
+            break;
+    }
+
+    return ok;
+}
+
+static char *poolString(CBuild *cb, const char *s)
+{
+    if (s == NULL) return NULL;
+
+    return cb->ct->strings + findIntern(&(cb->strs), s);
+}
+
+static void *poolData(CBuild *cb, const void *src, int size)
+{
+    char *p;
+
+    if (src == NULL || size < 1) return NULL;
+
+    p = cb->ct->data + cb->dataoff;
+    memcpy(p, src, size);
+    cb->dataoff += DALIGN(size);
+
+    return p;
+}
+
+static MsvgPackedPath *poolPacked(CBuild *cb, MsvgElement *el)
+{
+    MsvgPackedPath *pp;
+    char *p;
+
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL) return NULL;
+
+    p = cb->ct->data + cb->dataoff;
+    cb->dataoff += DALIGN(MsvgI_PackedPathSize(pp));
+
+    return MsvgI_CopyPackedPath(p, pp);
+}
+
+static MsvgBPServer *resolveBPS(CBuild *cb, rgbcolor color, char *iri)
+{
+    MsvgElement *refel;
+    MsvgBPServer *bps;
+
+    if (color != IRI_COLOR || iri == NULL || cb->tid == NULL) return NULL;
+
+    refel = MsvgFindIdTableId(cb->tid, iri);
+    if (refel == NULL) return NULL;
+    bps = MsvgGetBPServer(refel);
+
+    return bps ? MsvgRefBPServer(bps) : NULL;
+}
+
+static void fillTables(CBuild *cb)
+{
+    MsvgCTree *ct;
+    MsvgPaintCtx *des;
+    const CInternItem *item;
+    int i;
+
+    ct = cb->ct;
+
+    for (i=0; i<cb->strs.nslots; i++) {
+        item = &(cb->strs.item[i]);
+        if (item->key) strcpy(ct->strings + item->index, (const char *)item->key);
+    }
+
+    for (i=0; i<cb->styles.nslots; i++) {
+        item = &(cb->styles.item[i]);
+        if (item->key == NULL) continue;
+        des = &(ct->pctx[item->index]);
+        *des = *((const MsvgPaintCtx *)item->key);
+        TMSetIdentity(&(des->tmatrix));
+        des->fill_iri = poolString(cb, des->fill_iri);
+        des->stroke_iri = poolString(cb, des->stroke_iri);
+        des->sfont_family = poolString(cb, des->sfont_family);
+        des->fill_bps = resolveBPS(cb, des->fill, des->fill_iri);
+        des->stroke_bps = resolveBPS(cb, des->stroke, des->stroke_iri);
+    }
+
+    for (i=0; i<cb->mats.nslots; i++) {
+        item = &(cb->mats.item[i]);
+        if (item->key) ct->tmatrix[item->index] = *((const TMatrix *)item->key);
+    }
+}
+
+static void setNode(CBuild *cb, MsvgCNode *n, MsvgElement *el)
+{
+    MsvgCTree *ct;
+    char *p;
+
+    ct = cb->ct;
+    n->eid = el->eid;
+    n->ref = -1;
+
+    n->id = -1;
+    if (el->id) {
+        p = poolString(cb, el->id);
+        n->id = p - ct->strings;
+    }
+
+    n->content = -1;
+    if (el->fcontent) {
+        p = poolData(cb, el->fcontent, sizeof(MsvgContent) + el->fcontent->len);
+        n->content = p - ct->data;
+    }
+
+    n->pctx = -1;
+    n->tmatrix = -1;
+    n->pmask = 0;
+    if (el->pctx && hasPaintCtx(el->eid)) {
+        n->pmask = MsvgPaintCtxFieldsSet(el->pctx);
+        if (n->pmask & ~PCTX_TMATRIX)
+            n->pctx = findIntern(&(cb->styles), el->pctx);
+        if (n->pmask & PCTX_TMATRIX)
+            n->tmatrix = findIntern(&(cb->mats), &(el->pctx->tmatrix));
+    }
+
+    memset(&(n->attr), 0, sizeof(n->attr));
+
+    switch (el->eid) {
+        case EID_SVG :
+            ct->svgattr = *(el->psvgattr);
+            ct->svgattr.rtree = NULL;
+            ct->svgattr.usecache = NULL;
+            ct->svgattr.idindex = NULL;
+            ct->svgattr.pctxcache = 0;
+            ct->svgattr.journal = NULL;
+            ct->svgattr.frozen = 0;
+            break;
+        case EID_DEFS :
+            n->attr.defs = *(el->pdefsattr);
+            break;
+        case EID_G :
+            n->attr.g = *(el->pgattr);
+            break;
+        case EID_USE :
+            n->attr.use = *(el->puseattr);
+            n->attr.use.refel = poolString(cb, el->puseattr->refel);
+            break;
+        case EID_RECT :
+            n->attr.rect = *(el->prectattr);
+            break;
+        case EID_CIRCLE :
+            n->attr.circle = *(el->pcircleattr);
+            break;
+        case EID_ELLIPSE :
+            n->attr.ellipse = *(el->pellipseattr);
+            break;
+        case EID_LINE :
+            n->attr.line = *(el->plineattr);
+            break;
+        case EID_POLYLINE :
+            n->attr.polyline.npoints = el->ppolylineattr->npoints;
+            n->attr.polyline.points = poolData(cb, el->ppolylineattr->points,
+                sizeof(MsvgCoord) * 2 * el->ppolylineattr->npoints);
+            break;
+        case EID_POLYGON :
+            n->attr.polygon.npoints = el->ppolygonattr->npoints;
+            n->attr.polygon.points = poolData(cb, el->ppolygonattr->points,
+                sizeof(MsvgCoord) * 2 * el->ppolygonattr->npoints);
+            break;
+        case EID_PATH :
+            n->attr.path.pp = poolPacked(cb, el);
+            break;
+        case EID_TEXT :
+            n->attr.text = *(el->ptextattr);
+            break;
+        case EID_LINEARGRADIENT :
+            n->attr.lgrad = *(el->plgradattr);
+            n->attr.lgrad.bps = NULL;
+            break;
+        case EID_RADIALGRADIENT :
+            n->attr.rgrad = *(el->prgradattr);
+            n->attr.rgrad.bps = NULL;
+            break;
+        case EID_STOP :
+            n->attr.stop = *(el->pstopattr);
+            break;
+        case EID_FONT :
+            n->attr.font = *(el->pfontattr);
+            break;
+        case EID_FONTFACE :
+            n->attr.fontface = *(el->pfontfaceattr);
+            n->attr.fontface.sfont_family =
+                poolString(cb, el->pfontfaceattr->sfont_family);
+            break;
+        case EID_MISSINGGLYPH :
+        case EID_GLYPH :
+            n->attr.glyph.unicode = el->pglyphattr->unicode;
+            n->attr.glyph.horiz_adv_x = el->pglyphattr->horiz_adv_x;
+            n->attr.glyph.pp = poolPacked(cb, el);
+            break;
+        default :
+            break;
+    }
+}
+
+typedef struct {
+    const char *id;
+    int node;
+} CIdItem;
+
+static int cmpIdItem(const void *p1, const void *p2)
+{
+    const CIdItem *i1 = (const CIdItem *)p1, *i2 = (const CIdItem *)p2;
+    int r;
+
+    // a repeated id references the first node
+    r = strcmp(i1->id, i2->id);
+    if (r == 0) r = i1->node - i2->node;
+
+    return r;
+}
+
+static int findFirstId(const CIdItem *item, int nitems, const char *id)
+{
+    int lo = 0, hi = nitems, mid;
+
+    // the first item with the id, items sorted by id and node
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(item[mid].id, id) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo < nitems && strcmp(item[lo].id, id) == 0) return item[lo].node;
+
+    return -1;
+}
+
+/* the referenced nodes in a reference cycle are found like in usecache.c,
+ * so the EID_USE elements draw the same than in the linked tree */
+
+typedef struct {
+    char *state;            /* 0 = not seen, 1 = compiling, 2 = done */
+    char *cyclic;           /* 1 = in a reference cycle, not drawn */
+    int *chain;             /* referenced nodes being compiled */
+    int nchain;
+} CUseMark;
+
+static int markRef(const MsvgCTree *ct, CUseMark *um, int ref);
+
+static void markContent(const MsvgCTree *ct, CUseMark *um, int i)
+{
+    const MsvgCNode *n;
+    int son;
+
+    n = &(ct->node[i]);
+    if (n->eid == EID_G) {
+        son = n->end > i + 1 ? i + 1 : -1;
+        for (; son>=0; son=ct->node[son].nsibling)
+            markContent(ct, um, son);
+    } else if (n->eid == EID_USE && n->ref >= 0) {
+        markRef(ct, um, n->ref);
+    }
+}
+
+static int markRef(const MsvgCTree *ct, CUseMark *um, int ref)
+{
+    int i;
+
+    if (um->state[ref] == 1) {
+        // the nodes compiling up to ref are in the cycle
+        for (i=um->nchain-1; i>=0; i--) {
+            um->cyclic[um->chain[i]] = 1;
+            if (um->chain[i] == ref) break;
+        }
+        return 0;
+    }
+
+    if (um->state[ref] == 0) {
+        um->state[ref] = 1;
+        um->chain[um->nchain++] = ref;
+        markContent(ct, um, ref);
+        um->nchain--;
+        um->state[ref] = 2;
+    }
+
+    return !um->cyclic[ref];
+}
+
+static void markCycles(MsvgCTree *ct)
+{
+    CUseMark um;
+    int i;
+
+    if (ct->nnodes < 1) return;
+
+    um.state = (char *)calloc(ct->nnodes, 1);
+    um.cyclic = (char *)calloc(ct->nnodes, 1);
+    um.chain = (int *)malloc(sizeof(int) * ct->nnodes);
+    um.nchain = 0;
+
+    if (um.state && um.cyclic && um.chain) {
+        for (i=0; i<ct->nnodes; i++) {
+            if (ct->node[i].eid == EID_USE && ct->node[i].ref >= 0)
+                markRef(ct, &um, ct->node[i].ref);
+        }
+        for (i=0; i<ct->nnodes; i++) {
+            if (ct->node[i].eid == EID_USE && ct->node[i].ref >= 0 &&
+                um.cyclic[ct->node[i].ref]) ct->node[i].ref = -1;
+        }
+    }
+
+    if (um.state) free(um.state);
+    if (um.cyclic) free(um.cyclic);
+    if (um.chain) free(um.chain);
+}
+
+static void resolveUses(MsvgCTree *ct)
+{
+    CIdItem *item;
+    int i, nitems = 0;
+
+    item = (CIdItem *)malloc(sizeof(CIdItem) * (ct->nnodes + 1));
+    if (item == NULL) return;
+
+    // the root is not referenced by id
+    for (i=1; i<ct->nnodes; i++) {
+        if (ct->node[i].id < 0) continue;
+        item[nitems].id = ct->strings + ct->node[i].id;
+        item[nitems].node = i;
+        nitems++;
+    }
+    qsort(item, nitems, sizeof(CIdItem), cmpIdItem);
+
+    for (i=0; i<ct->nnodes; i++) {
+        if (ct->node[i].eid == EID_USE && ct->node[i].attr.use.refel)
+            ct->node[i].ref = findFirstId(item, nitems, ct->node[i].attr.use.refel);
+    }
+
+    free(item);
+
+    markCycles(ct);
+}
+
+static int allocPools(MsvgCTree *ct)
+{
+    ct->node = (MsvgCNode *)malloc(sizeof(MsvgCNode) * ct->nnodes);
+    ct->pctx = (MsvgPaintCtx *)malloc(sizeof(MsvgPaintCtx) * (ct->npctxs + 1));
+    ct->tmatrix = (TMatrix *)malloc(sizeof(TMatrix) * (ct->nmatrices + 1));
+    ct->strings = (char *)malloc(ct->strsize + 1);
+    ct->data = (char *)malloc(ct->datasize + 1);
+
+    return ct->node && ct->pctx && ct->tmatrix && ct->strings && ct->data;
+}
+
+static int fillNodes(CBuild *cb, MsvgElement *root)
+{
+    MsvgCTree *ct;
+    MsvgElement *el;
+    int *stack, *last;
+    int i, depth;
+
+    // the node of every level and the last son added to it
+    ct = cb->ct;
+    stack = (int *)malloc(sizeof(int) * (ct->maxdepth + 1));
+    last = (int *)malloc(sizeof(int) * (ct->maxdepth + 1));
+    if (stack == NULL || last == NULL) {
+        if (stack) free(stack);
+        if (last) free(last);
+        return 0;
+    }
+
+    cb->dataoff = 0;
+    ct->nnodes = 0;
+
+    el = root;
+    depth = 0;
+    last[0] = -1;
+    while (el) {
+        i = ct->nnodes++;
+        setNode(cb, &(ct->node[i]), el);
+        ct->node[i].father = depth > 0 ? stack[depth-1] : -1;
+        ct->node[i].nsibling = -1;
+        if (last[depth] >= 0) ct->node[last[depth]].nsibling = i;
+        last[depth] = i;
+        stack[depth] = i;
+
+        if (el->fson) {
+            el = el->fson;
+            depth++;
+            last[depth] = -1;
+            continue;
+        }
+
+        // close the subtrees ended here
+        for (;;) {
+            ct->node[stack[depth]].end = ct->nnodes;
+            if (depth == 0) {
+                el = NULL;
+                break;
+            }
+            if (el->nsibling) {
+                el = el->nsibling;
+                break;
+            }
+            el = el->father;
+            depth--;
+        }
+    }
+
+    free(stack);
+    free(last);
+
+    return 1;
+}
+
+static void freeBuild(CBuild *cb, int own_tid)
+{
+    freeIntern(&(cb->strs));
+    freeIntern(&(cb->styles));
+    freeIntern(&(cb->mats));
+    if (own_tid && cb->tid) MsvgDestroyTableId(cb->tid);
+}
+
+MsvgCTree *MsvgCompactTree(MsvgElement *root)
+{
+    MsvgCTree *ct;
+    MsvgElement *el;
+    CBuild cb;
+    int depth, own_tid, ok, filled = 0;
+
+    if (root == NULL) return NULL;
+    if (root->eid != EID_SVG) return NULL;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return NULL;
+
+    ct = (MsvgCTree *)calloc(1, sizeof(MsvgCTree));
+    if (ct == NULL) return NULL;
+
+    memset(&cb, 0, sizeof(CBuild));
+    cb.ct = ct;
+    cb.tid = MsvgI_GetTableId(root, &own_tid);
+    ok = initIntern(&(cb.strs), CI_STRING) && initIntern(&(cb.styles), CI_STYLE) &&
+         initIntern(&(cb.mats), CI_MATRIX);
+
+    // first pass, the sizes and the interned values
+    el = root;
+    depth = 0;
+    while (el && ok) {
+        ok = internElement(&cb, el);
+        if (depth > ct->maxdepth) ct->maxdepth = depth;
+        el = nextPreorder(el, root, &depth);
+    }
+    ct->npctxs = cb.styles.nitems;
+    ct->nmatrices = cb.mats.nitems;
+    ct->strsize = cb.strs.next;
+
+    if (ok) ok = allocPools(ct);
+    if (ok) {
+        fillTables(&cb);
+        filled = 1;
+        ok = fillNodes(&cb, root);
+    }
+    freeBuild(&cb, own_tid);
+
+    if (!ok) {
+        // the paint servers are resolved only in a filled styles table
+        if (!filled) ct->npctxs = 0;
+        MsvgDestroyCTree(ct);
+        return NULL;
+    }
+
+    resolveUses(ct);
+
+    return ct;
+}
+
+void MsvgDestroyCTree(MsvgCTree *ct)
+{
+    int i;
+
+    if (ct == NULL) return;
+
+    if (ct->pctx) {
+        for (i=0; i<ct->npctxs; i++) {
+            if (ct->pctx[i].fill_bps) MsvgDestroyBPServer(ct->pctx[i].fill_bps);
+            if (ct->pctx[i].stroke_bps) MsvgDestroyBPServer(ct->pctx[i].stroke_bps);
+        }
+        free(ct->pctx);
+    }
+    if (ct->tmatrix) free(ct->tmatrix);
+    if (ct->node) free(ct->node);
+    if (ct->strings) free(ct->strings);
+    if (ct->data) free(ct->data);
+    free(ct);
+}
+
+static void nodePaintCtx(const MsvgCTree *ct, const MsvgCNode *n,
+                         MsvgPaintCtx *pctx)
+{
+    // the style, or nothing defined, with the matrix
+    if (n->pctx >= 0) *pctx = ct->pctx[n->pctx];
+    else MsvgI_UndefPaintCtx(pctx);
+    if (n->tmatrix >= 0) pctx->tmatrix = ct->tmatrix[n->tmatrix];
+}
+
+static void setView(const MsvgCTree *ct, int i, MsvgElement *view,
+                    MsvgPaintCtx *pctx)
+{
+    const MsvgCNode *n;
+
+    // an element that points to the node data, it must not be changed
+    n = &(ct->node[i]);
+    memset(view, 0, sizeof(MsvgElement));
+    view->eid = n->eid;
+    if (n->id >= 0) view->id = ct->strings + n->id;
+    if (n->content >= 0) view->fcontent = (MsvgContent *)(ct->data + n->content);
+    if (hasPaintCtx(n->eid)) view->pctx = pctx;
+
+    if (n->eid == EID_SVG)
+        view->psvgattr = (MsvgSvgAttributes *)&(ct->svgattr);
+    else if (n->eid > EID_SVG && n->eid <= EID_GLYPH)
+        view->pdefsattr = (MsvgDefsAttributes *)&(n->attr);
+}
+
+MsvgElement *MsvgExpandTree(const MsvgCTree *ct)
+{
+    MsvgElement **els, *root, view;
+    MsvgPaintCtx pctx;
+    const MsvgCNode *n;
+    int i, j;
+
+    if (ct == NULL || ct->nnodes < 1) return NULL;
+
+    els = (MsvgElement **)malloc(sizeof(MsvgElement *) * ct->nnodes);
+    if (els == NULL) return NULL;
+
+    for (i=0; i<ct->nnodes; i++) {
+        n = &(ct->node[i]);
+        els[i] = MsvgNewElement(n->eid, NULL);
+        if (els[i] == NULL) {
+            for (j=0; j<i; j++) MsvgDeleteElement(els[j]);
+            free(els);
+            return NULL;
+        }
+        // the paint servers are compiled again by the new tree
+        if (hasPaintCtx(n->eid)) {
+            nodePaintCtx(ct, n, &pctx);
+            pctx.fill_bps = pctx.stroke_bps = NULL;
+        }
+        setView(ct, i, &view, &pctx);
+        MsvgCopyCookedAttributes(els[i], &view);
+        MsvgCopyContents(els[i], &view);
+    }
+
+    // linked at the end, the nodes are in preorder
+    for (i=0; i<ct->nnodes; i++) {
+        n = &(ct->node[i]);
+        if (n->father >= 0) els[i]->father = els[n->father];
+        if (n->nsibling >= 0) {
+            els[i]->nsibling = els[n->nsibling];
+            els[n->nsibling]->psibling = els[i];
+        } else if (n->father >= 0) {
+            els[n->father]->lson = els[i];
+        }
+        if (n->end > i + 1) els[i]->fson = els[i+1];
+    }
+
+    root = els[0];
+    free(els);
+
+    if (root->eid == EID_SVG) MsvgBuildIdIndex(root);
+
+    return root;
+}
+
+void MsvgCalcCountsCTree(const MsvgCTree *ct, MsvgTreeCounts *tc)
+{
+    const MsvgCNode *n, *last;
+    int i;
+
+    for (i=0; i<=EID_LAST; i++)
+        tc->nelem[i] = 0;
+    tc->totelem = 0;
+    tc->totelwid = 0;
+
+    last = ct->node + ct->nnodes;
+    for (n=ct->node; n<last; n++) {
+        if (n->eid > EID_SVG && n->eid <= EID_LAST) {
+            tc->nelem[n->eid] += 1;
+            tc->totelem += 1;
+            if (n->id >= 0) tc->totelwid += 1;
+        }
+    }
+}
+
+int MsvgFindIdCTree(const MsvgCTree *ct, const char *id)
+{
+    int i;
+
+    // the root is not found by id, like in the cooked trees
+    for (i=1; i<ct->nnodes; i++) {
+        if (ct->node[i].id >= 0 && strcmp(ct->strings + ct->node[i].id, id) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* serialization, the inherited paint contexts are kept in a stack of frames
+ * by depth, a frame ends when the sweep arrives to the end node of its
+ * container. The content referenced by an EID_USE element is serialized
+ * from an undefined paint context and then inherited from the chain of
+ * EID_USE elements, in the same order than the compiled use cache */
+
+typedef struct {
+    int end;                /* node after the container subtree */
+    MsvgPaintCtx pctx;      /* inherited paint context */
+} CFrame;
+
+typedef struct _CUseLink {
+    MsvgPaintCtx pctx;      /* EID_USE element paint context, inherited */
+    const struct _CUseLink *prev;
+} CUseLink;
+
+typedef struct {
+    const MsvgCTree *ct;
+    MsvgSerUserFn sufn;
+    void *udata;
+    int genbps;
+    MsvgPaintCtx undef;
+} CSerData;
+
+static void inheritPctx(MsvgPaintCtx *son, const MsvgPaintCtx *fath)
+{
+    MsvgI_InheritBorrowedPaintCtx(son, fath);
+
+    // the resolved paint servers go with the borrowed iris
+    if (son->fill_iri == fath->fill_iri) son->fill_bps = fath->fill_bps;
+    if (son->stroke_iri == fath->stroke_iri) son->stroke_bps = fath->stroke_bps;
+}
+
+static void inheritNode(const MsvgCTree *ct, const MsvgCNode *n,
+                        MsvgPaintCtx *des, const MsvgPaintCtx *fath)
+{
+    TMatrix t;
+
+    // without style fields set it is the father one with the matrix
+    if (n->pctx < 0 && fath) {
+        *des = *fath;
+        if (n->tmatrix >= 0) {
+            t = fath->tmatrix;
+            TMMpy(&(des->tmatrix), &t, &(ct->tmatrix[n->tmatrix]));
+        }
+        return;
+    }
+
+    nodePaintCtx(ct, n, des);
+    if (fath) inheritPctx(des, fath);
+}
+
+static int serNodes(CSerData *sd, int first, const MsvgPaintCtx *fath,
+                    const CUseLink *uses);
+
+static void serUse(CSerData *sd, int i, const MsvgPaintCtx *fath,
+                   const CUseLink *uses)
+{
+    const MsvgCNode *n;
+    CUseLink link;
+    TMatrix t, uset;
+
+    // the references in a cycle were removed when compacting
+    n = &(sd->ct->node[i]);
+    if (n->ref < 0) return;
+
+    // it acts like a group with the referenced node as son
+    nodePaintCtx(sd->ct, n, &(link.pctx));
+    t = link.pctx.tmatrix;
+    TMSetTranslation(&uset, n->attr.use.x, n->attr.use.y);
+    TMMpy(&(link.pctx.tmatrix), &t, &uset);
+    if (fath) inheritPctx(&(link.pctx), fath);
+    link.prev = uses;
+
+    serNodes(sd, n->ref, &(sd->undef), &link);
+}
+
+static void serElement(CSerData *sd, int i, const MsvgPaintCtx *fath,
+                       const CUseLink *uses)
+{
+    const MsvgCNode *n;
+    MsvgElement view;
+    MsvgPaintCtx own, pctx;
+
+    n = &(sd->ct->node[i]);
+    nodePaintCtx(sd->ct, n, &own);
+    setView(sd->ct, i, &view, &own);
+    inheritNode(sd->ct, n, &pctx, fath);
+    for (; uses!=NULL; uses=uses->prev)
+        inheritPctx(&pctx, &(uses->pctx));
+    MsvgProcPaintCtxDefaults(&pctx);
+    if (!sd->genbps) pctx.fill_bps = pctx.stroke_bps = NULL;
+
+    sd->sufn(&view, &pctx, sd->udata);
+}
+
+static int serNodes(CSerData *sd, int first, const MsvgPaintCtx *fath,
+                    const CUseLink *uses)
+{
+    const MsvgCTree *ct;
+    const MsvgCNode *n;
+    const MsvgPaintCtx *fpctx;
+    CFrame *frame;
+    int i, last, nframes = 0;
+
+    ct = sd->ct;
+    frame = (CFrame *)malloc(sizeof(CFrame) * (ct->maxdepth + 1));
+    if (frame == NULL) return 0;
+
+    i = first;
+    last = ct->node[first].end;
+    while (i < last) {
+        while (nframes > 0 && i >= frame[nframes-1].end) nframes--;
+        fpctx = nframes > 0 ? &(frame[nframes-1].pctx) : fath;
+        n = &(ct->node[i]);
+
+        switch (n->eid) {
+            case EID_SVG :
+            case EID_G :
+                // only the root svg element is a container
+                if (n->eid == EID_SVG && i != 0) {
+                    i = n->end;
+                    break;
+                }
+                frame[nframes].end = n->end;
+                inheritNode(ct, n, &(frame[nframes].pctx), fpctx);
+                nframes++;
+                i++;
+                break;
+            case EID_USE :
+                serUse(sd, i, fpctx, uses);
+                i = n->end;
+                break;
+            case EID_RECT :
+            case EID_CIRCLE :
+            case EID_ELLIPSE :
+            case EID_LINE :
+            case EID_POLYLINE :
+            case EID_POLYGON :
+            case EID_PATH :
+            case EID_TEXT :
+                serElement(sd, i, fpctx, uses);
+                i = n->end;
+                break;
+            default :
+                // not drawn, and its sons neither
+                i = n->end;
+                break;
+        }
+    }
+
+    free(frame);
+
+    return 1;
+}
+
+int MsvgSerCTree(const MsvgCTree *ct, MsvgSerUserFn sufn, void *udata, int genbps)
+{
+    CSerData sd;
+
+    if (ct == NULL || ct->nnodes < 1) return 0;
+    if (ct->node[0].eid != EID_SVG) return 0;
+
+    sd.ct = ct;
+    sd.sufn = sufn;
+    sd.udata = udata;
+    sd.genbps = genbps;
+    MsvgI_UndefPaintCtx(&(sd.undef));
+
+    return serNodes(&sd, 0, NULL, NULL);
+}
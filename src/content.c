@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "msvg.h"
+#include "util.h"
 
 int MsvgAddContent(MsvgElement *el, int len, const char *cnt)
 {
@@ -38,10 +39,24 @@ int MsvgAddContent(MsvgElement *el, int len, const char *cnt)
     if (el->fcontent == NULL) {
         pcnt = calloc(1, sizeof(MsvgContent)+len*sizeof(char));
         if (pcnt == NULL) return 0;
+        pcnt->nrefs = 1;
         pcnt->len = len;
         strncpy(pcnt->s, cnt, len);
         pcnt->s[len] = '\0';
         el->fcontent = pcnt;
+    } else if (el->fcontent->nrefs > 1) {
+        // shared with a duplicated element, copied on write
+        olen = el->fcontent->len;
+        nlen = olen + len;
+        pcnt = malloc(sizeof(MsvgContent)+nlen*sizeof(char));
+        if (pcnt == NULL) return 0;
+        pcnt->nrefs = 1;
+        pcnt->len = nlen;
+        memcpy(pcnt->s, el->fcontent->s, olen);
+        strncpy(&(pcnt->s[olen]), cnt, len);
+        pcnt->s[nlen] = '\0';
+        el->fcontent->nrefs--;
+        el->fcontent = pcnt;
     } else {
         olen = el->fcontent->len;
         nlen = olen + len;
@@ -59,7 +74,8 @@ int MsvgAddContent(MsvgElement *el, int len, const char *cnt)
 int MsvgDelContents(MsvgElement *el)
 {
     if (el->fcontent != NULL) {
-        free(el->fcontent);
+        if (--(el->fcontent->nrefs) <= 0) free(el->fcontent);
+        el->fcontent = NULL;
         return 1;
     }
 
@@ -72,7 +88,19 @@ int MsvgCopyContents(MsvgElement *desel, MsvgElement *srcel)
 
     if (desel->fcontent != NULL) MsvgDelContents(desel);
 
-    return MsvgAddContent(desel, srcel->fcontent->len, srcel->fcontent->s);;
+    return MsvgAddContent(desel, srcel->fcontent->len, srcel->fcontent->s);
+}
+
+int MsvgI_ShareContents(MsvgElement *desel, MsvgElement *srcel)
+{
+    if (srcel->fcontent == NULL || desel->fcontent == srcel->fcontent) return 0;
+
+    if (desel->fcontent != NULL) MsvgDelContents(desel);
+
+    desel->fcontent = srcel->fcontent;
+    desel->fcontent->nrefs++;
+
+    return 1;
 }
 
 // linked list of contents version
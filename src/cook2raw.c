@@ -96,7 +96,10 @@ static void addTextRawAttr(MsvgElement *el, char *key, int value)
 
     if (value == INHERIT_VALUE) MsvgAddRawAttribute(el, key, "inherit");
 
-    if (strcmp(key,"text-anchor") == 0) {
+    if (strcmp(key,"fill-rule") == 0) {
+        if (value == FILLRULE_NONZERO) MsvgAddRawAttribute(el, key, "nonzero");
+        else if (value == FILLRULE_EVENODD) MsvgAddRawAttribute(el, key, "evenodd");
+    } else if (strcmp(key,"text-anchor") == 0) {
         if (value == TEXTANCHOR_START) MsvgAddRawAttribute(el, key, "start");
         else if (value == TEXTANCHOR_MIDDLE) MsvgAddRawAttribute(el, key, "middle");
         else if (value == TEXTANCHOR_END) MsvgAddRawAttribute(el, key, "end");
@@ -120,32 +123,22 @@ static void addTextRawAttr(MsvgElement *el, char *key, int value)
 
 #define MAX_COORD_PER_LINE 10
 
-static void addPathRawAttr(MsvgElement *el, MsvgSubPath *rsp)
+static void addPathRawAttr(MsvgElement *el, MsvgPackedPath *pp)
 {
-    MsvgSubPath *sp;
-    int i, n, tpoints;
+    int i, j, n;
     char *s, *p, salto;
     int csalto, first;
 
-    if (rsp == NULL) return;
+    if (pp == NULL || pp->npoints < 1) return;
 
-    sp = rsp;
-    tpoints = 0;
-    while (sp) {
-        tpoints += sp->npoints;
-        sp = sp->next;
-    }
-
-    if (tpoints < 1) return;
-    s = malloc(sizeof(char)*tpoints*40+3);
+    s = malloc(sizeof(char)*pp->npoints*40+pp->nsubpaths+3);
     if (s == NULL) return;
     p = s;
 
-    sp = rsp;
     csalto = 1;
     first = 1;
-    while (sp) {
-        for (i=0; i<sp->npoints; i++) {
+    for (j=0; j<pp->nsubpaths; j++) {
+        for (i=pp->fpoint[j]; i<pp->fpoint[j+1]; i++) {
             if (!first) {
                 if (csalto >= MAX_COORD_PER_LINE) {
                     salto = '\n';
@@ -159,18 +152,17 @@ static void addPathRawAttr(MsvgElement *el, MsvgSubPath *rsp)
             } else {
                 first = 0;
             }
-            if (sp->spp[i].cmd != ' ') {
-                *p = sp->spp[i].cmd;
+            if (pp->cmd[i] != ' ') {
+                *p = pp->cmd[i];
                 p++;
             }
-            n = sprintf(p, "%g,%g", sp->spp[i].x, sp->spp[i].y);
+            n = sprintf(p, "%g,%g", pp->x[i], pp->y[i]);
             p += n;
         }
-        if (sp->closed) {
+        if (pp->closed[j]) {
             *p = 'Z';
             p++;
         }
-        sp = sp->next;
     }
     *p = '\0';
 
@@ -179,7 +171,7 @@ static void addPathRawAttr(MsvgElement *el, MsvgSubPath *rsp)
     free(s);
 }
 
-static void addPolyRawAttr(MsvgElement *el, int npoints, double *points)
+static void addPolyRawAttr(MsvgElement *el, int npoints, MsvgCoord *points)
 {
     int i, n;
     char *s, *p, salto;
@@ -227,6 +219,7 @@ static void torawPCtxAttr(MsvgElement *el)
 
     addColorExtRawAttr(el, "fill", el->pctx->fill, el->pctx->fill_iri);
     addSpcDblRawAttr(el, "fill-opacity", el->pctx->fill_opacity);
+    addTextRawAttr(el, "fill-rule", el->pctx->fill_rule);
     addColorExtRawAttr(el, "stroke", el->pctx->stroke, el->pctx->stroke_iri);
     addSpcDblRawAttr(el, "stroke-width", el->pctx->stroke_width);
     addSpcDblRawAttr(el, "stroke-opacity", el->pctx->stroke_opacity);
@@ -334,7 +327,7 @@ static void toRawPolygonCookedAttr(MsvgElement *el)
 
 static void toRawPathCookedAttr(MsvgElement *el)
 {
-    addPathRawAttr(el, el->ppathattr->sp);
+    addPathRawAttr(el, MsvgGetPackedPath(el));
 }
 
 static void toRawTextCookedAttr(MsvgElement *el)
@@ -395,7 +388,7 @@ static void toRawMissingGlyphCookedAttr(MsvgElement *el)
 {
     if (el->pglyphattr->horiz_adv_x != NODEFINED_VALUE)
         addDoubleRawAttr(el, "horiz-adv-x", el->pglyphattr->horiz_adv_x);
-    addPathRawAttr(el, el->pglyphattr->sp);
+    addPathRawAttr(el, MsvgGetPackedPath(el));
 }
 
 static void toRawGlyphCookedAttr(MsvgElement *el)
@@ -406,10 +399,10 @@ static void toRawGlyphCookedAttr(MsvgElement *el)
     MsvgAddRawAttribute(el, "unicode", s);
     if (el->pglyphattr->horiz_adv_x != NODEFINED_VALUE)
         addDoubleRawAttr(el, "horiz-adv-x", el->pglyphattr->horiz_adv_x);
-    addPathRawAttr(el, el->pglyphattr->sp);
+    addPathRawAttr(el, MsvgGetPackedPath(el));
 }
 
-static void toRawElement(MsvgElement *el)
+static void toRawAttributes(MsvgElement *el)
 {
     torawPCtxAttr(el);
 
@@ -479,12 +472,23 @@ static void toRawElement(MsvgElement *el)
         default :
             break;
     }
+}
 
-    if (el->fson != NULL)
-        toRawElement(el->fson);
-    
-    if (el->nsibling != NULL)
-        toRawElement(el->nsibling);
+static void toRawElement(MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    pel = el;
+    for (;;) {
+        toRawAttributes(pel);
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
 }
 
 int MsvgCooked2RawTree(MsvgElement *root)
@@ -498,3 +502,10 @@ int MsvgCooked2RawTree(MsvgElement *root)
     
     return 1;
 }
+
+/* internal function, only for el */
+
+void MsvgI_Cooked2RawElement(MsvgElement *el)
+{
+    toRawAttributes(el);
+}
@@ -0,0 +1,213 @@
+/* ctxcache.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include "msvg.h"
+#include "util.h"
+
+/* The computed paint context of an element is its paint context inherited
+ * from all its ancestors with the defaults applied, and with the world
+ * matrix (the root matrix is not included, so changing the view doesn't
+ * invalidate anything). It is calculated from the father's one, so a tree
+ * walked from the root costs an inheritance per element, and a valid
+ * cached one costs nothing.
+ *
+ * The element manipulation functions invalidate the subtree of the changed,
+ * inserted or pruned element, the allocated paint contexts are reused.
+ */
+
+static MsvgElement *pctxFather(MsvgElement *el)
+{
+    MsvgElement *fath;
+
+    // the elements without paint context are skipped, like in
+    // MsvgBuildPaintCtxInherited
+    for (fath=el->father; fath!=NULL; fath=fath->father) {
+        if (fath->pctx) return fath;
+    }
+
+    return NULL;
+}
+
+static int compute(MsvgElement *el, MsvgElement *fath)
+{
+    if (el->cpctx == NULL) {
+        el->cpctx = MsvgNewPaintCtx(el->pctx);
+        if (el->cpctx == NULL) return 0;
+    } else {
+        MsvgCopyPaintCtx(el->cpctx, el->pctx);
+    }
+
+    if (fath)
+        MsvgProcPaintCtxInheritance(el->cpctx, fath->cpctx);
+    else
+        TMSetIdentity(&(el->cpctx->tmatrix));
+    MsvgProcPaintCtxDefaults(el->cpctx);
+    el->cpctx_ok = 1;
+
+    return 1;
+}
+
+static int computeChain(MsvgElement *el)
+{
+    MsvgElement *pel, **chain;
+    int n = 0, i;
+
+    // the invalid ancestors are computed first, from the top
+    for (pel=el; pel!=NULL && !pel->cpctx_ok; pel=pctxFather(pel)) n++;
+
+    chain = (MsvgElement **)malloc(sizeof(MsvgElement *) * n);
+    if (chain == NULL) return 0;
+
+    i = n;
+    for (pel=el; pel!=NULL && !pel->cpctx_ok; pel=pctxFather(pel))
+        chain[--i] = pel;
+
+    for (i=0; i<n; i++) {
+        if (!compute(chain[i], pctxFather(chain[i]))) break;
+    }
+
+    free(chain);
+
+    return i == n;
+}
+
+static void invalidateSubtree(MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    pel = el;
+    for (;;) {
+        pel->cpctx_ok = 0;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+}
+
+static void freeSubtree(MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    pel = el;
+    for (;;) {
+        if (pel->cpctx) MsvgDestroyPaintCtx(pel->cpctx);
+        pel->cpctx = NULL;
+        pel->cpctx_ok = 0;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+}
+
+int MsvgBuildPaintCtxCache(MsvgElement *root)
+{
+    MsvgElement *pel;
+    int ok = 1;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    root->psvgattr->pctxcache = 1;
+
+    // top-down, so every element is computed from a valid father
+    pel = root;
+    for (;;) {
+        if (pel->pctx && !pel->cpctx_ok) {
+            if (!compute(pel, pctxFather(pel))) ok = 0;
+        }
+        if (pel->fson && (pel->pctx == NULL || pel->cpctx_ok)) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != root && pel->nsibling == NULL) pel = pel->father;
+        if (pel == root) break;
+        pel = pel->nsibling;
+    }
+
+    return ok;
+}
+
+void MsvgDestroyPaintCtxCache(MsvgElement *root)
+{
+    if (root == NULL) return;
+    if (root->eid != EID_SVG) return;
+
+    freeSubtree(root);
+    root->psvgattr->pctxcache = 0;
+}
+
+const MsvgPaintCtx *MsvgGetCachedPaintCtx(MsvgElement *el)
+{
+    MsvgElement *root;
+
+    if (el->cpctx_ok) return el->cpctx;
+    if (el->pctx == NULL) return NULL;
+
+    root = MsvgFindFirstFather(el);
+    if (root->eid != EID_SVG || !root->psvgattr->pctxcache) return NULL;
+
+    if (!computeChain(el)) return NULL;
+
+    return el->cpctx;
+}
+
+void MsvgI_PaintCtxCacheChanged(MsvgElement *root, MsvgElement *el)
+{
+    MsvgPaintCtx *pctx;
+
+    if (!root->psvgattr->pctxcache) return;
+
+    if (el != root) {
+        invalidateSubtree(el);
+        return;
+    }
+
+    // the root matrix is not used, so a view change keeps the cache
+    pctx = MsvgNewPaintCtx(root->pctx);
+    if (pctx == NULL) {
+        invalidateSubtree(root);
+        return;
+    }
+    TMSetIdentity(&(pctx->tmatrix));
+    MsvgProcPaintCtxDefaults(pctx);
+    if (!root->cpctx_ok || !MsvgSamePaintState(pctx, root->cpctx))
+        invalidateSubtree(root);
+    if (root->cpctx) MsvgDestroyPaintCtx(root->cpctx);
+    root->cpctx = pctx;
+    root->cpctx_ok = 1;
+}
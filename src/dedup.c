@@ -0,0 +1,314 @@
+/* dedup.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "msvg.h"
+#include "util.h"
+
+/* The geometry of a cooked tree (the poly points arrays and the packed
+ * paths) that is the same bit to bit in several elements, like repeated
+ * icons or tile patterns, can be stored only once. MsvgDedupGeometry finds
+ * it with a hash table, with open addressing and linear probing like the
+ * intern tables in compact.c, and lets all the elements point to the first
+ * copy, MsvgDupElement shares it with the copies too. A packed path has
+ * its reference counter inside, a points array an allocated counter shared
+ * by the elements, and they are freed with the last reference. The coordinates are absolute, so only the same geometry
+ * in the same place is shared, not a translated one.
+ *
+ * Shared geometry must not be changed in place, MsvgUnshareGeometry gives
+ * an element its own copy before (copy on write). The library does it, and
+ * the paths changed through MsvgGetSubPath or the points allocated again
+ * are not shared anymore, only programs writing directly in the arrays
+ * must call it.
+ */
+
+typedef struct {
+    unsigned int hash;
+    int packed;             /* 1 = packed path, 0 = points array */
+    int n1, n2;             /* npoints and nsubpaths, or npoints */
+    const void *data;       /* bytes compared */
+    size_t size;
+    MsvgElement *el;        /* the element that keeps it, NULL = free slot */
+} DGeom;
+
+typedef struct {
+    int nslots;
+    DGeom *slot;
+    int nshared;            /* elements that share now */
+} DTable;
+
+static unsigned int hashBytes(unsigned int h, const void *p, size_t size)
+{
+    const unsigned char *b = (const unsigned char *)p;
+
+    while (size-- > 0) {
+        h ^= *b++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static MsvgPackedPath **packedPtr(MsvgElement *el)
+{
+    // subpaths set by program keep their own copy, they are not shared
+    if (el->eid == EID_PATH)
+        return el->ppathattr->sp ? NULL : &(el->ppathattr->pp);
+    else if (el->eid == EID_GLYPH || el->eid == EID_MISSINGGLYPH)
+        return el->pglyphattr->sp ? NULL : &(el->pglyphattr->pp);
+
+    return NULL;
+}
+
+static MsvgCoord **pointsPtr(MsvgElement *el, int *npoints, int ***nrefs)
+{
+    if (el->eid == EID_POLYLINE) {
+        *npoints = el->ppolylineattr->npoints;
+        *nrefs = &(el->ppolylineattr->nrefs);
+        return &(el->ppolylineattr->points);
+    } else if (el->eid == EID_POLYGON) {
+        *npoints = el->ppolygonattr->npoints;
+        *nrefs = &(el->ppolygonattr->nrefs);
+        return &(el->ppolygonattr->points);
+    }
+
+    return NULL;
+}
+
+static int geomOf(MsvgElement *el, DGeom *g)
+{
+    MsvgPackedPath **ppp, *pp;
+    MsvgCoord **ppoints;
+    int **pnrefs, npoints;
+    unsigned int h;
+
+    h = 2166136261u;
+    if ((ppp = packedPtr(el)) != NULL) {
+        // the path-data is scanned now if it is pending
+        pp = MsvgGetPackedPath(el);
+        if (pp == NULL) return 0;
+        g->packed = 1;
+        g->n1 = pp->npoints;
+        g->n2 = pp->nsubpaths;
+        // the arrays follow the header in the same allocation
+        g->data = pp->x;
+        g->size = MsvgI_PackedPathSize(pp) - ((char *)pp->x - (char *)pp);
+    } else if ((ppoints = pointsPtr(el, &npoints, &pnrefs)) != NULL) {
+        if (*ppoints == NULL || npoints < 1) return 0;
+        g->packed = 0;
+        g->n1 = npoints;
+        g->n2 = 0;
+        g->data = *ppoints;
+        g->size = sizeof(MsvgCoord) * 2 * npoints;
+    } else {
+        return 0;
+    }
+
+    h = hashBytes(h, &(g->packed), sizeof(int));
+    h = hashBytes(h, &(g->n1), sizeof(int));
+    h = hashBytes(h, &(g->n2), sizeof(int));
+    g->hash = hashBytes(h, g->data, g->size);
+    g->el = el;
+
+    return 1;
+}
+
+static int sameGeom(const DGeom *g1, const DGeom *g2)
+{
+    return g1->hash == g2->hash && g1->packed == g2->packed &&
+           g1->n1 == g2->n1 && g1->n2 == g2->n2 && g1->size == g2->size &&
+           memcmp(g1->data, g2->data, g1->size) == 0;
+}
+
+static void shareGeom(DTable *dt, MsvgElement *owner, MsvgElement *el)
+{
+    MsvgPackedPath **oppp, **ppp;
+    MsvgCoord **opoints, **ppoints;
+    int **onrefs = NULL, **pnrefs = NULL, npoints;
+
+    if ((ppp = packedPtr(el)) != NULL) {
+        oppp = packedPtr(owner);
+        if (*oppp == *ppp) return;
+        MsvgDestroyPackedPath(*ppp);
+        *ppp = *oppp;
+        (*ppp)->nrefs++;
+    } else {
+        opoints = pointsPtr(owner, &npoints, &onrefs);
+        ppoints = pointsPtr(el, &npoints, &pnrefs);
+        if (*opoints == *ppoints) return;
+        if (!MsvgI_SharePoints(ppoints, pnrefs, *opoints, onrefs)) return;
+    }
+
+    dt->nshared++;
+}
+
+static int countGeoms(MsvgElement *el)
+{
+    MsvgElement *pel;
+    int n = 0;
+
+    pel = el;
+    for (;;) {
+        switch (pel->eid) {
+            case EID_POLYLINE :
+            case EID_POLYGON :
+            case EID_PATH :
+            case EID_GLYPH :
+            case EID_MISSINGGLYPH :
+                n++;
+                break;
+            default :
+                break;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+
+    return n;
+}
+
+static void dedupSubtree(DTable *dt, MsvgElement *el)
+{
+    MsvgElement *pel;
+    DGeom g;
+    int i;
+
+    pel = el;
+    for (;;) {
+        if (geomOf(pel, &g)) {
+            i = g.hash & (dt->nslots - 1);
+            while (dt->slot[i].el != NULL) {
+                if (sameGeom(&(dt->slot[i]), &g)) {
+                    shareGeom(dt, dt->slot[i].el, pel);
+                    break;
+                }
+                i = (i + 1) & (dt->nslots - 1);
+            }
+            // the first occurrence is the key
+            if (dt->slot[i].el == NULL) dt->slot[i] = g;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+}
+
+int MsvgDedupGeometry(MsvgElement *el)
+{
+    DTable dt;
+    int n;
+
+    n = countGeoms(el);
+    if (n < 2) return 0;
+
+    // half full at most
+    dt.nslots = 4;
+    while (dt.nslots < n * 2) dt.nslots *= 2;
+    dt.slot = (DGeom *)calloc(dt.nslots, sizeof(DGeom));
+    if (dt.slot == NULL) return 0;
+    dt.nshared = 0;
+
+    dedupSubtree(&dt, el);
+
+    free(dt.slot);
+
+    return dt.nshared;
+}
+
+int MsvgUnshareGeometry(MsvgElement *el)
+{
+    MsvgPackedPath **ppp, *pp;
+    MsvgCoord **ppoints, *points;
+    int **pnrefs, npoints;
+
+    if ((ppp = packedPtr(el)) != NULL) {
+        if (*ppp == NULL || (*ppp)->nrefs < 2) return 1;
+        pp = MsvgDupPackedPath(*ppp);
+        if (pp == NULL) return 0;
+        MsvgDestroyPackedPath(*ppp);
+        *ppp = pp;
+    } else if ((ppoints = pointsPtr(el, &npoints, &pnrefs)) != NULL) {
+        if (*pnrefs == NULL) return 1;
+        if (**pnrefs < 2) {
+            // the other elements are gone, the array is its own
+            free(*pnrefs);
+            *pnrefs = NULL;
+            return 1;
+        }
+        points = (MsvgCoord *)malloc(sizeof(MsvgCoord) * 2 * npoints);
+        if (points == NULL) return 0;
+        memcpy(points, *ppoints, sizeof(MsvgCoord) * 2 * npoints);
+        MsvgI_ReleasePoints(ppoints, pnrefs);
+        *ppoints = points;
+    }
+
+    return 1;
+}
+
+int MsvgI_SharePoints(MsvgCoord **points, int **nrefs, MsvgCoord *srcpoints,
+                      int **srcnrefs)
+{
+    if (*points == srcpoints) return 1;
+
+    // the counter is allocated when the array is shared the first time
+    if (srcpoints && *srcnrefs == NULL) {
+        *srcnrefs = (int *)malloc(sizeof(int));
+        if (*srcnrefs == NULL) return 0;
+        **srcnrefs = 1;
+    }
+
+    MsvgI_ReleasePoints(points, nrefs);
+    if (srcpoints) {
+        *points = srcpoints;
+        *nrefs = *srcnrefs;
+        (**nrefs)++;
+    }
+
+    return 1;
+}
+
+void MsvgI_ReleasePoints(MsvgCoord **points, int **nrefs)
+{
+    // the last reference frees the shared array and its counter
+    if (*nrefs == NULL || --(**nrefs) == 0) {
+        if (*points) free(*points);
+        if (*nrefs) free(*nrefs);
+    }
+    *points = NULL;
+    *nrefs = NULL;
+}
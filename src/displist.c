@@ -0,0 +1,479 @@
+/* displist.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "msvg.h"
+
+#define DL_HASHSIZE 1024
+
+typedef struct {
+    MsvgDisplayList *dl;
+    int error;                  // 1 = an allocation failed
+    int hashhead[DL_HASHSIZE];  // first pctx in table for every hash value
+    int *hashnext;              // next pctx with the same hash value
+    int maxhashnext;            // hashnext capacity
+} BuildData;
+
+static int growArray(void **array, int *maxitems, int nitems, int size)
+{
+    void *p;
+    int newmax;
+
+    if (nitems <= *maxitems) return 1;
+
+    newmax = (*maxitems > 0) ? *maxitems * 2 : 64;
+    while (newmax < nitems) newmax *= 2;
+
+    p = realloc(*array, newmax * size);
+    if (p == NULL) return 0;
+
+    *array = p;
+    *maxitems = newmax;
+    return 1;
+}
+
+static int sameString(const char *s1, const char *s2)
+{
+    if (s1 == NULL || s2 == NULL) return s1 == s2;
+    return strcmp(s1, s2) == 0;
+}
+
+static int sameBPServer(const MsvgBPServer *b1, const MsvgBPServer *b2)
+{
+    if (b1 == NULL || b2 == NULL) return b1 == b2;
+    return b1 == b2 || MsvgEqualBPServer(b1, b2);
+}
+
+static int samePaintCtx(const MsvgPaintCtx *p1, const MsvgPaintCtx *p2)
+{
+    // the matrix is not compared, it is always the identity
+    if (p1->fill != p2->fill) return 0;
+    if (p1->fill_opacity != p2->fill_opacity) return 0;
+    if (p1->fill_rule != p2->fill_rule) return 0;
+    if (p1->stroke != p2->stroke) return 0;
+    if (p1->stroke_width != p2->stroke_width) return 0;
+    if (p1->stroke_opacity != p2->stroke_opacity) return 0;
+    if (p1->text_anchor != p2->text_anchor) return 0;
+    if (p1->ifont_family != p2->ifont_family) return 0;
+    if (p1->font_style != p2->font_style) return 0;
+    if (p1->font_weight != p2->font_weight) return 0;
+    if (p1->font_size != p2->font_size) return 0;
+    if (!sameString(p1->fill_iri, p2->fill_iri)) return 0;
+    if (!sameString(p1->stroke_iri, p2->stroke_iri)) return 0;
+    if (!sameString(p1->sfont_family, p2->sfont_family)) return 0;
+    if (!sameBPServer(p1->fill_bps, p2->fill_bps)) return 0;
+    if (!sameBPServer(p1->stroke_bps, p2->stroke_bps)) return 0;
+
+    return 1;
+}
+
+static unsigned int hashPaintCtx(const MsvgPaintCtx *pctx)
+{
+    unsigned int h;
+
+    h = (unsigned int)pctx->fill;
+    h = h * 31 + (unsigned int)pctx->stroke;
+    h = h * 31 + (unsigned int)(pctx->stroke_width * 1024);
+    h = h * 31 + (unsigned int)(pctx->fill_opacity * 255);
+    h = h * 31 + (unsigned int)(pctx->stroke_opacity * 255);
+    h = h * 31 + (unsigned int)(pctx->font_size * 64);
+
+    return h % DL_HASHSIZE;
+}
+
+static void freePaintCtxData(MsvgPaintCtx *pctx)
+{
+    if (pctx->fill_iri) free(pctx->fill_iri);
+    if (pctx->fill_bps) MsvgDestroyBPServer(pctx->fill_bps);
+    if (pctx->stroke_iri) free(pctx->stroke_iri);
+    if (pctx->stroke_bps) MsvgDestroyBPServer(pctx->stroke_bps);
+    if (pctx->sfont_family) free(pctx->sfont_family);
+}
+
+static int addPaintCtx(BuildData *bd, MsvgPaintCtx *pctx)
+{
+    MsvgDisplayList *dl = bd->dl;
+    unsigned int h;
+    int i;
+
+    h = hashPaintCtx(pctx);
+    for (i=bd->hashhead[h]; i>=0; i=bd->hashnext[i]) {
+        if (samePaintCtx(&(dl->pctx[i]), pctx)) return i;
+    }
+
+    if (!growArray((void **)&(dl->pctx), &(dl->maxpctxs),
+                   dl->npctxs+1, sizeof(MsvgPaintCtx))) return -1;
+    if (!growArray((void **)&(bd->hashnext), &(bd->maxhashnext),
+                   dl->npctxs+1, sizeof(int))) return -1;
+
+    // the table owns the strings and binary paint servers, steal them
+    i = dl->npctxs;
+    dl->pctx[i] = *pctx;
+    TMSetIdentity(&(dl->pctx[i].tmatrix));
+    pctx->fill_iri = NULL;
+    pctx->fill_bps = NULL;
+    pctx->stroke_iri = NULL;
+    pctx->stroke_bps = NULL;
+    pctx->sfont_family = NULL;
+    bd->hashnext[i] = bd->hashhead[h];
+    bd->hashhead[h] = i;
+    dl->npctxs++;
+
+    return i;
+}
+
+static int addSubPath(MsvgDisplayList *dl, MsvgDLRecord *rec, int closed)
+{
+    MsvgDLSubPath *dlsp;
+
+    if (!growArray((void **)&(dl->subpath), &(dl->maxsubpaths),
+                   dl->nsubpaths+1, sizeof(MsvgDLSubPath))) return 0;
+
+    dlsp = &(dl->subpath[dl->nsubpaths]);
+    dlsp->fpoint = dl->npoints;
+    dlsp->npoints = 0;
+    dlsp->closed = closed;
+    if (rec->nsubpaths == 0) rec->fsubpath = dl->nsubpaths;
+    rec->nsubpaths++;
+    dl->nsubpaths++;
+
+    return 1;
+}
+
+static int addPoint(MsvgDisplayList *dl, MsvgDLRecord *rec,
+                    double x, double y, char cmd)
+{
+    MsvgSubPathPoint *p;
+
+    if (!growArray((void **)&(dl->point), &(dl->maxpoints),
+                   dl->npoints+1, sizeof(MsvgSubPathPoint))) return 0;
+
+    p = &(dl->point[dl->npoints]);
+    p->x = x;
+    p->y = y;
+    p->cmd = cmd;
+
+    if (rec->npoints == 0) {
+        rec->bbox.gminx = rec->bbox.gmaxx = x;
+        rec->bbox.gminy = rec->bbox.gmaxy = y;
+    } else {
+        if (x < rec->bbox.gminx) rec->bbox.gminx = x;
+        if (x > rec->bbox.gmaxx) rec->bbox.gmaxx = x;
+        if (y < rec->bbox.gminy) rec->bbox.gminy = y;
+        if (y > rec->bbox.gmaxy) rec->bbox.gmaxy = y;
+    }
+    rec->npoints++;
+    dl->subpath[dl->nsubpaths-1].npoints++;
+    dl->npoints++;
+
+    return 1;
+}
+
+static int addPointArray(MsvgDisplayList *dl, MsvgDLRecord *rec,
+                         MsvgCoord *points, int npoints, int closed)
+{
+    int i;
+
+    if (!addSubPath(dl, rec, closed)) return 0;
+    for (i=0; i<npoints; i++) {
+        if (!addPoint(dl, rec, points[i*2], points[i*2+1], (i == 0) ? 'M' : 'L'))
+            return 0;
+    }
+
+    return 1;
+}
+
+static void setEllipseBBox(MsvgDisplayList *dl, MsvgDLRecord *rec)
+{
+    MsvgSubPathPoint *p;
+    double dx, dy;
+
+    // points are the center and the two semi-axis ends
+    p = &(dl->point[rec->fpoint]);
+    dx = sqrt(pow(p[1].x - p[0].x, 2) + pow(p[2].x - p[0].x, 2));
+    dy = sqrt(pow(p[1].y - p[0].y, 2) + pow(p[2].y - p[0].y, 2));
+    rec->bbox.gminx = p[0].x - dx;
+    rec->bbox.gmaxx = p[0].x + dx;
+    rec->bbox.gminy = p[0].y - dy;
+    rec->bbox.gmaxy = p[0].y + dy;
+}
+
+static int addGeometry(MsvgDisplayList *dl, MsvgDLRecord *rec, MsvgElement *el)
+{
+    MsvgPackedPath *pp;
+    double x, y, w, h;
+    int i, j;
+
+    switch (el->eid) {
+        case EID_RECT :
+            x = el->prectattr->x;
+            y = el->prectattr->y;
+            w = el->prectattr->width;
+            h = el->prectattr->height;
+            if (!addSubPath(dl, rec, 1)) return 0;
+            if (!addPoint(dl, rec, x, y, 'M')) return 0;
+            if (!addPoint(dl, rec, x+w, y, 'L')) return 0;
+            if (!addPoint(dl, rec, x+w, y+h, 'L')) return 0;
+            if (!addPoint(dl, rec, x, y+h, 'L')) return 0;
+            break;
+        case EID_CIRCLE :
+            x = el->pcircleattr->cx;
+            y = el->pcircleattr->cy;
+            w = el->pcircleattr->r;
+            rec->eid = EID_ELLIPSE;
+            if (!addSubPath(dl, rec, 1)) return 0;
+            if (!addPoint(dl, rec, x, y, ' ')) return 0;
+            if (!addPoint(dl, rec, x+w, y, ' ')) return 0;
+            if (!addPoint(dl, rec, x, y+w, ' ')) return 0;
+            setEllipseBBox(dl, rec);
+            break;
+        case EID_ELLIPSE :
+            if (!addSubPath(dl, rec, 1)) return 0;
+            if (!addPoint(dl, rec, el->pellipseattr->cx,
+                          el->pellipseattr->cy, ' ')) return 0;
+            if (!addPoint(dl, rec, el->pellipseattr->rx_x,
+                          el->pellipseattr->rx_y, ' ')) return 0;
+            if (!addPoint(dl, rec, el->pellipseattr->ry_x,
+                          el->pellipseattr->ry_y, ' ')) return 0;
+            setEllipseBBox(dl, rec);
+            break;
+        case EID_LINE :
+            if (!addSubPath(dl, rec, 0)) return 0;
+            if (!addPoint(dl, rec, el->plineattr->x1, el->plineattr->y1, 'M'))
+                return 0;
+            if (!addPoint(dl, rec, el->plineattr->x2, el->plineattr->y2, 'L'))
+                return 0;
+            break;
+        case EID_POLYLINE :
+            if (!addPointArray(dl, rec, el->ppolylineattr->points,
+                               el->ppolylineattr->npoints, 0)) return 0;
+            break;
+        case EID_POLYGON :
+            if (!addPointArray(dl, rec, el->ppolygonattr->points,
+                               el->ppolygonattr->npoints, 1)) return 0;
+            break;
+        case EID_PATH :
+            pp = MsvgGetPackedPath(el);
+            if (pp == NULL) break;
+            for (j=0; j<pp->nsubpaths; j++) {
+                if (!addSubPath(dl, rec, pp->closed[j])) return 0;
+                for (i=pp->fpoint[j]; i<pp->fpoint[j+1]; i++) {
+                    if (!addPoint(dl, rec, pp->x[i], pp->y[i], pp->cmd[i]))
+                        return 0;
+                }
+            }
+            break;
+        case EID_TEXT :
+            if (!addSubPath(dl, rec, 0)) return 0;
+            if (!addPoint(dl, rec, el->ptextattr->x, el->ptextattr->y, 'M'))
+                return 0;
+            break;
+        default :
+            return 0;
+    }
+
+    return 1;
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    BuildData *bd = (BuildData *)udata;
+    MsvgDisplayList *dl = bd->dl;
+    MsvgElement *newel;
+    MsvgDLRecord *rec;
+
+    if (bd->error) return;
+
+    newel = MsvgTransformCookedElement(el, pctx, MSVGTCE_NORMAL);
+    if (newel == NULL) return;
+
+    if (!growArray((void **)&(dl->record), &(dl->maxrecords),
+                   dl->nrecords+1, sizeof(MsvgDLRecord))) {
+        bd->error = 1;
+        MsvgDeleteElement(newel);
+        return;
+    }
+
+    rec = &(dl->record[dl->nrecords]);
+    rec->eid = newel->eid;
+    rec->el = el;
+    rec->fpoint = dl->npoints;
+    rec->npoints = 0;
+    rec->fsubpath = dl->nsubpaths;
+    rec->nsubpaths = 0;
+    rec->treplay = 0;
+    rec->ipctx = addPaintCtx(bd, newel->pctx);
+
+    if (rec->ipctx < 0 || !addGeometry(dl, rec, newel))
+        bd->error = 1;
+    else
+        dl->nrecords++;
+
+    MsvgDeleteElement(newel);
+}
+
+MsvgDisplayList *MsvgBuildDisplayList(MsvgElement *root)
+{
+    MsvgDisplayList *dl;
+    BuildData bd;
+    int i;
+
+    if (root == NULL) return NULL;
+    if (root->eid != EID_SVG) return NULL;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return NULL;
+
+    dl = calloc(1, sizeof(MsvgDisplayList));
+    if (dl == NULL) return NULL;
+
+    bd.dl = dl;
+    bd.error = 0;
+    for (i=0; i<DL_HASHSIZE; i++) bd.hashhead[i] = -1;
+    bd.hashnext = NULL;
+    bd.maxhashnext = 0;
+
+    MsvgSerCookedTree(root, sufn, &bd, 1);
+
+    if (bd.hashnext) free(bd.hashnext);
+
+    // the replays don't allocate memory
+    if (!bd.error && dl->npoints > 0) {
+        dl->tpoint = malloc(dl->npoints * sizeof(MsvgSubPathPoint));
+        if (dl->tpoint == NULL) bd.error = 1;
+    }
+    if (!bd.error && dl->npctxs > 0) {
+        dl->tpctx = malloc(dl->npctxs * sizeof(MsvgPaintCtx));
+        dl->tbps = malloc(dl->npctxs * 2 * sizeof(MsvgBPServer));
+        if (dl->tpctx == NULL || dl->tbps == NULL) bd.error = 1;
+    }
+
+    if (bd.error) {
+        MsvgDestroyDisplayList(dl);
+        return NULL;
+    }
+
+    return dl;
+}
+
+void MsvgDestroyDisplayList(MsvgDisplayList *dl)
+{
+    int i;
+
+    if (dl == NULL) return;
+
+    for (i=0; i<dl->npctxs; i++)
+        freePaintCtxData(&(dl->pctx[i]));
+    if (dl->record) free(dl->record);
+    if (dl->subpath) free(dl->subpath);
+    if (dl->point) free(dl->point);
+    if (dl->tpoint) free(dl->tpoint);
+    if (dl->pctx) free(dl->pctx);
+    if (dl->tpctx) free(dl->tpctx);
+    if (dl->tbps) free(dl->tbps);
+    free(dl);
+}
+
+int MsvgReplayDisplayList(MsvgDisplayList *dl, const TMatrix *view,
+                          MsvgDLUserFn dlufn, void *udata)
+{
+    MsvgPaintCtx *pctx;
+    TMatrix *t;
+    double wscale = 1, fscale = 1;
+    int i;
+
+    if (dl == NULL) return 0;
+
+    t = &(dl->view);
+    if (view) {
+        *t = *view;
+        wscale = sqrt(t->a*t->a + t->b*t->b);
+        fscale = sqrt(t->c*t->c + t->d*t->d);
+    } else {
+        TMSetIdentity(t);
+    }
+    dl->identity = TMIsIdentity(t);
+
+    // the points of the records are transformed when they are asked
+    if (dl->nreplays == INT_MAX) {
+        for (i=0; i<dl->nrecords; i++) dl->record[i].treplay = 0;
+        dl->nreplays = 0;
+    }
+    dl->nreplays++;
+
+    // the paint contexts are adjusted once, they are shared by the records,
+    // strings are not copied, and the paint servers are transformed locally
+    for (i=0; i<dl->npctxs; i++) {
+        pctx = &(dl->tpctx[i]);
+        *pctx = dl->pctx[i];
+        if (pctx->stroke_width > 0) pctx->stroke_width *= wscale;
+        if (pctx->font_size > 0) pctx->font_size *= fscale;
+        if (pctx->fill_bps) {
+            dl->tbps[i*2] = *(pctx->fill_bps);
+            MsvgCalcUnitsBPServer(&(dl->tbps[i*2]), NULL, t);
+            pctx->fill_bps = &(dl->tbps[i*2]);
+        }
+        if (pctx->stroke_bps) {
+            dl->tbps[i*2+1] = *(pctx->stroke_bps);
+            MsvgCalcUnitsBPServer(&(dl->tbps[i*2+1]), NULL, t);
+            pctx->stroke_bps = &(dl->tbps[i*2+1]);
+        }
+    }
+
+    for (i=0; i<dl->nrecords; i++)
+        dlufn(dl, &(dl->record[i]), &(dl->tpctx[dl->record[i].ipctx]), udata);
+
+    return 1;
+}
+
+MsvgSubPathPoint *MsvgDLRecordPoints(MsvgDisplayList *dl, MsvgDLRecord *rec)
+{
+    MsvgSubPathPoint *src, *des;
+    TMatrix *t;
+    double x, y;
+    int j;
+
+    src = &(dl->point[rec->fpoint]);
+    if (dl->identity) return src;
+
+    des = &(dl->tpoint[rec->fpoint]);
+    if (rec->treplay == dl->nreplays) return des;
+
+    t = &(dl->view);
+    for (j=0; j<rec->npoints; j++) {
+        x = src[j].x;
+        y = src[j].y;
+        des[j].x = t->a * x + t->c * y + t->e;
+        des[j].y = t->b * x + t->d * y + t->f;
+        des[j].cmd = src[j].cmd;
+    }
+    rec->treplay = dl->nreplays;
+
+    return des;
+}
@@ -28,11 +28,11 @@
 
 #include <stdlib.h>
 #include "msvg.h"
+#include "util.h"
 
 static MsvgElement *MsvgNewGenericElement(enum EID eid, MsvgElement *father, int addpctx)
 {
     MsvgElement *element;
-    MsvgElement *ptr;
     MsvgPaintCtx *pctx = NULL;
 
     if (addpctx) {
@@ -53,12 +53,10 @@ static MsvgElement *MsvgNewGenericElement(enum EID eid, MsvgElement *father, int
         if (father->fson == NULL) {
             father->fson = element;
         } else {
-            ptr = father->fson;
-            while (ptr->nsibling != NULL)
-                ptr = ptr->nsibling;
-            ptr->nsibling = element;
-            element->psibling = ptr;
+            father->lson->nsibling = element;
+            element->psibling = father->lson;
         }
+        father->lson = element;
     }
 
     element->fcontent = NULL;
@@ -299,6 +297,8 @@ static MsvgElement *MsvgNewPathElement(MsvgElement *father)
 
     element->ppathattr = ppathattr;
     element->ppathattr->sp = NULL;
+    element->ppathattr->d = NULL;
+    element->ppathattr->pp = NULL;
     return element;
 }
 
@@ -450,6 +450,8 @@ static MsvgElement *MsvgNewMissingGlyphElement(MsvgElement *father)
     element->pglyphattr->unicode = 0;
     element->pglyphattr->horiz_adv_x = NODEFINED_VALUE;
     element->pglyphattr->sp = NULL;
+    element->pglyphattr->d = NULL;
+    element->pglyphattr->pp = NULL;
     return element;
 }
 
@@ -471,6 +473,8 @@ static MsvgElement *MsvgNewGlyphElement(MsvgElement *father)
     element->pglyphattr->unicode = 0;
     element->pglyphattr->horiz_adv_x = NODEFINED_VALUE;
     element->pglyphattr->sp = NULL;
+    element->pglyphattr->d = NULL;
+    element->pglyphattr->pp = NULL;
     return element;
 }
 
@@ -597,13 +601,13 @@ MsvgElement *MsvgNewElement(enum EID eid, MsvgElement *father)
 
 int MsvgAllocPointsToPolylineElement(MsvgElement *el, int npoints)
 {
-    double *points;
+    MsvgCoord *points;
 
     if (el->eid != EID_POLYLINE) return 0;
-    points = (double *)calloc(npoints*2, sizeof(double));
+    points = (MsvgCoord *)calloc(npoints*2, sizeof(MsvgCoord));
     if (points == NULL) return 0;
 
-    if (el->ppolylineattr->points) free(el->ppolylineattr->points);
+    MsvgI_ReleasePoints(&(el->ppolylineattr->points), &(el->ppolylineattr->nrefs));
     el->ppolylineattr->points = points;
     el->ppolylineattr->npoints = npoints;
 
@@ -612,13 +616,13 @@ int MsvgAllocPointsToPolylineElement(MsvgElement *el, int npoints)
 
 int MsvgAllocPointsToPolygonElement(MsvgElement *el, int npoints)
 {
-    double *points;
+    MsvgCoord *points;
 
     if (el->eid != EID_POLYGON) return 0;
-    points = (double *)calloc(npoints*2, sizeof(double));
+    points = (MsvgCoord *)calloc(npoints*2, sizeof(MsvgCoord));
     if (points == NULL) return 0;
 
-    if (el->ppolygonattr->points) free(el->ppolygonattr->points);
+    MsvgI_ReleasePoints(&(el->ppolygonattr->points), &(el->ppolygonattr->nrefs));
     el->ppolygonattr->points = points;
     el->ppolygonattr->npoints = npoints;
 
@@ -28,15 +28,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include "msvg.h"
+#include "util.h"
+
+/* the walks go down by the first sons and up by the fathers, so they use
+ * no stack, and like the first ones they continue by the next siblings of
+ * the starting element */
 
 void MsvgWalkTree(MsvgElement *root, MsvgWalkUserFn wufn, void *udata)
 {
-    MsvgElement *pel;
+    MsvgElement *pel, *top;
 
+    top = root->father;
     pel = root;
-    while (pel) {
+    for (;;) {
         wufn(pel, udata);
-        if (pel->fson) MsvgWalkTree(pel->fson, wufn, udata);
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return;
+        }
         pel = pel->nsibling;
     }
 }
@@ -58,15 +71,26 @@ MsvgElement *MsvgFindFirstFather(MsvgElement *el)
 
 static void addCountsCookedTree(const MsvgElement *el, MsvgTreeCounts *tc)
 {
-    if (el->eid > EID_SVG && el->eid <= EID_LAST) {
-        tc->nelem[el->eid] += 1;
-        tc->totelem += 1;
-        if (el->id) tc->totelwid += 1;
+    const MsvgElement *pel, *top;
+
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (pel->eid > EID_SVG && pel->eid <= EID_LAST) {
+            tc->nelem[pel->eid] += 1;
+            tc->totelem += 1;
+            if (pel->id) tc->totelwid += 1;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return;
+        }
+        pel = pel->nsibling;
     }
-
-    if (el->fson) addCountsCookedTree(el->fson, tc);
-
-    if (el->nsibling) addCountsCookedTree(el->nsibling, tc);
 }
 
 void MsvgCalcCountsCookedTree(const MsvgElement *el, MsvgTreeCounts *tc)
@@ -97,15 +121,26 @@ static char *findRawId(const MsvgElement *el)
 
 static void addCountsRawTree(const MsvgElement *el, MsvgTreeCounts *tc)
 {
-    if (el->eid > EID_SVG && el->eid <= EID_LAST) {
-        tc->nelem[el->eid] += 1;
-        tc->totelem += 1;
-        if (findRawId(el)) tc->totelwid += 1;
+    const MsvgElement *pel, *top;
+
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (pel->eid > EID_SVG && pel->eid <= EID_LAST) {
+            tc->nelem[pel->eid] += 1;
+            tc->totelem += 1;
+            if (findRawId(pel)) tc->totelwid += 1;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return;
+        }
+        pel = pel->nsibling;
     }
-
-    if (el->fson) addCountsRawTree(el->fson, tc);
-
-    if (el->nsibling) addCountsRawTree(el->nsibling, tc);
 }
 
 void MsvgCalcCountsRawTree(const MsvgElement *el, MsvgTreeCounts *tc)
@@ -122,116 +157,273 @@ void MsvgCalcCountsRawTree(const MsvgElement *el, MsvgTreeCounts *tc)
 
 MsvgElement *MsvgFindIdCookedTree(MsvgElement *el, char *id)
 {
-    MsvgElement *aux;
+    MsvgElement *pel, *top;
+
+    // a root with id index has no siblings to search
+    if (el->eid == EID_SVG && el->father == NULL && el->psvgattr->idindex)
+        return MsvgFindIdTableId(el->psvgattr->idindex, id);
+
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (pel->eid > EID_SVG && pel->id && strcmp(pel->id, id) == 0)
+            return pel;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return NULL;
+        }
+        pel = pel->nsibling;
+    }
+}
 
-    if (el->eid > EID_SVG && el->id && strcmp(el->id, id) == 0)
-        return el;
+MsvgElement *MsvgFindIdRawTree(MsvgElement *el, char *id)
+{
+    MsvgElement *pel, *top;
+    char *rid;
 
-    if (el->fson) {
-        aux = MsvgFindIdCookedTree(el->fson, id);
-        if (aux) return aux;
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (pel->eid > EID_SVG) {
+            rid = findRawId(pel);
+            if (rid && strcmp(rid, id) == 0)
+                return pel;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return NULL;
+        }
+        pel = pel->nsibling;
     }
+}
 
-    if (el->nsibling) {
-        aux = MsvgFindIdCookedTree(el->nsibling, id);
-        if (aux) return aux;
+/* The id tables are hash tables with open addressing and linear probing,
+ * half full at most. The deletions shift back the next items, so there
+ * are no tombstones and a repeated id is found in insertion order. The
+ * tables keep their own copies of the ids, an id changed or freed in the
+ * element leaves the table stale, but never reading freed memory. */
+
+static unsigned int hashId(const char *id)
+{
+    unsigned int h = 2166136261u;
+
+    while (*id) {
+        h ^= (unsigned char)*id++;
+        h *= 16777619u;
     }
 
-    return NULL;
+    return h;
 }
 
-MsvgElement *MsvgFindIdRawTree(MsvgElement *el, char *id)
+static MsvgTableId *newTableId(int nelem)
 {
-    MsvgElement *aux;
-    char *rid;
+    MsvgTableId *tid;
+    int nslots = 8;
 
-    if (el->eid > EID_SVG) {
-        rid = findRawId(el);
-        if (rid && strcmp(rid, id) == 0)
-            return el;
-    }
+    while (nslots < nelem * 2) nslots *= 2;
 
-    if (el->fson) {
-        aux = MsvgFindIdRawTree(el->fson, id);
-        if (aux) return aux;
-    }
+    tid = (MsvgTableId *)malloc(sizeof(MsvgTableId));
+    if (tid == NULL) return NULL;
 
-    if (el->nsibling) {
-        aux = MsvgFindIdRawTree(el->nsibling, id);
-        if (aux) return aux;
+    tid->item = (MsvgTableIdItem *)calloc(nslots, sizeof(MsvgTableIdItem));
+    if (tid->item == NULL) {
+        free(tid);
+        return NULL;
     }
+    tid->nelem = 0;
+    tid->nslots = nslots;
 
-    return NULL;
+    return tid;
 }
 
-static int cmpTableIdItem(const void *t1, const void *t2)
+static void moveTableIdItem(MsvgTableId *tid, char *id, MsvgElement *el)
 {
-    MsvgTableIdItem *it1, *it2;
+    unsigned int i, mask;
 
-    it1 = (MsvgTableIdItem *)t1;
-    it2 = (MsvgTableIdItem *)t2;
+    // the table owns id from now on
+    mask = tid->nslots - 1;
+    i = hashId(id) & mask;
+    while (tid->item[i].id != NULL) i = (i + 1) & mask;
 
-    return strcmp(it1->id, it2->id);
+    tid->item[i].id = id;
+    tid->item[i].el = el;
+    tid->nelem++;
 }
 
-static void addTableIdItemCooked(MsvgElement *el, MsvgTableId *tid, int maxelem)
+static int putTableIdItem(MsvgTableId *tid, const char *id, MsvgElement *el)
 {
-    if (tid->nelem >= maxelem) return;
+    char *idcopy;
+
+    idcopy = strdup(id);
+    if (idcopy == NULL) return 0;
+    moveTableIdItem(tid, idcopy, el);
+
+    return 1;
+}
 
-    if (el->eid > EID_SVG && el->eid <= EID_LAST && el->id) {
-        tid->item[tid->nelem].id = el->id;
-        tid->item[tid->nelem].el = el;
-        tid->nelem++;
+int MsvgI_AddTableId(MsvgTableId *tid, const char *id, MsvgElement *el)
+{
+    MsvgTableIdItem *olditem;
+    int i, oldnslots;
+
+    if ((tid->nelem + 1) * 2 > tid->nslots) {
+        olditem = tid->item;
+        oldnslots = tid->nslots;
+        tid->item = (MsvgTableIdItem *)calloc(oldnslots * 2,
+                                              sizeof(MsvgTableIdItem));
+        if (tid->item == NULL) {
+            tid->item = olditem;
+            return 0;
+        }
+        tid->nslots = oldnslots * 2;
+        tid->nelem = 0;
+        for (i=0; i<oldnslots; i++) {
+            if (olditem[i].id)
+                moveTableIdItem(tid, olditem[i].id, olditem[i].el);
+        }
+        free(olditem);
     }
 
-    if (el->fson) addTableIdItemCooked(el->fson, tid, maxelem);
+    return putTableIdItem(tid, id, el);
+}
+
+void MsvgI_DelTableId(MsvgTableId *tid, const char *id, const MsvgElement *el)
+{
+    unsigned int i, j, h, mask;
 
-    if (el->nsibling) addTableIdItemCooked(el->nsibling, tid, maxelem);
+    mask = tid->nslots - 1;
+    i = hashId(id) & mask;
+    while (tid->item[i].id != NULL) {
+        if (tid->item[i].el == el && strcmp(tid->item[i].id, id) == 0) break;
+        i = (i + 1) & mask;
+    }
+    if (tid->item[i].id == NULL) return;
+    free(tid->item[i].id);
+
+    // shift back the next items that can't be found with a hole here
+    j = i;
+    for (;;) {
+        tid->item[i].id = NULL;
+        do {
+            j = (j + 1) & mask;
+            if (tid->item[j].id == NULL) {
+                tid->nelem--;
+                return;
+            }
+            h = hashId(tid->item[j].id) & mask;
+        } while (i <= j ? (i < h && h <= j) : (i < h || h <= j));
+        tid->item[i] = tid->item[j];
+        i = j;
+    }
 }
 
-MsvgTableId *MsvgBuildTableIdCookedTree(MsvgElement *el)
+static int hasCookedId(const MsvgElement *el)
+{
+    return el->eid > EID_SVG && el->eid <= EID_LAST && el->id;
+}
+
+void MsvgI_TableIdSubtree(MsvgTableId *tid, MsvgElement *el, int add)
+{
+    MsvgElement *pel;
+
+    // el siblings are not walked
+    pel = el;
+    for (;;) {
+        if (hasCookedId(pel)) {
+            if (add) MsvgI_AddTableId(tid, pel->id, pel);
+            else MsvgI_DelTableId(tid, pel->id, pel);
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+}
+
+static int addTableIdItemCooked(MsvgElement *el, MsvgTableId *tid)
+{
+    MsvgElement *pel, *top;
+
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (hasCookedId(pel) && !putTableIdItem(tid, pel->id, pel)) return 0;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return 1;
+        }
+        pel = pel->nsibling;
+    }
+}
+
+static MsvgTableId *newTableIdCookedTree(MsvgElement *el)
 {
     MsvgTreeCounts tc;
     MsvgTableId *tid;
 
     MsvgCalcCountsCookedTree(el, &tc);
 
-    if (tc.totelwid < 1) return NULL;
+    tid = newTableId(tc.totelwid);
+    if (tid == NULL) return NULL;
 
-    tid = (MsvgTableId *)malloc(sizeof(MsvgTableId)+
-                                sizeof(MsvgTableIdItem)*(tc.totelwid-1));
+    if (!addTableIdItemCooked(el, tid)) {
+        MsvgDestroyTableId(tid);
+        return NULL;
+    }
 
-    if (tid == NULL) return NULL;
+    return tid;
+}
 
-    tid->nelem = 0;
-    addTableIdItemCooked(el, tid, tc.totelwid);
+MsvgTableId *MsvgBuildTableIdCookedTree(MsvgElement *el)
+{
+    MsvgTableId *tid;
 
-    if (tid->nelem > 1) {
-        qsort(&(tid->item[0]), tid->nelem,
-              sizeof(MsvgTableIdItem), cmpTableIdItem);
+    tid = newTableIdCookedTree(el);
+    if (tid && tid->nelem < 1) {
+        MsvgDestroyTableId(tid);
+        return NULL;
     }
 
     return tid;
 }
 
-static void addTableIdItemRaw(MsvgElement *el, MsvgTableId *tid, int maxelem)
+static int addTableIdItemRaw(MsvgElement *el, MsvgTableId *tid)
 {
+    MsvgElement *pel, *top;
     char *rid;
 
-    if (tid->nelem >= maxelem) return;
-
-    if (el->eid > EID_SVG && el->eid <= EID_LAST) {
-        rid = findRawId(el);
-        if (rid) {
-            tid->item[tid->nelem].id = rid;
-            tid->item[tid->nelem].el = el;
-            tid->nelem++;
+    top = el->father;
+    pel = el;
+    for (;;) {
+        if (pel->eid > EID_SVG && pel->eid <= EID_LAST) {
+            rid = findRawId(pel);
+            if (rid && !putTableIdItem(tid, rid, pel)) return 0;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
         }
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            if (pel == top) return 1;
+        }
+        pel = pel->nsibling;
     }
-
-    if (el->fson) addTableIdItemRaw(el->fson, tid, maxelem);
-
-    if (el->nsibling) addTableIdItemRaw(el->nsibling, tid, maxelem);
 }
 
 MsvgTableId *MsvgBuildTableIdRawTree(MsvgElement *el)
@@ -243,17 +435,12 @@ MsvgTableId *MsvgBuildTableIdRawTree(MsvgElement *el)
 
     if (tc.totelwid < 1) return NULL;
 
-    tid = (MsvgTableId *)malloc(sizeof(MsvgTableId)+
-                                sizeof(MsvgTableIdItem)*(tc.totelwid-1));
-
+    tid = newTableId(tc.totelwid);
     if (tid == NULL) return NULL;
 
-    tid->nelem = 0;
-    addTableIdItemRaw(el, tid, tc.totelwid);
-
-    if (tid->nelem > 1) {
-        qsort(&(tid->item[0]), tid->nelem,
-              sizeof(MsvgTableIdItem), cmpTableIdItem);
+    if (!addTableIdItemRaw(el, tid)) {
+        MsvgDestroyTableId(tid);
+        return NULL;
     }
 
     return tid;
@@ -261,19 +448,54 @@ MsvgTableId *MsvgBuildTableIdRawTree(MsvgElement *el)
 
 void MsvgDestroyTableId(MsvgTableId *tid)
 {
+    int i;
+
+    for (i=0; i<tid->nslots; i++)
+        if (tid->item[i].id) free(tid->item[i].id);
+    free(tid->item);
     free(tid);
 }
 
 MsvgElement *MsvgFindIdTableId(const MsvgTableId *tid, char *id)
 {
-    MsvgTableIdItem key, *found;
+    unsigned int i, mask;
 
-    key.id = id;
+    mask = tid->nslots - 1;
+    i = hashId(id) & mask;
+    while (tid->item[i].id != NULL) {
+        if (strcmp(tid->item[i].id, id) == 0) return tid->item[i].el;
+        i = (i + 1) & mask;
+    }
 
-    found = bsearch(&key, &(tid->item[0]), tid->nelem,
-                    sizeof(MsvgTableIdItem), cmpTableIdItem);
+    return NULL;
+}
 
-    if (found) return found->el;
+int MsvgBuildIdIndex(MsvgElement *root)
+{
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
 
-    return NULL;
+    MsvgDestroyIdIndex(root);
+    root->psvgattr->idindex = newTableIdCookedTree(root);
+
+    return root->psvgattr->idindex != NULL;
+}
+
+void MsvgDestroyIdIndex(MsvgElement *root)
+{
+    if (root == NULL) return;
+    if (root->eid != EID_SVG) return;
+
+    if (root->psvgattr->idindex) MsvgDestroyTableId(root->psvgattr->idindex);
+    root->psvgattr->idindex = NULL;
+}
+
+MsvgTableId *MsvgI_GetTableId(MsvgElement *root, int *own)
+{
+    *own = 0;
+    if (root->psvgattr->idindex) return root->psvgattr->idindex;
+
+    *own = 1;
+    return MsvgBuildTableIdCookedTree(root);
 }
@@ -0,0 +1,126 @@
+/* freeze.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include "msvg.h"
+#include "util.h"
+
+/* A frozen cooked tree is a read only snapshot. All that the readers (the
+ * serialization functions, MsvgTransformCookedElement, the hit test, the
+ * spatial index queries and the bounding boxes functions) would calculate
+ * and store in the tree the first time is done by MsvgFreezeTree: the paths
+ * are scanned and packed, the gradients compiled and their binary paint
+ * servers pinned, and the id index, the compiled EID_USE content, the world
+ * bounding boxes and the computed paint contexts (if the cache is enabled)
+ * are built. After that the readers only read the tree, so any number of
+ * threads can use it at the same time without locks. The view matrix is
+ * passed to the serialization functions, not set in the root.
+ *
+ * The tree must not be changed while frozen, MsvgThawTree makes it a
+ * normal tree again.
+ */
+
+static int prepareEl(MsvgElement *el, int freeze)
+{
+    switch (el->eid) {
+        case EID_PATH :
+            if (!freeze) return 1;
+            MsvgGetPackedPath(el);
+            // out of memory if still pending, a reader would try again
+            if (el->ppathattr->d) return 0;
+            if (el->ppathattr->sp && el->ppathattr->pp == NULL) return 0;
+            return 1;
+        case EID_GLYPH :
+        case EID_MISSINGGLYPH :
+            if (!freeze) return 1;
+            MsvgGetPackedPath(el);
+            if (el->pglyphattr->d) return 0;
+            if (el->pglyphattr->sp && el->pglyphattr->pp == NULL) return 0;
+            return 1;
+        case EID_LINEARGRADIENT :
+        case EID_RADIALGRADIENT :
+            // the gradients without enough stops have no paint server
+            MsvgI_PinBPServerCache(el, freeze);
+            return 1;
+        default :
+            return 1;
+    }
+}
+
+static int prepareTree(MsvgElement *root, int freeze)
+{
+    MsvgElement *pel;
+    int ok = 1;
+
+    pel = root;
+    for (;;) {
+        if (!prepareEl(pel, freeze)) ok = 0;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != root && pel->nsibling == NULL) pel = pel->father;
+        if (pel == root) break;
+        pel = pel->nsibling;
+    }
+
+    return ok;
+}
+
+int MsvgFreezeTree(MsvgElement *root)
+{
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+    if (root->psvgattr->frozen) return 1;
+
+    // the id index first, the other ones use it
+    if (root->psvgattr->idindex == NULL && !MsvgBuildIdIndex(root)) return 0;
+    if (!MsvgBuildUseCache(root)) return 0;
+    if (!MsvgCalcCookedWorldBBoxes(root)) return 0;
+    if (root->psvgattr->pctxcache && !MsvgBuildPaintCtxCache(root)) return 0;
+
+    if (!prepareTree(root, 1)) {
+        prepareTree(root, 0);
+        return 0;
+    }
+
+    root->psvgattr->frozen = 1;
+
+    return 1;
+}
+
+void MsvgThawTree(MsvgElement *root)
+{
+    if (root == NULL) return;
+    if (root->eid != EID_SVG) return;
+    if (!root->psvgattr->frozen) return;
+
+    prepareTree(root, 0);
+    root->psvgattr->frozen = 0;
+}
@@ -89,17 +89,13 @@ static int normalizeGradient(MsvgElement *el, const MsvgTableId *tid)
     return ngn;
 }
 
-static int normalize(MsvgElement *el)
+static int normalize(MsvgElement *el, const MsvgTableId *tid)
 {
     int ngn = 0;
-    MsvgTableId *tid;
     MsvgElement *pel;
 
     if (el->eid != EID_DEFS) return 0;
 
-    tid = MsvgBuildTableIdRawTree(el);
-    if (tid == NULL) return 0;
-
     pel = el->fson;
     while (pel) {
         if (pel->eid == EID_LINEARGRADIENT || pel->eid == EID_RADIALGRADIENT) {
@@ -114,17 +110,25 @@ static int normalize(MsvgElement *el)
 int MsvgNormalizeRawGradients(MsvgElement *el)
 {
     int ngn = 0;
+    MsvgTableId *tid;
     MsvgElement *pel;
 
     if (el->eid != EID_SVG) return 0;
 
+    // one table for all the EID_DEFS elements, the stops added don't
+    // have id
+    tid = MsvgBuildTableIdRawTree(el);
+    if (tid == NULL) return 0;
+
     pel = el->fson;
     while (pel) {
         if (pel->eid == EID_DEFS) {
-            ngn += normalize(pel);
+            ngn += normalize(pel, tid);
         }
         pel = pel->nsibling;
     }
 
+    MsvgDestroyTableId(tid);
+
     return ngn;
 }
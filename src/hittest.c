@@ -0,0 +1,475 @@
+/* hittest.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msvg.h"
+#include "util.h"
+
+/* curves are flattened to a point every two device pixels, more or less:
+ * path2ply places a point every 8 units of control polygon divided by the
+ * pixels per unit, that are this value by the scale of the root matrix */
+
+#define HIT_PX_X_UNIT 4
+
+typedef struct {
+    double x, y;            // point tested, in world coordinates
+    double tol;             // tolerance
+    double pxunit;          // pixels per world unit to flatten curves
+    MsvgBox box;            // point box enlarged by the tolerance
+    MsvgElement *root;      // to get tid when needed
+    MsvgTableId *tid;
+    int own_tid;            // tid is not the root id index
+    MsvgI_UseChain *uses;   // referenced elements being expanded
+    int ncands;             // candidates found by the bbox prefilter
+    int maxcands;
+    MsvgElement **cands;
+} HitData;
+
+typedef struct {
+    int winding;            // sum of the ring winding numbers
+    double dfill;           // min distance to the fill outline
+    double dstroke;         // min distance to the stroke
+} HitAcc;
+
+static int hitElement(MsvgElement *el, const MsvgPaintCtx *fath, HitData *hd);
+
+static int windingNumber(int npoints, const MsvgCoord *points, double x, double y)
+{
+    const MsvgCoord *p0, *p1;
+    double cross;
+    int i, wn = 0;
+
+    p0 = &points[npoints*2-2];
+    p1 = &points[0];
+
+    for (i=0; i<npoints; i++) {
+        cross = (p1[0] - p0[0]) * (y - p0[1]) - (x - p0[0]) * (p1[1] - p0[1]);
+        if (p0[1] <= y) {
+            if (p1[1] > y && cross > 0) wn++;
+        } else {
+            if (p1[1] <= y && cross < 0) wn--;
+        }
+        p0 = p1;
+        p1 += 2;
+    }
+
+    return wn;
+}
+
+static double segmentDist(const MsvgCoord *p0, const MsvgCoord *p1, double x, double y)
+{
+    double dx, dy, t, l2;
+
+    dx = p1[0] - p0[0];
+    dy = p1[1] - p0[1];
+    l2 = dx*dx + dy*dy;
+    t = 0;
+    if (l2 > 0) {
+        t = ((x - p0[0]) * dx + (y - p0[1]) * dy) / l2;
+        if (t < 0) t = 0;
+        else if (t > 1) t = 1;
+    }
+    dx = p0[0] + t * dx - x;
+    dy = p0[1] + t * dy - y;
+
+    return sqrt(dx*dx + dy*dy);
+}
+
+int MsvgInsidePolygonTest(int npoints, const MsvgCoord *points, double x, double y,
+                          int fillrule)
+{
+    int wn;
+
+    if (npoints < 3) return 0;
+
+    wn = windingNumber(npoints, points, x, y);
+
+    if (fillrule == FILLRULE_EVENODD) return wn & 1;
+
+    return wn != 0;
+}
+
+static void accRing(HitAcc *acc, int npoints, const MsvgCoord *points,
+                    int closed, double x, double y)
+{
+    double d;
+    int i;
+
+    if (npoints < 1) return;
+
+    // the fill of an open ring is closed implicitly
+    if (npoints > 2) acc->winding += windingNumber(npoints, points, x, y);
+
+    if (npoints == 1) {
+        d = segmentDist(points, points, x, y);
+        if (d < acc->dfill) acc->dfill = d;
+        if (d < acc->dstroke) acc->dstroke = d;
+        return;
+    }
+
+    for (i=1; i<npoints; i++) {
+        d = segmentDist(&points[i*2-2], &points[i*2], x, y);
+        if (d < acc->dfill) acc->dfill = d;
+        if (d < acc->dstroke) acc->dstroke = d;
+    }
+
+    d = segmentDist(&points[npoints*2-2], &points[0], x, y);
+    if (d < acc->dfill) acc->dfill = d;
+    if (closed && d < acc->dstroke) acc->dstroke = d;
+}
+
+static int hitText(MsvgElement *el, MsvgElement *newel, HitData *hd)
+{
+    double pad = 0;
+
+    // the same rough box used for the world bbox
+    if (el->fcontent)
+        pad = newel->pctx->font_size * el->fcontent->len;
+    if (pad < newel->pctx->font_size) pad = newel->pctx->font_size;
+    pad += hd->tol;
+
+    return fabs(hd->x - newel->ptextattr->x) <= pad &&
+           fabs(hd->y - newel->ptextattr->y) <= pad;
+}
+
+static int hitLeaf(MsvgElement *el, MsvgPaintCtx *pctx, HitData *hd)
+{
+    MsvgElement *newel;
+    MsvgPaintCtx *npctx;
+    MsvgPackedPath *pp;
+    HitAcc acc;
+    MsvgCoord rp[8], *points;
+    int i, npoints, inside, hit = 0;
+
+    newel = MsvgTransformCookedElement(el, pctx, MSVGTCE_CIR2PATH|MSVGTCE_ELL2PATH);
+    if (newel == NULL) return 0;
+
+    acc.winding = 0;
+    acc.dfill = acc.dstroke = 1e300;
+
+    switch (newel->eid) {
+        case EID_RECT :
+            rp[0] = rp[6] = newel->prectattr->x;
+            rp[1] = rp[3] = newel->prectattr->y;
+            rp[2] = rp[4] = newel->prectattr->x + newel->prectattr->width;
+            rp[5] = rp[7] = newel->prectattr->y + newel->prectattr->height;
+            accRing(&acc, 4, rp, 1, hd->x, hd->y);
+            break;
+        case EID_LINE :
+            rp[0] = newel->plineattr->x1;
+            rp[1] = newel->plineattr->y1;
+            rp[2] = newel->plineattr->x2;
+            rp[3] = newel->plineattr->y2;
+            accRing(&acc, 2, rp, 0, hd->x, hd->y);
+            break;
+        case EID_POLYLINE :
+            accRing(&acc, newel->ppolylineattr->npoints,
+                    newel->ppolylineattr->points, 0, hd->x, hd->y);
+            break;
+        case EID_POLYGON :
+            accRing(&acc, newel->ppolygonattr->npoints,
+                    newel->ppolygonattr->points, 1, hd->x, hd->y);
+            break;
+        case EID_PATH :
+            pp = MsvgGetPackedPath(newel);
+            if (pp == NULL) break;
+            for (i=0; i<pp->nsubpaths; i++) {
+                points = MsvgI_FlattenSubPath(pp, i, hd->pxunit, &npoints);
+                if (points == NULL) continue;
+                accRing(&acc, npoints, points, pp->closed[i], hd->x, hd->y);
+                free(points);
+            }
+            break;
+        case EID_TEXT :
+            hit = hitText(el, newel, hd);
+            break;
+        default :
+            break;
+    }
+
+    npctx = newel->pctx;
+    if (!hit && npctx->fill != NO_COLOR && newel->eid != EID_LINE) {
+        inside = (npctx->fill_rule == FILLRULE_EVENODD) ? (acc.winding & 1) :
+                 (acc.winding != 0);
+        if (inside || acc.dfill <= hd->tol) hit = 1;
+    }
+    if (!hit && npctx->stroke != NO_COLOR && npctx->stroke_width > 0 &&
+        newel->eid != EID_TEXT) {
+        if (acc.dstroke <= npctx->stroke_width / 2 + hd->tol) hit = 1;
+    }
+
+    MsvgDeleteElement(newel);
+
+    return hit;
+}
+
+static int hitUse(MsvgElement *el, const MsvgPaintCtx *fath, HitData *hd)
+{
+    MsvgElement *refel;
+    MsvgPaintCtx *pctx;
+    MsvgI_UseChain link;
+    TMatrix uset;
+    int hit;
+
+    if (hd->tid == NULL && hd->root != NULL) {
+        hd->tid = MsvgI_GetTableId(hd->root, &(hd->own_tid));
+        hd->root = NULL; // only one try
+    }
+    if (hd->tid == NULL) return 0;
+
+    refel = MsvgFindIdTableId(hd->tid, el->puseattr->refel);
+    if (refel == NULL) return 0;
+    if (MsvgI_InUseChain(hd->uses, refel)) return 0; // reference cycle
+
+    pctx = MsvgNewPaintCtx(el->pctx);
+    if (pctx == NULL) return 0;
+    TMSetTranslation(&uset, el->puseattr->x, el->puseattr->y);
+    TMMpy(&(pctx->tmatrix), &(el->pctx->tmatrix), &uset);
+    MsvgProcPaintCtxInheritance(pctx, fath);
+
+    link.refel = refel;
+    link.prev = hd->uses;
+    hd->uses = &link;
+    hit = hitElement(refel, pctx, hd);
+    hd->uses = link.prev;
+
+    MsvgDestroyPaintCtx(pctx);
+
+    return hit;
+}
+
+static int hitElement(MsvgElement *el, const MsvgPaintCtx *fath, HitData *hd)
+{
+    MsvgPaintCtx *pctx;
+    MsvgElement *pel;
+    int hit = 0;
+
+    switch (el->eid) {
+        case EID_G :
+            pctx = MsvgNewPaintCtx(el->pctx);
+            if (pctx == NULL) return 0;
+            MsvgProcPaintCtxInheritance(pctx, fath);
+            // the last son is painted over the others
+            pel = el->lson;
+            while (pel && !hit) {
+                hit = hitElement(pel, pctx, hd);
+                pel = pel->psibling;
+            }
+            MsvgDestroyPaintCtx(pctx);
+            return hit;
+        case EID_USE :
+            return hitUse(el, fath, hd);
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            pctx = MsvgNewPaintCtx(el->pctx);
+            if (pctx == NULL) return 0;
+            MsvgProcPaintCtxInheritance(pctx, fath);
+            MsvgProcPaintCtxDefaults(pctx);
+            hit = hitLeaf(el, pctx, hd);
+            MsvgDestroyPaintCtx(pctx);
+            return hit;
+        default :
+            return 0;
+    }
+}
+
+static int hitCandidate(MsvgElement *el, HitData *hd)
+{
+    MsvgPaintCtx *fath;
+    int hit;
+
+    if (el->father->cpctx_ok) return hitElement(el, el->father->cpctx, hd);
+
+    fath = MsvgI_BuildWorldPaintCtx(el->father);
+    if (fath == NULL) return 0;
+
+    hit = hitElement(el, fath, hd);
+
+    MsvgDestroyPaintCtx(fath);
+
+    return hit;
+}
+
+/* bbox prefilter */
+
+static int intersectBox(const MsvgBox *b1, const MsvgBox *b2)
+{
+    if (b1->gmaxx < b2->gminx || b1->gminx > b2->gmaxx) return 0;
+    if (b1->gmaxy < b2->gminy || b1->gminy > b2->gmaxy) return 0;
+    return 1;
+}
+
+static void addCandidate(MsvgElement *el, void *udata)
+{
+    HitData *hd;
+    MsvgElement **p;
+    int n;
+
+    hd = (HitData *)udata;
+    if (hd->ncands >= hd->maxcands) {
+        n = (hd->maxcands > 0) ? hd->maxcands * 2 : 64;
+        p = realloc(hd->cands, n * sizeof(MsvgElement *));
+        if (p == NULL) return;
+        hd->cands = p;
+        hd->maxcands = n;
+    }
+    hd->cands[hd->ncands++] = el;
+}
+
+static void collectCandidates(MsvgElement *el, HitData *hd)
+{
+    MsvgElement *pel;
+
+    // candidates are collected in paint order
+    pel = el->fson;
+    while (pel) {
+        switch (pel->eid) {
+            case EID_G :
+                if (pel->fson && pel->wbbox_ok &&
+                    intersectBox(&(pel->wbbox), &(hd->box))) {
+                    pel = pel->fson;
+                    continue;
+                }
+                break;
+            case EID_USE :
+            case EID_RECT :
+            case EID_CIRCLE :
+            case EID_ELLIPSE :
+            case EID_LINE :
+            case EID_POLYLINE :
+            case EID_POLYGON :
+            case EID_PATH :
+            case EID_TEXT :
+                if (pel->wbbox_ok && intersectBox(&(pel->wbbox), &(hd->box)))
+                    addCandidate(pel, hd);
+                break;
+            default :
+                break;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        pel = (pel == el) ? NULL : pel->nsibling;
+    }
+}
+
+/* qsort compare function, sorts elements in paint order */
+
+static int cmpPaintOrder(const void *a, const void *b)
+{
+    MsvgElement *e1 = *(MsvgElement **)a;
+    MsvgElement *e2 = *(MsvgElement **)b;
+    MsvgElement *p1, *p2;
+    int d1 = 0, d2 = 0;
+
+    for (p1=e1; p1->father; p1=p1->father) d1++;
+    for (p2=e2; p2->father; p2=p2->father) d2++;
+
+    for (; d1>d2; d1--) e1 = e1->father;
+    for (; d2>d1; d2--) e2 = e2->father;
+    if (e1 == e2) return 0; // one is an ancestor of the other
+
+    while (e1->father != e2->father) {
+        e1 = e1->father;
+        e2 = e2->father;
+    }
+
+    // e1 and e2 are siblings now, search in both directions
+    p1 = e1->psibling;
+    p2 = e1->nsibling;
+    while (p1 || p2) {
+        if (p1 == e2) return 1;
+        if (p2 == e2) return -1;
+        if (p1) p1 = p1->psibling;
+        if (p2) p2 = p2->nsibling;
+    }
+
+    return 0;
+}
+
+MsvgElement *MsvgHitTest(MsvgElement *root, double x, double y, double tolerance)
+{
+    HitData hd;
+    MsvgElement *hitel = NULL;
+    TMatrix *t;
+    double scale;
+    int i;
+
+    if (root == NULL) return NULL;
+    if (root->eid != EID_SVG) return NULL;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return NULL;
+
+    if (tolerance < 0) tolerance = 0;
+    hd.x = x;
+    hd.y = y;
+    hd.tol = tolerance;
+    // the world is drawn with the root matrix, a zoom needs more points
+    t = &(root->pctx->tmatrix);
+    scale = sqrt(fabs(t->a * t->d - t->b * t->c));
+    if (scale < 1e-6) scale = 1;
+    hd.pxunit = HIT_PX_X_UNIT * scale;
+    hd.box.gminx = x - tolerance;
+    hd.box.gmaxx = x + tolerance;
+    hd.box.gminy = y - tolerance;
+    hd.box.gmaxy = y + tolerance;
+    hd.root = root;
+    hd.tid = NULL;
+    hd.own_tid = 0;
+    hd.uses = NULL;
+    hd.ncands = 0;
+    hd.maxcands = 0;
+    hd.cands = NULL;
+
+    if (root->psvgattr->rtree) {
+        MsvgRTreeSearch(root, &(hd.box), addCandidate, &hd);
+        if (hd.ncands > 1)
+            qsort(hd.cands, hd.ncands, sizeof(MsvgElement *), cmpPaintOrder);
+    } else {
+        if (!root->wbbox_ok) MsvgCalcCookedWorldBBoxes(root);
+        collectCandidates(root, &hd);
+    }
+
+    // the topmost hit is the last painted
+    for (i=hd.ncands-1; i>=0; i--) {
+        if (hitCandidate(hd.cands[i], &hd)) {
+            hitel = hd.cands[i];
+            break;
+        }
+    }
+
+    if (hd.cands) free(hd.cands);
+    if (hd.own_tid && hd.tid) MsvgDestroyTableId(hd.tid);
+
+    return hitel;
+}
@@ -0,0 +1,250 @@
+/* journal.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include "msvg.h"
+#include "util.h"
+
+/* The change journal records the elements inserted, removed or modified by
+ * the element manipulation functions with their world bounding boxes before
+ * and after the change, so the world bboxes are kept updated while a tree
+ * has a journal. A change that can affect other elements (of the root, of
+ * an element not in drawable position, like inside EID_DEFS, or with ids if
+ * the tree has EID_USE elements) makes all the tree dirty.
+ */
+
+static void iniBox(MsvgBox *box)
+{
+    box->gminx = 1e9;
+    box->gmaxx = -1e9;
+    box->gminy = 1e9;
+    box->gmaxy = -1e9;
+}
+
+static void unionBox(MsvgBox *box, const MsvgBox *box2)
+{
+    if (box2->gminx > box2->gmaxx) return; // empty box
+    if (box2->gminx < box->gminx) box->gminx = box2->gminx;
+    if (box2->gmaxx > box->gmaxx) box->gmaxx = box2->gmaxx;
+    if (box2->gminy < box->gminy) box->gminy = box2->gminy;
+    if (box2->gmaxy > box->gmaxy) box->gmaxy = box2->gmaxy;
+}
+
+static int scanSubtree(MsvgElement *el, int *hasids)
+{
+    MsvgElement *pel;
+    int nuses = 0;
+
+    // returns the number of EID_USE elements
+    pel = el;
+    for (;;) {
+        if (pel->eid == EID_USE) nuses++;
+        if (pel->id) *hasids = 1;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+
+    return nuses;
+}
+
+static int drawablePosition(MsvgElement *root, MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    switch (el->eid) {
+        case EID_G :
+        case EID_USE :
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            break;
+        default :
+            return 0;
+    }
+
+    // the same elements that have a world bbox
+    for (pel=el->father; pel!=root; pel=pel->father) {
+        if (pel == NULL || pel->eid != EID_G) return 0;
+    }
+
+    return 1;
+}
+
+static void addChange(MsvgChangeJournal *jn, MsvgElement *el, int type,
+                      int wholetree, const MsvgBox *oldbox,
+                      const MsvgBox *newbox)
+{
+    MsvgChange *change;
+    int maxchanges;
+
+    if (wholetree) jn->wholetree = 1;
+    unionBox(&(jn->dirty), oldbox);
+    unionBox(&(jn->dirty), newbox);
+
+    if (jn->nchanges >= jn->maxchanges) {
+        maxchanges = jn->maxchanges ? jn->maxchanges * 2 : 16;
+        change = (MsvgChange *)realloc(jn->change,
+                                       sizeof(MsvgChange) * maxchanges);
+        if (change == NULL) {
+            // not recorded, but the dirty box is still right
+            jn->wholetree = 1;
+            return;
+        }
+        jn->change = change;
+        jn->maxchanges = maxchanges;
+    }
+
+    change = &(jn->change[jn->nchanges++]);
+    change->el = el;
+    change->type = type;
+    change->wholetree = wholetree;
+    change->oldbox = *oldbox;
+    change->newbox = *newbox;
+}
+
+int MsvgBuildChangeJournal(MsvgElement *root)
+{
+    MsvgChangeJournal *jn;
+    int hasids = 0;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    MsvgDestroyChangeJournal(root);
+
+    if (!MsvgCalcCookedWorldBBoxes(root)) return 0;
+
+    jn = (MsvgChangeJournal *)calloc(1, sizeof(MsvgChangeJournal));
+    if (jn == NULL) return 0;
+
+    iniBox(&(jn->dirty));
+    jn->world = root->wbbox;
+    jn->nuses = scanSubtree(root, &hasids);
+
+    root->psvgattr->journal = jn;
+
+    return 1;
+}
+
+void MsvgDestroyChangeJournal(MsvgElement *root)
+{
+    MsvgChangeJournal *jn;
+
+    if (root == NULL || root->eid != EID_SVG) return;
+
+    jn = root->psvgattr->journal;
+    if (jn == NULL) return;
+
+    if (jn->change) free(jn->change);
+    free(jn);
+    root->psvgattr->journal = NULL;
+}
+
+int MsvgGetDirtyBox(MsvgElement *root, MsvgBox *box)
+{
+    MsvgChangeJournal *jn;
+    int dirty;
+
+    if (root == NULL || root->eid != EID_SVG) return 0;
+
+    jn = root->psvgattr->journal;
+    if (jn == NULL) return 0;
+
+    // all that was drawn is inside the world box, and all that will be
+    // drawn is inside the new world box or the changed boxes
+    if (jn->wholetree) {
+        unionBox(&(jn->dirty), &(jn->world));
+        MsvgCalcCookedWorldBBoxes(root);
+        jn->world = root->wbbox;
+        unionBox(&(jn->dirty), &(jn->world));
+    } else {
+        unionBox(&(jn->world), &(jn->dirty));
+    }
+
+    dirty = jn->dirty.gminx <= jn->dirty.gmaxx;
+    if (box) *box = jn->dirty;
+
+    iniBox(&(jn->dirty));
+    jn->nchanges = 0;
+    jn->wholetree = 0;
+
+    return dirty;
+}
+
+/* internal function called by the element manipulation functions */
+
+void MsvgI_JournalChange(MsvgElement *root, MsvgElement *el, int type,
+                         const MsvgBox *oldbox, int boxes)
+{
+    MsvgChangeJournal *jn;
+    MsvgBox empty;
+    int nuses, hasids = 0, tracked;
+
+    if (root == NULL || root->eid != EID_SVG) return;
+    jn = root->psvgattr->journal;
+    if (jn == NULL) return;
+
+    nuses = scanSubtree(el, &hasids);
+    if (type == CHANGE_INSERTED) jn->nuses += nuses;
+
+    tracked = el != root && drawablePosition(root, el) &&
+              !(hasids && jn->nuses > 0) && !jn->wholetree;
+
+    if (type == CHANGE_REMOVED) jn->nuses -= nuses;
+
+    iniBox(&empty);
+
+    // with the whole tree dirty the boxes are calculated by MsvgGetDirtyBox
+    if (tracked && type == CHANGE_REMOVED) {
+        if (el->wbbox_ok) {
+            addChange(jn, el, type, 0, &(el->wbbox), &empty);
+            return;
+        }
+    } else if (tracked && (type == CHANGE_INSERTED || oldbox != NULL)) {
+        if (!boxes) MsvgI_CalcSubtreeWorldBBoxes(root, el);
+        if (el->wbbox_ok) {
+            addChange(jn, el, type, 0,
+                      type == CHANGE_INSERTED ? &empty : oldbox,
+                      &(el->wbbox));
+            return;
+        }
+    }
+
+    addChange(jn, el, type, 1, &empty, &empty);
+}
@@ -27,16 +27,149 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "msvg.h"
+#include "util.h"
 
-void MsvgPruneElement(MsvgElement *el)
+/* the id index, the spatial index and the change journal of a cooked tree
+ * are kept updated here, the world bboxes of a tree without spatial index
+ * or journal, the computed paint contexts, the compiled EID_USE content and
+ * the compiled gradients are only invalidated */
+
+static MsvgElement *updateRootCaches(MsvgElement *el, int add)
+{
+    MsvgElement *root;
+
+    if (el->father == NULL) return NULL;
+
+    root = MsvgFindFirstFather(el);
+    if (root->eid != EID_SVG) return NULL;
+
+    if (root->psvgattr->idindex)
+        MsvgI_TableIdSubtree(root->psvgattr->idindex, el, add);
+    MsvgI_PaintCtxCacheChanged(root, el);
+
+    return root;
+}
+
+static MsvgElement *indexedRoot(MsvgElement *el, int *indefs)
+{
+    MsvgElement *root, *pel;
+
+    // el can be a gradient or be inside one
+    for (pel=el; pel!=NULL; pel=pel->father)
+        MsvgI_ClearBPServerCache(pel);
+
+    if (el->father == NULL) return NULL;
+
+    root = MsvgFindFirstFather(el);
+    if (root->eid != EID_SVG) return NULL;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return NULL;
+
+    // any element can be referenced or hold a referenced element
+    if (root->psvgattr->usecache)
+        MsvgI_ClearUseCache(root->psvgattr->usecache);
+
+    if (root->psvgattr->rtree == NULL) {
+        root->wbbox_ok = 0;
+        return NULL;
+    }
+
+    // only the elements in drawable position are indexed, but a change
+    // inside DEFS can affect to the EID_USE elements
+    *indefs = 0;
+    for (pel=el->father; pel!=root; pel=pel->father) {
+        if (pel->eid == EID_DEFS) *indefs = 1;
+        else if (pel->eid != EID_G) return NULL;
+    }
+
+    return root;
+}
+
+static int hasIds(MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    pel = el;
+    for (;;) {
+        if (pel->id) return 1;
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) return 0;
+        pel = pel->nsibling;
+    }
+}
+
+static void addToRTree(MsvgElement *root, MsvgElement *el)
+{
+    // without memory to index the subtree the spatial index is dropped,
+    // the queries walk the tree as if it was never built
+    if (!MsvgI_RTreeAddSubtree(root->psvgattr->rtree, el)) {
+        MsvgDestroyRTree(root);
+        root->wbbox_ok = 0;
+    }
+}
+
+static int affectsUses(MsvgElement *root, MsvgElement *el, int indefs)
+{
+    if (MsvgI_RTreeNumUses(root->psvgattr->rtree) == 0) return 0;
+
+    return indefs || hasIds(el);
+}
+
+static void notifyInserted(MsvgElement *el)
+{
+    MsvgElement *root, *svgroot;
+    int indefs, boxes = 0;
+
+    svgroot = updateRootCaches(el, 1);
+
+    root = indexedRoot(el, &indefs);
+    if (root != NULL) {
+        if (affectsUses(root, el, indefs)) {
+            MsvgBuildRTree(root);
+            boxes = 1;
+        } else if (!indefs) {
+            MsvgI_CalcSubtreeWorldBBoxes(root, el);
+            addToRTree(root, el);
+            boxes = 1;
+        }
+    }
+
+    MsvgI_JournalChange(svgroot, el, CHANGE_INSERTED, NULL, boxes);
+}
+
+/* returns 1 if the index must be rebuilt after the element is unlinked */
+
+static int notifyRemoving(MsvgElement *el)
+{
+    MsvgElement *root, *svgroot;
+    int indefs;
+
+    svgroot = updateRootCaches(el, 0);
+    MsvgI_JournalChange(svgroot, el, CHANGE_REMOVED, NULL, 0);
+
+    root = indexedRoot(el, &indefs);
+    if (root == NULL) return 0;
+
+    if (affectsUses(root, el, indefs)) return 1;
+
+    if (!indefs) MsvgI_RTreeDelSubtree(root->psvgattr->rtree, el);
+
+    return 0;
+}
+
+static void unlinkElement(MsvgElement *el)
 {
     MsvgElement *father;
     
     father = el->father;
-    if (father == NULL) return; // already pruned
     
     el->father = NULL;
+    if (el->nsibling == NULL) father->lson = el->psibling;
     if (el->psibling == NULL) { // first sibling
         father->fson = el->nsibling;
         if (el->nsibling != NULL) {
@@ -53,6 +186,19 @@ void MsvgPruneElement(MsvgElement *el)
     }
 }
 
+void MsvgPruneElement(MsvgElement *el)
+{
+    MsvgElement *root;
+    int rebuild;
+
+    if (el->father == NULL) return; // already pruned
+
+    root = MsvgFindFirstFather(el);
+    rebuild = notifyRemoving(el);
+    unlinkElement(el);
+    if (rebuild) MsvgBuildRTree(root);
+}
+
 static void MsvgFreeElement(MsvgElement *el)
 {
     switch (el->eid) {
@@ -82,24 +228,28 @@ static void MsvgFreeElement(MsvgElement *el)
             free(el->plineattr);
             break;
         case EID_POLYLINE :
-            if (el->ppolylineattr->points) free(el->ppolylineattr->points);
+            MsvgI_ReleasePoints(&(el->ppolylineattr->points), &(el->ppolylineattr->nrefs));
             free(el->ppolylineattr);
             break;
         case EID_POLYGON :
-            if (el->ppolygonattr->points) free(el->ppolygonattr->points);
+            MsvgI_ReleasePoints(&(el->ppolygonattr->points), &(el->ppolygonattr->nrefs));
             free(el->ppolygonattr);
             break;
         case EID_PATH :
             if (el->ppathattr->sp) MsvgDestroySubPath(el->ppathattr->sp);
+            if (el->ppathattr->d) free(el->ppathattr->d);
+            if (el->ppathattr->pp) MsvgDestroyPackedPath(el->ppathattr->pp);
             free(el->ppathattr);
             break;
         case EID_TEXT :
             free(el->ptextattr);
             break;
         case EID_LINEARGRADIENT :
+            if (el->plgradattr->bps) MsvgDestroyBPServer(el->plgradattr->bps);
             free(el->plgradattr);
             break;
         case EID_RADIALGRADIENT :
+            if (el->prgradattr->bps) MsvgDestroyBPServer(el->prgradattr->bps);
             free(el->prgradattr);
             break;
         case EID_STOP :
@@ -114,10 +264,14 @@ static void MsvgFreeElement(MsvgElement *el)
             break;
         case EID_MISSINGGLYPH :
             if (el->pglyphattr->sp) MsvgDestroySubPath(el->pglyphattr->sp);
+            if (el->pglyphattr->d) free(el->pglyphattr->d);
+            if (el->pglyphattr->pp) MsvgDestroyPackedPath(el->pglyphattr->pp);
             free(el->pglyphattr);
             break;
         case EID_GLYPH :
             if (el->pglyphattr->sp) MsvgDestroySubPath(el->pglyphattr->sp);
+            if (el->pglyphattr->d) free(el->pglyphattr->d);
+            if (el->pglyphattr->pp) MsvgDestroyPackedPath(el->pglyphattr->pp);
             free(el->pglyphattr);
             break;
         case EID_TITLE :
@@ -131,26 +285,51 @@ static void MsvgFreeElement(MsvgElement *el)
 
     if (el->id) free(el->id);
     if (el->pctx) MsvgDestroyPaintCtx(el->pctx);
+    if (el->cpctx) MsvgDestroyPaintCtx(el->cpctx);
     free(el);
 }
 
+static void destroyIndexes(MsvgElement *el)
+{
+    MsvgThawTree(el);
+    MsvgDestroyRTree(el);
+    MsvgDestroyUseCache(el);
+    MsvgDestroyIdIndex(el);
+    MsvgDestroyChangeJournal(el);
+}
+
 void MsvgDeleteElement(MsvgElement *el)
 {
+    MsvgElement *pel, *father;
+
     MsvgPruneElement(el);
-    
-    while (el->fson != NULL) {
-        MsvgDeleteElement(el->fson);
+
+    // the subtree is unlinked now, so the sons are not removed from the
+    // indexes one by one, they are freed from the first leaf going up
+    if (el->eid == EID_SVG) destroyIndexes(el);
+    pel = el;
+    for (;;) {
+        if (pel->fson) {
+            pel = pel->fson;
+            if (pel->eid == EID_SVG) destroyIndexes(pel);
+            continue;
+        }
+        father = (pel == el) ? NULL : pel->father;
+        if (father) {
+            father->fson = pel->nsibling;
+            if (father->fson) father->fson->psibling = NULL;
+            else father->lson = NULL;
+        }
+        MsvgDelAllRawAttributes(pel);
+        MsvgDelContents(pel);
+        MsvgFreeElement(pel);
+        if (father == NULL) break;
+        pel = father;
     }
-    
-    MsvgDelAllRawAttributes(el);
-    MsvgDelContents(el);
-    MsvgFreeElement(el);
 }
 
 int MsvgInsertSonElement(MsvgElement *el, MsvgElement *father)
 {
-    MsvgElement *ptr;
-    
     if (father == NULL) return 0;
     if (!MsvgIsSupSonElement(father->eid, el->eid)) return 0;
     
@@ -159,13 +338,13 @@ int MsvgInsertSonElement(MsvgElement *el, MsvgElement *father)
     if (father->fson == NULL) {
         father->fson = el;
     } else {
-        ptr = father->fson;
-        while (ptr->nsibling != NULL)
-            ptr = ptr->nsibling;
-        ptr->nsibling = el;
-        el->psibling = ptr;
+        father->lson->nsibling = el;
+        el->psibling = father->lson;
     }
+    father->lson = el;
     
+    notifyInserted(el);
+
     return 1;
 }
 
@@ -187,6 +366,8 @@ int MsvgInsertPSiblingElement(MsvgElement *el, MsvgElement *sibling)
         sibling->psibling = el;
     }
     
+    notifyInserted(el);
+
     return 1;
 }
 
@@ -197,31 +378,64 @@ int MsvgInsertNSiblingElement(MsvgElement *el, MsvgElement *sibling)
     el->father = sibling->father;
     
     el->nsibling = sibling->nsibling;
-    el->nsibling = el;
+    sibling->nsibling = el;
     el->psibling = sibling;
     if (el->nsibling != NULL)
         el->nsibling->psibling = el;
+    else if (el->father != NULL)
+        el->father->lson = el;
     
+    notifyInserted(el);
+
     return 1;
 }
 
-MsvgElement *MsvgDupElement(MsvgElement *el, int copytree)
+static MsvgElement *dupNode(MsvgElement *el)
 {
-    MsvgElement *newel, *ptrnew, *ptrold;
+    MsvgElement *newel;
 
     newel = MsvgNewElement(el->eid, NULL);
     if (newel == NULL) return NULL;
 
-    MsvgCopyRawAttributes(newel, el);
-    MsvgCopyCookedAttributes(newel, el);
-    MsvgCopyContents(newel, el);
+    // the payloads are shared, copied when they are changed
+    MsvgI_ShareRawAttributes(newel, el);
+    MsvgI_ShareCookedAttributes(newel, el);
+    MsvgI_ShareContents(newel, el);
+
+    return newel;
+}
+
+MsvgElement *MsvgDupElement(MsvgElement *el, int copytree)
+{
+    MsvgElement *newel, *ptrnew, *ptrold, *nfather;
+
+    newel = dupNode(el);
+    if (newel == NULL) return NULL;
 
     if (copytree != 1) return newel;
 
+    // linked after the last copy, the new tree has no indexes to update,
+    // nfather is the copy of the father of ptrold
+    nfather = newel;
     ptrold = el->fson;
     while (ptrold) {
-        ptrnew = MsvgDupElement(ptrold, 1);
-        if (ptrnew) MsvgInsertSonElement(ptrnew, newel);
+        ptrnew = dupNode(ptrold);
+        if (ptrnew) {
+            ptrnew->father = nfather;
+            ptrnew->psibling = nfather->lson;
+            if (nfather->lson) nfather->lson->nsibling = ptrnew;
+            else nfather->fson = ptrnew;
+            nfather->lson = ptrnew;
+            if (ptrold->fson) {
+                nfather = ptrnew;
+                ptrold = ptrold->fson;
+                continue;
+            }
+        }
+        while (ptrold->father != el && ptrold->nsibling == NULL) {
+            ptrold = ptrold->father;
+            nfather = nfather->father;
+        }
         ptrold = ptrold->nsibling;
     }
 
@@ -230,8 +444,14 @@ MsvgElement *MsvgDupElement(MsvgElement *el, int copytree)
 
 int MsvgReplaceElement(MsvgElement *old, MsvgElement *newe)
 {
+    MsvgElement *root;
+    int rebuild;
+
     if (old == NULL || newe == NULL) return 0;
 
+    root = MsvgFindFirstFather(old);
+    rebuild = notifyRemoving(old);
+
     newe->father = old->father;
     newe->psibling = old->psibling;
     newe->nsibling = old->nsibling;
@@ -242,10 +462,98 @@ int MsvgReplaceElement(MsvgElement *old, MsvgElement *newe)
     }
     if (newe->nsibling) {
         newe->nsibling->psibling = newe;
+    } else {
+        newe->father->lson = newe;
     }
     old->father = NULL;
     old->psibling = NULL;
     old->nsibling = NULL;
 
+    if (rebuild) {
+        updateRootCaches(newe, 1);
+        MsvgBuildRTree(root);
+        MsvgI_JournalChange(root, newe, CHANGE_INSERTED, NULL, 1);
+    } else {
+        notifyInserted(newe);
+    }
+
+    return 1;
+}
+
+void MsvgElementChanged(MsvgElement *el)
+{
+    MsvgElement *root, *svgroot;
+    MsvgBox oldbox;
+    int indefs, oldbox_ok, boxes = 0;
+
+    // the cooked attributes of el or its sons have been changed, but
+    // its world bbox not yet
+    oldbox = el->wbbox;
+    oldbox_ok = el->wbbox_ok;
+
+    MsvgI_DropPackedPaths(el);
+
+    svgroot = MsvgFindFirstFather(el);
+    if (svgroot->eid != EID_SVG) svgroot = NULL;
+    if (svgroot) MsvgI_PaintCtxCacheChanged(svgroot, el);
+
+    root = indexedRoot(el, &indefs);
+    if (root != NULL) {
+        if (affectsUses(root, el, indefs)) {
+            MsvgBuildRTree(root);
+            boxes = 1;
+        } else if (!indefs) {
+            MsvgI_RTreeDelSubtree(root->psvgattr->rtree, el);
+            MsvgI_CalcSubtreeWorldBBoxes(root, el);
+            addToRTree(root, el);
+            boxes = 1;
+        }
+    }
+
+    MsvgI_JournalChange(svgroot, el, CHANGE_MODIFIED,
+                        oldbox_ok ? &oldbox : NULL, boxes);
+}
+
+int MsvgSetElementTMatrix(MsvgElement *el, const TMatrix *t)
+{
+    if (el->pctx == NULL) return 0;
+
+    el->pctx->tmatrix = *t;
+    MsvgElementChanged(el);
+
+    return 1;
+}
+
+void MsvgI_ReplaceElementId(MsvgElement *el, char *newid)
+{
+    MsvgElement *root;
+    MsvgTableId *tid = NULL;
+
+    root = MsvgFindFirstFather(el);
+    if (root->eid == EID_SVG && el->eid > EID_SVG)
+        tid = root->psvgattr->idindex;
+
+    if (el->id) {
+        if (tid) MsvgI_DelTableId(tid, el->id, el);
+        free(el->id);
+    }
+    el->id = newid;
+    if (tid && newid) MsvgI_AddTableId(tid, newid, el);
+}
+
+int MsvgSetElementId(MsvgElement *el, const char *id)
+{
+    char *newid = NULL;
+
+    if (id) {
+        newid = strdup(id);
+        if (newid == NULL) return 0;
+    }
+
+    MsvgI_ReplaceElementId(el, newid);
+
+    // EID_USE elements can reference it now, or not
+    MsvgElementChanged(el);
+
     return 1;
 }
@@ -30,8 +30,9 @@
 #define __MSVG_H_INCLUDED__
 
 #include <stdio.h>
+#include <stdint.h>
 
-#define LIBMSVG_VERSION_API 0x0090
+#define LIBMSVG_VERSION_API 0x0100
 
 /* define id's for supported elements */
 
@@ -112,6 +113,11 @@ typedef int rgbcolor;
 #define INHERIT_IVALUE      -1
 #define NODEFINED_IVALUE    -2
 
+/* define values for the fill-rule attribute */
+
+#define FILLRULE_NONZERO    1
+#define FILLRULE_EVENODD    2
+
 /* define values for text context attributes */
 
 #define TEXTANCHOR_START        1
@@ -158,6 +164,7 @@ typedef struct _MsvgRawAttribute {
     char *key;                  /* key attribute */
     char *value;                /* value attribute */
     MsvgRawAttributePtr nrattr; /* pointer to next raw attribute */
+    int nrefs;                  /* lists sharing it, see MsvgDupElement */
 } MsvgRawAttribute;
 
 /* contents */
@@ -168,10 +175,21 @@ typedef struct _MsvgConten {
     // By now only one content, not sure in the future, when elements between
     // contents are allowed, it can be nested contents or virtual elements
     //MsvgContentPtr ncontent; /* next content */
+    int nrefs;               /* elements sharing it, see MsvgDupElement */
     int len;                 /* len content */
     char s[1];               /* content (real size = len+1) */
 } MsvgContent;
 
+/* coordinates of the cooked geometry arrays (poly points and packed paths),
+   float if the library is built with MSVG_SINGLE_PRECISION defined (see
+   makedefs), programs using it must be built with the same definition */
+
+#ifdef MSVG_SINGLE_PRECISION
+typedef float MsvgCoord;
+#else
+typedef double MsvgCoord;
+#endif
+
 /* transformation matrix */
 
 typedef struct {
@@ -191,6 +209,7 @@ typedef struct _MsvgPaintCtx {
     char *fill_iri;        /* paint server if fill == IRI_COLOR */
     MsvgBPServerPtr fill_bps; /* binary paint server for fill */
     double fill_opacity;   /* fill-opacity attribute */
+    int fill_rule;         /* fill-rule attribute */
     rgbcolor stroke;       /* stroke color attribute */
     char *stroke_iri;      /* paint server if stroke == IRI_COLOR */
     MsvgBPServerPtr stroke_bps; /* binary paint server for stroke */
@@ -205,6 +224,39 @@ typedef struct _MsvgPaintCtx {
     double font_size;      /* font-size attribute */
 } MsvgPaintCtx;
 
+/* paint context fields set, different from NODEFINED_*, or a matrix other
+   than identity, see MsvgPaintCtxFieldsSet */
+
+#define PCTX_FILL           0x0001
+#define PCTX_FILL_OPACITY   0x0002
+#define PCTX_STROKE         0x0004
+#define PCTX_STROKE_WIDTH   0x0008
+#define PCTX_STROKE_OPACITY 0x0010
+#define PCTX_TMATRIX        0x0020
+#define PCTX_TEXT_ANCHOR    0x0040
+#define PCTX_FONT_FAMILY    0x0080
+#define PCTX_FONT_STYLE     0x0100
+#define PCTX_FONT_WEIGHT    0x0200
+#define PCTX_FONT_SIZE      0x0400
+#define PCTX_FILL_RULE      0x0800
+
+/* spatial index, opaque type */
+
+typedef struct _MsvgRTree MsvgRTree;
+
+/* compiled EID_USE content, opaque types */
+
+typedef struct _MsvgUseCache MsvgUseCache;
+typedef struct _MsvgUseInst MsvgUseInst;
+
+/* id table, defined with the find.c functions */
+
+typedef struct _MsvgTableId MsvgTableId;
+
+/* change journal, defined with the journal.c functions */
+
+typedef struct _MsvgChangeJournal MsvgChangeJournal;
+
 /* cooked specific attributes for each element */
 
 typedef struct _MsvgSvgAttributes {
@@ -217,6 +269,14 @@ typedef struct _MsvgSvgAttributes {
     double vb_height;
     rgbcolor vp_fill;       /* viewport-fill attribute */
     double vp_fill_opacity; /* viewport-fill-opacity attribute */
+    MsvgRTree *rtree;       /* spatial index, can be NULL */
+    MsvgUseCache *usecache; /* compiled EID_USE content, can be NULL */
+    MsvgTableId *idindex;   /* id index, can be NULL, change the ids only
+                               with MsvgSetElementId or call
+                               MsvgBuildIdIndex */
+    int pctxcache;          /* 1 = the computed paint contexts are cached */
+    MsvgChangeJournal *journal; /* change journal, can be NULL */
+    int frozen;             /* 1 = read only snapshot, see MsvgFreezeTree */
 } MsvgSvgAttributes;
 
 typedef struct _MsvgDefsAttributes {
@@ -265,13 +325,15 @@ typedef struct _MsvgLineAttributes {
 } MsvgLineAttributes;
 
 typedef struct _MsvgPolylineAttributes {
-    double *points; /* points attibute */
+    MsvgCoord *points; /* points attibute */
     int npoints;    /* number of points */
+    int *nrefs;     /* elements sharing points, NULL = not shared */
 } MsvgPolylineAttributes;
 
 typedef struct _MsvgPolygonAttributes {
-    double *points; /* points attibute */
+    MsvgCoord *points; /* points attibute */
     int npoints;    /* number of points */
+    int *nrefs;     /* elements sharing points, NULL = not shared */
 } MsvgPolygonAttributes;
 
 typedef struct {
@@ -291,8 +353,24 @@ typedef struct _MsvgSubPath {
     MsvgSubPathPtr next;     /* next SubPath (can be NULL) */
 } MsvgSubPath;
 
+/* packed path-data, all in one allocation */
+
+typedef struct _MsvgPackedPath {
+    int nsubpaths;           /* number of subpaths */
+    int npoints;             /* total number of points */
+    MsvgCoord *x;            /* absolute x of every point */
+    MsvgCoord *y;            /* absolute y of every point */
+    char *cmd;               /* one of 'M', 'L', 'C', 'Q', ' ' per point */
+    int *fpoint;             /* first point of every subpath, and npoints */
+    unsigned char *closed;   /* 1 = closed subpath, 0 = open */
+    int nrefs;               /* elements sharing it, see MsvgDedupGeometry */
+} MsvgPackedPath;
+
 typedef struct _MsvgPathAttributes {
-    MsvgSubPath *sp;    /* path-data normalized */
+    MsvgSubPath *sp;    /* path-data normalized, use MsvgGetSubPath to
+                           change it or MsvgReadSubPath to get a copy */
+    char *d;            /* path-data not scanned yet (or NULL) */
+    MsvgPackedPath *pp; /* path-data packed, use MsvgGetPackedPath */
 } MsvgPathAttributes;
 
 typedef struct _MsvgTextAttributes {
@@ -306,6 +384,7 @@ typedef struct _MsvgLinearGradientAttributes {
     double y1;          /* grad vector y1 coordinate */
     double x2;          /* grad vector x2 coordinate */
     double y2;          /* grad vector y2 coordinate */
+    MsvgBPServerPtr bps; /* compiled paint server, can be NULL */
 } MsvgLinearGradientAttributes;
 
 typedef struct _MsvgRadialGradientAttributes {
@@ -313,6 +392,7 @@ typedef struct _MsvgRadialGradientAttributes {
     double cx;          /* x center coordinate */
     double cy;          /* y center coordinate */
     double r;           /* radius */
+    MsvgBPServerPtr bps; /* compiled paint server, can be NULL */
 } MsvgRadialGradientAttributes;
 
 typedef struct _MsvgStopAttributes {
@@ -338,9 +418,18 @@ typedef struct _MsvgFontFaceAttributes {
 typedef struct _MsvgGlyphAttributes {
     long unicode;       /* unicode point */
     double horiz_adv_x; /* horizontal advance */
-    MsvgSubPath *sp;    /* path-data normalized */
+    MsvgSubPath *sp;    /* path-data normalized, use MsvgGetSubPath to
+                           change it or MsvgReadSubPath to get a copy */
+    char *d;            /* path-data not scanned yet (or NULL) */
+    MsvgPackedPath *pp; /* path-data packed, use MsvgGetPackedPath */
 } MsvgGlyphAttributes;
 
+/* generic box structure, used for bounding box calculations and others */
+
+typedef struct _MsvgBox {
+    double gminx, gmaxx, gminy, gmaxy;
+} MsvgBox;
+
 /* element structure */
 
 typedef struct _MsvgElement {
@@ -349,6 +438,7 @@ typedef struct _MsvgElement {
     MsvgElementPtr psibling;    /* pointer to previous sibling element */
     MsvgElementPtr nsibling;    /* pointer to next sibling element */
     MsvgElementPtr fson;        /* pointer to first son element */
+    MsvgElementPtr lson;        /* pointer to last son element */
 
     MsvgRawAttributePtr frattr; /* pointer to first raw attribute */
     MsvgContentPtr fcontent;    /* pointer to content */
@@ -357,6 +447,12 @@ typedef struct _MsvgElement {
     char *id;                   /* id attribute */
     MsvgPaintCtxPtr pctx;       /* pointer to painting context */
 
+    /* cached values */
+    int wbbox_ok;               /* 1 = wbbox is calculated */
+    MsvgBox wbbox;              /* world bounding box */
+    int cpctx_ok;               /* 1 = cpctx is calculated */
+    MsvgPaintCtxPtr cpctx;      /* computed paint context, can be NULL */
+
     /* cooked specific attributes */
     union {
         MsvgSvgAttributes *psvgattr;
@@ -380,12 +476,6 @@ typedef struct _MsvgElement {
     };
 } MsvgElement;
 
-/* generic box structure, used for bounding box calculations and others */
-
-typedef struct _MsvgBox {
-    double gminx, gmaxx, gminy, gmaxy;
-} MsvgBox;
-
 /* functions in elements.c */
 
 MsvgElement *MsvgNewElement(enum EID eid, MsvgElement *father);
@@ -410,6 +500,7 @@ MsvgPaintCtx *MsvgNewPaintCtx(const MsvgPaintCtx *src);
 void MsvgCopyPaintCtx(MsvgPaintCtx *des, const MsvgPaintCtx *src);
 void MsvgDestroyPaintCtx(MsvgPaintCtx *pctx);
 void MsvgUndefPaintCtxTextAttr(MsvgPaintCtx *pctx);
+int MsvgPaintCtxFieldsSet(const MsvgPaintCtx *pctx);
 int MsvgGetInheritedTextAnchor(const MsvgElement *el);
 double MsvgGetInheritedFontSize(const MsvgElement *el);
 void MsvgGetInheritedFontFamily(const MsvgElement *el, int *ifont_family,
@@ -437,6 +528,10 @@ MsvgElement *MsvgDupElement(MsvgElement *el, int copytree);
 
 int MsvgReplaceElement(MsvgElement *old, MsvgElement *newe);
 
+void MsvgElementChanged(MsvgElement *el);
+int MsvgSetElementTMatrix(MsvgElement *el, const TMatrix *t);
+int MsvgSetElementId(MsvgElement *el, const char *id);
+
 /* functions in rdsvgf.c */
 
 MsvgElement *MsvgReadSvgFile(const char *fname, int *error);
@@ -457,15 +552,28 @@ void MsvgPrintCookedElement(FILE *f, MsvgElement *el);
 
 int MsvgRaw2CookedTree(MsvgElement *root);
 
+/* functions in patch.c */
+
+int MsvgApplyPatch(MsvgElement *root, const char *buf, int len, int *error);
+
 /* functions in scanpath.c */
 
 MsvgSubPath *MsvgScanPath(char *d);
 MsvgSubPath *MsvgNewSubPath(int maxpoints);
 void MsvgExpandSubPath(MsvgSubPath *sp);
 void MsvgAddPointToSubPath(MsvgSubPath *sp, char cmd, double x, double y);
-MsvgSubPath *MsvgDupSubPath(MsvgSubPath *sp);
-int MsvgCountSubPaths(MsvgSubPath *sp);
+MsvgSubPath *MsvgDupSubPath(const MsvgSubPath *sp);
+int MsvgCountSubPaths(const MsvgSubPath *sp);
 void MsvgDestroySubPath(MsvgSubPath *sp);
+MsvgSubPath *MsvgReadSubPath(const MsvgElement *el);
+MsvgSubPath *MsvgGetSubPath(MsvgElement *el);
+int MsvgForcePathScan(MsvgElement *el);
+MsvgPackedPath *MsvgScanPackedPath(char *d);
+MsvgPackedPath *MsvgPackSubPath(const MsvgSubPath *sp);
+MsvgSubPath *MsvgUnpackPath(const MsvgPackedPath *pp);
+MsvgPackedPath *MsvgDupPackedPath(const MsvgPackedPath *pp);
+void MsvgDestroyPackedPath(MsvgPackedPath *pp);
+MsvgPackedPath *MsvgGetPackedPath(MsvgElement *el);
 
 /* functions in cook2raw.c */
 
@@ -483,6 +591,8 @@ void TMSetScaling(TMatrix *des, double sx, double sy);
 void TMSetRotationOrigin(TMatrix *des, double ang);
 void TMSetRotation(TMatrix *des, double ang, double cx, double cy);
 void TMTransformCoord(double *x, double *y, const TMatrix *ctm);
+void TMTransformCoordArray(MsvgCoord *x, MsvgCoord *y, int n, int stride,
+                           const TMatrix *ctm);
 
 /* MsvgTreeCounts structure */
 
@@ -492,17 +602,18 @@ typedef struct {
     int totelwid;           // num elements with id != NULL
 } MsvgTreeCounts;
 
-/* MsvgTableId structure */
+/* MsvgTableId structure, a hash table with open addressing */
 
 typedef struct {
-    char *id;
+    char *id;                 // NULL if the slot is empty
     MsvgElement *el;
 } MsvgTableIdItem;
 
-typedef struct {
+struct _MsvgTableId {
     int nelem;                // num elements in table
-    MsvgTableIdItem item[1];  // real size = nelem
-} MsvgTableId;
+    int nslots;               // num slots, a power of 2
+    MsvgTableIdItem *item;    // slots
+};
 
 /* functions in find.c */
 
@@ -519,22 +630,25 @@ MsvgTableId *MsvgBuildTableIdRawTree(MsvgElement *el);
 void MsvgDestroyTableId(MsvgTableId *tid);
 MsvgElement *MsvgFindIdTableId(const MsvgTableId *tid, char *id);
 
+/* the id index is built by MsvgRaw2CookedTree and updated by the manielem.c
+   functions and MsvgCopyCookedAttributes. It keeps its own copies of the ids,
+   an el->id changed directly leaves it stale (the old id is still found and
+   the new one is not) until it is built again */
+int MsvgBuildIdIndex(MsvgElement *root);
+void MsvgDestroyIdIndex(MsvgElement *root);
+
 /* binary paint servers types */
 
 #define BPSERVER_LINEARGRADIENT 1
 #define BPSERVER_RADIALGRADIENT 2
 
-/* max stops a binary gradient can have */
-
-#define BGRADIENT_MAXSTOPS 10
-
 /* binary paint server struct */
 
 typedef struct _MsvgBGradientStops {
-    int nstops;                             /* num stops */
-    double offset[BGRADIENT_MAXSTOPS];      /* offset [0..1] */
-    double sopacity[BGRADIENT_MAXSTOPS];    /* stop opacity attribute */
-    rgbcolor scolor[BGRADIENT_MAXSTOPS];    /* stop color attribute */
+    int nstops;             /* num stops */
+    double *offset;         /* offset [0..1] */
+    double *sopacity;       /* stop opacity attribute */
+    rgbcolor *scolor;       /* stop color attribute */
 } MsvgBGradientStops;
 
 typedef struct _MsvgBLinearGradient {
@@ -560,21 +674,90 @@ typedef struct _MsvgBPServer {
         MsvgBLinearGradient blg;
         MsvgBRadialGradient brg;
     };
+    int refcount;       /* references to the server */
+    int pinned;         /* 1 = cached in a frozen tree, not counted */
+    struct _MsvgBPServer *stops_owner; /* server holding the stops arrays,
+                                          can be this one */
 } MsvgBPServer;
 
 /* functions in bpserver.c */
 
+MsvgBPServer *MsvgGetBPServer(MsvgElement *el);
 MsvgBPServer *MsvgNewBPServer(MsvgElement *el);
+MsvgBPServer *MsvgRefBPServer(MsvgBPServer *bps);
+MsvgBPServer *MsvgSpecializeBPServer(const MsvgBPServer *bps, MsvgBox *bbox,
+                                     TMatrix *t);
 void MsvgDestroyBPServer(MsvgBPServer *bps);
 int MsvgCalcUnitsBPServer(MsvgBPServer *bps, MsvgBox *bbox, TMatrix *t);
+int MsvgEqualBPServer(const MsvgBPServer *bps1, const MsvgBPServer *bps2);
 
 /* functions in serializ.c */
 
 typedef void (*MsvgSerUserFn)(MsvgElement *el, MsvgPaintCtx *pctx, void *udata);
 
-#define MAX_NESTED_USE_ELEMENT 5
-
 int MsvgSerCookedTree(MsvgElement *root, MsvgSerUserFn sufn, void *udata, int genbps);
+int MsvgSerCookedTreeClip(MsvgElement *root, MsvgSerUserFn sufn, void *udata,
+                          int genbps, const MsvgBox *clip);
+int MsvgSerCookedTreeView(MsvgElement *root, MsvgSerUserFn sufn, void *udata,
+                          int genbps, const MsvgBox *clip, const TMatrix *view);
+
+/* serialization iterator, the fields are private */
+
+#define MSVG_SERITER_CHUNK 32
+
+typedef struct _MsvgSerFrame {
+    MsvgElement *next;          /* next element to process */
+    MsvgPaintCtx pctx;          /* inherited paint context */
+} MsvgSerFrame;
+
+typedef struct _MsvgSerFrameChunk {
+    MsvgSerFrame frame[MSVG_SERITER_CHUNK];
+    struct _MsvgSerFrameChunk *next;
+    struct _MsvgSerFrameChunk *prev;
+} MsvgSerFrameChunk;
+
+typedef struct _MsvgSerIter {
+    MsvgTableId *tid;           /* id table, the root id index if any */
+    int own_tid;                /* 1 = tid is private to the iterator */
+    int genbps;
+    const MsvgBox *clip;        /* device clip box, can be NULL */
+    TMatrix devt;               /* world to device matrix */
+    MsvgUseCache *uc;           /* compiled EID_USE content */
+    int own_uc;                 /* 1 = uc is private to the iterator */
+    MsvgUseInst *inst;          /* EID_USE instance being returned */
+    int inst_pos;               /* next item of the instance */
+    MsvgPaintCtx inst_pctx;     /* EID_USE element paint context */
+    int depth;                  /* frames in use */
+    MsvgSerFrameChunk first;    /* first chunk of frames */
+    MsvgSerFrameChunk *cur;     /* chunk of the top frame */
+    MsvgPaintCtx pctx;          /* paint context returned */
+} MsvgSerIter;
+
+int MsvgSerIterBegin(MsvgSerIter *it, MsvgElement *root, int genbps,
+                     const MsvgBox *clip);
+int MsvgSerIterBeginView(MsvgSerIter *it, MsvgElement *root, int genbps,
+                         const MsvgBox *clip, const TMatrix *view);
+MsvgElement *MsvgSerIterNext(MsvgSerIter *it, MsvgPaintCtx **pctx);
+void MsvgSerIterEnd(MsvgSerIter *it);
+
+/* batched serialization, all the items in a batch share the paint state
+ * (colors, opacities, stroke width, paint servers and font), the binary
+ * paint servers are shared too and must be treated as read only */
+
+typedef struct _MsvgSerItem {
+    MsvgElement *el;            /* element to draw */
+    MsvgPaintCtx pctx;          /* its paint context */
+} MsvgSerItem;
+
+typedef void (*MsvgSerBatchUserFn)(MsvgSerItem *item, int nitems, void *udata);
+
+int MsvgSerCookedTreeBatch(MsvgElement *root, MsvgSerBatchUserFn sbufn,
+                           void *udata, int genbps, int maxitems,
+                           const MsvgBox *clip);
+int MsvgSerCookedTreeBatchView(MsvgElement *root, MsvgSerBatchUserFn sbufn,
+                               void *udata, int genbps, int maxitems,
+                               const MsvgBox *clip, const TMatrix *view);
+int MsvgSamePaintState(const MsvgPaintCtx *pctx1, const MsvgPaintCtx *pctx2);
 
 /* functions in tcookel.c */
 
@@ -594,6 +777,224 @@ MsvgElement *MsvgPathToPolyGroup(MsvgElement *el, double px_x_unit);
 int MsvgGetCookedBoundingBox(MsvgElement *el, MsvgBox *box, int inibox);
 int MsvgGetCookedDims(MsvgElement *root, double *minx, double *maxx,
                       double *miny, double *maxy);
+int MsvgCalcCookedWorldBBoxes(MsvgElement *root);
+
+/* functions in optimize.c */
+
+int MsvgOptimizeCookedTree(MsvgElement *root);
+
+/* functions in dedup.c */
+
+int MsvgDedupGeometry(MsvgElement *el);
+int MsvgUnshareGeometry(MsvgElement *el);
+
+/* functions in freeze.c */
+
+int MsvgFreezeTree(MsvgElement *root);
+void MsvgThawTree(MsvgElement *root);
+
+/* functions in rtree.c */
+
+typedef void (*MsvgRTreeUserFn)(MsvgElement *el, void *udata);
+
+int MsvgBuildRTree(MsvgElement *root);
+void MsvgDestroyRTree(MsvgElement *root);
+int MsvgRTreeSearch(MsvgElement *root, const MsvgBox *box,
+                    MsvgRTreeUserFn rtufn, void *udata);
+MsvgElement *MsvgRTreeNearest(MsvgElement *root, double x, double y, double *dist);
+int MsvgRTreeCount(MsvgElement *root);
+
+/* functions in usecache.c */
+
+int MsvgBuildUseCache(MsvgElement *root);
+void MsvgDestroyUseCache(MsvgElement *root);
+
+/* functions in ctxcache.c */
+
+int MsvgBuildPaintCtxCache(MsvgElement *root);
+void MsvgDestroyPaintCtxCache(MsvgElement *root);
+const MsvgPaintCtx *MsvgGetCachedPaintCtx(MsvgElement *el);
+
+/* change journal struct, the boxes are world bounding boxes */
+
+#define CHANGE_INSERTED     1
+#define CHANGE_REMOVED      2
+#define CHANGE_MODIFIED     3
+
+typedef struct _MsvgChange {
+    MsvgElement *el;        /* changed element, can be already deleted */
+    int type;               /* CHANGE_INSERTED, CHANGE_REMOVED or CHANGE_MODIFIED */
+    int wholetree;          /* 1 = it can change other elements, boxes not set */
+    MsvgBox oldbox;         /* box before the change, empty if inserted */
+    MsvgBox newbox;         /* box after the change, empty if removed */
+} MsvgChange;
+
+struct _MsvgChangeJournal {
+    int nchanges;           /* changes since the last MsvgGetDirtyBox */
+    int maxchanges;         /* allocated changes */
+    MsvgChange *change;     /* changes in order */
+    MsvgBox dirty;          /* union of the changes boxes */
+    int wholetree;          /* 1 = all the tree is dirty */
+    MsvgBox world;          /* box of all the tree at the last MsvgGetDirtyBox */
+    int nuses;              /* number of EID_USE elements in the tree */
+};
+
+/* functions in journal.c */
+
+int MsvgBuildChangeJournal(MsvgElement *root);
+void MsvgDestroyChangeJournal(MsvgElement *root);
+int MsvgGetDirtyBox(MsvgElement *root, MsvgBox *box);
+
+/* functions in hittest.c, the MsvgHitTest point and tolerance are in world
+   coordinates (the root user space, without the root matrix), not in device
+   pixels, apply the inverse of the root matrix to a device point */
+
+int MsvgInsidePolygonTest(int npoints, const MsvgCoord *points, double x, double y,
+                          int fillrule);
+MsvgElement *MsvgHitTest(MsvgElement *root, double x, double y, double tolerance);
+
+/* render modes, like the GD backend ones */
+
+#define MSVGRENDER_FIT      0   /* fit to the buffer */
+#define MSVGRENDER_PAR      1   /* fit preserving aspect/ratio */
+#define MSVGRENDER_SCOORD   2   /* same coordinates as the svg file */
+
+#define MSVGRENDER_LEFT     0   /* fit to left */
+#define MSVGRENDER_CENTER   1   /* fit to center */
+#define MSVGRENDER_RIGHT    2   /* fit to right */
+
+typedef struct {
+    int mode;               /* one of MSVGRENDER_FIT, PAR or SCOORD */
+    int adj;                /* one of MSVGRENDER_LEFT, CENTER or RIGHT */
+    double zoom;            /* zoom to apply before drawing */
+    double xdespl;          /* x displacement to apply before drawing */
+    double ydespl;          /* y displacement to apply before drawing */
+    double rotang;          /* angle in degrees to rotate before drawing */
+    rgbcolor bg;            /* background if not defined by root, or NO_COLOR */
+} MsvgRenderMode;
+
+/* functions in render.c */
+
+int MsvgRenderToBuffer(MsvgElement *root, const MsvgRenderMode *rm,
+                       uint32_t *pixels, int w, int h, int stride);
+int MsvgRenderToBufferTiled(MsvgElement *root, const MsvgRenderMode *rm,
+                            uint32_t *pixels, int w, int h, int stride,
+                            int nthreads);
+
+/* display list structs */
+
+typedef struct _MsvgDLRecord {
+    enum EID eid;           /* EID_RECT, EID_ELLIPSE, EID_LINE, EID_POLYLINE,
+                               EID_POLYGON, EID_PATH or EID_TEXT */
+    MsvgElement *el;        /* source element */
+    int ipctx;              /* index in the paint contexts table */
+    int fpoint;             /* first point in the points buffer */
+    int npoints;            /* number of points */
+    int fsubpath;           /* first subpath in the subpaths table */
+    int nsubpaths;          /* number of subpaths */
+    MsvgBox bbox;           /* world bounding box */
+    int treplay;            /* replay that transformed the points */
+} MsvgDLRecord;
+
+typedef struct _MsvgDLSubPath {
+    int fpoint;             /* first point in the points buffer */
+    int npoints;            /* number of points */
+    int closed;             /* 1 = yes, 0 = no */
+} MsvgDLSubPath;
+
+typedef struct _MsvgDisplayList {
+    int nrecords, maxrecords;
+    MsvgDLRecord *record;       /* draw records in paint order */
+    int nsubpaths, maxsubpaths;
+    MsvgDLSubPath *subpath;     /* subpaths table */
+    int npoints, maxpoints;
+    MsvgSubPathPoint *point;    /* world coordinates points buffer */
+    MsvgSubPathPoint *tpoint;   /* points transformed when asked in a replay */
+    int npctxs, maxpctxs;
+    MsvgPaintCtx *pctx;         /* resolved paint contexts table */
+    MsvgPaintCtx *tpctx;        /* paint contexts adjusted by the last replay */
+    MsvgBPServer *tbps;         /* their paint servers, fill and stroke */
+    int nreplays;               /* replays done */
+    int identity;               /* 1 = the last replay view is the identity */
+    TMatrix view;               /* view matrix of the last replay */
+} MsvgDisplayList;
+
+/* functions in displist.c */
+
+typedef void (*MsvgDLUserFn)(MsvgDisplayList *dl, MsvgDLRecord *rec,
+                             MsvgPaintCtx *pctx, void *udata);
+
+MsvgDisplayList *MsvgBuildDisplayList(MsvgElement *root);
+void MsvgDestroyDisplayList(MsvgDisplayList *dl);
+int MsvgReplayDisplayList(MsvgDisplayList *dl, const TMatrix *view,
+                          MsvgDLUserFn dlufn, void *udata);
+MsvgSubPathPoint *MsvgDLRecordPoints(MsvgDisplayList *dl, MsvgDLRecord *rec);
+
+/* compact tree structs, the elements of a cooked tree in preorder in only one
+ * array, linked by indexes (-1 = none) and with the specific attributes
+ * inline, the pointers in the attributes and paint contexts point to the
+ * pools of the tree */
+
+typedef struct _MsvgCNode {
+    enum EID eid;           /* element type id */
+    int father;             /* father node, -1 for the root */
+    int nsibling;           /* next sibling node */
+    int end;                /* node after the last descendant, the first son
+                               is the next node if end > this node + 1 */
+    int id;                 /* id offset in the strings pool */
+    int content;            /* MsvgContent offset in the data pool */
+    int pctx;               /* index in the paint styles table, -1 if no
+                               style field is set */
+    int tmatrix;            /* index in the matrices table, -1 if identity */
+    int pmask;              /* paint context fields set, PCTX_* flags */
+    int ref;                /* EID_USE: referenced node */
+    union {                 /* cooked specific attributes, EID_SVG ones are
+                               in the MsvgCTree struct */
+        MsvgDefsAttributes defs;
+        MsvgGAttributes g;
+        MsvgUseAttributes use;
+        MsvgRectAttributes rect;
+        MsvgCircleAttributes circle;
+        MsvgEllipseAttributes ellipse;
+        MsvgLineAttributes line;
+        MsvgPolylineAttributes polyline;
+        MsvgPolygonAttributes polygon;
+        MsvgPathAttributes path;
+        MsvgTextAttributes text;
+        MsvgLinearGradientAttributes lgrad;
+        MsvgRadialGradientAttributes rgrad;
+        MsvgStopAttributes stop;
+        MsvgFontAttributes font;
+        MsvgFontFaceAttributes fontface;
+        MsvgGlyphAttributes glyph;
+    } attr;
+} MsvgCNode;
+
+typedef struct _MsvgCTree {
+    int nnodes;             /* number of nodes */
+    MsvgCNode *node;        /* nodes in preorder, node[0] is the root */
+    MsvgSvgAttributes svgattr; /* root attributes, without indexes */
+    int maxdepth;           /* maximum node depth, the root one is 0 */
+    int npctxs;             /* number of paint styles */
+    MsvgPaintCtx *pctx;     /* paint styles table, paint contexts without
+                               matrix, interned, the paint servers are
+                               resolved and owned by the tree */
+    int nmatrices;          /* number of matrices */
+    TMatrix *tmatrix;       /* matrices table, interned */
+    int strsize;            /* size of the strings pool, interned */
+    char *strings;          /* ids and strings of attributes and contexts */
+    int datasize;           /* size of the data pool */
+    char *data;             /* points arrays, packed paths and contents */
+} MsvgCTree;
+
+/* functions in compact.c */
+
+MsvgCTree *MsvgCompactTree(MsvgElement *root);
+MsvgElement *MsvgExpandTree(const MsvgCTree *ct);
+void MsvgDestroyCTree(MsvgCTree *ct);
+void MsvgCalcCountsCTree(const MsvgCTree *ct, MsvgTreeCounts *tc);
+int MsvgFindIdCTree(const MsvgCTree *ct, const char *id);
+int MsvgSerCTree(const MsvgCTree *ct, MsvgSerUserFn sufn, void *udata, int genbps);
 
 /* functions in gradnorm.c */
 
@@ -0,0 +1,364 @@
+/* optimize.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msvg.h"
+#include "util.h"
+
+typedef struct {
+    int nrefs;      // num of ids referenced by use elements
+    char **refs;    // sorted array of referenced ids (not owned)
+    int changes;    // num of changes done
+} OptData;
+
+static void countRefs(MsvgElement *el, void *udata)
+{
+    OptData *od = (OptData *)udata;
+
+    if (el->eid == EID_USE && el->puseattr->refel) od->nrefs++;
+}
+
+static void addRefs(MsvgElement *el, void *udata)
+{
+    OptData *od = (OptData *)udata;
+
+    if (el->eid == EID_USE && el->puseattr->refel)
+        od->refs[od->nrefs++] = el->puseattr->refel;
+}
+
+static int cmpRefs(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+static int isPinned(MsvgElement *el, OptData *od)
+{
+    // elements referenced by a use element are not touched, they are
+    // rendered in other contexts too
+
+    if (el->id == NULL || od->nrefs == 0) return 0;
+
+    if (bsearch(&(el->id), od->refs, od->nrefs, sizeof(char *), cmpRefs))
+        return 1;
+
+    return 0;
+}
+
+static int haveSonPinned(MsvgElement *el, OptData *od)
+{
+    MsvgElement *pel;
+
+    pel = el->fson;
+    while (pel) {
+        if (isPinned(pel, od)) return 1;
+        pel = pel->nsibling;
+    }
+
+    return 0;
+}
+
+static int isPaintCtxEmpty(MsvgPaintCtx *pctx)
+{
+    if (pctx->fill != NODEFINED_COLOR && pctx->fill != INHERIT_COLOR) return 0;
+    if (pctx->fill_opacity != NODEFINED_VALUE &&
+        pctx->fill_opacity != INHERIT_VALUE) return 0;
+    if (pctx->fill_rule != NODEFINED_IVALUE &&
+        pctx->fill_rule != INHERIT_IVALUE) return 0;
+    if (pctx->stroke != NODEFINED_COLOR && pctx->stroke != INHERIT_COLOR) return 0;
+    if (pctx->stroke_width != NODEFINED_VALUE &&
+        pctx->stroke_width != INHERIT_VALUE) return 0;
+    if (pctx->stroke_opacity != NODEFINED_VALUE &&
+        pctx->stroke_opacity != INHERIT_VALUE) return 0;
+    if (!TMIsIdentity(&(pctx->tmatrix))) return 0;
+    if (pctx->text_anchor != NODEFINED_IVALUE &&
+        pctx->text_anchor != INHERIT_IVALUE) return 0;
+    if (pctx->ifont_family != NODEFINED_IVALUE &&
+        pctx->ifont_family != INHERIT_IVALUE) return 0;
+    if (pctx->font_style != NODEFINED_IVALUE &&
+        pctx->font_style != INHERIT_IVALUE) return 0;
+    if (pctx->font_weight != NODEFINED_IVALUE &&
+        pctx->font_weight != INHERIT_IVALUE) return 0;
+    if (pctx->font_size != NODEFINED_VALUE &&
+        pctx->font_size != INHERIT_VALUE) return 0;
+
+    return 1;
+}
+
+static int isInvisible(MsvgElement *el, MsvgPaintCtx *cpctx)
+{
+    int nofill, nostroke;
+
+    nofill = (cpctx->fill == NO_COLOR) || (cpctx->fill_opacity <= 0) ||
+             (el->eid == EID_LINE);
+    nostroke = (cpctx->stroke == NO_COLOR) || (cpctx->stroke_opacity <= 0) ||
+               (cpctx->stroke_width <= 0);
+
+    return nofill && nostroke;
+}
+
+static void pushMatrixToSons(MsvgElement *el)
+{
+    MsvgElement *pel;
+    TMatrix taux;
+
+    pel = el->fson;
+    while (pel) {
+        if (pel->pctx) {
+            TMMpy(&taux, &(el->pctx->tmatrix), &(pel->pctx->tmatrix));
+            pel->pctx->tmatrix = taux;
+        }
+        pel = pel->nsibling;
+    }
+
+    TMSetIdentity(&(el->pctx->tmatrix));
+}
+
+static int pushPaintCtxToSons(MsvgElement *el)
+{
+    MsvgPaintCtx *emptypctx;
+    MsvgElement *pel;
+
+    // all the paint context attributes are inherited, so they can be
+    // moved to the sons, even the transformation matrix
+    emptypctx = MsvgNewPaintCtx(NULL);
+    if (emptypctx == NULL) return 0;
+
+    pel = el->fson;
+    while (pel) {
+        if (pel->pctx) MsvgProcPaintCtxInheritance(pel->pctx, el->pctx);
+        pel = pel->nsibling;
+    }
+
+    MsvgDestroyPaintCtx(el->pctx);
+    el->pctx = emptypctx;
+
+    return 1;
+}
+
+static int bakeMatrix(MsvgElement *el, MsvgPaintCtx *cpctx)
+{
+    TMatrix *t;
+    MsvgSubPath *sp;
+    MsvgPackedPath *pp;
+    double zerox = 0, zeroy = 0;
+    double w, h;
+    int stroked, i;
+
+    t = &(el->pctx->tmatrix);
+    if (TMIsIdentity(t)) return 0;
+    if (t->a * t->d - t->b * t->c == 0) return 0;
+
+    // paint servers can depend on the user space, let them as they are
+    if (cpctx->fill == IRI_COLOR || cpctx->stroke == IRI_COLOR) return 0;
+
+    // the stroke width is scaled by sqrt(a*a+b*b) of the final matrix,
+    // we can keep it only if the baked matrix don't mix the x axis
+    stroked = (cpctx->stroke != NO_COLOR) && (cpctx->stroke_opacity > 0) &&
+              (cpctx->stroke_width > 0);
+    if (stroked && t->b != 0) return 0;
+
+    // the points are changed in place, shared geometry is copied before
+    if (!MsvgUnshareGeometry(el)) return 0;
+
+    switch (el->eid) {
+        case EID_RECT :
+            if (TMHaveRotation(t)) return 0;
+            TMTransformCoord(&(el->prectattr->x), &(el->prectattr->y), t);
+            TMTransformCoord(&zerox, &zeroy, t);
+            w = el->prectattr->width;
+            h = el->prectattr->height;
+            TMTransformCoord(&w, &h, t);
+            w -= zerox;
+            h -= zeroy;
+            if (w < 0) {
+                el->prectattr->x += w;
+                w = -w;
+            }
+            if (h < 0) {
+                el->prectattr->y += h;
+                h = -h;
+            }
+            el->prectattr->width = w;
+            el->prectattr->height = h;
+            el->prectattr->rx *= fabs(t->a);
+            el->prectattr->ry *= fabs(t->d);
+            break;
+        case EID_CIRCLE :
+            if (TMHaveRotation(t) || fabs(t->a) != fabs(t->d)) return 0;
+            TMTransformCoord(&(el->pcircleattr->cx), &(el->pcircleattr->cy), t);
+            el->pcircleattr->r *= fabs(t->a);
+            break;
+        case EID_ELLIPSE :
+            // only axis-aligned, so the ellipse can be written back
+            if (TMHaveRotation(t)) return 0;
+            TMTransformCoord(&(el->pellipseattr->cx), &(el->pellipseattr->cy), t);
+            TMTransformCoord(&(el->pellipseattr->rx_x), &(el->pellipseattr->rx_y), t);
+            TMTransformCoord(&(el->pellipseattr->ry_x), &(el->pellipseattr->ry_y), t);
+            break;
+        case EID_LINE :
+            TMTransformCoord(&(el->plineattr->x1), &(el->plineattr->y1), t);
+            TMTransformCoord(&(el->plineattr->x2), &(el->plineattr->y2), t);
+            break;
+        case EID_POLYLINE :
+            TMTransformCoordArray(el->ppolylineattr->points,
+                                  el->ppolylineattr->points + 1,
+                                  el->ppolylineattr->npoints, 2, t);
+            break;
+        case EID_POLYGON :
+            TMTransformCoordArray(el->ppolygonattr->points,
+                                  el->ppolygonattr->points + 1,
+                                  el->ppolygonattr->npoints, 2, t);
+            break;
+        case EID_PATH :
+            // subpaths set by program are changed, and the packed copy dropped
+            if (el->ppathattr->sp && el->ppathattr->d == NULL) {
+                for (sp=el->ppathattr->sp; sp!=NULL; sp=sp->next) {
+                    for (i=0; i<sp->npoints; i++) {
+                        TMTransformCoord(&(sp->spp[i].x), &(sp->spp[i].y), t);
+                    }
+                }
+                MsvgI_DropPackedPaths(el);
+            } else if ((pp = MsvgGetPackedPath(el)) != NULL) {
+                TMTransformCoordArray(pp->x, pp->y, pp->npoints, 1, t);
+            }
+            break;
+        default :
+            return 0;
+    }
+
+    if (stroked && fabs(t->a) != 1)
+        el->pctx->stroke_width = cpctx->stroke_width * fabs(t->a);
+    TMSetIdentity(t);
+
+    return 1;
+}
+
+static void optContainer(MsvgElement *el, MsvgPaintCtx *fath, OptData *od)
+{
+    MsvgPaintCtx *mypctx = NULL, *sonpctx = NULL;
+    MsvgElement *pel, *nextel, *son;
+
+    mypctx = MsvgNewPaintCtx(el->pctx);
+    if (mypctx == NULL) return;
+
+    if (fath) MsvgProcPaintCtxInheritance(mypctx, fath);
+
+    pel = el->fson;
+    while (pel) {
+        nextel = pel->nsibling;
+        switch (pel->eid) {
+            case EID_G :
+                if (isPinned(pel, od)) break;
+                if (!isPaintCtxEmpty(pel->pctx) && !haveSonPinned(pel, od)) {
+                    // in place changes, the caches and indexes are notified
+                    if (pel->id == NULL) {
+                        if (pushPaintCtxToSons(pel)) {
+                            MsvgElementChanged(pel);
+                            od->changes++;
+                        }
+                    } else if (!TMIsIdentity(&(pel->pctx->tmatrix))) {
+                        pushMatrixToSons(pel);
+                        MsvgElementChanged(pel);
+                        od->changes++;
+                    }
+                }
+                optContainer(pel, mypctx, od);
+                if (pel->fson == NULL) {
+                    MsvgDeleteElement(pel);
+                    od->changes++;
+                } else if (pel->id == NULL && isPaintCtxEmpty(pel->pctx)) {
+                    // sons are yet optimized, move them in place of the group
+                    while (pel->fson) {
+                        son = pel->fson;
+                        MsvgPruneElement(son);
+                        MsvgInsertPSiblingElement(son, pel);
+                    }
+                    MsvgDeleteElement(pel);
+                    od->changes++;
+                }
+                break;
+            case EID_RECT :
+            case EID_CIRCLE :
+            case EID_ELLIPSE :
+            case EID_LINE :
+            case EID_POLYLINE :
+            case EID_POLYGON :
+            case EID_PATH :
+            case EID_TEXT :
+                if (isPinned(pel, od)) break;
+                sonpctx = MsvgNewPaintCtx(pel->pctx);
+                if (sonpctx == NULL) break;
+                MsvgProcPaintCtxInheritance(sonpctx, mypctx);
+                MsvgProcPaintCtxDefaults(sonpctx);
+                if (isInvisible(pel, sonpctx)) {
+                    MsvgDeleteElement(pel);
+                    od->changes++;
+                } else if (bakeMatrix(pel, sonpctx)) {
+                    MsvgElementChanged(pel);
+                    od->changes++;
+                }
+                MsvgDestroyPaintCtx(sonpctx);
+                break;
+            default :
+                break;
+        }
+        pel = nextel;
+    }
+
+    MsvgDestroyPaintCtx(mypctx);
+}
+
+int MsvgOptimizeCookedTree(MsvgElement *root)
+{
+    OptData od;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    od.nrefs = 0;
+    od.refs = NULL;
+    od.changes = 0;
+
+    MsvgWalkTree(root, countRefs, &od);
+    if (od.nrefs > 0) {
+        od.refs = (char **)calloc(od.nrefs, sizeof(char *));
+        if (od.refs == NULL) return 0;
+        od.nrefs = 0;
+        MsvgWalkTree(root, addRefs, &od);
+        qsort(od.refs, od.nrefs, sizeof(char *), cmpRefs);
+    }
+
+    optContainer(root, NULL, &od);
+
+    if (od.refs) free(od.refs);
+
+    return od.changes;
+}
@@ -41,6 +41,7 @@ MsvgPaintCtx *MsvgNewPaintCtx(const MsvgPaintCtx *src)
     pctx->fill_iri = NULL;
     pctx->fill_bps = NULL;
     pctx->fill_opacity = NODEFINED_VALUE;
+    pctx->fill_rule = NODEFINED_IVALUE;
     pctx->stroke = NODEFINED_COLOR;
     pctx->stroke_iri = NULL;
     pctx->stroke_bps = NULL;
@@ -70,15 +71,11 @@ void MsvgCopyPaintCtx(MsvgPaintCtx *des, const MsvgPaintCtx *src)
 
     *des = *src;
     if (src->fill_iri) des->fill_iri = strdup(src->fill_iri);
-    if (src->fill_bps) {
-        des->fill_bps = calloc(1, sizeof(MsvgBPServer));
-        if (des->fill_bps) *(des->fill_bps) = *(src->fill_bps);
-    }
+    if (src->fill_bps)
+        des->fill_bps = MsvgSpecializeBPServer(src->fill_bps, NULL, NULL);
     if (src->stroke_iri) des->stroke_iri = strdup(src->stroke_iri);
-    if (src->stroke_bps) {
-        des->stroke_bps = calloc(1, sizeof(MsvgBPServer));
-        if (des->stroke_bps) *(des->stroke_bps) = *(src->stroke_bps);
-    }
+    if (src->stroke_bps)
+        des->stroke_bps = MsvgSpecializeBPServer(src->stroke_bps, NULL, NULL);
     if (src->sfont_family) des->sfont_family = strdup(src->sfont_family);
 }
 
@@ -105,6 +102,28 @@ void MsvgUndefPaintCtxTextAttr(MsvgPaintCtx *pctx)
     pctx->font_size = NODEFINED_VALUE;
 }
 
+int MsvgPaintCtxFieldsSet(const MsvgPaintCtx *pctx)
+{
+    int mask = 0;
+
+    // an inherit value is set, it can differ from the not defined default
+    if (pctx->fill != NODEFINED_COLOR || pctx->fill_iri) mask |= PCTX_FILL;
+    if (pctx->fill_opacity != NODEFINED_VALUE) mask |= PCTX_FILL_OPACITY;
+    if (pctx->fill_rule != NODEFINED_IVALUE) mask |= PCTX_FILL_RULE;
+    if (pctx->stroke != NODEFINED_COLOR || pctx->stroke_iri) mask |= PCTX_STROKE;
+    if (pctx->stroke_width != NODEFINED_VALUE) mask |= PCTX_STROKE_WIDTH;
+    if (pctx->stroke_opacity != NODEFINED_VALUE) mask |= PCTX_STROKE_OPACITY;
+    if (!TMIsIdentity(&(pctx->tmatrix))) mask |= PCTX_TMATRIX;
+    if (pctx->text_anchor != NODEFINED_IVALUE) mask |= PCTX_TEXT_ANCHOR;
+    if (pctx->ifont_family != NODEFINED_IVALUE || pctx->sfont_family)
+        mask |= PCTX_FONT_FAMILY;
+    if (pctx->font_style != NODEFINED_IVALUE) mask |= PCTX_FONT_STYLE;
+    if (pctx->font_weight != NODEFINED_IVALUE) mask |= PCTX_FONT_WEIGHT;
+    if (pctx->font_size != NODEFINED_VALUE) mask |= PCTX_FONT_SIZE;
+
+    return mask;
+}
+
 int MsvgGetInheritedTextAnchor(const MsvgElement *el)
 {
     MsvgElement *fath;
@@ -192,6 +211,11 @@ void MsvgProcPaintCtxInheritance(MsvgPaintCtx *son, const MsvgPaintCtx *fath)
         son->fill_opacity = fath->fill_opacity;
     }
 
+    if (son->fill_rule == INHERIT_IVALUE ||
+        son->fill_rule == NODEFINED_IVALUE) {
+        son->fill_rule = fath->fill_rule;
+    }
+
     if (son->stroke == INHERIT_COLOR || son->stroke == NODEFINED_COLOR) {
         son->stroke = fath->stroke;
         if (son->stroke_iri) {
@@ -260,6 +284,11 @@ void MsvgProcPaintCtxDefaults(MsvgPaintCtx *des)
         des->fill_opacity = 1.0;  // solid
     }
 
+    if (des->fill_rule == INHERIT_IVALUE ||
+        des->fill_rule == NODEFINED_IVALUE) {
+        des->fill_rule = FILLRULE_NONZERO;
+    }
+
     if (des->stroke == INHERIT_COLOR || des->stroke == NODEFINED_COLOR) {
         des->stroke = NO_COLOR;
     }
@@ -303,10 +332,23 @@ void MsvgProcPaintCtxDefaults(MsvgPaintCtx *des)
 MsvgPaintCtx *MsvgBuildPaintCtxInherited(MsvgElement *el)
 {
     MsvgPaintCtx *des;
+    const MsvgPaintCtx *cpctx;
     MsvgElement *fath;
+    TMatrix taux;
 
     if (!el || !el->pctx)  return NULL;
 
+    // the cached one has the world matrix, the root one is added
+    cpctx = MsvgGetCachedPaintCtx(el);
+    if (cpctx) {
+        des = MsvgNewPaintCtx(cpctx);
+        if (des == NULL) return NULL;
+        fath = MsvgFindFirstFather(el);
+        taux = des->tmatrix;
+        TMMpy(&(des->tmatrix), &(fath->pctx->tmatrix), &taux);
+        return des;
+    }
+
     des = MsvgNewPaintCtx(el->pctx);
     if (des == NULL) return NULL;
 
@@ -0,0 +1,358 @@
+/* patch.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "xmlparse.h"
+#include "msvg.h"
+#include "util.h"
+
+/* A patch is a xml document with a "patch" root element whose sons are the
+ * operations, applied in order as they are read, addressing the elements by
+ * their id with the ref attribute:
+ *
+ *   <set ref="id" key="value" .../>   set (or remove if the value is empty)
+ *                                     raw attributes
+ *   <replace ref="id">elements</replace>
+ *   <insert ref="id" where="into|before|after">elements</insert>
+ *   <delete ref="id"/>
+ *
+ * In a cooked tree only the changed or new elements are cooked, and the
+ * element manipulation functions keep the tree indexes and caches updated.
+ */
+
+#define OP_NONE     0
+#define OP_SET      1
+#define OP_REPLACE  2
+#define OP_INSERT   3
+#define OP_DELETE   4
+
+#define WHERE_INTO      0
+#define WHERE_BEFORE    1
+#define WHERE_AFTER     2
+
+typedef struct {
+    MsvgElement *root;
+    int cooked;
+    int depth;
+    int skip_depth;
+    int op;                     // operation being read
+    int where;
+    MsvgElement *target;        // element addressed by the operation
+    MsvgElement *ghost;         // holds the new elements while read
+    MsvgElement *active_element;
+    int applied;                // number of operations applied
+    int op_error;
+    int mem_error;
+} PatchData;
+
+static MsvgElement *findTarget(PatchData *pd, const char **attr)
+{
+    char *ref = NULL;
+    int i;
+
+    for (i=0; attr[i]; i+=2) {
+        if (strcmp(attr[i], "ref") == 0) ref = (char *)attr[i+1];
+    }
+    if (ref == NULL) return NULL;
+
+    if (pd->cooked) return MsvgFindIdCookedTree(pd->root, ref);
+    return MsvgFindIdRawTree(pd->root, ref);
+}
+
+static int setAttributes(PatchData *pd, MsvgElement *el, const char **attr)
+{
+    MsvgElement *ghost;
+    MsvgRawAttribute *pattr;
+    int i;
+
+    // an element built by program gets raw attributes first, so it can be
+    // cooked again from them
+    if (pd->cooked && el->frattr == NULL) MsvgI_Cooked2RawElement(el);
+
+    // a ghost element splits the style attribute
+    ghost = MsvgNewElement(EID_G, NULL);
+    if (ghost == NULL) return 0;
+    for (i=0; attr[i]; i+=2) {
+        if (strcmp(attr[i], "ref") == 0) continue;
+        if (!MsvgAddRawAttribute(ghost, attr[i], attr[i+1])) {
+            MsvgDeleteElement(ghost);
+            return 0;
+        }
+    }
+
+    for (pattr=ghost->frattr; pattr!=NULL; pattr=pattr->nrattr) {
+        while (MsvgDelRawAttribute(el, pattr->key));
+        if (pattr->value[0] != '\0' &&
+            !MsvgAddRawAttribute(el, pattr->key, pattr->value)) {
+            MsvgDeleteElement(ghost);
+            return 0;
+        }
+        if (pd->cooked && (strcmp(pattr->key, "id") == 0 ||
+                           strcmp(pattr->key, "xml:id") == 0)) {
+            MsvgSetElementId(el, pattr->value[0] ? pattr->value : NULL);
+        }
+    }
+
+    MsvgDeleteElement(ghost);
+
+    if (pd->cooked) {
+        if (!MsvgI_RecookElement(el)) return 0;
+        MsvgElementChanged(el);
+    }
+
+    return 1;
+}
+
+static void startOperation(PatchData *pd, const char *name, const char **attr)
+{
+    MsvgElement *father;
+    int i;
+
+    pd->op = OP_NONE;
+    if (strcmp(name, "set") == 0) pd->op = OP_SET;
+    else if (strcmp(name, "replace") == 0) pd->op = OP_REPLACE;
+    else if (strcmp(name, "insert") == 0) pd->op = OP_INSERT;
+    else if (strcmp(name, "delete") == 0) pd->op = OP_DELETE;
+
+    pd->target = findTarget(pd, attr);
+    if (pd->op == OP_NONE || pd->target == NULL) {
+        pd->op = OP_NONE;
+        pd->op_error = 1;
+        return;
+    }
+
+    pd->where = WHERE_INTO;
+    for (i=0; attr[i]; i+=2) {
+        if (strcmp(attr[i], "where") != 0) continue;
+        if (strcmp(attr[i+1], "before") == 0) pd->where = WHERE_BEFORE;
+        else if (strcmp(attr[i+1], "after") == 0) pd->where = WHERE_AFTER;
+    }
+
+    if (pd->op == OP_SET) {
+        if (setAttributes(pd, pd->target, attr)) pd->applied++;
+        else pd->mem_error = 1;
+        pd->op = OP_NONE;
+        return;
+    }
+
+    if (pd->op == OP_DELETE) return;
+
+    // the new elements are read in a ghost element like their father
+    if (pd->op == OP_INSERT && pd->where == WHERE_INTO)
+        father = pd->target;
+    else
+        father = pd->target->father;
+    if (father == NULL) {
+        pd->op = OP_NONE;
+        pd->op_error = 1;
+        return;
+    }
+
+    pd->ghost = MsvgNewElement(father->eid, NULL);
+    if (pd->ghost == NULL) {
+        pd->op = OP_NONE;
+        pd->mem_error = 1;
+        return;
+    }
+    pd->active_element = pd->ghost;
+}
+
+static void endOperation(PatchData *pd)
+{
+    MsvgElement *el, *prev = NULL, *target;
+
+    target = pd->target;
+
+    if (pd->op == OP_DELETE) {
+        if (target == pd->root) {
+            pd->op_error = 1;
+            return;
+        }
+        MsvgDeleteElement(target);
+        pd->applied++;
+        return;
+    }
+
+    // the new elements are inserted in order
+    while ((el = pd->ghost->fson) != NULL) {
+        MsvgPruneElement(el);
+        if (pd->cooked) MsvgI_CookSubtree(el);
+        if (prev) {
+            MsvgInsertNSiblingElement(el, prev);
+        } else if (pd->op == OP_REPLACE) {
+            MsvgReplaceElement(target, el);
+            MsvgDeleteElement(target);
+            target = NULL;
+        } else if (pd->where == WHERE_BEFORE) {
+            MsvgInsertPSiblingElement(el, target);
+        } else if (pd->where == WHERE_AFTER) {
+            MsvgInsertNSiblingElement(el, target);
+        } else {
+            MsvgInsertSonElement(el, target);
+        }
+        if (pd->op == OP_REPLACE || pd->where != WHERE_INTO) prev = el;
+    }
+
+    // replaced by nothing
+    if (pd->op == OP_REPLACE && target) MsvgDeleteElement(target);
+
+    MsvgDeleteElement(pd->ghost);
+    pd->ghost = NULL;
+    pd->applied++;
+}
+
+static void startElement(void *userData, const char *name, const char **attr)
+{
+    PatchData *pd = userData;
+    MsvgElement *el;
+    enum EID eid;
+    int i;
+
+    pd->depth += 1;
+    if (pd->mem_error || pd->skip_depth) return;
+
+    if (pd->depth == 1) {
+        if (strcmp(name, "patch") != 0) pd->skip_depth = pd->depth;
+        return;
+    }
+
+    if (pd->depth == 2) {
+        startOperation(pd, name, attr);
+        if (pd->op == OP_NONE) pd->skip_depth = pd->depth;
+        return;
+    }
+
+    // an element of a replace or insert operation
+    eid = MsvgFindElementId(name);
+    if (pd->active_element == NULL ||
+        !MsvgIsSupSonElement(pd->active_element->eid, eid)) {
+        pd->skip_depth = pd->depth;
+        pd->op_error = 1;
+        return;
+    }
+
+    el = MsvgNewElement(eid, pd->active_element);
+    if (el == NULL) {
+        pd->mem_error = 1;
+        return;
+    }
+    for (i=0; attr[i]; i+=2) {
+        MsvgAddRawAttribute(el, attr[i], attr[i+1]);
+    }
+    pd->active_element = el;
+}
+
+static void endElement(void *userData, const char *name)
+{
+    PatchData *pd = userData;
+
+    pd->depth -= 1;
+    if (pd->mem_error) return;
+
+    if (pd->skip_depth) {
+        if (pd->skip_depth == pd->depth + 1) pd->skip_depth = 0;
+        return;
+    }
+
+    if (pd->depth == 1) {
+        if (pd->op != OP_NONE) endOperation(pd);
+        pd->op = OP_NONE;
+        pd->active_element = NULL;
+    } else if (pd->depth > 1) {
+        pd->active_element = pd->active_element->father;
+    }
+}
+
+static void data(void *userData, const char *s, int len)
+{
+    PatchData *pd = userData;
+    int i;
+
+    if (pd->mem_error || pd->skip_depth) return;
+    if (pd->depth < 3 || pd->active_element == NULL) return;
+    if (!MsvgElementCanHaveContent(pd->active_element->eid)) return;
+
+    // the spaces between elements are not content
+    if (pd->active_element->fcontent == NULL) {
+        for (i=0; i<len; i++) {
+            if (s[i] != '\n' && s[i] != '\t' && s[i] != ' ' && s[i] != '\r')
+                break;
+        }
+        if (i == len) return;
+        s += i;
+        len -= i;
+    }
+
+    if (!MsvgAddContent(pd->active_element, len, s)) pd->mem_error = 1;
+}
+
+int MsvgApplyPatch(MsvgElement *root, const char *buf, int len, int *error)
+{
+    XML_Parser parser;
+    PatchData pd;
+
+    *error = 0;
+    // -2 memory error creating parser
+    // -3 memory error building the elements, the patch is not finished
+    // -4 an operation was not applied, unknown or wrong ref
+    // >0 expat error, the previous operations were applied
+
+    if (root == NULL || root->eid != EID_SVG) return 0;
+    if (len < 0) len = strlen(buf);
+
+    memset(&pd, 0, sizeof(PatchData));
+    pd.root = root;
+    pd.cooked = root->psvgattr->tree_type == COOKED_SVGTREE;
+
+    parser = XML_ParserCreate(NULL);
+    if (parser == NULL) {
+        *error = -2;
+        return 0;
+    }
+
+    XML_SetUserData(parser, &pd);
+    XML_SetElementHandler(parser, startElement, endElement);
+    XML_SetCharacterDataHandler(parser, data);
+
+    if (!XML_Parse(parser, buf, len, 1)) {
+        *error = XML_GetErrorCode(parser);
+    }
+
+    XML_ParserFree(parser);
+
+    // an operation not finished
+    if (pd.ghost) MsvgDeleteElement(pd.ghost);
+
+    if (*error == 0) {
+        if (pd.mem_error) *error = -3;
+        else if (pd.op_error) *error = -4;
+    }
+
+    return pd.applied;
+}
@@ -30,12 +30,13 @@
 #include <string.h>
 #include <math.h>
 #include "msvg.h"
+#include "util.h"
 
 typedef struct {
     int maxpoints;           // max capacity (realloc if necesary)
     int npoints;             // actual number of points
     int failed_realloc;      // 1 = yes, 0 = no
-    double *points;          // Points array
+    MsvgCoord *points;       // Points array
 } ExpPointArray;
 
 #define POINTSEP 8
@@ -49,7 +50,7 @@ static ExpPointArray * NewExpPointArray(int maxpoints)
 
     pa = malloc(sizeof(ExpPointArray));
     if (pa == NULL) return NULL;
-    pa->points = malloc(sizeof(double)*2*maxpoints);
+    pa->points = malloc(sizeof(MsvgCoord)*2*maxpoints);
     if (pa->points == NULL) {
         free(pa);
         return NULL;
@@ -64,11 +65,11 @@ static ExpPointArray * NewExpPointArray(int maxpoints)
 
 static void ExpandExpPointArray(ExpPointArray *pa)
 {
-    double *newpoints;
+    MsvgCoord *newpoints;
     int newmaxpoints;
 
     newmaxpoints = pa->maxpoints * 2;
-    newpoints = realloc(pa->points, sizeof(double)*2*newmaxpoints);
+    newpoints = realloc(pa->points, sizeof(MsvgCoord)*2*newmaxpoints);
     if (newpoints == NULL) {
         pa->failed_realloc = 1;
         return;
@@ -98,7 +99,7 @@ static void DestroyExpPointArray(ExpPointArray *pa)
     free(pa);
 }
 
-static void GenQBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_unit)
+static void GenQBezier(const MsvgPackedPath *pp, int pos, ExpPointArray *pa, double px_x_unit)
 {
     int numpts;
     double xorg, yorg, xpc, ypc, xend, yend;
@@ -106,12 +107,12 @@ static void GenQBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_
     double t, dt, tSquared;
     int i;
 
-    xorg = sp->spp[pos-1].x;
-    yorg = sp->spp[pos-1].y;
-    xpc = sp->spp[pos].x;
-    ypc = sp->spp[pos].y;
-    xend = sp->spp[pos+1].x;
-    yend = sp->spp[pos+1].y;
+    xorg = pp->x[pos-1];
+    yorg = pp->y[pos-1];
+    xpc = pp->x[pos];
+    ypc = pp->y[pos];
+    xend = pp->x[pos+1];
+    yend = pp->y[pos+1];
 
     numpts = (fabs(xorg - xpc) + fabs(yorg - ypc) +
               fabs(xpc - xend) + fabs(ypc - yend)) * px_x_unit / POINTSEP;
@@ -135,7 +136,7 @@ static void GenQBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_
     AddPointToExpPointArray(pa, xend, yend);
 }
 
-static void GenCBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_unit)
+static void GenCBezier(const MsvgPackedPath *pp, int pos, ExpPointArray *pa, double px_x_unit)
 {
     int numpts;
     double xorg, yorg, xpc1, ypc1, xpc2, ypc2, xend, yend;
@@ -143,14 +144,14 @@ static void GenCBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_
     double t, dt, tSquared, tCubed;
     int i;
 
-    xorg = sp->spp[pos-1].x;
-    yorg = sp->spp[pos-1].y;
-    xpc1 = sp->spp[pos].x;
-    ypc1 = sp->spp[pos].y;
-    xpc2 = sp->spp[pos+1].x;
-    ypc2 = sp->spp[pos+1].y;
-    xend = sp->spp[pos+2].x;
-    yend = sp->spp[pos+2].y;
+    xorg = pp->x[pos-1];
+    yorg = pp->y[pos-1];
+    xpc1 = pp->x[pos];
+    ypc1 = pp->y[pos];
+    xpc2 = pp->x[pos+1];
+    ypc2 = pp->y[pos+1];
+    xend = pp->x[pos+2];
+    yend = pp->y[pos+2];
 
     numpts = (fabs(xorg - xpc1) + fabs(yorg - ypc1) +
               fabs(xpc1 - xpc2) + fabs(ypc1 - ypc2) +
@@ -178,50 +179,64 @@ static void GenCBezier(MsvgSubPath *sp, int pos, ExpPointArray *pa, double px_x_
     AddPointToExpPointArray(pa, xend, yend);
 }
 
-static ExpPointArray *PathToExpPointArray(MsvgSubPath *sp, double px_x_unit)
+static ExpPointArray *PathToExpPointArray(const MsvgPackedPath *pp, int nsp,
+                                          double px_x_unit)
 {
     ExpPointArray *pa;
-    int i;
+    int i, first, last;
 
-    if (sp->npoints < 2) return NULL;
+    first = pp->fpoint[nsp];
+    last = pp->fpoint[nsp+1];
+    if (last - first < 2) return NULL;
 
-    pa = NewExpPointArray(sp->npoints*2);
+    pa = NewExpPointArray((last - first)*2);
     if (pa == NULL) return NULL;
 
-    AddPointToExpPointArray(pa, sp->spp[0].x, sp->spp[0].y);
-    for (i=1; i<sp->npoints; i++) {
-        if (sp->spp[i].cmd == 'L') {
-            AddPointToExpPointArray(pa, sp->spp[i].x, sp->spp[i].y);
-        } else if (sp->spp[i].cmd == 'Q') {
-            GenQBezier(sp, i, pa, px_x_unit);
-        } else if (sp->spp[i].cmd == 'C') {
-            GenCBezier(sp, i, pa, px_x_unit);
+    AddPointToExpPointArray(pa, pp->x[first], pp->y[first]);
+    for (i=first+1; i<last; i++) {
+        if (pp->cmd[i] == 'L') {
+            AddPointToExpPointArray(pa, pp->x[i], pp->y[i]);
+        } else if (pp->cmd[i] == 'Q') {
+            GenQBezier(pp, i, pa, px_x_unit);
+        } else if (pp->cmd[i] == 'C') {
+            GenCBezier(pp, i, pa, px_x_unit);
         }
     }
 
     return pa;
 }
 
+MsvgCoord *MsvgI_FlattenSubPath(const MsvgPackedPath *pp, int nsp, double px_x_unit,
+                                int *npoints)
+{
+    ExpPointArray *pa;
+    MsvgCoord *points;
+
+    pa = PathToExpPointArray(pp, nsp, px_x_unit);
+    if (pa == NULL) return NULL;
+
+    points = pa->points;
+    *npoints = pa->npoints;
+    free(pa);
+
+    return points;
+}
+
 MsvgElement *MsvgSubPathToPoly(MsvgElement *el, int nsp, double px_x_unit)
 {
     MsvgElement *newel;
-    MsvgSubPath *sp;
+    MsvgPackedPath *pp;
     ExpPointArray *pa;
-    int i;
 
     if (el->eid != EID_PATH) return NULL;
 
-    sp = el->ppathattr->sp;
-    for (i=0; i < nsp; i++) {
-        if (sp == NULL) return NULL;
-        sp = sp->next;
-    }
-    if (sp == NULL) return NULL;
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL || nsp < 0 || nsp >= pp->nsubpaths) return NULL;
 
-    pa = PathToExpPointArray(sp, px_x_unit);
+    pa = PathToExpPointArray(pp, nsp, px_x_unit);
     if (pa == NULL) return NULL;
 
-    if (sp->closed) {
+    if (pp->closed[nsp]) {
         newel = MsvgNewElement(EID_POLYGON, NULL);
         if (newel == NULL) {
             DestroyExpPointArray(pa);
@@ -249,22 +264,19 @@ MsvgElement *MsvgSubPathToPoly(MsvgElement *el, int nsp, double px_x_unit)
 MsvgElement *MsvgPathToPolyGroup(MsvgElement *el, double px_x_unit)
 {
     MsvgElement *newel, *group;
-    MsvgSubPath *sp;
+    MsvgPackedPath *pp;
     int nsp;
 
     if (el->eid != EID_PATH) return NULL;
-    sp = el->ppathattr->sp;
-    if (sp == NULL) return NULL;
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL) return NULL;
 
     group = MsvgNewElement(EID_G, NULL);
     if (group == NULL) return NULL;
 
-    nsp = 0;
-    while (sp) {
+    for (nsp=0; nsp<pp->nsubpaths; nsp++) {
         newel = MsvgSubPathToPoly(el, nsp, px_x_unit);
         if (newel) MsvgInsertSonElement(newel, group);
-        sp = sp->next;
-        nsp++;
     }
 
     return group;
@@ -31,11 +31,10 @@
 
 static void printRawAttribute(FILE *f, MsvgRawAttribute *el)
 {
-    if (el == NULL) return;
-    
-    fprintf(f, " (%s = %s)", el->key, el->value);
-    
-    printRawAttribute(f, el->nrattr);
+    while (el) {
+        fprintf(f, " (%s = %s)", el->key, el->value);
+        el = el->nrattr;
+    }
 }
 
 static void printContents(FILE *f, MsvgElement *el, int depth)
@@ -72,24 +71,39 @@ static void printContents(FILE *f, MsvgElement *el, int depth)
 
 void MsvgPrintRawElementTree(FILE *f, MsvgElement *el, int depth)
 {
+    MsvgElement *pel, *top;
     int i;
     
     if (el == NULL) return;
+
+    // the next siblings too, but not of the top element
+    top = depth ? el->father : el;
+    pel = el;
+    for (;;) {
+        if (depth > 0) {
+            for (i=0; i<depth; i++)
+                fputs("  |", f);
+            fputs("-->", f);
+        }
     
-    if (depth > 0) {
-        for (i=0; i<depth; i++)
-            fputs("  |", f);
-        fputs("-->", f);
+        fprintf(f, "%s", MsvgFindElementName(pel->eid));
+        printRawAttribute(f, pel->frattr);
+        fputs("\n", f);
+        printContents(f, pel, depth);
+
+        if (pel->fson) {
+            pel = pel->fson;
+            depth++;
+            continue;
+        }
+        if (pel == top) return;
+        while (pel->nsibling == NULL) {
+            pel = pel->father;
+            depth--;
+            if (pel == top) return;
+        }
+        pel = pel->nsibling;
     }
-    
-    fprintf(f, "%s", MsvgFindElementName(el->eid));
-    printRawAttribute(f, el->frattr);
-    fputs("\n", f);
-    printContents(f, el, depth);
-    
-    MsvgPrintRawElementTree(f, el->fson, depth+1);
-    
-    if (depth) MsvgPrintRawElementTree(f, el->nsibling, depth);
 }
 
 static char * printcolor(rgbcolor color)
@@ -144,6 +158,7 @@ void MsvgPrintPctx(FILE *f, MsvgPaintCtx *pctx)
     if (pctx->fill_iri)
         fprintf(f, "  fill_iri       %s\n", pctx->fill_iri);
     fprintf(f, "  fill_opacity   %s\n", printdvalue(pctx->fill_opacity));
+    fprintf(f, "  fill_rule      %s\n", printivalue(pctx->fill_rule));
     fprintf(f, "  stroke         %s\n", printcolor(pctx->stroke));
     if (pctx->stroke_iri)
         fprintf(f, "  stroke_iri     %s\n", pctx->stroke_iri);
@@ -161,21 +176,20 @@ void MsvgPrintPctx(FILE *f, MsvgPaintCtx *pctx)
     fprintf(f, "  font-size      %s\n", printdvalue(pctx->font_size));
 }
 
-static void printPath(FILE *f, MsvgSubPath *osp)
+static void printPath(FILE *f, MsvgPackedPath *pp)
 {
-    MsvgSubPath *sp;
-    int i;
+    int i, j;
+
+    if (pp == NULL) return;
 
-    sp = osp;
-    while (sp) {
+    for (j=0; j<pp->nsubpaths; j++) {
         fprintf(f, "  sp             (npoints:%d closed:%d) ",
-                sp->npoints, sp->closed);
-        for (i=0; i<sp->npoints; i++) {
-            if (sp->spp[i].cmd != ' ') fprintf(f, "%c ", sp->spp[i].cmd);
-            fprintf(f, "%g,%g ", sp->spp[i].x, sp->spp[i].y);
+                pp->fpoint[j+1] - pp->fpoint[j], pp->closed[j]);
+        for (i=pp->fpoint[j]; i<pp->fpoint[j+1]; i++) {
+            if (pp->cmd[i] != ' ') fprintf(f, "%c ", pp->cmd[i]);
+            fprintf(f, "%g,%g ", pp->x[i], pp->y[i]);
         }
         fprintf(f, "\n");
-        sp = sp->next;
     }
 }
 
@@ -268,7 +282,7 @@ static void printPolygonCookedAttr(FILE *f, MsvgElement *el)
 
 static void printPathCookedAttr(FILE *f, MsvgElement *el)
 {
-    printPath(f, el->ppathattr->sp);
+    printPath(f, MsvgGetPackedPath(el));
 }
 
 static void printTextCookedAttr(FILE *f, MsvgElement *el)
@@ -330,13 +344,13 @@ static void printGlyphCookedAttr(FILE *f, MsvgElement *el)
 {
     fprintf(f, "  unicode        U+%04lx\n", el->pglyphattr->unicode);
     fprintf(f, "  horiz_adv_x    %s\n", printdvalue(el->pglyphattr->horiz_adv_x));
-    printPath(f, el->pglyphattr->sp);
+    printPath(f, MsvgGetPackedPath(el));
 }
 
 static void printMissingGlyphCookedAttr(FILE *f, MsvgElement *el)
 {
     fprintf(f, "  horiz_adv_x    %s\n", printdvalue(el->pglyphattr->horiz_adv_x));
-    printPath(f, el->pglyphattr->sp);
+    printPath(f, MsvgGetPackedPath(el));
 }
 
 void MsvgPrintCookedElement(FILE *f, MsvgElement *el)
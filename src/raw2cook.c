@@ -184,6 +184,14 @@ static void gettmatrix(char *value, TMatrix *t)
     free(valaux);
 }
 
+static int fillrule(char *value)
+{
+    if (strcmp(value, "inherit") == 0) return INHERIT_IVALUE;
+    else if (strstr(value, "nonzero") != NULL) return FILLRULE_NONZERO;
+    else if (strstr(value, "evenodd") != NULL) return FILLRULE_EVENODD;
+    else return NODEFINED_IVALUE;
+}
+
 static int textanchor(char *value)
 {
     if (strcmp(value, "inherit") == 0) return INHERIT_IVALUE;
@@ -262,6 +270,7 @@ static int cookPCtxAttr(MsvgElement *el, char *key, char *value)
             getcolorattr(value, &(el->pctx->fill), &(el->pctx->fill_iri));
         }
         else if (strcmp(key, "fill-opacity") == 0) el->pctx->fill_opacity = opacitytof(value);
+        else if (strcmp(key, "fill-rule") == 0) el->pctx->fill_rule = fillrule(value);
         else if (strcmp(key, "stroke") == 0) {
             if (el->pctx->stroke_iri) free(el->pctx->stroke_iri);
             getcolorattr(value, &(el->pctx->stroke), &(el->pctx->stroke_iri));
@@ -356,34 +365,45 @@ static void cookLineGenAttr(MsvgElement *el, char *key, char *value)
     else if (strcmp(key, "y2") == 0) el->plineattr->y2 = atof(value);
 }
 
-static void readpoints(char *value, double **points, int *npoints)
+static void readpoints(char *value, MsvgCoord **points, int *npoints, int **nrefs)
 {
     int n;
     
+    // a copied element can have an empty array already
+    MsvgI_ReleasePoints(points, nrefs);
     *npoints = 0;
     n = MsvgI_count_numbers(value);
     if (n < 2) return;
-    *points = (double *)calloc(n, sizeof(double));
+    *points = (MsvgCoord *)calloc(n, sizeof(MsvgCoord));
     if (*points == NULL) return;
-    MsvgI_read_numbers(value, *points, n);
+    MsvgI_read_coords(value, *points, n);
     *npoints = n / 2;
 }
 
 static void cookPolylineGenAttr(MsvgElement *el, char *key, char *value)
 {
     if (strcmp(key, "points") == 0) 
-        readpoints(value, &(el->ppolylineattr->points), &(el->ppolylineattr->npoints));
+        readpoints(value, &(el->ppolylineattr->points), &(el->ppolylineattr->npoints),
+                   &(el->ppolylineattr->nrefs));
 }
 
 static void cookPolygonGenAttr(MsvgElement *el, char *key, char *value)
 {
     if (strcmp(key, "points") == 0) 
-        readpoints(value, &(el->ppolylineattr->points), &(el->ppolylineattr->npoints));
+        readpoints(value, &(el->ppolylineattr->points), &(el->ppolylineattr->npoints),
+                   &(el->ppolylineattr->nrefs));
+}
+
+static void setPathData(char **d, char *value)
+{
+    // a copy, scanned the first time it is needed
+    if (*d) free(*d);
+    *d = strdup(value);
 }
 
 static void cookPathGenAttr(MsvgElement *el, char *key, char *value)
 {
-    if (strcmp(key, "d") == 0) el->ppathattr->sp = MsvgScanPath(value);
+    if (strcmp(key, "d") == 0) setPathData(&(el->ppathattr->d), value);
 }
 
 static void cookTextGenAttr(MsvgElement *el, char *key, char *value)
@@ -450,7 +470,7 @@ static void cookFontFaceGenAttr(MsvgElement *el, char *key, char *value)
 static void cookMissingGlyphGenAttr(MsvgElement *el, char *key, char *value)
 {
     if (strcmp(key, "horiz-adv-x") == 0) el->pglyphattr->horiz_adv_x = atof(value);
-    else if (strcmp(key, "d") == 0) el->pglyphattr->sp = MsvgScanPath(value);
+    else if (strcmp(key, "d") == 0) setPathData(&(el->pglyphattr->d), value);
 }
 
 static void cookGlyphGenAttr(MsvgElement *el, char *key, char *value)
@@ -464,7 +484,7 @@ static void cookGlyphGenAttr(MsvgElement *el, char *key, char *value)
         //printf("Unicode!! %s %08lx\n", value, el->pglyphattr->unicode);
     }
     else if (strcmp(key, "horiz-adv-x") == 0) el->pglyphattr->horiz_adv_x = atof(value);
-    else if (strcmp(key, "d") == 0) el->pglyphattr->sp = MsvgScanPath(value);
+    else if (strcmp(key, "d") == 0) setPathData(&(el->pglyphattr->d), value);
 }
 
 static void checkSvgCookedAttr(MsvgElement *el)
@@ -512,7 +532,7 @@ static void checkEllipseCookedAttr(MsvgElement *el)
     el->pellipseattr->ry_y += el->pellipseattr->cy;
 }
 
-static void cookElement(MsvgElement *el, int depth)
+static void cookAttributes(MsvgElement *el)
 {
     MsvgRawAttribute *pattr;
     
@@ -602,12 +622,23 @@ static void cookElement(MsvgElement *el, int depth)
         default :
             break;
     }
+}
 
-    if (el->fson != NULL)
-        cookElement(el->fson, depth+1);
-    
-    if (el->nsibling != NULL)
-        cookElement(el->nsibling, depth);
+static void cookSubtree(MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    pel = el;
+    for (;;) {
+        cookAttributes(pel);
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
 }
 
 int MsvgRaw2CookedTree(MsvgElement *root)
@@ -616,8 +647,62 @@ int MsvgRaw2CookedTree(MsvgElement *root)
     if (root->eid != EID_SVG) return 0;
     if (root->psvgattr->tree_type != RAW_SVGTREE) return 0;
     
-    cookElement(root, 0);
+    cookSubtree(root);
     root->psvgattr->tree_type = COOKED_SVGTREE;
-    
+
+    // the id index is kept updated by the manipulation functions, the
+    // ids changed directly need a MsvgBuildIdIndex call
+    MsvgBuildIdIndex(root);
+
+    return 1;
+}
+
+/* internal functions to cook parts of a cooked tree */
+
+void MsvgI_CookSubtree(MsvgElement *el)
+{
+    cookSubtree(el);
+}
+
+int MsvgI_RecookElement(MsvgElement *el)
+{
+    MsvgElement *newel;
+    MsvgSvgAttributes *psvgattr;
+    MsvgPaintCtx *pctx;
+
+    // the raw attributes are cooked in a new element, so the removed ones
+    // get the default values, and then the cooked attributes are swapped
+    newel = MsvgNewElement(el->eid, NULL);
+    if (newel == NULL) return 0;
+
+    newel->frattr = el->frattr;
+    cookAttributes(newel);
+    newel->frattr = NULL;
+
+    if (el->eid == EID_SVG) {
+        newel->psvgattr->tree_type = el->psvgattr->tree_type;
+        newel->psvgattr->rtree = el->psvgattr->rtree;
+        newel->psvgattr->usecache = el->psvgattr->usecache;
+        newel->psvgattr->idindex = el->psvgattr->idindex;
+        newel->psvgattr->pctxcache = el->psvgattr->pctxcache;
+        newel->psvgattr->journal = el->psvgattr->journal;
+        el->psvgattr->rtree = NULL;
+        el->psvgattr->usecache = NULL;
+        el->psvgattr->idindex = NULL;
+        el->psvgattr->pctxcache = 0;
+        el->psvgattr->journal = NULL;
+    }
+
+    // all the union members are pointers, the id is set by the caller
+    psvgattr = el->psvgattr;
+    el->psvgattr = newel->psvgattr;
+    newel->psvgattr = psvgattr;
+    pctx = el->pctx;
+    el->pctx = newel->pctx;
+    newel->pctx = pctx;
+    if (el->eid == EID_SVG) el->pctx->tmatrix = pctx->tmatrix; // the view
+
+    MsvgDeleteElement(newel);
+
     return 1;
 }
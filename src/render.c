@@ -0,0 +1,1462 @@
+/* render.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#ifdef MSVG_PTHREADS
+#include <pthread.h>
+#endif
+#include "msvg.h"
+#include "util.h"
+
+/* A native renderer to a 32 bits buffer, with the same view semantics as the
+ * GD backend. Every drawable element is converted to device coordinates, its
+ * fill and its stroke become lists of edges in 24.8 fixed point (the stroke
+ * is the outline of its sides filled nonzero) and the edges are rasterized
+ * to sparse scanlines: cells with the exact covered area and the winding
+ * cover, sorted by row and column, and swept to get the coverage of every
+ * pixel, like the libart/AGG scanline rasterizers.
+ *
+ * The edges are clipped to the buffer before the conversion to fixed point
+ * and every crossing with a row or column boundary is calculated from the
+ * clipped edge only, so the cells (integer sums) and then the pixels do not
+ * depend on the clip box used to rasterize, a part of the buffer gives the
+ * same pixels than the whole one.
+ */
+
+#define RSUBPIX_SHIFT 8
+#define RSUBPIX (1 << RSUBPIX_SHIFT)
+
+#define RFLATTEN_PX_X_UNIT 2.0  /* about one point every four pixels */
+#define RMITER_LIMIT 4.0        /* the SVG default */
+
+#define RPAINT_SOLID  0
+#define RPAINT_LINEAR 1
+#define RPAINT_RADIAL 2
+
+#define RLUT_SIZE 256
+
+typedef struct {
+    int x1, y1, x2, y2;     /* fixed point, inside the buffer */
+} REdge;
+
+typedef struct {
+    int x, y;               /* pixel */
+    int cover;              /* winding cover, in subpixels */
+    int area;               /* cover times the covered width, doubled */
+} RCell;
+
+typedef struct {
+    int x0, y0, x1, y1;     /* pixels to render, x1 and y1 excluded */
+} RClip;
+
+typedef struct {
+    int type;               /* RPAINT_SOLID, RPAINT_LINEAR or RPAINT_RADIAL */
+    uint32_t color;         /* solid color, 0xRRGGBB */
+    int alpha;              /* solid opacity, 0..255 */
+    double gx, gy, g0;      /* linear gradient t = gx * x + gy * y + g0 */
+    double cx, cy, rr;      /* radial gradient center and 1 / radius */
+    uint32_t *lut;          /* gradient colors with opacity, 0xAARRGGBB */
+} RPaint;
+
+typedef struct {
+    uint32_t *pixels;
+    int w, h, stride;       /* stride in pixels */
+} RBuffer;
+
+typedef struct {
+    int w, h;               /* buffer size, to clip the edges */
+    REdge *edges;
+    int nedges, maxedges;
+    RCell *cells;
+    int ncells, maxcells;
+    double bx0, by0, bx1, by1; /* bounds of the edges added */
+    int ymin, ymax;         /* rows with cells */
+    RCell *sorted;          /* cells by row and column */
+    int maxsorted;
+    int *rowstart;
+    int maxrows;
+    double *pts;            /* flattened points of a polyline */
+    int maxpts;
+    double *nrm;            /* normals of its segments */
+    int maxnrm;
+    double *opts;           /* stroke outline */
+    int nopts, maxopts;
+    int nomem;
+} RScratch;
+
+static void *growArray(void *p, int *max, int need, size_t size, int *nomem)
+{
+    void *newp;
+    int newmax;
+
+    if (need <= *max) return p;
+    newmax = (*max > 0) ? *max * 2 : 256;
+    while (newmax < need) newmax *= 2;
+    newp = realloc(p, newmax * size);
+    if (newp == NULL) {
+        *nomem = 1;
+        return NULL;
+    }
+    *max = newmax;
+
+    return newp;
+}
+
+static void resetEdges(RScratch *rs)
+{
+    rs->nedges = 0;
+    rs->bx0 = rs->by0 = HUGE_VAL;
+    rs->bx1 = rs->by1 = -HUGE_VAL;
+}
+
+static void initScratch(RScratch *rs, int w, int h)
+{
+    memset(rs, 0, sizeof(RScratch));
+    rs->w = w;
+    rs->h = h;
+    resetEdges(rs);
+}
+
+static void freeScratch(RScratch *rs)
+{
+    free(rs->edges);
+    free(rs->cells);
+    free(rs->sorted);
+    free(rs->rowstart);
+    free(rs->pts);
+    free(rs->nrm);
+    free(rs->opts);
+}
+
+/* edges */
+
+static void pushEdge(RScratch *rs, double x1, double y1, double x2, double y2)
+{
+    REdge *e, *newe;
+    int fy1, fy2;
+
+    fy1 = y1 * RSUBPIX + 0.5;
+    fy2 = y2 * RSUBPIX + 0.5;
+    if (fy1 == fy2) return; // no cover
+
+    newe = growArray(rs->edges, &(rs->maxedges), rs->nedges + 1,
+                     sizeof(REdge), &(rs->nomem));
+    if (newe == NULL) return;
+    rs->edges = newe;
+
+    e = &(rs->edges[rs->nedges++]);
+    e->x1 = x1 * RSUBPIX + 0.5;
+    e->y1 = fy1;
+    e->x2 = x2 * RSUBPIX + 0.5;
+    e->y2 = fy2;
+}
+
+static void pushClampedEdge(RScratch *rs, double x1, double y1, double x2, double y2)
+{
+    // the parts out of the buffer sides keep their cover as vertical edges
+    if (x1 < 0) x1 = 0;
+    else if (x1 > rs->w) x1 = rs->w;
+    if (x2 < 0) x2 = 0;
+    else if (x2 > rs->w) x2 = rs->w;
+    pushEdge(rs, x1, y1, x2, y2);
+}
+
+static void addEdge(RScratch *rs, double x1, double y1, double x2, double y2)
+{
+    double t, xm, ym, xb[2];
+    int i;
+
+    if (!(x1 == x1 && y1 == y1 && x2 == x2 && y2 == y2)) return; // NaN
+    if (x1 < rs->bx0) rs->bx0 = x1;
+    if (x2 < rs->bx0) rs->bx0 = x2;
+    if (x1 > rs->bx1) rs->bx1 = x1;
+    if (x2 > rs->bx1) rs->bx1 = x2;
+    if (y1 < rs->by0) rs->by0 = y1;
+    if (y2 < rs->by0) rs->by0 = y2;
+    if (y1 > rs->by1) rs->by1 = y1;
+    if (y2 > rs->by1) rs->by1 = y2;
+    if (y1 == y2) return;
+    if ((y1 <= 0 && y2 <= 0) || (y1 >= rs->h && y2 >= rs->h)) return;
+    if (x1 >= rs->w && x2 >= rs->w) return;
+
+    // clip to the buffer rows
+    if (y1 < 0) {
+        x1 += (x2 - x1) * (0 - y1) / (y2 - y1);
+        y1 = 0;
+    } else if (y1 > rs->h) {
+        x1 += (x2 - x1) * (rs->h - y1) / (y2 - y1);
+        y1 = rs->h;
+    }
+    if (y2 < 0) {
+        x2 += (x1 - x2) * (0 - y2) / (y1 - y2);
+        y2 = 0;
+    } else if (y2 > rs->h) {
+        x2 += (x1 - x2) * (rs->h - y2) / (y1 - y2);
+        y2 = rs->h;
+    }
+
+    // split where it crosses the left and right sides
+    xb[0] = 0;
+    xb[1] = rs->w;
+    if (x1 > x2) {
+        xb[0] = rs->w;
+        xb[1] = 0;
+    }
+    for (i=0; i<2; i++) {
+        if ((x1 < xb[i] && x2 > xb[i]) || (x1 > xb[i] && x2 < xb[i])) {
+            t = (xb[i] - x1) / (x2 - x1);
+            xm = xb[i];
+            ym = y1 + (y2 - y1) * t;
+            pushClampedEdge(rs, x1, y1, xm, ym);
+            x1 = xm;
+            y1 = ym;
+        }
+    }
+    pushClampedEdge(rs, x1, y1, x2, y2);
+}
+
+static void addRing(RScratch *rs, const double *pts, int npts)
+{
+    int i;
+
+    if (npts < 2) return;
+    for (i=1; i<npts; i++)
+        addEdge(rs, pts[i*2-2], pts[i*2-1], pts[i*2], pts[i*2+1]);
+    addEdge(rs, pts[npts*2-2], pts[npts*2-1], pts[0], pts[1]);
+}
+
+/* stroker, the outline of the two offset sides joined by butt caps, with
+ * miter joins that become bevel over the limit in the outer side and the
+ * joins through the vertex in the inner one, filled nonzero */
+
+static void pushPoint(RScratch *rs, double x, double y)
+{
+    double *newp;
+
+    newp = growArray(rs->opts, &(rs->maxopts), rs->nopts * 2 + 2,
+                     sizeof(double), &(rs->nomem));
+    if (newp == NULL) return;
+    rs->opts = newp;
+    rs->opts[rs->nopts*2] = x;
+    rs->opts[rs->nopts*2+1] = y;
+    rs->nopts++;
+}
+
+static void pushJoin(RScratch *rs, const double *p, const double *n0,
+                     const double *n1, double hw)
+{
+    double cross, dot, k;
+
+    cross = n0[0] * n1[1] - n0[1] * n1[0];
+    dot = n0[0] * n1[0] + n0[1] * n1[1];
+    if (fabs(cross) < 1e-9 && dot > 0) {
+        // straight
+        pushPoint(rs, p[0] + hw * n1[0], p[1] + hw * n1[1]);
+        return;
+    }
+
+    pushPoint(rs, p[0] + hw * n0[0], p[1] + hw * n0[1]);
+    if ((cross > 0) == (hw > 0)) {
+        // inner side
+        pushPoint(rs, p[0], p[1]);
+    } else if (1 + dot > 2 / (RMITER_LIMIT * RMITER_LIMIT)) {
+        k = hw / (1 + dot);
+        pushPoint(rs, p[0] + k * (n0[0] + n1[0]), p[1] + k * (n0[1] + n1[1]));
+    }
+    pushPoint(rs, p[0] + hw * n1[0], p[1] + hw * n1[1]);
+}
+
+static void pushSide(RScratch *rs, const double *pts, const double *nrm,
+                     int npts, int closed, double hw)
+{
+    int i, nsegs;
+
+    // pts without repeated points, nrm the unit normal of every segment
+    nsegs = closed ? npts : npts - 1;
+    if (closed) {
+        pushJoin(rs, pts, &(nrm[(nsegs-1)*2]), nrm, hw);
+    } else {
+        pushPoint(rs, pts[0] + hw * nrm[0], pts[1] + hw * nrm[1]);
+    }
+    for (i=1; i<nsegs; i++)
+        pushJoin(rs, &(pts[i*2]), &(nrm[(i-1)*2]), &(nrm[i*2]), hw);
+    if (!closed) {
+        pushPoint(rs, pts[nsegs*2] + hw * nrm[(nsegs-1)*2],
+                  pts[nsegs*2+1] + hw * nrm[(nsegs-1)*2+1]);
+    }
+}
+
+static void reversePoints(double *pts, int npts)
+{
+    double t;
+    int i, j;
+
+    for (i=0, j=npts-1; i<j; i++, j--) {
+        t = pts[i*2]; pts[i*2] = pts[j*2]; pts[j*2] = t;
+        t = pts[i*2+1]; pts[i*2+1] = pts[j*2+1]; pts[j*2+1] = t;
+    }
+}
+
+static void addStroke(RScratch *rs, double *pts, int npts, int closed,
+                      double width)
+{
+    double *nrm, dx, dy, len;
+    int i, j, n, nsegs, nleft;
+
+    // drop the repeated points, and the last one if closing
+    n = 0;
+    for (i=0; i<npts; i++) {
+        if (n > 0 && pts[i*2] == pts[n*2-2] && pts[i*2+1] == pts[n*2-1])
+            continue;
+        pts[n*2] = pts[i*2];
+        pts[n*2+1] = pts[i*2+1];
+        n++;
+    }
+    if (closed && n > 1 && pts[0] == pts[n*2-2] && pts[1] == pts[n*2-1]) n--;
+    if (n < 2) return;
+    if (n == 2) closed = 0;
+
+    nsegs = closed ? n : n - 1;
+    nrm = growArray(rs->nrm, &(rs->maxnrm), nsegs * 2, sizeof(double),
+                    &(rs->nomem));
+    if (nrm == NULL) return;
+    rs->nrm = nrm;
+    for (i=0; i<nsegs; i++) {
+        j = (i + 1) % n;
+        dx = pts[j*2] - pts[i*2];
+        dy = pts[j*2+1] - pts[i*2+1];
+        len = sqrt(dx * dx + dy * dy);
+        nrm[i*2] = -dy / len;
+        nrm[i*2+1] = dx / len;
+    }
+
+    // a closed one is two rings, an open one only one with the caps
+    rs->nopts = 0;
+    pushSide(rs, pts, nrm, n, closed, width / 2);
+    if (closed) {
+        addRing(rs, rs->opts, rs->nopts);
+        rs->nopts = 0;
+    }
+    nleft = rs->nopts;
+    pushSide(rs, pts, nrm, n, closed, -width / 2);
+    reversePoints(&(rs->opts[nleft*2]), rs->nopts - nleft);
+    addRing(rs, rs->opts, rs->nopts);
+}
+
+/* cells, every crossing calculated from the edge, see above */
+
+static void pushCell(RScratch *rs, int x, int y, int cover, int area)
+{
+    RCell *c, *newc;
+
+    if (rs->ncells > 0) {
+        c = &(rs->cells[rs->ncells-1]);
+        if (c->x == x && c->y == y) {
+            c->cover += cover;
+            c->area += area;
+            return;
+        }
+    }
+
+    newc = growArray(rs->cells, &(rs->maxcells), rs->ncells + 1,
+                     sizeof(RCell), &(rs->nomem));
+    if (newc == NULL) return;
+    rs->cells = newc;
+
+    if (y < rs->ymin) rs->ymin = y;
+    if (y > rs->ymax) rs->ymax = y;
+    c = &(rs->cells[rs->ncells++]);
+    c->x = x;
+    c->y = y;
+    c->cover = cover;
+    c->area = area;
+}
+
+static void rowPiece(RScratch *rs, const RClip *cl, int ey, int xl, int yl,
+                     int xr, int yr, int dir)
+{
+    int exl, exr, ex, xp, yp, xn, yn, cx, d;
+
+    // xl <= xr, dir is the sign of the edge dy
+    exl = xl >> RSUBPIX_SHIFT;
+    exr = xr >> RSUBPIX_SHIFT;
+    if (exl >= cl->x1) return; // no pixel at its right
+    if (exr < cl->x0) {
+        pushCell(rs, cl->x0 - 1, ey, dir * abs(yr - yl), 0);
+        return;
+    }
+    if (exl == exr) {
+        d = dir * abs(yr - yl);
+        cx = exl << RSUBPIX_SHIFT;
+        pushCell(rs, exl, ey, d, d * ((xl - cx) + (xr - cx)));
+        return;
+    }
+
+    ex = exl;
+    xp = xl;
+    yp = yl;
+    if (exl < cl->x0) {
+        // the cover at the left of the clip box in only one cell
+        xn = cl->x0 << RSUBPIX_SHIFT;
+        yn = yl + (long long)(xn - xl) * (yr - yl) / (xr - xl);
+        pushCell(rs, cl->x0 - 1, ey, dir * abs(yn - yl), 0);
+        ex = cl->x0;
+        xp = xn;
+        yp = yn;
+    }
+    for (; ex<=exr && ex<cl->x1; ex++) {
+        if (ex == exr) {
+            xn = xr;
+            yn = yr;
+        } else {
+            xn = (ex + 1) << RSUBPIX_SHIFT;
+            yn = yl + (long long)(xn - xl) * (yr - yl) / (xr - xl);
+        }
+        d = dir * abs(yn - yp);
+        cx = ex << RSUBPIX_SHIFT;
+        pushCell(rs, ex, ey, d, d * ((xp - cx) + (xn - cx)));
+        xp = xn;
+        yp = yn;
+    }
+}
+
+static void edgeCells(RScratch *rs, const RClip *cl, const REdge *e)
+{
+    int xt, yt, xb, yb, ey, ey0, ey1, ya, yz, xa, xz, dir;
+
+    // all at the right of the clip box, no cells
+    if (((e->x1 < e->x2) ? e->x1 : e->x2) >> RSUBPIX_SHIFT >= cl->x1) return;
+
+    if (e->y1 < e->y2) {
+        xt = e->x1; yt = e->y1;
+        xb = e->x2; yb = e->y2;
+        dir = 1;
+    } else {
+        xt = e->x2; yt = e->y2;
+        xb = e->x1; yb = e->y1;
+        dir = -1;
+    }
+
+    ey0 = yt >> RSUBPIX_SHIFT;
+    ey1 = (yb - 1) >> RSUBPIX_SHIFT;
+    if (ey0 < cl->y0) ey0 = cl->y0;
+    if (ey1 >= cl->y1) ey1 = cl->y1 - 1;
+
+    for (ey=ey0; ey<=ey1; ey++) {
+        ya = ey << RSUBPIX_SHIFT;
+        if (ya < yt) ya = yt;
+        yz = (ey + 1) << RSUBPIX_SHIFT;
+        if (yz > yb) yz = yb;
+        if (xt == xb) {
+            xa = xz = xt;
+        } else {
+            xa = xt + (long long)(ya - yt) * (xb - xt) / (yb - yt);
+            xz = xt + (long long)(yz - yt) * (xb - xt) / (yb - yt);
+        }
+        if (xa <= xz)
+            rowPiece(rs, cl, ey, xa, ya, xz, yz, dir);
+        else
+            rowPiece(rs, cl, ey, xz, yz, xa, ya, dir);
+    }
+}
+
+static int cmpCellX(const void *a, const void *b)
+{
+    return ((const RCell *)a)->x - ((const RCell *)b)->x;
+}
+
+static int sortCells(RScratch *rs)
+{
+    RCell *newc, c;
+    int *newr, nrows, i, j, k, r, n;
+
+    nrows = rs->ymax - rs->ymin + 1;
+    newc = growArray(rs->sorted, &(rs->maxsorted), rs->ncells,
+                     sizeof(RCell), &(rs->nomem));
+    if (newc == NULL) return 0;
+    rs->sorted = newc;
+    newr = growArray(rs->rowstart, &(rs->maxrows), nrows + 1,
+                     sizeof(int), &(rs->nomem));
+    if (newr == NULL) return 0;
+    rs->rowstart = newr;
+
+    // counting sort by row, and by column in every row
+    for (r=0; r<=nrows; r++)
+        rs->rowstart[r] = 0;
+    for (i=0; i<rs->ncells; i++)
+        rs->rowstart[rs->cells[i].y - rs->ymin + 1]++;
+    for (r=1; r<=nrows; r++)
+        rs->rowstart[r] += rs->rowstart[r-1];
+    for (i=0; i<rs->ncells; i++) {
+        r = rs->cells[i].y - rs->ymin;
+        rs->sorted[rs->rowstart[r]++] = rs->cells[i];
+    }
+    for (r=nrows; r>0; r--)
+        rs->rowstart[r] = rs->rowstart[r-1];
+    rs->rowstart[0] = 0;
+
+    for (r=0; r<nrows; r++) {
+        i = rs->rowstart[r];
+        n = rs->rowstart[r+1] - i;
+        if (n > 16) {
+            qsort(&(rs->sorted[i]), n, sizeof(RCell), cmpCellX);
+        } else {
+            for (j=i+1; j<i+n; j++) {
+                c = rs->sorted[j];
+                for (k=j; k>i && rs->sorted[k-1].x>c.x; k--)
+                    rs->sorted[k] = rs->sorted[k-1];
+                rs->sorted[k] = c;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* paint */
+
+#define DIV255(v) (((v) + 128 + (((v) + 128) >> 8)) >> 8)
+
+static uint32_t lerpColor(rgbcolor c1, rgbcolor c2, double f, int alpha)
+{
+    int r, g, b;
+
+    r = ((c1 >> 16) & 0xff) + (((c2 >> 16) & 0xff) - ((c1 >> 16) & 0xff)) * f + 0.5;
+    g = ((c1 >> 8) & 0xff) + (((c2 >> 8) & 0xff) - ((c1 >> 8) & 0xff)) * f + 0.5;
+    b = (c1 & 0xff) + ((c2 & 0xff) - (c1 & 0xff)) * f + 0.5;
+
+    return ((uint32_t)alpha << 24) | (r << 16) | (g << 8) | b;
+}
+
+static int opacityToAlpha(double opacity)
+{
+    if (opacity < 0) return 255; // not defined
+    if (opacity > 1) opacity = 1;
+
+    return opacity * 255 + 0.5;
+}
+
+static int setGradientLut(RPaint *p, const MsvgBGradientStops *st, double opacity)
+{
+    double t, f, op0, op1;
+    int i, k;
+
+    if (st->nstops < 1) return 0;
+
+    // k is the first stop at t or after it, pad before and after the stops
+    k = 0;
+    for (i=0; i<RLUT_SIZE; i++) {
+        t = (double)i / (RLUT_SIZE - 1);
+        while (k < st->nstops && st->offset[k] < t) k++;
+        if (k == 0 || k == st->nstops) {
+            op0 = st->sopacity[k ? k-1 : 0];
+            if (op0 < 0) op0 = 1;
+            p->lut[i] = lerpColor(st->scolor[k ? k-1 : 0], 0, 0,
+                                  opacityToAlpha(op0 * opacity));
+            continue;
+        }
+        f = (t - st->offset[k-1]) / (st->offset[k] - st->offset[k-1]);
+        op0 = (st->sopacity[k-1] < 0) ? 1 : st->sopacity[k-1];
+        op1 = (st->sopacity[k] < 0) ? 1 : st->sopacity[k];
+        p->lut[i] = lerpColor(st->scolor[k-1], st->scolor[k], f,
+                              opacityToAlpha((op0 + (op1 - op0) * f) * opacity));
+    }
+
+    return 1;
+}
+
+static int setPaint(RPaint *p, rgbcolor color, MsvgBPServer *bps, double opacity)
+{
+    double dx, dy, l2;
+
+    if (color == NO_COLOR || (color < 0 && color != IRI_COLOR)) return 0;
+
+    if (color != IRI_COLOR) {
+        p->type = RPAINT_SOLID;
+        p->color = color & 0xffffff;
+        p->alpha = opacityToAlpha(opacity);
+        return p->alpha > 0;
+    }
+
+    // a paint server not found is not painted
+    if (bps == NULL) return 0;
+    if (bps->type == BPSERVER_LINEARGRADIENT) {
+        p->type = RPAINT_LINEAR;
+        dx = bps->blg.x2 - bps->blg.x1;
+        dy = bps->blg.y2 - bps->blg.y1;
+        l2 = dx * dx + dy * dy;
+        if (l2 > 0) {
+            p->gx = dx / l2;
+            p->gy = dy / l2;
+            p->g0 = -(bps->blg.x1 * dx + bps->blg.y1 * dy) / l2;
+        } else {
+            // the last stop
+            p->gx = p->gy = 0;
+            p->g0 = 1;
+        }
+        return setGradientLut(p, &(bps->blg.stops), opacity);
+    } else if (bps->type == BPSERVER_RADIALGRADIENT) {
+        p->type = RPAINT_RADIAL;
+        p->cx = bps->brg.cx;
+        p->cy = bps->brg.cy;
+        p->rr = (bps->brg.r > 0) ? 1 / bps->brg.r : 0;
+        if (p->rr == 0) {
+            p->cx = p->cy = INT_MAX; // the last stop
+            p->rr = 1;
+        }
+        return setGradientLut(p, &(bps->brg.stops), opacity);
+    }
+
+    return 0;
+}
+
+static uint32_t paintColor(const RPaint *p, int x, int y)
+{
+    double px, py, t;
+    int i;
+
+    // at the pixel center, the same value for any span or clip box
+    px = x + 0.5;
+    py = y + 0.5;
+    if (p->type == RPAINT_LINEAR) {
+        t = p->gx * px + p->gy * py + p->g0;
+    } else {
+        px -= p->cx;
+        py -= p->cy;
+        t = sqrt(px * px + py * py) * p->rr;
+    }
+    if (t <= 0) return p->lut[0];
+    if (t >= 1) return p->lut[RLUT_SIZE-1];
+    i = t * (RLUT_SIZE - 1) + 0.5;
+
+    return p->lut[i];
+}
+
+static void blendPixel(uint32_t *d, uint32_t c, int a)
+{
+    uint32_t dc;
+    int da, ia, oa, t;
+
+    // straight alpha over
+    if (a <= 0) return;
+    if (a >= 255) {
+        *d = 0xff000000 | c;
+        return;
+    }
+    dc = *d;
+    da = dc >> 24;
+    ia = 255 - a;
+    if (da == 255) {
+        *d = 0xff000000 |
+             (DIV255(((c >> 16) & 0xff) * a + ((dc >> 16) & 0xff) * ia) << 16) |
+             (DIV255(((c >> 8) & 0xff) * a + ((dc >> 8) & 0xff) * ia) << 8) |
+             DIV255((c & 0xff) * a + (dc & 0xff) * ia);
+        return;
+    }
+    t = DIV255(da * ia);
+    oa = a + t;
+    *d = ((uint32_t)oa << 24) |
+         (((((c >> 16) & 0xff) * a + ((dc >> 16) & 0xff) * t + oa / 2) / oa) << 16) |
+         (((((c >> 8) & 0xff) * a + ((dc >> 8) & 0xff) * t + oa / 2) / oa) << 8) |
+         (((c & 0xff) * a + (dc & 0xff) * t + oa / 2) / oa);
+}
+
+static void paintSpan(const RBuffer *b, const RPaint *p, int x, int y, int n,
+                      int cov)
+{
+    uint32_t *d, c;
+    int i, a;
+
+    d = &(b->pixels[(long)y * b->stride + x]);
+    if (p->type == RPAINT_SOLID) {
+        a = DIV255(cov * p->alpha);
+        for (i=0; i<n; i++)
+            blendPixel(&(d[i]), p->color, a);
+    } else {
+        for (i=0; i<n; i++) {
+            c = paintColor(p, x + i, y);
+            blendPixel(&(d[i]), c & 0xffffff, DIV255(cov * (int)(c >> 24)));
+        }
+    }
+}
+
+static int coverage(int area, int evenodd)
+{
+    int cov;
+
+    cov = area >> (RSUBPIX_SHIFT * 2 + 1 - 8);
+    if (cov < 0) cov = -cov;
+    if (evenodd) {
+        cov &= 511;
+        if (cov > 256) cov = 512 - cov;
+    }
+    if (cov > 255) cov = 255;
+
+    return cov;
+}
+
+static void sweepRow(const RBuffer *b, const RPaint *p, const RClip *cl,
+                     int y, const RCell *c, int n, int evenodd)
+{
+    int i, x, nx, cover, area, cov;
+
+    cover = 0;
+    i = 0;
+    while (i < n) {
+        x = c[i].x;
+        area = 0;
+        while (i < n && c[i].x == x) {
+            cover += c[i].cover;
+            area += c[i].area;
+            i++;
+        }
+        if (x >= cl->x0) {
+            if (area != 0) {
+                cov = coverage((cover * RSUBPIX * 2) - area, evenodd);
+                if (cov > 0) paintSpan(b, p, x, y, 1, cov);
+                x++;
+            }
+        } else {
+            x = cl->x0;
+        }
+        nx = (i < n) ? c[i].x : cl->x1;
+        if (nx > cl->x1) nx = cl->x1;
+        if (nx > x && cover != 0) {
+            cov = coverage(cover * RSUBPIX * 2, evenodd);
+            if (cov > 0) paintSpan(b, p, x, y, nx - x, cov);
+        }
+    }
+}
+
+static void rasterEdges(RScratch *rs, const REdge *edges, int nedges,
+                        int fill_rule, const RPaint *p, const RBuffer *b,
+                        const RClip *cl)
+{
+    const REdge *e;
+    REdge left;
+    int i, r, nleft = 0;
+
+    rs->ncells = 0;
+    rs->ymin = INT_MAX;
+    rs->ymax = INT_MIN;
+    for (i=0; i<nedges; i++) {
+        e = &(edges[i]);
+        // the cover of a chain of edges at the left of the clip box only
+        // depends on its ends, it is only one edge
+        if (((e->x1 > e->x2) ? e->x1 : e->x2) >> RSUBPIX_SHIFT < cl->x0) {
+            if (nleft && left.y2 == e->y1) {
+                left.y2 = e->y2;
+                continue;
+            }
+            if (nleft && left.y1 != left.y2) edgeCells(rs, cl, &left);
+            left = *e;
+            nleft = 1;
+            continue;
+        }
+        if (nleft && left.y1 != left.y2) edgeCells(rs, cl, &left);
+        nleft = 0;
+        edgeCells(rs, cl, e);
+    }
+    if (nleft && left.y1 != left.y2) edgeCells(rs, cl, &left);
+    if (rs->ncells == 0 || rs->nomem) return;
+    if (!sortCells(rs)) return;
+
+    for (r=0; r<=rs->ymax-rs->ymin; r++) {
+        if (rs->rowstart[r+1] > rs->rowstart[r])
+            sweepRow(b, p, cl, rs->ymin + r, &(rs->sorted[rs->rowstart[r]]),
+                     rs->rowstart[r+1] - rs->rowstart[r],
+                     fill_rule == FILLRULE_EVENODD);
+    }
+}
+
+/* record of the primitives (the edges of a fill or a stroke with its paint)
+ * for the tiled render, with the pixels every one can paint */
+
+typedef struct {
+    int first, nedges;      /* in the recorded edges */
+    int fill_rule;
+    RPaint p;
+    int lut;                /* its gradient colors in the recorded ones, or -1 */
+    RClip bb;               /* pixels it can paint */
+    int band;               /* its edges by tile row, for the tiled render */
+} RPrim;
+
+typedef struct {
+    REdge *edges;
+    int nedges, maxedges;
+    RPrim *prims;
+    int nprims, maxprims;
+    uint32_t *luts;
+    int nluts, maxluts;
+    int nomem;
+} RRecord;
+
+static void freeRecord(RRecord *rec)
+{
+    free(rec->edges);
+    free(rec->prims);
+    free(rec->luts);
+}
+
+static int boundPix(double v, int max)
+{
+    if (v <= 0) return 0;
+    if (v >= max) return max;
+
+    return (int)v;
+}
+
+static void recordEdges(RRecord *rec, const RScratch *rs, int fill_rule,
+                        const RPaint *p)
+{
+    RPrim *pr, *newpr;
+    REdge *newe;
+    uint32_t *newl;
+
+    if (rs->nedges == 0) return;
+
+    newe = growArray(rec->edges, &(rec->maxedges), rec->nedges + rs->nedges,
+                     sizeof(REdge), &(rec->nomem));
+    if (newe == NULL) return;
+    rec->edges = newe;
+    newpr = growArray(rec->prims, &(rec->maxprims), rec->nprims + 1,
+                      sizeof(RPrim), &(rec->nomem));
+    if (newpr == NULL) return;
+    rec->prims = newpr;
+
+    pr = &(rec->prims[rec->nprims]);
+    pr->first = rec->nedges;
+    pr->nedges = rs->nedges;
+    pr->fill_rule = fill_rule;
+    pr->p = *p;
+    pr->lut = -1;
+
+    // a pixel more by side for the rounding to fixed point, the edges out of
+    // the right side have been dropped and their cover goes up to it
+    pr->bb.x0 = boundPix(floor(rs->bx0) - 1, rs->w);
+    pr->bb.y0 = boundPix(floor(rs->by0) - 1, rs->h);
+    pr->bb.x1 = boundPix(floor(rs->bx1) + 2, rs->w);
+    pr->bb.y1 = boundPix(floor(rs->by1) + 2, rs->h);
+    if (pr->bb.x0 >= pr->bb.x1 || pr->bb.y0 >= pr->bb.y1) return;
+
+    if (p->type != RPAINT_SOLID) {
+        newl = growArray(rec->luts, &(rec->maxluts), rec->nluts + RLUT_SIZE,
+                         sizeof(uint32_t), &(rec->nomem));
+        if (newl == NULL) return;
+        rec->luts = newl;
+        memcpy(&(rec->luts[rec->nluts]), p->lut, RLUT_SIZE * sizeof(uint32_t));
+        pr->lut = rec->nluts;
+        rec->nluts += RLUT_SIZE;
+    }
+    memcpy(&(rec->edges[rec->nedges]), rs->edges, rs->nedges * sizeof(REdge));
+    rec->nedges += rs->nedges;
+    rec->nprims++;
+}
+
+/* elements */
+
+typedef struct {
+    RScratch rs;
+    RBuffer b;
+    RClip cl;
+    RPaint fp, sp;
+    uint32_t flut[RLUT_SIZE], slut[RLUT_SIZE];
+    RRecord *rec;           /* to record the primitives instead of drawing them */
+} RenderData;
+
+static double *getPoints(RScratch *rs, int npts)
+{
+    double *newp;
+
+    newp = growArray(rs->pts, &(rs->maxpts), npts * 2, sizeof(double),
+                     &(rs->nomem));
+    if (newp == NULL) return NULL;
+    rs->pts = newp;
+
+    return rs->pts;
+}
+
+static double *copyPoints(RScratch *rs, const MsvgCoord *points, int npts)
+{
+    double *pts;
+    int i;
+
+    pts = getPoints(rs, npts);
+    if (pts == NULL) return NULL;
+    for (i=0; i<npts*2; i++)
+        pts[i] = points[i];
+
+    return pts;
+}
+
+static void flushEdges(RenderData *rd, int fill_rule, const RPaint *p)
+{
+    if (rd->rec)
+        recordEdges(rd->rec, &(rd->rs), fill_rule, p);
+    else
+        rasterEdges(&(rd->rs), rd->rs.edges, rd->rs.nedges, fill_rule, p,
+                    &(rd->b), &(rd->cl));
+    resetEdges(&(rd->rs));
+}
+
+static void renderPoly(RenderData *rd, MsvgElement *newel, int dofill,
+                       int dostroke, const MsvgCoord *points, int npts,
+                       int closed)
+{
+    double *pts;
+
+    pts = copyPoints(&(rd->rs), points, npts);
+    if (pts == NULL) return;
+    if (dofill) {
+        addRing(&(rd->rs), pts, npts);
+        flushEdges(rd, newel->pctx->fill_rule, &(rd->fp));
+    }
+    if (dostroke) {
+        addStroke(&(rd->rs), pts, npts, closed, newel->pctx->stroke_width);
+        flushEdges(rd, FILLRULE_NONZERO, &(rd->sp));
+    }
+}
+
+static void renderPath(RenderData *rd, MsvgElement *newel, int dofill,
+                       int dostroke)
+{
+    MsvgPackedPath *pp;
+    MsvgCoord *points;
+    double *pts;
+    int i, npts;
+
+    pp = MsvgGetPackedPath(newel);
+    if (pp == NULL) return;
+
+    // all the subpaths are filled together, the fill-rule applies to all
+    if (dofill) {
+        for (i=0; i<pp->nsubpaths; i++) {
+            points = MsvgI_FlattenSubPath(pp, i, RFLATTEN_PX_X_UNIT, &npts);
+            if (points == NULL) continue;
+            pts = copyPoints(&(rd->rs), points, npts);
+            if (pts) addRing(&(rd->rs), pts, npts);
+            free(points);
+        }
+        flushEdges(rd, newel->pctx->fill_rule, &(rd->fp));
+    }
+    if (dostroke) {
+        for (i=0; i<pp->nsubpaths; i++) {
+            points = MsvgI_FlattenSubPath(pp, i, RFLATTEN_PX_X_UNIT, &npts);
+            if (points == NULL) continue;
+            pts = copyPoints(&(rd->rs), points, npts);
+            if (pts) addStroke(&(rd->rs), pts, npts, pp->closed[i],
+                               newel->pctx->stroke_width);
+            free(points);
+        }
+        flushEdges(rd, FILLRULE_NONZERO, &(rd->sp));
+    }
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    RenderData *rd;
+    MsvgElement *newel;
+    MsvgPaintCtx *npctx;
+    MsvgCoord rp[8];
+    int dofill, dostroke;
+
+    rd = (RenderData *)udata;
+    newel = MsvgTransformCookedElement(el, pctx, MSVGTCE_CIR2PATH|MSVGTCE_ELL2PATH);
+    if (newel == NULL) return;
+
+    npctx = newel->pctx;
+    dofill = setPaint(&(rd->fp), npctx->fill, npctx->fill_bps,
+                      npctx->fill_opacity);
+    dostroke = npctx->stroke_width > 0 &&
+               setPaint(&(rd->sp), npctx->stroke, npctx->stroke_bps,
+                        npctx->stroke_opacity);
+
+    switch (newel->eid) {
+        case EID_RECT :
+            // not rotated, the rotated ones are polygons
+            rp[0] = rp[6] = newel->prectattr->x;
+            rp[1] = rp[3] = newel->prectattr->y;
+            rp[2] = rp[4] = newel->prectattr->x + newel->prectattr->width;
+            rp[5] = rp[7] = newel->prectattr->y + newel->prectattr->height;
+            renderPoly(rd, newel, dofill, dostroke, rp, 4, 1);
+            break;
+        case EID_LINE :
+            rp[0] = newel->plineattr->x1;
+            rp[1] = newel->plineattr->y1;
+            rp[2] = newel->plineattr->x2;
+            rp[3] = newel->plineattr->y2;
+            renderPoly(rd, newel, 0, dostroke, rp, 2, 0);
+            break;
+        case EID_POLYLINE :
+            renderPoly(rd, newel, dofill, dostroke,
+                       newel->ppolylineattr->points,
+                       newel->ppolylineattr->npoints, 0);
+            break;
+        case EID_POLYGON :
+            renderPoly(rd, newel, dofill, dostroke,
+                       newel->ppolygonattr->points,
+                       newel->ppolygonattr->npoints, 1);
+            break;
+        case EID_PATH :
+            renderPath(rd, newel, dofill, dostroke);
+            break;
+        default :
+            // text must be converted to paths before
+            break;
+    }
+
+    MsvgDeleteElement(newel);
+}
+
+static void fillBackground(const RBuffer *b, const RClip *cl, uint32_t c)
+{
+    int x, y;
+
+    for (y=cl->y0; y<cl->y1; y++)
+        for (x=cl->x0; x<cl->x1; x++)
+            b->pixels[(long)y * b->stride + x] = c;
+}
+
+static int bgColor(MsvgElement *root, const MsvgRenderMode *rm, uint32_t *c)
+{
+    if (root->psvgattr->vp_fill != NO_COLOR) {
+        *c = ((uint32_t)opacityToAlpha(root->psvgattr->vp_fill_opacity) << 24) |
+             (root->psvgattr->vp_fill & 0xffffff);
+        return 1;
+    } else if (rm->bg != NO_COLOR) {
+        *c = 0xff000000 | (rm->bg & 0xffffff);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int setView(MsvgElement *root, const MsvgRenderMode *rm,
+                   uint32_t *pixels, int w, int h, int stride, TMatrix *view)
+{
+    double ratiow, ratioh, rvb_width, rvb_height;
+    double scale_x, scale_y, xorg, yorg, cx, cy;
+    TMatrix taux1, taux2, taux3;
+
+    if (root == NULL) return -1;
+    if (root->eid != EID_SVG) return -2;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return -3;
+    if (pixels == NULL || w < 1 || h < 1 || stride < w) return -5;
+
+    rvb_width = root->psvgattr->vb_width;
+    rvb_height = root->psvgattr->vb_height;
+
+    // the device coordinates must fit in 24.8 fixed point
+    if ((rvb_width * rm->zoom) > (INT_MAX / RSUBPIX / 2) ||
+        (rvb_height * rm->zoom) > (INT_MAX / RSUBPIX / 2) ||
+        w > INT_MAX / RSUBPIX / 2 || h > INT_MAX / RSUBPIX / 2) return -4;
+
+    switch (rm->mode) {
+        case MSVGRENDER_FIT :
+            scale_x = rvb_width / w;
+            scale_y = rvb_height / h;
+            break;
+        case MSVGRENDER_PAR :
+            ratiow = w / rvb_width;
+            ratioh = h / rvb_height;
+            if (ratiow > ratioh) {
+                scale_x = rvb_height / h;
+                scale_y = rvb_height / h;
+            } else {
+                scale_x = rvb_width / w;
+                scale_y = rvb_width / w;
+            }
+            break;
+        case MSVGRENDER_SCOORD :
+            scale_x = 1;
+            scale_y = 1;
+            break;
+        default:
+            return -5;
+    }
+
+    if (rm->adj == MSVGRENDER_LEFT) {
+        xorg = 0;
+        yorg = 0;
+    } else if (rm->adj == MSVGRENDER_CENTER) {
+        xorg = (w - rvb_width * rm->zoom / scale_x) / 2;
+        yorg = (h - rvb_height * rm->zoom / scale_y) / 2;
+    } else if (rm->adj == MSVGRENDER_RIGHT) {
+        xorg = (w - rvb_width * rm->zoom / scale_x);
+        yorg = (h - rvb_height * rm->zoom / scale_y);
+    } else
+        return -5;
+
+    // the GD backend view, with the origin in the matrix
+    TMSetTranslation(&taux1, rm->xdespl + xorg, rm->ydespl + yorg);
+    TMSetScaling(&taux2, rm->zoom / scale_x, rm->zoom / scale_y);
+    TMMpy(&taux3, &taux1, &taux2);
+
+    cx = root->psvgattr->vb_width / 2;
+    cy = root->psvgattr->vb_height / 2;
+    TMSetRotation(&taux2, rm->rotang, cx, cy);
+    TMMpy(&taux1, &taux3, &taux2);
+
+    TMSetTranslation(&taux2, -root->psvgattr->vb_min_x, -root->psvgattr->vb_min_y);
+    TMMpy(view, &taux1, &taux2);
+
+    return 0;
+}
+
+static void initRenderData(RenderData *rd, uint32_t *pixels, int w, int h,
+                           int stride, RRecord *rec)
+{
+    initScratch(&(rd->rs), w, h);
+    rd->b.pixels = pixels;
+    rd->b.w = w;
+    rd->b.h = h;
+    rd->b.stride = stride;
+    rd->cl.x0 = 0;
+    rd->cl.y0 = 0;
+    rd->cl.x1 = w;
+    rd->cl.y1 = h;
+    rd->fp.lut = rd->flut;
+    rd->sp.lut = rd->slut;
+    rd->rec = rec;
+}
+
+int MsvgRenderToBuffer(MsvgElement *root, const MsvgRenderMode *rm,
+                       uint32_t *pixels, int w, int h, int stride)
+{
+    RenderData rd;
+    TMatrix view;
+    uint32_t bg;
+    int ret;
+
+    ret = setView(root, rm, pixels, w, h, stride, &view);
+    if (ret != 0) return ret;
+
+    initRenderData(&rd, pixels, w, h, stride, NULL);
+    if (bgColor(root, rm, &bg)) fillBackground(&(rd.b), &(rd.cl), bg);
+
+    ret = MsvgSerCookedTreeView(root, sufn, &rd, 1, NULL, &view);
+    freeScratch(&(rd.rs));
+    if (ret != 1) return -6;
+    if (rd.rs.nomem) return -7;
+
+    return 0;
+}
+
+/* tiled render, the recorded primitives are binned to the tiles they can
+ * paint, with their edges grouped by the tile rows they cross, and the tiles
+ * are rendered by a pool of workers, every one with its own scratch buffers,
+ * taking the next tile from a queue shared by all of them, a counter under a
+ * lock, the tiles are many and equal so they end at about the same time. The
+ * tiles don't share
+ * pixels and the rasterizer doesn't depend on the clip box, so the pixels are
+ * the same than rendering the whole buffer at once.
+ *
+ * The tiles are wide, every one gets the cover of the edges at its left in a
+ * cell by row, and low, to have many of them to share */
+
+#define RTILE_W 1024
+#define RTILE_H 32
+
+#ifdef MSVG_PTHREADS
+#define RLOCK(rt) pthread_mutex_lock(&((rt)->lock))
+#define RUNLOCK(rt) pthread_mutex_unlock(&((rt)->lock))
+#else
+#define RLOCK(rt)
+#define RUNLOCK(rt)
+#endif
+
+struct _RTiles;
+
+typedef struct {
+    struct _RTiles *rt;
+    RScratch rs;
+#ifdef MSVG_PTHREADS
+    pthread_t thread;
+    int started;
+#endif
+} RWorker;
+
+typedef struct _RTiles {
+    RRecord *rec;
+    RBuffer b;
+    int dobg;
+    uint32_t bg;
+    int ntx, ntiles;        /* tiles by row and total */
+    int *binstart;          /* first bin of every tile, and the end */
+    int *bins;              /* recorded primitives of every tile, in order */
+    int *bandstart;         /* first edge of every band, and the end */
+    REdge *bedges;          /* edges of every primitive by tile row */
+    RWorker *wk;
+    int nworkers;
+    int next;               /* next tile to render, the shared queue */
+#ifdef MSVG_PTHREADS
+    pthread_mutex_t lock;   /* of next */
+#endif
+} RTiles;
+
+static void edgeBands(const RPrim *pr, const REdge *e, int *ty0, int *ty1)
+{
+    int yt, yb;
+
+    // the tile rows of its pixel rows, inside the ones of the primitive
+    yt = (e->y1 < e->y2) ? e->y1 : e->y2;
+    yb = (e->y1 < e->y2) ? e->y2 : e->y1;
+    *ty0 = (yt >> RSUBPIX_SHIFT) / RTILE_H;
+    *ty1 = ((yb - 1) >> RSUBPIX_SHIFT) / RTILE_H;
+    if (*ty0 < pr->bb.y0 / RTILE_H) *ty0 = pr->bb.y0 / RTILE_H;
+    if (*ty1 > (pr->bb.y1 - 1) / RTILE_H) *ty1 = (pr->bb.y1 - 1) / RTILE_H;
+}
+
+static int binPrims(RTiles *rt)
+{
+    RPrim *pr;
+    long nbins;
+    int i, t, tx, ty;
+
+    rt->binstart = (int *)calloc(rt->ntiles + 1, sizeof(int));
+    if (rt->binstart == NULL) return 0;
+
+    // counting sort by tile, keeping the order of the primitives
+    for (i=0; i<rt->rec->nprims; i++) {
+        pr = &(rt->rec->prims[i]);
+        for (ty=pr->bb.y0/RTILE_H; ty<=(pr->bb.y1-1)/RTILE_H; ty++)
+            for (tx=pr->bb.x0/RTILE_W; tx<=(pr->bb.x1-1)/RTILE_W; tx++)
+                rt->binstart[ty*rt->ntx+tx+1]++;
+    }
+    nbins = 0;
+    for (t=1; t<=rt->ntiles; t++) {
+        nbins += rt->binstart[t];
+        if (nbins > INT_MAX) return 0;
+        rt->binstart[t] = nbins;
+    }
+
+    rt->bins = (int *)malloc((nbins > 0 ? nbins : 1) * sizeof(int));
+    if (rt->bins == NULL) return 0;
+    for (i=0; i<rt->rec->nprims; i++) {
+        pr = &(rt->rec->prims[i]);
+        for (ty=pr->bb.y0/RTILE_H; ty<=(pr->bb.y1-1)/RTILE_H; ty++)
+            for (tx=pr->bb.x0/RTILE_W; tx<=(pr->bb.x1-1)/RTILE_W; tx++)
+                rt->bins[rt->binstart[ty*rt->ntx+tx]++] = i;
+    }
+    for (t=rt->ntiles; t>0; t--)
+        rt->binstart[t] = rt->binstart[t-1];
+    rt->binstart[0] = 0;
+
+    return 1;
+}
+
+static int bandEdges(RTiles *rt)
+{
+    RPrim *pr;
+    REdge *e;
+    long nbands, nedges;
+    int i, j, k, ty0, ty1, ty;
+
+    // a band for every tile row of every primitive, an edge in every band
+    // it crosses
+    nbands = 0;
+    for (i=0; i<rt->rec->nprims; i++) {
+        pr = &(rt->rec->prims[i]);
+        pr->band = nbands;
+        nbands += (pr->bb.y1 - 1) / RTILE_H - pr->bb.y0 / RTILE_H + 1;
+        if (nbands > INT_MAX) return 0;
+    }
+    rt->bandstart = (int *)calloc(nbands + 1, sizeof(int));
+    if (rt->bandstart == NULL) return 0;
+
+    for (i=0; i<rt->rec->nprims; i++) {
+        pr = &(rt->rec->prims[i]);
+        for (j=0; j<pr->nedges; j++) {
+            e = &(rt->rec->edges[pr->first+j]);
+            edgeBands(pr, e, &ty0, &ty1);
+            for (ty=ty0; ty<=ty1; ty++)
+                rt->bandstart[pr->band+ty-pr->bb.y0/RTILE_H+1]++;
+        }
+    }
+    nedges = 0;
+    for (k=1; k<=nbands; k++) {
+        nedges += rt->bandstart[k];
+        if (nedges > INT_MAX) return 0;
+        rt->bandstart[k] = nedges;
+    }
+
+    rt->bedges = (REdge *)malloc((nedges > 0 ? nedges : 1) * sizeof(REdge));
+    if (rt->bedges == NULL) return 0;
+    for (i=0; i<rt->rec->nprims; i++) {
+        pr = &(rt->rec->prims[i]);
+        for (j=0; j<pr->nedges; j++) {
+            e = &(rt->rec->edges[pr->first+j]);
+            edgeBands(pr, e, &ty0, &ty1);
+            for (ty=ty0; ty<=ty1; ty++)
+                rt->bedges[rt->bandstart[pr->band+ty-pr->bb.y0/RTILE_H]++] = *e;
+        }
+    }
+    for (k=nbands; k>0; k--)
+        rt->bandstart[k] = rt->bandstart[k-1];
+    rt->bandstart[0] = 0;
+
+    return 1;
+}
+
+static void renderTile(RWorker *wk, int t)
+{
+    RTiles *rt;
+    RPrim *pr;
+    RClip cl;
+    int i, k;
+
+    rt = wk->rt;
+    cl.x0 = (t % rt->ntx) * RTILE_W;
+    cl.y0 = (t / rt->ntx) * RTILE_H;
+    cl.x1 = (cl.x0 + RTILE_W < rt->b.w) ? cl.x0 + RTILE_W : rt->b.w;
+    cl.y1 = (cl.y0 + RTILE_H < rt->b.h) ? cl.y0 + RTILE_H : rt->b.h;
+
+    if (rt->dobg) fillBackground(&(rt->b), &cl, rt->bg);
+    for (i=rt->binstart[t]; i<rt->binstart[t+1]; i++) {
+        pr = &(rt->rec->prims[rt->bins[i]]);
+        k = pr->band + cl.y0 / RTILE_H - pr->bb.y0 / RTILE_H;
+        rasterEdges(&(wk->rs), &(rt->bedges[rt->bandstart[k]]),
+                    rt->bandstart[k+1] - rt->bandstart[k], pr->fill_rule,
+                    &(pr->p), &(rt->b), &cl);
+    }
+}
+
+static int nextTile(RTiles *rt)
+{
+    int t = -1;
+
+    RLOCK(rt);
+    if (rt->next < rt->ntiles) t = (rt->next)++;
+    RUNLOCK(rt);
+
+    return t;
+}
+
+static void *runWorker(void *arg)
+{
+    RWorker *wk;
+    int t;
+
+    wk = (RWorker *)arg;
+    while ((t = nextTile(wk->rt)) >= 0)
+        renderTile(wk, t);
+
+    return NULL;
+}
+
+static int runTiles(RTiles *rt, int nworkers)
+{
+    RWorker *wk;
+    int i, nomem = 0;
+
+    rt->wk = (RWorker *)calloc(nworkers, sizeof(RWorker));
+    if (rt->wk == NULL) return 0;
+    rt->nworkers = nworkers;
+    rt->next = 0;
+    for (i=0; i<nworkers; i++) {
+        wk = &(rt->wk[i]);
+        wk->rt = rt;
+        initScratch(&(wk->rs), rt->b.w, rt->b.h);
+    }
+
+#ifdef MSVG_PTHREADS
+    pthread_mutex_init(&(rt->lock), NULL);
+    // the caller is the first worker, a worker not started takes no tiles
+    for (i=1; i<nworkers; i++)
+        rt->wk[i].started = (pthread_create(&(rt->wk[i].thread), NULL,
+                             runWorker, &(rt->wk[i])) == 0);
+#endif
+    runWorker(&(rt->wk[0]));
+#ifdef MSVG_PTHREADS
+    for (i=1; i<nworkers; i++)
+        if (rt->wk[i].started) pthread_join(rt->wk[i].thread, NULL);
+    pthread_mutex_destroy(&(rt->lock));
+#endif
+
+    for (i=0; i<nworkers; i++) {
+        if (rt->wk[i].rs.nomem) nomem = 1;
+        freeScratch(&(rt->wk[i].rs));
+    }
+    free(rt->wk);
+
+    return !nomem;
+}
+
+int MsvgRenderToBufferTiled(MsvgElement *root, const MsvgRenderMode *rm,
+                            uint32_t *pixels, int w, int h, int stride,
+                            int nthreads)
+{
+    RenderData rd;
+    RRecord rec;
+    RTiles rt;
+    TMatrix view;
+    int i, ret;
+
+    ret = setView(root, rm, pixels, w, h, stride, &view);
+    if (ret != 0) return ret;
+    if (nthreads < 1) return -5;
+#ifndef MSVG_PTHREADS
+    nthreads = 1;
+#endif
+
+    // record the primitives, clipped to the whole buffer
+    memset(&rec, 0, sizeof(RRecord));
+    initRenderData(&rd, pixels, w, h, stride, &rec);
+    ret = MsvgSerCookedTreeView(root, sufn, &rd, 1, NULL, &view);
+    freeScratch(&(rd.rs));
+    if (ret != 1) {
+        freeRecord(&rec);
+        return -6;
+    }
+    if (rd.rs.nomem || rec.nomem) {
+        freeRecord(&rec);
+        return -7;
+    }
+    for (i=0; i<rec.nprims; i++)
+        if (rec.prims[i].lut >= 0)
+            rec.prims[i].p.lut = &(rec.luts[rec.prims[i].lut]);
+
+    memset(&rt, 0, sizeof(RTiles));
+    rt.rec = &rec;
+    rt.b = rd.b;
+    rt.dobg = bgColor(root, rm, &(rt.bg));
+    rt.ntx = (w + RTILE_W - 1) / RTILE_W;
+    rt.ntiles = rt.ntx * ((h + RTILE_H - 1) / RTILE_H);
+    ret = binPrims(&rt) && bandEdges(&rt) && runTiles(&rt, nthreads);
+
+    free(rt.binstart);
+    free(rt.bins);
+    free(rt.bandstart);
+    free(rt.bedges);
+    freeRecord(&rec);
+
+    return ret ? 0 : -7;
+}
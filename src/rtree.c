@@ -0,0 +1,728 @@
+/* rtree.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msvg.h"
+#include "util.h"
+
+/* R-tree of the world bounding boxes of the drawable and EID_USE elements
+ * of a cooked tree, bulk loaded using the Sort-Tile-Recursive algorithm
+ * and updated by the element manipulation functions */
+
+#define RTREE_MAXENTRIES 16
+#define RTHEAP_LOCALITEMS 256
+
+typedef struct _RTNode {
+    int leaf;                       // 1 = entries are elements
+    int nentries;                   // num of entries
+    struct _RTNode *parent;         // NULL for the root node
+    MsvgBox box[RTREE_MAXENTRIES];  // entry boxes
+    void *ptr[RTREE_MAXENTRIES];    // son nodes or elements
+} RTNode;
+
+typedef struct {
+    MsvgBox box;
+    void *ptr;
+} RTEntry;
+
+typedef struct {
+    double dist;                    // min distance to the point
+    int isel;                       // 1 = ptr is an element
+    void *ptr;
+} RTHeapItem;
+
+/* the nearest query heap is in the caller stack, allocated only if it
+   grows, so concurrent queries don't share anything */
+
+typedef struct {
+    int nitems;
+    int maxitems;
+    RTHeapItem *item;               // local or allocated
+    RTHeapItem local[RTHEAP_LOCALITEMS];
+} RTHeap;
+
+struct _MsvgRTree {
+    RTNode *root;           // root node
+    int nelems;             // num of elements indexed
+    int nuses;              // num of EID_USE elements indexed
+};
+
+static int isEmptyBox(const MsvgBox *box)
+{
+    return box->gminx > box->gmaxx;
+}
+
+static int intersectBox(const MsvgBox *b1, const MsvgBox *b2)
+{
+    if (b1->gmaxx < b2->gminx || b1->gminx > b2->gmaxx) return 0;
+    if (b1->gmaxy < b2->gminy || b1->gminy > b2->gmaxy) return 0;
+    return 1;
+}
+
+static void unionBox(MsvgBox *des, const MsvgBox *box)
+{
+    if (box->gminx < des->gminx) des->gminx = box->gminx;
+    if (box->gmaxx > des->gmaxx) des->gmaxx = box->gmaxx;
+    if (box->gminy < des->gminy) des->gminy = box->gminy;
+    if (box->gmaxy > des->gmaxy) des->gmaxy = box->gmaxy;
+}
+
+static double areaBox(const MsvgBox *box)
+{
+    return (box->gmaxx - box->gminx) * (box->gmaxy - box->gminy);
+}
+
+static double distBox(const MsvgBox *box, double x, double y)
+{
+    double dx = 0, dy = 0;
+
+    if (x < box->gminx) dx = box->gminx - x;
+    else if (x > box->gmaxx) dx = x - box->gmaxx;
+    if (y < box->gminy) dy = box->gminy - y;
+    else if (y > box->gmaxy) dy = y - box->gmaxy;
+
+    return sqrt(dx*dx + dy*dy);
+}
+
+static void nodeBox(const RTNode *node, MsvgBox *box)
+{
+    int i;
+
+    *box = node->box[0];
+    for (i=1; i<node->nentries; i++)
+        unionBox(box, &(node->box[i]));
+}
+
+static RTNode *newNode(int leaf)
+{
+    RTNode *node;
+
+    node = calloc(1, sizeof(RTNode));
+    if (node == NULL) return NULL;
+    node->leaf = leaf;
+
+    return node;
+}
+
+static void destroyNode(RTNode *node)
+{
+    int i;
+
+    if (!node->leaf) {
+        for (i=0; i<node->nentries; i++)
+            destroyNode((RTNode *)node->ptr[i]);
+    }
+    free(node);
+}
+
+static int nodeIndex(const RTNode *node)
+{
+    int i;
+
+    for (i=0; i<node->parent->nentries; i++)
+        if (node->parent->ptr[i] == node) return i;
+
+    return -1;
+}
+
+static void adjustBoxes(RTNode *node)
+{
+    int i;
+
+    while (node->parent) {
+        i = nodeIndex(node);
+        nodeBox(node, &(node->parent->box[i]));
+        node = node->parent;
+    }
+}
+
+static void addEntry(RTNode *node, const MsvgBox *box, void *ptr)
+{
+    node->box[node->nentries] = *box;
+    node->ptr[node->nentries] = ptr;
+    if (!node->leaf) ((RTNode *)ptr)->parent = node;
+    node->nentries++;
+}
+
+/* bulk loading, Sort-Tile-Recursive */
+
+static int cmpEntryX(const void *a, const void *b)
+{
+    const RTEntry *e1 = a, *e2 = b;
+    double c1 = e1->box.gminx + e1->box.gmaxx;
+    double c2 = e2->box.gminx + e2->box.gmaxx;
+
+    return (c1 < c2) ? -1 : (c1 > c2) ? 1 : 0;
+}
+
+static int cmpEntryY(const void *a, const void *b)
+{
+    const RTEntry *e1 = a, *e2 = b;
+    double c1 = e1->box.gminy + e1->box.gmaxy;
+    double c2 = e2->box.gminy + e2->box.gmaxy;
+
+    return (c1 < c2) ? -1 : (c1 > c2) ? 1 : 0;
+}
+
+static void destroyEntries(RTEntry *entry, int first, int last)
+{
+    int i;
+
+    for (i=first; i<last; i++)
+        destroyNode((RTNode *)entry[i].ptr);
+}
+
+static RTNode *bulkLoad(RTEntry *entry, int nentries, int leaf)
+{
+    RTNode *node;
+    int nnodes, nslices, slicesize, i, j, k, n;
+
+    while (1) {
+        if (nentries <= RTREE_MAXENTRIES) {
+            node = newNode(leaf);
+            if (node == NULL) return NULL;
+            for (i=0; i<nentries; i++)
+                addEntry(node, &(entry[i].box), entry[i].ptr);
+            return node;
+        }
+
+        nnodes = (nentries + RTREE_MAXENTRIES - 1) / RTREE_MAXENTRIES;
+        nslices = ceil(sqrt(nnodes));
+        slicesize = nslices * RTREE_MAXENTRIES;
+
+        qsort(entry, nentries, sizeof(RTEntry), cmpEntryX);
+        for (i=0; i<nentries; i+=slicesize) {
+            n = (nentries - i < slicesize) ? nentries - i : slicesize;
+            qsort(&(entry[i]), n, sizeof(RTEntry), cmpEntryY);
+        }
+
+        // pack the nodes, the entries array is reused for the next level,
+        // the new nodes are stored before the entries not packed yet
+        k = 0;
+        for (i=0; i<nentries; i+=slicesize) {
+            n = (nentries - i < slicesize) ? nentries - i : slicesize;
+            for (j=0; j<n; j+=RTREE_MAXENTRIES) {
+                node = newNode(leaf);
+                if (node == NULL) {
+                    // free this level and the lower levels not packed
+                    destroyEntries(entry, 0, k);
+                    if (!leaf) destroyEntries(entry, i + j, nentries);
+                    return NULL;
+                }
+                while (node->nentries < RTREE_MAXENTRIES && j+node->nentries < n)
+                    addEntry(node, &(entry[i+j+node->nentries].box),
+                             entry[i+j+node->nentries].ptr);
+                nodeBox(node, &(entry[k].box));
+                entry[k].ptr = node;
+                k++;
+            }
+        }
+
+        nentries = k;
+        leaf = 0;
+    }
+}
+
+static int isIndexed(MsvgElement *el)
+{
+    switch (el->eid) {
+        case EID_USE :
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            return el->wbbox_ok && !isEmptyBox(&(el->wbbox));
+        default :
+            return 0;
+    }
+}
+
+static int collectEntries(MsvgElement *el, RTEntry *entry, int nentries,
+                          int *nuses)
+{
+    MsvgElement *pel;
+
+    pel = el->fson;
+    while (pel) {
+        if (pel->eid == EID_G) {
+            nentries = collectEntries(pel, entry, nentries, nuses);
+        } else if (isIndexed(pel)) {
+            if (entry) {
+                entry[nentries].box = pel->wbbox;
+                entry[nentries].ptr = pel;
+            }
+            if (pel->eid == EID_USE) *nuses += 1;
+            nentries++;
+        }
+        pel = pel->nsibling;
+    }
+
+    return nentries;
+}
+
+/* dynamic insertion */
+
+static RTNode *chooseLeaf(RTNode *node, const MsvgBox *box)
+{
+    MsvgBox aux;
+    double enl, area, bestenl, bestarea;
+    int i, best;
+
+    while (!node->leaf) {
+        best = 0;
+        bestenl = bestarea = 0;
+        for (i=0; i<node->nentries; i++) {
+            aux = node->box[i];
+            area = areaBox(&aux);
+            unionBox(&aux, box);
+            enl = areaBox(&aux) - area;
+            if (i == 0 || enl < bestenl || (enl == bestenl && area < bestarea)) {
+                best = i;
+                bestenl = enl;
+                bestarea = area;
+            }
+        }
+        node = (RTNode *)node->ptr[best];
+    }
+
+    return node;
+}
+
+/* the nodes the splits need, one per full node in the path to the root and
+ * a new root if it is full too, are allocated before inserting, so a failed
+ * insertion leaves the tree as it was. They are chained by parent */
+
+static RTNode *spareNodes(RTNode *leaf)
+{
+    RTNode *node, *spare = NULL, *aux;
+
+    node = leaf;
+    while (1) {
+        if (node != NULL && node->nentries < RTREE_MAXENTRIES) break;
+        aux = newNode(0);
+        if (aux == NULL) {
+            while (spare) {
+                aux = spare->parent;
+                free(spare);
+                spare = aux;
+            }
+            return NULL;
+        }
+        aux->parent = spare;
+        spare = aux;
+        if (node == NULL) break;
+        node = node->parent;
+    }
+
+    return spare;
+}
+
+static RTNode *takeSpare(RTNode **spare, int leaf)
+{
+    RTNode *node;
+
+    node = *spare;
+    *spare = node->parent;
+    node->parent = NULL;
+    node->leaf = leaf;
+
+    return node;
+}
+
+static void insertInNode(MsvgRTree *rt, RTNode *node, const MsvgBox *box,
+                         void *ptr, RTNode **spare)
+{
+    RTEntry entry[RTREE_MAXENTRIES+1];
+    RTNode *newnode, *newroot;
+    MsvgBox b1, b2;
+    double minx, maxx, miny, maxy, c;
+    int i, n;
+
+    if (node->nentries < RTREE_MAXENTRIES) {
+        addEntry(node, box, ptr);
+        adjustBoxes(node);
+        return;
+    }
+
+    // split the node in two halves along the axis with more spread
+    newnode = takeSpare(spare, node->leaf);
+
+    n = node->nentries;
+    for (i=0; i<n; i++) {
+        entry[i].box = node->box[i];
+        entry[i].ptr = node->ptr[i];
+    }
+    entry[n].box = *box;
+    entry[n].ptr = ptr;
+    n++;
+
+    minx = miny = 1e300;
+    maxx = maxy = -1e300;
+    for (i=0; i<n; i++) {
+        c = entry[i].box.gminx + entry[i].box.gmaxx;
+        if (c < minx) minx = c;
+        if (c > maxx) maxx = c;
+        c = entry[i].box.gminy + entry[i].box.gmaxy;
+        if (c < miny) miny = c;
+        if (c > maxy) maxy = c;
+    }
+    qsort(entry, n, sizeof(RTEntry), (maxx-minx >= maxy-miny) ? cmpEntryX : cmpEntryY);
+
+    node->nentries = 0;
+    for (i=0; i<n/2; i++)
+        addEntry(node, &(entry[i].box), entry[i].ptr);
+    for (i=n/2; i<n; i++)
+        addEntry(newnode, &(entry[i].box), entry[i].ptr);
+
+    nodeBox(node, &b1);
+    nodeBox(newnode, &b2);
+
+    if (node->parent == NULL) {
+        newroot = takeSpare(spare, 0);
+        addEntry(newroot, &b1, node);
+        addEntry(newroot, &b2, newnode);
+        rt->root = newroot;
+        return;
+    }
+
+    node->parent->box[nodeIndex(node)] = b1;
+    insertInNode(rt, node->parent, &b2, newnode, spare);
+}
+
+static int insertElement(MsvgRTree *rt, MsvgElement *el)
+{
+    RTNode *leaf, *spare = NULL;
+
+    leaf = chooseLeaf(rt->root, &(el->wbbox));
+    if (leaf->nentries >= RTREE_MAXENTRIES) {
+        spare = spareNodes(leaf);
+        if (spare == NULL) return 0;
+    }
+    insertInNode(rt, leaf, &(el->wbbox), el, &spare);
+    rt->nelems++;
+    if (el->eid == EID_USE) rt->nuses++;
+
+    return 1;
+}
+
+/* deletion */
+
+static RTNode *findLeaf(RTNode *node, MsvgElement *el, const MsvgBox *box, int *idx)
+{
+    RTNode *found;
+    int i;
+
+    for (i=0; i<node->nentries; i++) {
+        if (box && !intersectBox(&(node->box[i]), box)) continue;
+        if (node->leaf) {
+            if (node->ptr[i] == el) {
+                *idx = i;
+                return node;
+            }
+        } else {
+            found = findLeaf((RTNode *)node->ptr[i], el, box, idx);
+            if (found) return found;
+        }
+    }
+
+    return NULL;
+}
+
+static int deleteElement(MsvgRTree *rt, MsvgElement *el)
+{
+    RTNode *node, *parent;
+    int i;
+
+    node = findLeaf(rt->root, el, &(el->wbbox), &i);
+    // the box can be outdated, do a full search
+    if (node == NULL) node = findLeaf(rt->root, el, NULL, &i);
+    if (node == NULL) return 0;
+
+    // remove the entry, the nodes are not rebalanced, only the empty
+    // nodes are removed
+    while (1) {
+        node->nentries--;
+        node->box[i] = node->box[node->nentries];
+        node->ptr[i] = node->ptr[node->nentries];
+        if (node->nentries > 0 || node->parent == NULL) break;
+        parent = node->parent;
+        i = nodeIndex(node);
+        free(node);
+        node = parent;
+    }
+    if (node->nentries > 0) adjustBoxes(node);
+
+    // remove the root nodes with only one son
+    while (!rt->root->leaf && rt->root->nentries == 1) {
+        node = (RTNode *)rt->root->ptr[0];
+        free(rt->root);
+        node->parent = NULL;
+        rt->root = node;
+    }
+    if (!rt->root->leaf && rt->root->nentries == 0) {
+        rt->root->leaf = 1;
+    }
+
+    rt->nelems--;
+    if (el->eid == EID_USE) rt->nuses--;
+
+    return 1;
+}
+
+/* searching */
+
+static int searchNode(RTNode *node, const MsvgBox *box,
+                      MsvgRTreeUserFn rtufn, void *udata)
+{
+    int i, n = 0;
+
+    for (i=0; i<node->nentries; i++) {
+        if (!intersectBox(&(node->box[i]), box)) continue;
+        if (node->leaf) {
+            if (rtufn) rtufn((MsvgElement *)node->ptr[i], udata);
+            n++;
+        } else {
+            n += searchNode((RTNode *)node->ptr[i], box, rtufn, udata);
+        }
+    }
+
+    return n;
+}
+
+static int heapPush(RTHeap *h, double dist, int isel, void *ptr)
+{
+    RTHeapItem *p, aux;
+    int i, j;
+
+    if (h->nitems >= h->maxitems) {
+        i = h->maxitems * 2;
+        if (h->item == h->local) {
+            p = malloc(i * sizeof(RTHeapItem));
+            if (p) memcpy(p, h->local, h->nitems * sizeof(RTHeapItem));
+        } else {
+            p = realloc(h->item, i * sizeof(RTHeapItem));
+        }
+        if (p == NULL) return 0;
+        h->item = p;
+        h->maxitems = i;
+    }
+
+    i = h->nitems++;
+    h->item[i].dist = dist;
+    h->item[i].isel = isel;
+    h->item[i].ptr = ptr;
+    while (i > 0) {
+        j = (i - 1) / 2;
+        if (h->item[j].dist <= h->item[i].dist) break;
+        aux = h->item[j];
+        h->item[j] = h->item[i];
+        h->item[i] = aux;
+        i = j;
+    }
+
+    return 1;
+}
+
+static void heapPop(RTHeap *h, RTHeapItem *item)
+{
+    RTHeapItem aux;
+    int i, j;
+
+    *item = h->item[0];
+    h->nitems--;
+    h->item[0] = h->item[h->nitems];
+    i = 0;
+    while (1) {
+        j = i * 2 + 1;
+        if (j >= h->nitems) break;
+        if (j + 1 < h->nitems && h->item[j+1].dist < h->item[j].dist) j++;
+        if (h->item[i].dist <= h->item[j].dist) break;
+        aux = h->item[j];
+        h->item[j] = h->item[i];
+        h->item[i] = aux;
+        i = j;
+    }
+}
+
+/* public functions */
+
+int MsvgBuildRTree(MsvgElement *root)
+{
+    MsvgRTree *rt;
+    RTEntry *entry;
+    int nentries;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    MsvgDestroyRTree(root);
+
+    if (!MsvgCalcCookedWorldBBoxes(root)) return 0;
+
+    rt = calloc(1, sizeof(MsvgRTree));
+    if (rt == NULL) return 0;
+
+    nentries = collectEntries(root, NULL, 0, &(rt->nuses));
+    entry = (RTEntry *)malloc((nentries + 1) * sizeof(RTEntry));
+    if (entry == NULL) {
+        free(rt);
+        return 0;
+    }
+    rt->nuses = 0;
+    collectEntries(root, entry, 0, &(rt->nuses));
+
+    rt->root = bulkLoad(entry, nentries, 1);
+    rt->nelems = nentries;
+    free(entry);
+
+    if (rt->root == NULL) {
+        free(rt);
+        return 0;
+    }
+
+    root->psvgattr->rtree = rt;
+
+    return 1;
+}
+
+void MsvgDestroyRTree(MsvgElement *root)
+{
+    MsvgRTree *rt;
+
+    if (root == NULL || root->eid != EID_SVG) return;
+
+    rt = root->psvgattr->rtree;
+    if (rt == NULL) return;
+
+    destroyNode(rt->root);
+    free(rt);
+    root->psvgattr->rtree = NULL;
+}
+
+int MsvgRTreeSearch(MsvgElement *root, const MsvgBox *box,
+                    MsvgRTreeUserFn rtufn, void *udata)
+{
+    if (root == NULL || root->eid != EID_SVG) return 0;
+    if (root->psvgattr->rtree == NULL) return 0;
+
+    return searchNode(root->psvgattr->rtree->root, box, rtufn, udata);
+}
+
+MsvgElement *MsvgRTreeNearest(MsvgElement *root, double x, double y, double *dist)
+{
+    MsvgRTree *rt;
+    MsvgElement *el = NULL;
+    RTHeap h;
+    RTHeapItem item;
+    RTNode *node;
+    int i;
+
+    if (root == NULL || root->eid != EID_SVG) return NULL;
+    rt = root->psvgattr->rtree;
+    if (rt == NULL || rt->nelems == 0) return NULL;
+
+    h.nitems = 0;
+    h.maxitems = RTHEAP_LOCALITEMS;
+    h.item = h.local;
+
+    // best first search, the first element popped is the nearest
+    if (!heapPush(&h, 0, 0, rt->root)) return NULL;
+
+    while (h.nitems > 0) {
+        heapPop(&h, &item);
+        if (item.isel) {
+            if (dist) *dist = item.dist;
+            el = (MsvgElement *)item.ptr;
+            break;
+        }
+        node = (RTNode *)item.ptr;
+        for (i=0; i<node->nentries; i++) {
+            if (!heapPush(&h, distBox(&(node->box[i]), x, y),
+                          node->leaf, node->ptr[i])) break;
+        }
+        if (i < node->nentries) break;
+    }
+
+    if (h.item != h.local) free(h.item);
+
+    return el;
+}
+
+int MsvgRTreeCount(MsvgElement *root)
+{
+    if (root == NULL || root->eid != EID_SVG) return 0;
+    if (root->psvgattr->rtree == NULL) return 0;
+
+    return root->psvgattr->rtree->nelems;
+}
+
+/* internal functions called by the element manipulation functions */
+
+int MsvgI_RTreeNumUses(MsvgRTree *rt)
+{
+    return rt->nuses;
+}
+
+int MsvgI_RTreeAddSubtree(MsvgRTree *rt, MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    if (el->eid == EID_G) {
+        pel = el->fson;
+        while (pel) {
+            if (!MsvgI_RTreeAddSubtree(rt, pel)) return 0;
+            pel = pel->nsibling;
+        }
+    } else if (isIndexed(el)) {
+        return insertElement(rt, el);
+    }
+
+    return 1;
+}
+
+void MsvgI_RTreeDelSubtree(MsvgRTree *rt, MsvgElement *el)
+{
+    MsvgElement *pel;
+
+    if (el->eid == EID_G) {
+        pel = el->fson;
+        while (pel) {
+            MsvgI_RTreeDelSubtree(rt, pel);
+            pel = pel->nsibling;
+        }
+    } else if (isIndexed(el)) {
+        deleteElement(rt, el);
+    }
+}
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <ctype.h>
 #include "msvg.h"
+#include "util.h"
 
 #define SCANBUFLEN 100
 
@@ -92,9 +93,147 @@ static char *scanItem(char *d, char *buf, int *isnumber)
     return d;
 }
 
-static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
+/* the path-data is scanned to growing arrays, packed at the end */
+
+typedef struct {
+    int nsubpaths, maxsubpaths;
+    int npoints, maxpoints;
+    double *x, *y;
+    char *cmd;
+    int *fpoint;
+    unsigned char *closed;
+    int failed;
+} PathBuilder;
+
+static void addSubPath(PathBuilder *pb)
+{
+    int newmax;
+    int *newfpoint;
+    unsigned char *newclosed;
+
+    if (pb->failed) return;
+
+    if (pb->nsubpaths >= pb->maxsubpaths) {
+        newmax = pb->maxsubpaths ? pb->maxsubpaths * 2 : 8;
+        newfpoint = realloc(pb->fpoint, sizeof(int)*newmax);
+        if (newfpoint == NULL) {
+            pb->failed = 1;
+            return;
+        }
+        pb->fpoint = newfpoint;
+        newclosed = realloc(pb->closed, newmax);
+        if (newclosed == NULL) {
+            pb->failed = 1;
+            return;
+        }
+        pb->closed = newclosed;
+        pb->maxsubpaths = newmax;
+    }
+
+    pb->fpoint[pb->nsubpaths] = pb->npoints;
+    pb->closed[pb->nsubpaths] = 0;
+    pb->nsubpaths++;
+}
+
+static void addPoint(PathBuilder *pb, char cmd, double x, double y)
+{
+    int newmax;
+    double *newx, *newy;
+    char *newcmd;
+
+    if (pb->failed) return;
+
+    if (pb->npoints >= pb->maxpoints) {
+        newmax = pb->maxpoints ? pb->maxpoints * 2 : 32;
+        newx = realloc(pb->x, sizeof(double)*newmax);
+        if (newx) pb->x = newx;
+        newy = realloc(pb->y, sizeof(double)*newmax);
+        if (newy) pb->y = newy;
+        newcmd = realloc(pb->cmd, newmax);
+        if (newcmd) pb->cmd = newcmd;
+        if (newx == NULL || newy == NULL || newcmd == NULL) {
+            pb->failed = 1;
+            return;
+        }
+        pb->maxpoints = newmax;
+    }
+
+    pb->x[pb->npoints] = x;
+    pb->y[pb->npoints] = y;
+    pb->cmd[pb->npoints] = cmd;
+    pb->npoints++;
+}
+
+static void freeBuilder(PathBuilder *pb)
+{
+    if (pb->x) free(pb->x);
+    if (pb->y) free(pb->y);
+    if (pb->cmd) free(pb->cmd);
+    if (pb->fpoint) free(pb->fpoint);
+    if (pb->closed) free(pb->closed);
+}
+
+static size_t packedHeadSize(void)
+{
+    // the coordinates after the struct must be aligned
+    return (sizeof(MsvgPackedPath) + sizeof(double) - 1) /
+           sizeof(double) * sizeof(double);
+}
+
+static size_t packedSize(int nsubpaths, int npoints)
+{
+    return packedHeadSize() + sizeof(MsvgCoord) * 2 * npoints +
+           sizeof(int) * (nsubpaths + 1) + nsubpaths + npoints;
+}
+
+static void setPackedPtrs(MsvgPackedPath *pp)
+{
+    pp->x = (MsvgCoord *)((char *)pp + packedHeadSize());
+    pp->y = pp->x + pp->npoints;
+    pp->fpoint = (int *)(pp->y + pp->npoints);
+    pp->closed = (unsigned char *)(pp->fpoint + pp->nsubpaths + 1);
+    pp->cmd = (char *)(pp->closed + pp->nsubpaths);
+}
+
+static MsvgPackedPath *newPackedPath(int nsubpaths, int npoints)
+{
+    MsvgPackedPath *pp;
+
+    pp = malloc(packedSize(nsubpaths, npoints));
+    if (pp == NULL) return NULL;
+    pp->nsubpaths = nsubpaths;
+    pp->npoints = npoints;
+    setPackedPtrs(pp);
+    pp->fpoint[nsubpaths] = npoints;
+    pp->nrefs = 1;
+
+    return pp;
+}
+
+static MsvgPackedPath *buildPacked(PathBuilder *pb)
+{
+    MsvgPackedPath *pp;
+    int i;
+
+    if (pb->nsubpaths < 1) return NULL;
+
+    pp = newPackedPath(pb->nsubpaths, pb->npoints);
+    if (pp == NULL) return NULL;
+    // scanned in double, the relative coordinates don't accumulate errors
+    for (i=0; i<pb->npoints; i++) {
+        pp->x[i] = pb->x[i];
+        pp->y[i] = pb->y[i];
+    }
+    memcpy(pp->cmd, pb->cmd, pb->npoints);
+    memcpy(pp->fpoint, pb->fpoint, sizeof(int) * pb->nsubpaths);
+    memcpy(pp->closed, pb->closed, pb->nsubpaths);
+
+    return pp;
+}
+
+static char *scanSubPath(char *d, double xorg, double yorg, PathBuilder *pb,
+                         int *found)
 {
-    MsvgSubPath *sp = NULL;
     char buf[SCANBUFLEN];
     double lcpx = 0;
     double lcpy = 0;
@@ -105,7 +244,7 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
     int isnumber;
     int i;
 
-    *psp = NULL;
+    *found = 0;
     // we need a M or m and 2 numbers to start
     while (*d) {
         d = scanItem(d, buf, &isnumber);
@@ -129,9 +268,8 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
             }
             lcpx = xorg;
             lcpy = yorg;
-            sp = MsvgNewSubPath(32);
-            if (sp == NULL) return d;
-            MsvgAddPointToSubPath(sp, 'M', xorg, yorg);
+            addSubPath(pb);
+            addPoint(pb, 'M', xorg, yorg);
             expected_pars = 2;
             npar = 0;
             break;
@@ -153,7 +291,7 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                     case 'l' :
                         xorg += par[0];
                         yorg += par[1];
-                        MsvgAddPointToSubPath(sp, 'L', xorg, yorg);
+                        addPoint(pb, 'L', xorg, yorg);
                         lcpx = xorg;
                         lcpy = yorg;
                         break;
@@ -161,7 +299,7 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                         xorg = 0;
                     case 'h' :
                         xorg += par[0];
-                        MsvgAddPointToSubPath(sp, 'L', xorg, yorg);
+                        addPoint(pb, 'L', xorg, yorg);
                         lcpx = xorg;
                         lcpy = yorg;
                         break;
@@ -169,7 +307,7 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                         yorg = 0;
                     case 'v' :
                         yorg += par[0];
-                        MsvgAddPointToSubPath(sp, 'L', xorg, yorg);
+                        addPoint(pb, 'L', xorg, yorg);
                         lcpx = xorg;
                         lcpy = yorg;
                         break;
@@ -179,9 +317,9 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                             par[i*2+1] += yorg;
                         }
                     case 'C' :
-                        MsvgAddPointToSubPath(sp, 'C', par[0], par[1]);
-                        MsvgAddPointToSubPath(sp, ' ', par[2], par[3]);
-                        MsvgAddPointToSubPath(sp, ' ', par[4], par[5]);
+                        addPoint(pb, 'C', par[0], par[1]);
+                        addPoint(pb, ' ', par[2], par[3]);
+                        addPoint(pb, ' ', par[4], par[5]);
                         lcpx = par[2];
                         lcpy = par[3];
                         xorg = par[4];
@@ -195,9 +333,9 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                     case 'S' :
                         lcpx = 2*xorg - lcpx;
                         lcpy = 2*yorg - lcpy;
-                        MsvgAddPointToSubPath(sp, 'C', lcpx, lcpy);
-                        MsvgAddPointToSubPath(sp, ' ', par[0], par[1]);
-                        MsvgAddPointToSubPath(sp, ' ', par[2], par[3]);
+                        addPoint(pb, 'C', lcpx, lcpy);
+                        addPoint(pb, ' ', par[0], par[1]);
+                        addPoint(pb, ' ', par[2], par[3]);
                         lcpx = par[0];
                         lcpy = par[1];
                         xorg = par[2];
@@ -209,8 +347,8 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                             par[i*2+1] += yorg;
                         }
                     case 'Q' :
-                        MsvgAddPointToSubPath(sp, 'Q', par[0], par[1]);
-                        MsvgAddPointToSubPath(sp, ' ', par[2], par[3]);
+                        addPoint(pb, 'Q', par[0], par[1]);
+                        addPoint(pb, ' ', par[2], par[3]);
                         lcpx = par[0];
                         lcpy = par[1];
                         xorg = par[2];
@@ -222,8 +360,8 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                     case 'T' :
                         lcpx = 2*xorg - lcpx;
                         lcpy = 2*yorg - lcpy;
-                        MsvgAddPointToSubPath(sp, 'Q', lcpx, lcpy);
-                        MsvgAddPointToSubPath(sp, ' ', par[0], par[1]);
+                        addPoint(pb, 'Q', lcpx, lcpy);
+                        addPoint(pb, ' ', par[0], par[1]);
                         xorg = par[0];
                         yorg = par[1];
                         break;
@@ -234,7 +372,7 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
                     case 'a' :
                         xorg += par[5];
                         yorg += par[6];
-                        MsvgAddPointToSubPath(sp, 'L', xorg, yorg);
+                        addPoint(pb, 'L', xorg, yorg);
                         lcpx = xorg;
                         lcpy = yorg;
                         break;
@@ -250,42 +388,68 @@ static char *scanSubPath(char *d, double xorg, double yorg, MsvgSubPath **psp)
             else if (strchr("Aa", actcmd)) expected_pars = 7;
             else if (strchr("Mm", actcmd)) {
                 // we have finished an open subpath
-                *psp = sp;
+                *found = 1;
                 d--; // because it is the beginning of next subpath
                 return d;
             } else if (strchr("Zz", actcmd)) {
                 // we have finished a closed subpath
-                //MsvgAddPointToSubPath(sp, 'Z', sp->spp[0].x, sp->spp[0].y);
-                sp->closed = 1;
-                *psp = sp;
+                if (pb->nsubpaths > 0) pb->closed[pb->nsubpaths-1] = 1;
+                *found = 1;
                 return d;
             } else expected_pars = 2; // really an error
         }
     }
     // no more chars, so we have finished an open subpath too
-    *psp = sp;
+    *found = 1;
     return d;
 }
 
-MsvgSubPath *MsvgScanPath(char *d)
+MsvgPackedPath *MsvgScanPackedPath(char *d)
 {
-    MsvgSubPath *firstsp, **psp;
+    PathBuilder pb;
+    MsvgPackedPath *pp;
     double xorg, yorg;
-    int nextpos;
+    int nextpos, found, nsubpaths;
 
+    memset(&pb, 0, sizeof(PathBuilder));
     xorg = 0;
     yorg = 0;
-    psp = &firstsp;
     while (1) {
-        d = scanSubPath(d, xorg, yorg, psp);
-        if (*psp == NULL || !*d) break;
-        nextpos = (*psp)->closed ? 0 : (*psp)->npoints-1;
-        xorg = (*psp)->spp[nextpos].x;
-        yorg = (*psp)->spp[nextpos].y;
-        psp = &((*psp)->next);
+        nsubpaths = pb.nsubpaths;
+        d = scanSubPath(d, xorg, yorg, &pb, &found);
+        if (!found) {
+            // a subpath started at the end of the path-data is not stored
+            if (pb.nsubpaths > nsubpaths) {
+                pb.nsubpaths = nsubpaths;
+                pb.npoints = pb.fpoint[nsubpaths];
+            }
+            break;
+        }
+        if (!*d || pb.failed) break;
+        nextpos = pb.closed[pb.nsubpaths-1] ? pb.fpoint[pb.nsubpaths-1] :
+                                               pb.npoints - 1;
+        xorg = pb.x[nextpos];
+        yorg = pb.y[nextpos];
     }
 
-    return firstsp;
+    pp = NULL;
+    if (!pb.failed) pp = buildPacked(&pb);
+    freeBuilder(&pb);
+
+    return pp;
+}
+
+MsvgSubPath *MsvgScanPath(char *d)
+{
+    MsvgPackedPath *pp;
+    MsvgSubPath *sp;
+
+    pp = MsvgScanPackedPath(d);
+    if (pp == NULL) return NULL;
+    sp = MsvgUnpackPath(pp);
+    MsvgDestroyPackedPath(pp);
+
+    return sp;
 }
 
 MsvgSubPath *MsvgNewSubPath(int maxpoints)
@@ -342,27 +506,28 @@ void MsvgAddPointToSubPath(MsvgSubPath *sp, char cmd, double x, double y)
     sp->npoints++;
 }
 
-MsvgSubPath *MsvgDupSubPath(MsvgSubPath *srcsp)
+MsvgSubPath *MsvgDupSubPath(const MsvgSubPath *srcsp)
 {
-    MsvgSubPath *dessp;
+    MsvgSubPath *first = NULL, *dessp, **pdes;
     int i;
 
-    if (srcsp == NULL) return NULL;
-    dessp = MsvgNewSubPath(srcsp->npoints);
-    if (dessp == NULL) return NULL;
-    dessp->npoints = srcsp->npoints;
-    dessp->closed = srcsp->closed;
-    for (i=0; i<srcsp->npoints; i++) {
-        dessp->spp[i] = srcsp->spp[i];
-    }
-    if (srcsp->next) {
-        dessp->next = MsvgDupSubPath(srcsp->next);
+    pdes = &first;
+    for (; srcsp!=NULL; srcsp=srcsp->next) {
+        dessp = MsvgNewSubPath(srcsp->npoints);
+        if (dessp == NULL) break;
+        dessp->npoints = srcsp->npoints;
+        dessp->closed = srcsp->closed;
+        for (i=0; i<srcsp->npoints; i++) {
+            dessp->spp[i] = srcsp->spp[i];
+        }
+        *pdes = dessp;
+        pdes = &(dessp->next);
     }
 
-    return dessp;
+    return first;
 }
 
-int MsvgCountSubPaths(MsvgSubPath *sp)
+int MsvgCountSubPaths(const MsvgSubPath *sp)
 {
     int count = 0;
 
@@ -376,8 +541,242 @@ int MsvgCountSubPaths(MsvgSubPath *sp)
 
 void MsvgDestroySubPath(MsvgSubPath *sp)
 {
-    if (sp == NULL) return;
-    MsvgDestroySubPath(sp->next);
-    free(sp->spp);
-    free(sp);
+    MsvgSubPath *next;
+
+    while (sp) {
+        next = sp->next;
+        free(sp->spp);
+        free(sp);
+        sp = next;
+    }
+}
+
+MsvgPackedPath *MsvgPackSubPath(const MsvgSubPath *sp)
+{
+    MsvgPackedPath *pp;
+    const MsvgSubPath *aux;
+    int nsubpaths = 0, npoints = 0, i, j;
+
+    for (aux=sp; aux!=NULL; aux=aux->next) {
+        nsubpaths++;
+        npoints += aux->npoints;
+    }
+    if (nsubpaths < 1) return NULL;
+
+    pp = newPackedPath(nsubpaths, npoints);
+    if (pp == NULL) return NULL;
+
+    npoints = 0;
+    for (aux=sp, i=0; aux!=NULL; aux=aux->next, i++) {
+        pp->fpoint[i] = npoints;
+        pp->closed[i] = aux->closed;
+        for (j=0; j<aux->npoints; j++) {
+            pp->x[npoints] = aux->spp[j].x;
+            pp->y[npoints] = aux->spp[j].y;
+            pp->cmd[npoints] = aux->spp[j].cmd;
+            npoints++;
+        }
+    }
+
+    return pp;
+}
+
+MsvgSubPath *MsvgUnpackPath(const MsvgPackedPath *pp)
+{
+    MsvgSubPath *first = NULL, *sp, **psp;
+    int i, j;
+
+    if (pp == NULL) return NULL;
+
+    psp = &first;
+    for (i=0; i<pp->nsubpaths; i++) {
+        sp = MsvgNewSubPath(pp->fpoint[i+1] - pp->fpoint[i]);
+        if (sp == NULL) {
+            MsvgDestroySubPath(first);
+            return NULL;
+        }
+        for (j=pp->fpoint[i]; j<pp->fpoint[i+1]; j++)
+            MsvgAddPointToSubPath(sp, pp->cmd[j], pp->x[j], pp->y[j]);
+        sp->closed = pp->closed[i];
+        *psp = sp;
+        psp = &(sp->next);
+    }
+
+    return first;
+}
+
+MsvgPackedPath *MsvgDupPackedPath(const MsvgPackedPath *pp)
+{
+    MsvgPackedPath *newpp;
+
+    if (pp == NULL) return NULL;
+
+    newpp = malloc(packedSize(pp->nsubpaths, pp->npoints));
+    if (newpp == NULL) return NULL;
+
+    return MsvgI_CopyPackedPath(newpp, pp);
+}
+
+size_t MsvgI_PackedPathSize(const MsvgPackedPath *pp)
+{
+    return packedSize(pp->nsubpaths, pp->npoints);
+}
+
+MsvgPackedPath *MsvgI_CopyPackedPath(void *mem, const MsvgPackedPath *pp)
+{
+    MsvgPackedPath *newpp;
+
+    newpp = (MsvgPackedPath *)mem;
+    memcpy(newpp, pp, packedSize(pp->nsubpaths, pp->npoints));
+    setPackedPtrs(newpp);
+    newpp->nrefs = 1;
+
+    return newpp;
+}
+
+void MsvgDestroyPackedPath(MsvgPackedPath *pp)
+{
+    // shared by MsvgDedupGeometry, freed with the last reference
+    if (pp && --pp->nrefs <= 0) free(pp);
+}
+
+static MsvgSubPath **pathPtrs(MsvgElement *el, char ***pd, MsvgPackedPath ***ppp)
+{
+    if (el->eid == EID_PATH) {
+        *pd = &(el->ppathattr->d);
+        *ppp = &(el->ppathattr->pp);
+        return &(el->ppathattr->sp);
+    } else if (el->eid == EID_GLYPH || el->eid == EID_MISSINGGLYPH) {
+        *pd = &(el->pglyphattr->d);
+        *ppp = &(el->pglyphattr->pp);
+        return &(el->pglyphattr->sp);
+    }
+
+    return NULL;
+}
+
+static void scanPending(MsvgSubPath **psp, char **pd, MsvgPackedPath **ppp)
+{
+    // the path-data is scanned the first time it is needed
+    if (*psp) MsvgDestroySubPath(*psp);
+    if (*ppp) MsvgDestroyPackedPath(*ppp);
+    *psp = NULL;
+    *ppp = MsvgScanPackedPath(*pd);
+    free(*pd);
+    *pd = NULL;
+}
+
+MsvgPackedPath *MsvgGetPackedPath(MsvgElement *el)
+{
+    MsvgSubPath **psp;
+    MsvgPackedPath **ppp;
+    char **pd;
+
+    psp = pathPtrs(el, &pd, &ppp);
+    if (psp == NULL) return NULL;
+
+    if (*pd) scanPending(psp, pd, ppp);
+    // subpaths set by program are packed once, MsvgElementChanged
+    // drops the packed copy
+    else if (*ppp == NULL && *psp) *ppp = MsvgPackSubPath(*psp);
+
+    return *ppp;
+}
+
+MsvgSubPath *MsvgReadSubPath(const MsvgElement *el)
+{
+    const MsvgSubPath *sp;
+    const MsvgPackedPath *pp;
+    char *d;
+
+    if (el->eid == EID_PATH) {
+        d = el->ppathattr->d;
+        pp = el->ppathattr->pp;
+        sp = el->ppathattr->sp;
+    } else if (el->eid == EID_GLYPH || el->eid == EID_MISSINGGLYPH) {
+        d = el->pglyphattr->d;
+        pp = el->pglyphattr->pp;
+        sp = el->pglyphattr->sp;
+    } else {
+        return NULL;
+    }
+
+    // a copy for the caller, nothing is stored in el so it can be read
+    // from several threads in a frozen tree
+    if (d) return MsvgScanPath(d);
+    if (pp) return MsvgUnpackPath(pp);
+    if (sp) return MsvgDupSubPath(sp);
+
+    return NULL;
+}
+
+MsvgSubPath *MsvgGetSubPath(MsvgElement *el)
+{
+    MsvgSubPath **psp;
+    MsvgPackedPath **ppp;
+    char **pd;
+
+    psp = pathPtrs(el, &pd, &ppp);
+    if (psp == NULL) return NULL;
+
+    if (*pd) scanPending(psp, pd, ppp);
+    if (*psp == NULL && *ppp) *psp = MsvgUnpackPath(*ppp);
+
+    // the caller can change the subpaths, they are packed again if needed
+    if (*ppp) {
+        MsvgDestroyPackedPath(*ppp);
+        *ppp = NULL;
+    }
+
+    return *psp;
+}
+
+int MsvgForcePathScan(MsvgElement *el)
+{
+    MsvgElement *pel;
+    MsvgPackedPath **ppp;
+    char **pd;
+    int n = 0;
+
+    pel = el;
+    for (;;) {
+        if (pathPtrs(pel, &pd, &ppp) && *pd) {
+            MsvgGetPackedPath(pel);
+            n++;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+
+    return n;
+}
+
+void MsvgI_DropPackedPaths(MsvgElement *el)
+{
+    MsvgElement *pel;
+    MsvgSubPath **psp;
+    MsvgPackedPath **ppp;
+    char **pd;
+
+    pel = el;
+    for (;;) {
+        // the packed copies of subpaths that can have been changed
+        psp = pathPtrs(pel, &pd, &ppp);
+        if (psp && *psp && *ppp) {
+            MsvgDestroyPackedPath(*ppp);
+            *ppp = NULL;
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
 }
@@ -31,86 +31,305 @@
 #include "msvg.h"
 #include "util.h"
 
-typedef struct {
-    MsvgSerUserFn sufn;
-    MsvgTableId *tid;
-    int nested_use;
-    void *udata;
-    int genbps;
-} SerData;
+/* The paint contexts used here live in the iterator frames and the
+ * strings they point to are borrowed from the element paint contexts, the
+ * binary paint servers are the ones cached in the gradient elements, so
+ * no memory is allocated when serializing a tree (except for very deep
+ * trees, the content referenced by EID_USE elements, compiled once in
+ * usecache.c, and the first time a gradient is used). They must not be
+ * freed with MsvgDestroyPaintCtx.
+ */
+
+void MsvgI_InheritBorrowedPaintCtx(MsvgPaintCtx *son, const MsvgPaintCtx *fath)
+{
+    TMatrix taux;
+
+    if (son->fill == INHERIT_COLOR || son->fill == NODEFINED_COLOR) {
+        son->fill = fath->fill;
+        son->fill_iri = fath->fill_iri;
+    }
+
+    if (son->fill_opacity == INHERIT_VALUE ||
+        son->fill_opacity == NODEFINED_VALUE) {
+        son->fill_opacity = fath->fill_opacity;
+    }
+
+    if (son->fill_rule == INHERIT_IVALUE ||
+        son->fill_rule == NODEFINED_IVALUE) {
+        son->fill_rule = fath->fill_rule;
+    }
+
+    if (son->stroke == INHERIT_COLOR || son->stroke == NODEFINED_COLOR) {
+        son->stroke = fath->stroke;
+        son->stroke_iri = fath->stroke_iri;
+    }
+
+    if (son->stroke_width == INHERIT_VALUE ||
+        son->stroke_width == NODEFINED_VALUE) {
+        son->stroke_width = fath->stroke_width;
+    }
+
+    if (son->stroke_opacity == INHERIT_VALUE ||
+        son->stroke_opacity == NODEFINED_VALUE) {
+        son->stroke_opacity = fath->stroke_opacity;
+    }
+
+    taux = son->tmatrix;
+    TMMpy(&(son->tmatrix), &(fath->tmatrix), &taux);
 
-static void process_container(MsvgElement *el, SerData *sd,
-                              MsvgPaintCtx *fath, int onlyfirstson);
+    if (son->text_anchor == INHERIT_IVALUE ||
+        son->text_anchor == NODEFINED_IVALUE) {
+        son->text_anchor = fath->text_anchor;
+    }
+
+    if (son->ifont_family == INHERIT_IVALUE ||
+        son->ifont_family == NODEFINED_IVALUE) {
+        son->sfont_family = fath->sfont_family;
+        son->ifont_family = fath->ifont_family;
+    }
+
+    if (son->font_style == INHERIT_IVALUE ||
+        son->font_style == NODEFINED_IVALUE) {
+        son->font_style = fath->font_style;
+    }
+
+    if (son->font_weight == INHERIT_IVALUE ||
+        son->font_weight == NODEFINED_IVALUE) {
+        son->font_weight = fath->font_weight;
+    }
+
+    if (son->font_size == INHERIT_VALUE ||
+        son->font_size == NODEFINED_VALUE) {
+        son->font_size = fath->font_size;
+    }
+}
 
-static void build_bps(MsvgPaintCtx *pctx, SerData *sd)
+static int is_visible(MsvgElement *el, MsvgSerIter *it)
+{
+    double x[4], y[4];
+    double minx, maxx, miny, maxy;
+    int i;
+
+    if (el->wbbox.gminx > el->wbbox.gmaxx) return 0; // nothing to draw
+
+    x[0] = x[3] = el->wbbox.gminx;
+    x[1] = x[2] = el->wbbox.gmaxx;
+    y[0] = y[1] = el->wbbox.gminy;
+    y[2] = y[3] = el->wbbox.gmaxy;
+    for (i=0; i<4; i++)
+        TMTransformCoord(&(x[i]), &(y[i]), &(it->devt));
+    minx = maxx = x[0];
+    miny = maxy = y[0];
+    for (i=1; i<4; i++) {
+        if (x[i] < minx) minx = x[i];
+        if (x[i] > maxx) maxx = x[i];
+        if (y[i] < miny) miny = y[i];
+        if (y[i] > maxy) maxy = y[i];
+    }
+
+    if (maxx < it->clip->gminx || minx > it->clip->gmaxx) return 0;
+    if (maxy < it->clip->gminy || miny > it->clip->gmaxy) return 0;
+
+    return 1;
+}
+
+static void build_bps(MsvgPaintCtx *pctx, MsvgSerIter *it)
 {
     MsvgElement *refel;
 
-    if (sd->tid == NULL) return;
+    pctx->fill_bps = NULL;
+    pctx->stroke_bps = NULL;
+
+    if (it->tid == NULL) return;
 
     if (pctx->fill == IRI_COLOR) {
-        refel = MsvgFindIdTableId(sd->tid, pctx->fill_iri);
-        if (refel) pctx->fill_bps = MsvgNewBPServer(refel);
+        refel = MsvgFindIdTableId(it->tid, pctx->fill_iri);
+        if (refel) pctx->fill_bps = MsvgGetBPServer(refel);
     }
     if (pctx->stroke == IRI_COLOR) {
-        refel = MsvgFindIdTableId(sd->tid, pctx->stroke_iri);
-        if (refel) pctx->stroke_bps = MsvgNewBPServer(refel);
+        refel = MsvgFindIdTableId(it->tid, pctx->stroke_iri);
+        if (refel) pctx->stroke_bps = MsvgGetBPServer(refel);
+    }
+}
+
+static MsvgSerFrame *push_frame(MsvgSerIter *it)
+{
+    MsvgSerFrameChunk *chunk;
+    int pos;
+
+    // chunks are never moved, so the frame paint contexts can be
+    // referenced by the next frames
+    pos = it->depth % MSVG_SERITER_CHUNK;
+    if (it->depth > 0 && pos == 0) {
+        if (it->cur->next == NULL) {
+            chunk = (MsvgSerFrameChunk *)malloc(sizeof(MsvgSerFrameChunk));
+            if (chunk == NULL) return NULL;
+            chunk->next = NULL;
+            chunk->prev = it->cur;
+            it->cur->next = chunk;
+        }
+        it->cur = it->cur->next;
     }
+
+    it->depth++;
+
+    return &(it->cur->frame[pos]);
 }
 
-static void process_use(MsvgElement *el, SerData *sd, MsvgPaintCtx *fath)
+static void pop_frame(MsvgSerIter *it)
 {
-    MsvgElement *refel, *ghostg;
+    it->depth--;
+    if (it->depth > 0 && it->depth % MSVG_SERITER_CHUNK == 0)
+        it->cur = it->cur->prev;
+}
+
+static MsvgSerFrame *top_frame(MsvgSerIter *it)
+{
+    return &(it->cur->frame[(it->depth - 1) % MSVG_SERITER_CHUNK]);
+}
+
+static void push_container(MsvgSerIter *it, MsvgElement *el,
+                           const MsvgPaintCtx *fath)
+{
+    MsvgSerFrame *f;
+
+    f = push_frame(it);
+    if (f == NULL) return;
+
+    f->next = el->fson;
+    f->pctx = *(el->pctx);
+    if (fath) MsvgI_InheritBorrowedPaintCtx(&(f->pctx), fath);
+}
+
+static void start_use(MsvgSerIter *it, MsvgElement *el,
+                      const MsvgPaintCtx *fath)
+{
+    MsvgElement *refel;
     TMatrix uset;
 
-    if (sd->nested_use >= MAX_NESTED_USE_ELEMENT) return;
-    if (sd->tid == NULL) return;
+    if (it->tid == NULL) return;
 
-    refel = MsvgFindIdTableId(sd->tid, el->puseattr->refel);
+    refel = MsvgFindIdTableId(it->tid, el->puseattr->refel);
     if (refel == NULL) return;
 
-    // create a ghost G element
-    ghostg = MsvgNewElement(EID_G, NULL);
-    if (ghostg == NULL) return;
-
-    sd->nested_use += 1;
+    // without a cache in the tree the compiled content is kept only
+    // for this serialization
+    if (it->uc == NULL) {
+        it->uc = MsvgI_NewUseCache();
+        if (it->uc == NULL) return;
+        it->own_uc = 1;
+    }
 
-    MsvgCopyPaintCtx(ghostg->pctx, el->pctx);
+    it->inst = MsvgI_GetUseInst(it->uc, it->tid, refel);
+    if (it->inst == NULL) return;
 
+    // the use element acts like a group with the referenced content as sons
+    it->inst_pos = 0;
+    it->inst_pctx = *(el->pctx);
     TMSetTranslation(&uset, el->puseattr->x, el->puseattr->y);
-    TMMpy(&(ghostg->pctx->tmatrix), &(el->pctx->tmatrix), &uset);
+    TMMpy(&(it->inst_pctx.tmatrix), &(el->pctx->tmatrix), &uset);
+    MsvgI_InheritBorrowedPaintCtx(&(it->inst_pctx), fath);
+}
 
-    ghostg->fson = refel;
-    process_container(ghostg, sd, fath, 1);
-    ghostg->fson = NULL;
-    MsvgDeleteElement(ghostg);
+static MsvgElement *ret_element(MsvgSerIter *it, MsvgElement *el,
+                                const MsvgPaintCtx *elpctx,
+                                const MsvgPaintCtx *fath, MsvgPaintCtx **pctx)
+{
+    it->pctx = *elpctx;
+    MsvgI_InheritBorrowedPaintCtx(&(it->pctx), fath);
+    MsvgProcPaintCtxDefaults(&(it->pctx));
+    if (it->genbps) build_bps(&(it->pctx), it);
+    if (pctx) *pctx = &(it->pctx);
 
-    sd->nested_use -= 1;
+    return el;
 }
 
-static void process_container(MsvgElement *el, SerData *sd,
-                              MsvgPaintCtx *fath, int onlyfirstson)
+static MsvgElement *ret_cached(MsvgSerIter *it, MsvgElement *el,
+                               MsvgPaintCtx **pctx)
 {
-    MsvgPaintCtx *mypctx = NULL, *sonpctx = NULL;
-    MsvgElement *pel;
+    // the computed paint context has the world matrix
+    it->pctx = *(el->cpctx);
+    TMMpy(&(it->pctx.tmatrix), &(it->devt), &(el->cpctx->tmatrix));
+    if (it->genbps) build_bps(&(it->pctx), it);
+    if (pctx) *pctx = &(it->pctx);
 
-    mypctx = MsvgNewPaintCtx(el->pctx);
-    if (mypctx == NULL) return;
+    return el;
+}
 
-    if (fath) MsvgProcPaintCtxInheritance(mypctx, fath);
-    
-    pel = el->fson;
-    while (pel) {
-        switch (pel->eid) {
-            case EID_SVG :
-                break;
+int MsvgSerIterBegin(MsvgSerIter *it, MsvgElement *root, int genbps,
+                     const MsvgBox *clip)
+{
+    return MsvgSerIterBeginView(it, root, genbps, clip, NULL);
+}
+
+int MsvgSerIterBeginView(MsvgSerIter *it, MsvgElement *root, int genbps,
+                         const MsvgBox *clip, const TMatrix *view)
+{
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    if (clip && !root->wbbox_ok) MsvgCalcCookedWorldBBoxes(root);
+
+    it->tid = MsvgI_GetTableId(root, &(it->own_tid));
+    it->genbps = genbps;
+    it->clip = clip;
+    // the view goes before the root matrix, the tree is not changed
+    if (view)
+        TMMpy(&(it->devt), view, &(root->pctx->tmatrix));
+    else
+        it->devt = root->pctx->tmatrix;
+    it->uc = root->psvgattr->usecache;
+    it->own_uc = 0;
+    it->inst = NULL;
+    it->depth = 0;
+    it->first.next = NULL;
+    it->first.prev = NULL;
+    it->cur = &(it->first);
+
+    push_container(it, root, NULL);
+    if (it->depth > 0) top_frame(it)->pctx.tmatrix = it->devt;
+
+    return 1;
+}
+
+MsvgElement *MsvgSerIterNext(MsvgSerIter *it, MsvgPaintCtx **pctx)
+{
+    MsvgSerFrame *f;
+    MsvgElement *el;
+    MsvgSerItem *item;
+
+    for (;;) {
+        if (it->inst) {
+            if (it->inst_pos < it->inst->nitems) {
+                item = &(it->inst->item[it->inst_pos]);
+                it->inst_pos++;
+                return ret_element(it, item->el, &(item->pctx),
+                                   &(it->inst_pctx), pctx);
+            }
+            it->inst = NULL;
+        }
+
+        if (it->depth == 0) break;
+
+        f = top_frame(it);
+        el = f->next;
+        if (el == NULL) {
+            pop_frame(it);
+            continue;
+        }
+        f->next = el->nsibling;
+
+        if (it->clip && el->wbbox_ok) {
+            if (!is_visible(el, it)) continue;
+        }
+
+        switch (el->eid) {
             case EID_G :
-                process_container(pel, sd, mypctx, 0);
-                break;
-            case EID_DEFS :
+                push_container(it, el, &(f->pctx));
                 break;
             case EID_USE :
-                process_use(pel, sd, mypctx);
+                start_use(it, el, &(f->pctx));
                 break;
             case EID_RECT :
             case EID_CIRCLE :
@@ -120,42 +339,140 @@ static void process_container(MsvgElement *el, SerData *sd,
             case EID_POLYGON :
             case EID_PATH :
             case EID_TEXT :
-                sonpctx = MsvgNewPaintCtx(pel->pctx);
-                if (sonpctx) {
-                    MsvgProcPaintCtxInheritance(sonpctx, mypctx);
-                    MsvgProcPaintCtxDefaults(sonpctx);
-                    if (sd->genbps) build_bps(sonpctx, sd);
-                    sd->sufn(pel, sonpctx, sd->udata);
-                    MsvgDestroyPaintCtx(sonpctx);
-                }
-                break;
+                if (el->cpctx_ok) return ret_cached(it, el, pctx);
+                return ret_element(it, el, el->pctx, &(f->pctx), pctx);
             default :
                 break;
         }
-        if (onlyfirstson) pel = NULL;
-        else pel = pel->nsibling;
     }
 
-    MsvgDestroyPaintCtx(mypctx);
+    return NULL;
+}
+
+void MsvgSerIterEnd(MsvgSerIter *it)
+{
+    MsvgSerFrameChunk *chunk, *next;
+
+    chunk = it->first.next;
+    while (chunk) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    it->first.next = NULL;
+    it->cur = &(it->first);
+    it->depth = 0;
+    it->inst = NULL;
+
+    if (it->own_uc) MsvgI_DestroyUseCache(it->uc);
+    it->uc = NULL;
+    it->own_uc = 0;
+
+    if (it->own_tid && it->tid) MsvgDestroyTableId(it->tid);
+    it->tid = NULL;
+    it->own_tid = 0;
 }
 
 int MsvgSerCookedTree(MsvgElement *root, MsvgSerUserFn sufn, void *udata, int genbps)
 {
-    SerData sd;
+    return MsvgSerCookedTreeClip(root, sufn, udata, genbps, NULL);
+}
 
-    if (root == NULL) return 0;
-    if (root->eid != EID_SVG) return 0;
-    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+int MsvgSerCookedTreeClip(MsvgElement *root, MsvgSerUserFn sufn, void *udata,
+                          int genbps, const MsvgBox *clip)
+{
+    return MsvgSerCookedTreeView(root, sufn, udata, genbps, clip, NULL);
+}
+
+int MsvgSerCookedTreeView(MsvgElement *root, MsvgSerUserFn sufn, void *udata,
+                          int genbps, const MsvgBox *clip, const TMatrix *view)
+{
+    MsvgSerIter it;
+    MsvgPaintCtx *pctx;
+    MsvgElement *el;
+
+    if (!MsvgSerIterBeginView(&it, root, genbps, clip, view)) return 0;
 
-    sd.sufn = sufn;
-    sd.tid = MsvgBuildTableIdCookedTree(root);
-    sd.nested_use = 0;
-    sd.udata = udata;
-    sd.genbps = genbps;
+    while ((el = MsvgSerIterNext(&it, &pctx)) != NULL)
+        sufn(el, pctx, udata);
 
-    process_container(root, &sd, NULL, 0);
+    MsvgSerIterEnd(&it);
+
+    return 1;
+}
+
+static int same_string(const char *s1, const char *s2)
+{
+    if (s1 == s2) return 1;
+    if (s1 == NULL || s2 == NULL) return 0;
+    return strcmp(s1, s2) == 0;
+}
+
+int MsvgSamePaintState(const MsvgPaintCtx *pctx1, const MsvgPaintCtx *pctx2)
+{
+    if (pctx1->fill != pctx2->fill) return 0;
+    if (pctx1->fill == IRI_COLOR &&
+        !same_string(pctx1->fill_iri, pctx2->fill_iri)) return 0;
+    if (pctx1->fill_opacity != pctx2->fill_opacity) return 0;
+    if (pctx1->fill_rule != pctx2->fill_rule) return 0;
+    if (pctx1->stroke != pctx2->stroke) return 0;
+    if (pctx1->stroke == IRI_COLOR &&
+        !same_string(pctx1->stroke_iri, pctx2->stroke_iri)) return 0;
+    if (pctx1->stroke_width != pctx2->stroke_width) return 0;
+    if (pctx1->stroke_opacity != pctx2->stroke_opacity) return 0;
+    if (pctx1->text_anchor != pctx2->text_anchor) return 0;
+    if (pctx1->ifont_family != pctx2->ifont_family) return 0;
+    if (!same_string(pctx1->sfont_family, pctx2->sfont_family)) return 0;
+    if (pctx1->font_style != pctx2->font_style) return 0;
+    if (pctx1->font_weight != pctx2->font_weight) return 0;
+    if (pctx1->font_size != pctx2->font_size) return 0;
+
+    return 1;
+}
+
+int MsvgSerCookedTreeBatch(MsvgElement *root, MsvgSerBatchUserFn sbufn,
+                           void *udata, int genbps, int maxitems,
+                           const MsvgBox *clip)
+{
+    return MsvgSerCookedTreeBatchView(root, sbufn, udata, genbps, maxitems,
+                                      clip, NULL);
+}
+
+int MsvgSerCookedTreeBatchView(MsvgElement *root, MsvgSerBatchUserFn sbufn,
+                               void *udata, int genbps, int maxitems,
+                               const MsvgBox *clip, const TMatrix *view)
+{
+    MsvgSerIter it;
+    MsvgSerItem *item;
+    MsvgPaintCtx *pctx;
+    MsvgElement *el;
+    int nitems;
+
+    if (maxitems < 1) return 0;
+
+    item = (MsvgSerItem *)malloc(sizeof(MsvgSerItem) * maxitems);
+    if (item == NULL) return 0;
+
+    if (!MsvgSerIterBeginView(&it, root, genbps, clip, view)) {
+        free(item);
+        return 0;
+    }
+
+    nitems = 0;
+    while ((el = MsvgSerIterNext(&it, &pctx)) != NULL) {
+        if (nitems > 0 && (nitems == maxitems ||
+            !MsvgSamePaintState(&(item[0].pctx), pctx))) {
+            sbufn(item, nitems, udata);
+            nitems = 0;
+        }
+        item[nitems].el = el;
+        item[nitems].pctx = *pctx;
+        nitems++;
+    }
+    if (nitems > 0) sbufn(item, nitems, udata);
 
-    if (sd.tid) MsvgDestroyTableId(sd.tid);
+    MsvgSerIterEnd(&it);
+    free(item);
 
     return 1;
 }
@@ -85,7 +85,7 @@ static MsvgElement *transCookRect(MsvgElement *el, MsvgPaintCtx *cpctx)
         if (auxel == NULL) return NULL;
 
         auxel->ppolygonattr->npoints = 4;
-        auxel->ppolygonattr->points = (double *)calloc(8, sizeof(double));
+        auxel->ppolygonattr->points = (MsvgCoord *)calloc(8, sizeof(MsvgCoord));
         if (auxel->ppolygonattr->points == NULL) {
             MsvgDeleteElement(auxel);
             return NULL;
@@ -344,11 +344,9 @@ static MsvgElement *transCookPolyline(MsvgElement *el, MsvgPaintCtx *cpctx)
     
     if (TMIsIdentity(&(cpctx->tmatrix))) return newel;
 
-    for (i=0; i< newel->ppolylineattr->npoints; i++) {
-        TMTransformCoord(&(newel->ppolylineattr->points[i*2]),
-                         &(newel->ppolylineattr->points[i*2+1]),
-                        &(cpctx->tmatrix));
-    }
+    TMTransformCoordArray(newel->ppolylineattr->points,
+                          newel->ppolylineattr->points + 1,
+                          newel->ppolylineattr->npoints, 2, &(cpctx->tmatrix));
 
     return newel;
 }
@@ -374,11 +372,9 @@ static MsvgElement *transCookPolygon(MsvgElement *el, MsvgPaintCtx *cpctx)
 
     if (TMIsIdentity(&(cpctx->tmatrix))) return newel;
 
-    for (i=0; i< newel->ppolygonattr->npoints; i++) {
-        TMTransformCoord(&(newel->ppolygonattr->points[i*2]),
-                         &(newel->ppolygonattr->points[i*2+1]),
-                        &(cpctx->tmatrix));
-    }
+    TMTransformCoordArray(newel->ppolygonattr->points,
+                          newel->ppolygonattr->points + 1,
+                          newel->ppolygonattr->npoints, 2, &(cpctx->tmatrix));
 
     return newel;
 }
@@ -386,28 +382,22 @@ static MsvgElement *transCookPolygon(MsvgElement *el, MsvgPaintCtx *cpctx)
 static MsvgElement *transCookPath(MsvgElement *el, MsvgPaintCtx *cpctx)
 {
     MsvgElement *newel;
-    MsvgSubPath *sp;
-    int i;
+    MsvgPackedPath *pp;
 
     newel = MsvgNewElement(EID_PATH, NULL);
     if (newel == NULL) return NULL;
-    newel->ppathattr->sp = MsvgDupSubPath(el->ppathattr->sp);
-    if (newel->ppathattr->sp == NULL) {
+    pp = MsvgDupPackedPath(MsvgGetPackedPath(el));
+    if (pp == NULL) {
         MsvgDeleteElement(newel);
         return NULL;
     }
+    newel->ppathattr->pp = pp;
 
     setElPctx(newel, cpctx);
 
     if (TMIsIdentity(&(cpctx->tmatrix))) return newel;
 
-    sp = newel->ppathattr->sp;
-    while (sp) {
-        for (i=0; i<sp->npoints; i++) {
-            TMTransformCoord(&(sp->spp[i].x), &(sp->spp[i].y), &(cpctx->tmatrix));
-        }
-        sp = sp->next;
-    }
+    TMTransformCoordArray(pp->x, pp->y, pp->npoints, 1, &(cpctx->tmatrix));
 
     return newel;
 }
@@ -417,8 +407,12 @@ static MsvgElement *transCookText(MsvgElement *el, MsvgPaintCtx *cpctx)
     MsvgElement *newel;
     TMatrix *t;
 
-    newel = MsvgDupElement(el, 0);
+    // the content is copied, not shared, el can be in a frozen tree
+    newel = MsvgNewElement(EID_TEXT, NULL);
     if (newel == NULL) return NULL;
+    *(newel->ptextattr) = *(el->ptextattr);
+    if (el->id) newel->id = strdup(el->id);
+    MsvgCopyContents(newel, el);
 
     setElPctx(newel, cpctx);
 
@@ -130,3 +130,18 @@ void TMTransformCoord(double *x, double *y, const TMatrix *ctm)
     *x = ctm->a * xorg + ctm->c * yorg + ctm->e;
     *y = ctm->b * xorg + ctm->d * yorg + ctm->f;
 }
+
+void TMTransformCoordArray(MsvgCoord *x, MsvgCoord *y, int n, int stride,
+                           const TMatrix *ctm)
+{
+    double xorg, yorg;
+    int i;
+
+    // n points, x and y are increased by stride (2 for x,y pairs)
+    for (i=0; i<n*stride; i+=stride) {
+        xorg = x[i];
+        yorg = y[i];
+        x[i] = ctm->a * xorg + ctm->c * yorg + ctm->e;
+        y[i] = ctm->b * xorg + ctm->d * yorg + ctm->f;
+    }
+}
@@ -0,0 +1,329 @@
+/* usecache.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "msvg.h"
+#include "util.h"
+
+/* The content referenced by an EID_USE element is compiled once to a flat
+ * list of drawable elements, with paint contexts in the EID_USE element
+ * space and not inherited from it. Every instance is then a matrix product
+ * and an inheritance away. The strings of the paint contexts are borrowed
+ * from the elements, so the cache must be cleared when the tree changes.
+ *
+ * The elements in a reference cycle are not drawn through EID_USE elements,
+ * a cycle is found when an element is referenced while it is compiled.
+ */
+
+#define USECACHE_MINBUCKETS 64
+
+struct _MsvgUseCache {
+    int ninsts;                 // compiled referenced elements
+    int nbuckets;
+    MsvgUseInst **bucket;       // hash table by referenced element
+};
+
+static int hash_ptr(const MsvgElement *el, int nbuckets)
+{
+    size_t h;
+
+    h = (size_t)el;
+    h ^= h >> 11;
+
+    return (int)((h >> 4) % nbuckets);
+}
+
+MsvgUseCache *MsvgI_NewUseCache(void)
+{
+    MsvgUseCache *uc;
+
+    uc = (MsvgUseCache *)malloc(sizeof(MsvgUseCache));
+    if (uc == NULL) return NULL;
+
+    uc->bucket = (MsvgUseInst **)calloc(USECACHE_MINBUCKETS,
+                                        sizeof(MsvgUseInst *));
+    if (uc->bucket == NULL) {
+        free(uc);
+        return NULL;
+    }
+    uc->nbuckets = USECACHE_MINBUCKETS;
+    uc->ninsts = 0;
+
+    return uc;
+}
+
+void MsvgI_ClearUseCache(MsvgUseCache *uc)
+{
+    MsvgUseInst *inst, *next;
+    int i;
+
+    for (i=0; i<uc->nbuckets; i++) {
+        for (inst=uc->bucket[i]; inst!=NULL; inst=next) {
+            next = inst->next;
+            if (inst->item) free(inst->item);
+            free(inst);
+        }
+        uc->bucket[i] = NULL;
+    }
+    uc->ninsts = 0;
+}
+
+void MsvgI_DestroyUseCache(MsvgUseCache *uc)
+{
+    MsvgI_ClearUseCache(uc);
+    free(uc->bucket);
+    free(uc);
+}
+
+static void grow_buckets(MsvgUseCache *uc)
+{
+    MsvgUseInst **bucket, *inst, *next;
+    int nbuckets, i, h;
+
+    nbuckets = uc->nbuckets * 2;
+    bucket = (MsvgUseInst **)calloc(nbuckets, sizeof(MsvgUseInst *));
+    if (bucket == NULL) return; // the chains only get longer
+
+    for (i=0; i<uc->nbuckets; i++) {
+        for (inst=uc->bucket[i]; inst!=NULL; inst=next) {
+            next = inst->next;
+            h = hash_ptr(inst->refel, nbuckets);
+            inst->next = bucket[h];
+            bucket[h] = inst;
+        }
+    }
+
+    free(uc->bucket);
+    uc->bucket = bucket;
+    uc->nbuckets = nbuckets;
+}
+
+static int add_item(MsvgUseInst *inst, MsvgElement *el,
+                    const MsvgPaintCtx *pctx)
+{
+    MsvgSerItem *item;
+    int maxitems;
+
+    if (inst->nitems >= inst->maxitems) {
+        maxitems = inst->maxitems ? inst->maxitems * 2 : 4;
+        item = (MsvgSerItem *)realloc(inst->item, sizeof(MsvgSerItem) * maxitems);
+        if (item == NULL) return 0;
+        inst->item = item;
+        inst->maxitems = maxitems;
+    }
+
+    inst->item[inst->nitems].el = el;
+    inst->item[inst->nitems].pctx = *pctx;
+    inst->nitems++;
+
+    return 1;
+}
+
+static MsvgUseInst *get_inst(MsvgUseCache *uc, MsvgTableId *tid,
+                             MsvgElement *refel, MsvgUseInst *caller);
+
+void MsvgI_UndefPaintCtx(MsvgPaintCtx *pctx)
+{
+    // nothing defined and identity matrix, the EID_USE element gives the
+    // undefined values when instanced
+    pctx->fill = NODEFINED_COLOR;
+    pctx->fill_iri = NULL;
+    pctx->fill_bps = NULL;
+    pctx->fill_opacity = NODEFINED_VALUE;
+    pctx->fill_rule = NODEFINED_IVALUE;
+    pctx->stroke = NODEFINED_COLOR;
+    pctx->stroke_iri = NULL;
+    pctx->stroke_bps = NULL;
+    pctx->stroke_width = NODEFINED_VALUE;
+    pctx->stroke_opacity = NODEFINED_VALUE;
+    TMSetIdentity(&(pctx->tmatrix));
+    pctx->text_anchor = NODEFINED_IVALUE;
+    pctx->sfont_family = NULL;
+    pctx->ifont_family = NODEFINED_IVALUE;
+    pctx->font_style = NODEFINED_IVALUE;
+    pctx->font_weight = NODEFINED_IVALUE;
+    pctx->font_size = NODEFINED_VALUE;
+}
+
+static void compile(MsvgUseCache *uc, MsvgTableId *tid, MsvgUseInst *inst,
+                    MsvgElement *el, const MsvgPaintCtx *fath)
+{
+    MsvgPaintCtx pctx, ipctx;
+    MsvgUseInst *sub;
+    MsvgElement *refel, *son;
+    TMatrix uset;
+    int i;
+
+    pctx = *(el->pctx);
+
+    switch (el->eid) {
+        case EID_G :
+            MsvgI_InheritBorrowedPaintCtx(&pctx, fath);
+            for (son=el->fson; son!=NULL; son=son->nsibling)
+                compile(uc, tid, inst, son, &pctx);
+            break;
+        case EID_USE :
+            refel = MsvgFindIdTableId(tid, el->puseattr->refel);
+            if (refel == NULL) break;
+            sub = get_inst(uc, tid, refel, inst);
+            if (sub == NULL) break;
+            TMSetTranslation(&uset, el->puseattr->x, el->puseattr->y);
+            TMMpy(&(pctx.tmatrix), &(el->pctx->tmatrix), &uset);
+            MsvgI_InheritBorrowedPaintCtx(&pctx, fath);
+            for (i=0; i<sub->nitems; i++) {
+                ipctx = sub->item[i].pctx;
+                MsvgI_InheritBorrowedPaintCtx(&ipctx, &pctx);
+                add_item(inst, sub->item[i].el, &ipctx);
+            }
+            break;
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            MsvgI_InheritBorrowedPaintCtx(&pctx, fath);
+            add_item(inst, el, &pctx);
+            break;
+        default :
+            break;
+    }
+}
+
+static MsvgUseInst *get_inst(MsvgUseCache *uc, MsvgTableId *tid,
+                             MsvgElement *refel, MsvgUseInst *caller)
+{
+    MsvgUseInst *inst, *c;
+    MsvgPaintCtx undef;
+    int h;
+
+    h = hash_ptr(refel, uc->nbuckets);
+    for (inst=uc->bucket[h]; inst!=NULL; inst=inst->next) {
+        if (inst->refel != refel) continue;
+        if (inst->compiling) {
+            // the callers up to refel are in the cycle
+            for (c=caller; c!=NULL; c=c->caller) {
+                c->cyclic = 1;
+                if (c == inst) break;
+            }
+            return NULL;
+        }
+        return inst->cyclic ? NULL : inst;
+    }
+
+    inst = (MsvgUseInst *)calloc(1, sizeof(MsvgUseInst));
+    if (inst == NULL) return NULL;
+    inst->refel = refel;
+    inst->compiling = 1;
+    inst->caller = caller;
+    inst->next = uc->bucket[h];
+    uc->bucket[h] = inst;
+    uc->ninsts++;
+
+    MsvgI_UndefPaintCtx(&undef);
+    compile(uc, tid, inst, refel, &undef);
+
+    inst->compiling = 0;
+    inst->caller = NULL;
+    if (inst->cyclic) {
+        if (inst->item) free(inst->item);
+        inst->item = NULL;
+        inst->nitems = 0;
+        inst->maxitems = 0;
+    }
+
+    if (uc->ninsts > uc->nbuckets * 2) grow_buckets(uc);
+
+    return inst->cyclic ? NULL : inst;
+}
+
+MsvgUseInst *MsvgI_GetUseInst(MsvgUseCache *uc, MsvgTableId *tid,
+                              MsvgElement *refel)
+{
+    return get_inst(uc, tid, refel, NULL);
+}
+
+static void compile_uses(MsvgUseCache *uc, MsvgTableId *tid, MsvgElement *el)
+{
+    MsvgElement *refel, *pel;
+
+    pel = el;
+    for (;;) {
+        if (pel->eid == EID_USE && pel->puseattr->refel) {
+            refel = MsvgFindIdTableId(tid, pel->puseattr->refel);
+            if (refel) get_inst(uc, tid, refel, NULL);
+        }
+        if (pel->fson) {
+            pel = pel->fson;
+            continue;
+        }
+        while (pel != el && pel->nsibling == NULL) pel = pel->father;
+        if (pel == el) break;
+        pel = pel->nsibling;
+    }
+}
+
+int MsvgBuildUseCache(MsvgElement *root)
+{
+    MsvgTableId *tid;
+    int own_tid;
+
+    if (root == NULL) return 0;
+    if (root->eid != EID_SVG) return 0;
+    if (root->psvgattr->tree_type != COOKED_SVGTREE) return 0;
+
+    if (root->psvgattr->usecache == NULL) {
+        root->psvgattr->usecache = MsvgI_NewUseCache();
+        if (root->psvgattr->usecache == NULL) return 0;
+    } else {
+        MsvgI_ClearUseCache(root->psvgattr->usecache);
+    }
+
+    // the referenced content is compiled now, the serializations only
+    // compile again after a change of the tree
+    tid = MsvgI_GetTableId(root, &own_tid);
+    if (tid) {
+        compile_uses(root->psvgattr->usecache, tid, root);
+        if (own_tid) MsvgDestroyTableId(tid);
+    }
+
+    return 1;
+}
+
+void MsvgDestroyUseCache(MsvgElement *root)
+{
+    if (root == NULL) return;
+    if (root->eid != EID_SVG) return;
+
+    if (root->psvgattr->usecache) MsvgI_DestroyUseCache(root->psvgattr->usecache);
+    root->psvgattr->usecache = NULL;
+}
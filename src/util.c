@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include "msvg.h"
 #include "util.h"
 
 static int get_ascii_number_len(char *s)
@@ -108,6 +109,25 @@ int MsvgI_read_numbers(char *s, double *df, int maxnumbers)
     return n;
 }
 
+int MsvgI_read_coords(char *s, MsvgCoord *c, int maxnumbers)
+{
+    int n = 0;
+    int len;
+
+    while (*s) {
+        if (n >= maxnumbers) break;
+        len = get_ascii_number_len(s);
+        if (len > 0) {
+            c[n++] = atof(s);
+            s += len;
+        } else {
+            s++;
+        }
+    }
+
+    return n;
+}
+
 char *MsvgI_rmspaces(char *s)
 {
     char *p;
@@ -205,3 +225,13 @@ long MsvgI_NextUCPfromUTF8Str(const unsigned char *s, int *nb)
 ILLFORMED:
     return (long)0xFFFD;
 }
+
+int MsvgI_InUseChain(const MsvgI_UseChain *chain, const MsvgElement *refel)
+{
+    while (chain) {
+        if (chain->refel == refel) return 1;
+        chain = chain->prev;
+    }
+
+    return 0;
+}
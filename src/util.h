@@ -32,6 +32,7 @@ int MsvgI_count_numbers(char *s);
 
 /* read up to maxnumbers from string into df */
 int MsvgI_read_numbers(char *s, double *df, int maxnumbers);
+int MsvgI_read_coords(char *s, MsvgCoord *c, int maxnumbers);
 
 /* remove spaces before and after, note: s is modified */
 char *MsvgI_rmspaces(char *s);
@@ -39,3 +40,126 @@ char *MsvgI_rmspaces(char *s);
 /* return next unicode code point from a utf-8 string
  * nb will be the number of bytes consumed */
 long MsvgI_NextUCPfromUTF8Str(const unsigned char *s, int *nb);
+
+/* functions shared by the spatial index and the element manipulation
+ * functions, msvg.h must be included before */
+
+/* flatten the subpath nsp of a packed path, returns an allocated array of
+ * npoints x,y pairs */
+MsvgCoord *MsvgI_FlattenSubPath(const MsvgPackedPath *pp, int nsp, double px_x_unit,
+                                int *npoints);
+
+/* drop the packed copies of the subpaths of el and its sons */
+void MsvgI_DropPackedPaths(MsvgElement *el);
+
+/* size of the allocation of a packed path, and copy to a memory block of that
+ * size (aligned for a double) that is not freed with the packed path */
+size_t MsvgI_PackedPathSize(const MsvgPackedPath *pp);
+MsvgPackedPath *MsvgI_CopyPackedPath(void *mem, const MsvgPackedPath *pp);
+
+/* build the paint context of an element in world coordinates,
+ * inheriting from its ancestors */
+MsvgPaintCtx *MsvgI_BuildWorldPaintCtx(MsvgElement *el);
+
+/* calculate the world bboxes of a subtree in its tree position */
+int MsvgI_CalcSubtreeWorldBBoxes(MsvgElement *root, MsvgElement *el);
+
+/* add or remove the indexed elements of a subtree, the add returns 0 if
+ * there is not enough memory, the elements added before are kept */
+int MsvgI_RTreeAddSubtree(MsvgRTree *rt, MsvgElement *el);
+void MsvgI_RTreeDelSubtree(MsvgRTree *rt, MsvgElement *el);
+
+/* num of EID_USE elements indexed */
+int MsvgI_RTreeNumUses(MsvgRTree *rt);
+
+/* inherit the paint context like MsvgProcPaintCtxInheritance, but the
+ * strings are borrowed from fath, not duplicated */
+void MsvgI_InheritBorrowedPaintCtx(MsvgPaintCtx *son, const MsvgPaintCtx *fath);
+
+/* chain of the elements referenced by the EID_USE elements being
+ * expanded, returns 1 if refel is in the chain (a reference cycle) */
+typedef struct _MsvgI_UseChain {
+    MsvgElement *refel;
+    struct _MsvgI_UseChain *prev;
+} MsvgI_UseChain;
+
+int MsvgI_InUseChain(const MsvgI_UseChain *chain, const MsvgElement *refel);
+
+/* compiled EID_USE content: the drawable elements of the referenced
+ * element with paint contexts relative to the EID_USE element */
+struct _MsvgUseInst {
+    MsvgElement *refel;         /* referenced element */
+    int nitems;
+    int maxitems;
+    MsvgSerItem *item;          /* not inherited from the EID_USE element */
+    int compiling;              /* 1 while it is compiled */
+    int cyclic;                 /* 1 = in a reference cycle, not drawn */
+    struct _MsvgUseInst *caller; /* instance compiling it, while compiling */
+    struct _MsvgUseInst *next;  /* next in the hash chain */
+};
+
+MsvgUseCache *MsvgI_NewUseCache(void);
+void MsvgI_ClearUseCache(MsvgUseCache *uc);
+void MsvgI_DestroyUseCache(MsvgUseCache *uc);
+
+/* returns NULL if refel is in a reference cycle or out of memory */
+MsvgUseInst *MsvgI_GetUseInst(MsvgUseCache *uc, MsvgTableId *tid,
+                              MsvgElement *refel);
+
+/* nothing defined and identity matrix, the paint context the referenced
+   content is compiled from */
+void MsvgI_UndefPaintCtx(MsvgPaintCtx *pctx);
+
+/* drop the binary paint server compiled for a gradient element */
+void MsvgI_ClearBPServerCache(MsvgElement *el);
+/* compile and pin (pin = 1) or unpin the one of a gradient element, pinned
+   it is not counted by MsvgRefBPServer and MsvgDestroyBPServer */
+int MsvgI_PinBPServerCache(MsvgElement *el, int pin);
+
+/* functions in find.c to keep an id table updated */
+int MsvgI_AddTableId(MsvgTableId *tid, const char *id, MsvgElement *el);
+void MsvgI_DelTableId(MsvgTableId *tid, const char *id, const MsvgElement *el);
+/* add or delete the ids of el and its descendants */
+void MsvgI_TableIdSubtree(MsvgTableId *tid, MsvgElement *el, int add);
+/* the id index of root or, if *own is set, a new table to be destroyed */
+MsvgTableId *MsvgI_GetTableId(MsvgElement *root, int *own);
+
+/* function in manielem.c, el takes newid (can be NULL) and the id index is
+   updated, the caches are not notified */
+void MsvgI_ReplaceElementId(MsvgElement *el, char *newid);
+
+/* functions in ctxcache.c */
+/* el or its subtree changed, was inserted or is going to be pruned */
+void MsvgI_PaintCtxCacheChanged(MsvgElement *root, MsvgElement *el);
+
+/* functions in journal.c */
+/* record a change of el, oldbox is the el world bbox before a CHANGE_MODIFIED
+ * (NULL if it was not calculated), boxes = 1 if the el subtree world bboxes
+ * are already updated, a CHANGE_REMOVED must be recorded before the prune */
+void MsvgI_JournalChange(MsvgElement *root, MsvgElement *el, int type,
+                         const MsvgBox *oldbox, int boxes);
+
+/* functions in raw2cook.c */
+/* cook el and its descendants, but not its siblings */
+void MsvgI_CookSubtree(MsvgElement *el);
+/* cook again el from its raw attributes, but not its id or its sons */
+int MsvgI_RecookElement(MsvgElement *el);
+
+/* functions in cook2raw.c */
+/* add to el the raw attributes for its cooked ones, but not to its sons */
+void MsvgI_Cooked2RawElement(MsvgElement *el);
+
+/* functions in dedup.c */
+/* free a points array, or drop the reference if it is shared by other
+ * elements, and set both pointers to NULL */
+void MsvgI_ReleasePoints(MsvgCoord **points, int **nrefs);
+/* let points share srcpoints, returns 0 if there is not enough memory */
+int MsvgI_SharePoints(MsvgCoord **points, int **nrefs, MsvgCoord *srcpoints,
+                      int **srcnrefs);
+
+/* functions in attribut.c and content.c used by MsvgDupElement, the copy
+ * shares the raw attributes list, the geometry and the contents of srcel,
+ * they are copied before they are changed */
+int MsvgI_ShareRawAttributes(MsvgElement *desel, MsvgElement *srcel);
+int MsvgI_ShareCookedAttributes(MsvgElement *desel, MsvgElement *srcel);
+int MsvgI_ShareContents(MsvgElement *desel, MsvgElement *srcel);
@@ -85,7 +85,9 @@ static void writeContent(FILE *f, char *s, int depth)
     fputs("\n", f);
 }
 
-static void writeElement(FILE *f, MsvgElement *el, int depth)
+/* returns 1 if the element is left open, to write the sons */
+
+static int writeElement(FILE *f, MsvgElement *el, int depth)
 {
     MsvgRawAttribute *pattr;
 
@@ -94,9 +96,7 @@ static void writeElement(FILE *f, MsvgElement *el, int depth)
         fputs("<!--", f);
         if (el->fcontent != NULL) fputs(el->fcontent->s, f);
         fputs("-->\n", f);
-        if (el->nsibling != NULL)
-            writeElement(f, el->nsibling, depth);
-        return;
+        return 0;
     }
 
     writeLabelElement(f, el->eid, 1, depth);
@@ -115,14 +115,36 @@ static void writeElement(FILE *f, MsvgElement *el, int depth)
         if (el->fcontent != NULL) {
             writeContent(f, el->fcontent->s, depth);
         }
-        if (el->fson != NULL) writeElement(f, el->fson, depth+1);
+        if (el->fson != NULL) return 1;
         writeLabelElement(f, el->eid, 0, depth);
     } else {
         fputs(" />\n", f);
     }
-    
-    if (el->nsibling != NULL)
-        writeElement(f, el->nsibling, depth);
+
+    return 0;
+}
+
+static void writeTree(FILE *f, MsvgElement *root)
+{
+    MsvgElement *pel;
+    int depth = 0;
+
+    pel = root;
+    for (;;) {
+        if (writeElement(f, pel, depth)) {
+            pel = pel->fson;
+            depth++;
+            continue;
+        }
+        // the fathers are closed going up
+        while (pel != root && pel->nsibling == NULL) {
+            pel = pel->father;
+            depth--;
+            writeLabelElement(f, pel->eid, 0, depth);
+        }
+        if (pel == root) break;
+        pel = pel->nsibling;
+    }
 }
 
 int MsvgWriteSvgFile(MsvgElement *root, const char *fname)
@@ -136,7 +158,7 @@ int MsvgWriteSvgFile(MsvgElement *root, const char *fname)
     if (f == NULL) return 0;
     
     fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n", f);
-    writeElement(f, root, 0);
+    writeTree(f, root);
     
     fclose(f);
     return 1;
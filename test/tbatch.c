@@ -0,0 +1,219 @@
+/* tbatch.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "msvg.h"
+
+typedef struct {
+    int nels;
+    int maxels;
+    MsvgElement **els;
+    MsvgPaintCtx *pctx;
+    MsvgBPServer *fill_bps;
+    MsvgBPServer *stroke_bps;
+} ElList;
+
+typedef struct {
+    ElList *ell;
+    int pos;
+    int maxitems;
+    int nbatches;
+    int nfails;
+    MsvgPaintCtx last;
+    int lastfull;
+} BatchData;
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    ElList *ell;
+
+    ell = (ElList *)udata;
+    if (ell->nels < ell->maxels) {
+        ell->els[ell->nels] = el;
+        ell->pctx[ell->nels] = *pctx;
+        if (pctx->fill_bps) ell->fill_bps[ell->nels] = *(pctx->fill_bps);
+        if (pctx->stroke_bps) ell->stroke_bps[ell->nels] = *(pctx->stroke_bps);
+    }
+    ell->nels++;
+}
+
+static int samePctx(MsvgPaintCtx *p1, MsvgPaintCtx *p2,
+                    MsvgBPServer *fill_bps, MsvgBPServer *stroke_bps)
+{
+    if ((p1->fill_bps == NULL) != (p2->fill_bps == NULL)) return 0;
+    if ((p1->stroke_bps == NULL) != (p2->stroke_bps == NULL)) return 0;
+    if (p1->fill_bps && !MsvgEqualBPServer(p1->fill_bps, fill_bps)) return 0;
+    if (p1->stroke_bps && !MsvgEqualBPServer(p1->stroke_bps, stroke_bps)) return 0;
+
+    if (p1->fill_iri != p2->fill_iri) return 0;
+    if (p1->stroke_iri != p2->stroke_iri) return 0;
+    if (p1->sfont_family != p2->sfont_family) return 0;
+    if (memcmp(&(p1->tmatrix), &(p2->tmatrix), sizeof(TMatrix))) return 0;
+    return MsvgSamePaintState(p1, p2);
+}
+
+static void sbufn(MsvgSerItem *item, int nitems, void *udata)
+{
+    BatchData *bd;
+    ElList *ell;
+    int i;
+
+    bd = (BatchData *)udata;
+    ell = bd->ell;
+
+    if (nitems < 1 || nitems > bd->maxitems) bd->nfails++;
+
+    // a batch not cut by size must be cut by a paint state change
+    if (bd->nbatches > 0 && !bd->lastfull &&
+        MsvgSamePaintState(&(bd->last), &(item[0].pctx))) bd->nfails++;
+
+    for (i=0; i<nitems; i++) {
+        if (!MsvgSamePaintState(&(item[0].pctx), &(item[i].pctx)))
+            bd->nfails++;
+        if (bd->pos >= ell->nels) {
+            bd->nfails++;
+            continue;
+        }
+        if (item[i].el != ell->els[bd->pos]) bd->nfails++;
+        else if (!samePctx(&(item[i].pctx), &(ell->pctx[bd->pos]),
+                           &(ell->fill_bps[bd->pos]),
+                           &(ell->stroke_bps[bd->pos]))) bd->nfails++;
+        bd->pos++;
+    }
+
+    bd->last = item[nitems-1].pctx;
+    bd->lastfull = (nitems == bd->maxitems);
+    bd->nbatches++;
+}
+
+static MsvgElement *buildRuns(int n)
+{
+    MsvgElement *root, *g, *el;
+    int i;
+
+    // runs of elements with the same color, some colors inherited from
+    // the group, so the paint state must be compared after inheritance
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 1000;
+    root->psvgattr->vb_height = 1000;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    g = MsvgNewElement(EID_G, root);
+    g->pctx->fill = 0X00FF00;
+    for (i=0; i<n; i++) {
+        if (i % 100 == 0) {
+            g = MsvgNewElement(EID_G, root);
+            g->pctx->fill = (i / 100) % 2 ? 0X00FF00 : 0X0000FF;
+        }
+        el = MsvgNewElement(EID_RECT, g);
+        el->prectattr->x = i % 1000;
+        el->prectattr->width = 1;
+        el->prectattr->height = 1;
+        if (i % 37 < 5) el->pctx->fill = 0XFF0000;
+        if (i % 53 == 0) el->pctx->stroke_width = 2;
+    }
+
+    return root;
+}
+
+static int compare(MsvgElement *root, int genbps, int maxitems)
+{
+    ElList ell;
+    BatchData bd;
+    int n;
+
+    ell.nels = 0;
+    ell.maxels = 0;
+    MsvgSerCookedTree(root, sufn, &ell, genbps);
+
+    n = ell.nels + 1;
+    ell.maxels = ell.nels;
+    ell.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * n);
+    ell.pctx = (MsvgPaintCtx *)malloc(sizeof(MsvgPaintCtx) * n);
+    ell.fill_bps = (MsvgBPServer *)calloc(n, sizeof(MsvgBPServer));
+    ell.stroke_bps = (MsvgBPServer *)calloc(n, sizeof(MsvgBPServer));
+    if (ell.els == NULL || ell.pctx == NULL ||
+        ell.fill_bps == NULL || ell.stroke_bps == NULL) return 1;
+    ell.nels = 0;
+    MsvgSerCookedTree(root, sufn, &ell, genbps);
+
+    bd.ell = &ell;
+    bd.pos = 0;
+    bd.maxitems = maxitems;
+    bd.nbatches = 0;
+    bd.nfails = 0;
+    bd.lastfull = 0;
+    if (!MsvgSerCookedTreeBatch(root, sbufn, &bd, genbps, maxitems, NULL))
+        bd.nfails++;
+    if (bd.pos != ell.nels) bd.nfails++;
+
+    printf("  genbps %d maxitems %4d: %d elements, %d batches, %d fails\n",
+           genbps, maxitems, ell.nels, bd.nbatches, bd.nfails);
+
+    free(ell.els);
+    free(ell.pctx);
+    free(ell.fill_bps);
+    free(ell.stroke_bps);
+
+    return bd.nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, maxitems = 256, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-m=", 3) == 0)
+            maxitems = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (maxitems < 1) {
+        printf("Usage: tbatch [-m=maxitems] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildRuns(10000);
+        printf("===== tree with runs of colors\n");
+    }
+
+    nfails += compare(root, 0, 1);
+    nfails += compare(root, 0, maxitems);
+    nfails += compare(root, 1, 1);
+    nfails += compare(root, 1, maxitems);
+
+    printf("%s\n", nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
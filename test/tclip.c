@@ -0,0 +1,165 @@
+/* tclip.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+#include "tgrid.h"
+
+typedef struct {
+    int nels;               // num of elements serialized
+    int maxels;
+    MsvgElement **els;      // elements serialized, if not NULL
+    MsvgBox *clip;          // to test the transformed elements
+    int ninside;            // num of transformed elements inside the clip box
+    int nmissing;           // num of elements inside not serialized
+} UserData;
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    UserData *ud;
+
+    ud = (UserData *)udata;
+    if (ud->els && ud->nels < ud->maxels) ud->els[ud->nels] = el;
+    ud->nels += 1;
+}
+
+static int cmpels(const void *a, const void *b)
+{
+    MsvgElement *e1 = *(MsvgElement **)a;
+    MsvgElement *e2 = *(MsvgElement **)b;
+
+    if (e1 < e2) return -1;
+    if (e1 > e2) return 1;
+    return 0;
+}
+
+static void checkfn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    MsvgElement *newel;
+    UserData *ud;
+    MsvgBox box;
+
+    ud = (UserData *)udata;
+
+    newel = MsvgTransformCookedElement(el, pctx, MSVGTCE_CIR2PATH|MSVGTCE_ELL2PATH);
+    if (newel == NULL) return;
+    MsvgGetCookedBoundingBox(newel, &box, 1);
+    MsvgDeleteElement(newel);
+
+    if (box.gmaxx < ud->clip->gminx || box.gminx > ud->clip->gmaxx) return;
+    if (box.gmaxy < ud->clip->gminy || box.gminy > ud->clip->gmaxy) return;
+
+    ud->ninside++;
+    if (!bsearch(&el, ud->els, ud->nels, sizeof(MsvgElement *), cmpels))
+        ud->nmissing++;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    MsvgTreeCounts tc;
+    UserData ud;
+    MsvgBox clip = {0, 799, 0, 599};
+    TMatrix view, tsave;
+    double zoom = 8;
+    clock_t t0;
+    int error, i, n = 100, nloops = 10;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-z=", 3) == 0)
+            zoom = atof(&(argv[0][3]));
+        else if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (zoom <= 0 || n < 1) {
+        printf("Usage: tclip [-z=zoom] [-n=cells] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+    } else {
+        root = buildGridMap(n, TGRID_PATH | TGRID_ROTLINE);
+    }
+
+    MsvgCalcCountsCookedTree(root, &tc);
+    printf("===== elements in tree %d\n", tc.totelem);
+
+    t0 = clock();
+    MsvgCalcCookedWorldBBoxes(root);
+    printf("  world bboxes       %g s\n", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    // a zoomed view of the image center, like the renderers do
+    tsave = root->pctx->tmatrix;
+    TMSetScaling(&view, zoom, zoom);
+    view.e = 400 - zoom * root->psvgattr->vb_width / 2;
+    view.f = 300 - zoom * root->psvgattr->vb_height / 2;
+    TMMpy(&(root->pctx->tmatrix), &view, &tsave);
+
+    ud.nels = 0;
+    ud.els = NULL;
+    t0 = clock();
+    for (i=0; i<nloops; i++)
+        MsvgSerCookedTree(root, sufn, &ud, 0);
+    printf("===== MsvgSerCookedTree, %d loops\n", nloops);
+    printf("  elements           %d\n", ud.nels / nloops);
+    printf("  time               %g s\n", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    ud.nels = 0;
+    t0 = clock();
+    for (i=0; i<nloops; i++)
+        MsvgSerCookedTreeClip(root, sufn, &ud, 0, &clip);
+    printf("===== MsvgSerCookedTreeClip, %d loops\n", nloops);
+    printf("  elements           %d\n", ud.nels / nloops);
+    printf("  time               %g s\n", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    // check that no visible element is culled
+    ud.maxels = ud.nels / nloops;
+    ud.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (ud.maxels + 1));
+    if (ud.els == NULL) {
+        MsvgDeleteElement(root);
+        return 0;
+    }
+    ud.nels = 0;
+    MsvgSerCookedTreeClip(root, sufn, &ud, 0, &clip);
+    qsort(ud.els, ud.nels, sizeof(MsvgElement *), cmpels);
+    ud.clip = &clip;
+    ud.ninside = 0;
+    ud.nmissing = 0;
+    MsvgSerCookedTree(root, checkfn, &ud, 0);
+    printf("===== Elements inside the clip box %d, missing %d\n",
+           ud.ninside, ud.nmissing);
+    printf("%s\n", ud.nmissing ? "FAIL" : "PASS");
+
+    free(ud.els);
+    root->pctx->tmatrix = tsave;
+    MsvgDeleteElement(root);
+
+    return ud.nmissing ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+/* tcow.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NDUPS 20
+#define NSTOPS 16
+#define NGRADS 50
+
+static MsvgElement *buildTemplate(int n)
+{
+    MsvgElement *root, *defs, *el, *tpl;
+    char s[1200], *p;
+    int i, j;
+
+    // a raw tree with a gradient of NSTOPS stops referenced by NGRADS
+    // gradients, and a template group of n paths, polygons and texts
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    MsvgAddRawAttribute(root, "viewBox", "0 0 1000 1000");
+    defs = MsvgNewElement(EID_DEFS, root);
+    el = MsvgNewElement(EID_LINEARGRADIENT, defs);
+    MsvgAddRawAttribute(el, "id", "grad0");
+    tpl = el;
+    for (i=0; i<NSTOPS; i++) {
+        el = MsvgNewElement(EID_STOP, tpl);
+        sprintf(s, "%g", (double)i / (NSTOPS - 1));
+        MsvgAddRawAttribute(el, "offset", s);
+        sprintf(s, "#%02x%02x00", i * 15, 255 - i * 15);
+        MsvgAddRawAttribute(el, "stop-color", s);
+    }
+    for (i=1; i<=NGRADS; i++) {
+        el = MsvgNewElement(EID_LINEARGRADIENT, defs);
+        sprintf(s, "grad%d", i);
+        MsvgAddRawAttribute(el, "id", s);
+        MsvgAddRawAttribute(el, "xlink:href", "#grad0");
+    }
+
+    tpl = MsvgNewElement(EID_G, root);
+    MsvgAddRawAttribute(tpl, "id", "template");
+    MsvgAddRawAttribute(tpl, "stroke", "black");
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_PATH, tpl);
+        p = s + sprintf(s, "M%d 0", i % 1000);
+        for (j=0; j<40; j++)
+            p += sprintf(p, " L%d %d", (i + j * 7) % 1000, (j * 13) % 1000);
+        MsvgAddRawAttribute(el, "d", s);
+        MsvgAddRawAttribute(el, "fill", "url(#grad1)");
+        el = MsvgNewElement(EID_POLYGON, tpl);
+        p = s;
+        for (j=0; j<20; j++)
+            p += sprintf(p, "%d,%d ", (i + j * 11) % 1000, (j * 17) % 1000);
+        MsvgAddRawAttribute(el, "points", s);
+        el = MsvgNewElement(EID_TEXT, tpl);
+        MsvgAddRawAttribute(el, "x", "10");
+        MsvgAddRawAttribute(el, "y", "20");
+        MsvgAddContent(el, 40, "A text repeated in every template copy..");
+    }
+
+    return root;
+}
+
+static MsvgElement *deepDup(MsvgElement *el)
+{
+    MsvgElement *newel, *son, *newson, *last = NULL;
+
+    // the copies before the payloads were shared, linked the same way
+    newel = MsvgNewElement(el->eid, NULL);
+    if (newel == NULL) return NULL;
+    MsvgCopyRawAttributes(newel, el);
+    MsvgCopyCookedAttributes(newel, el);
+    MsvgCopyContents(newel, el);
+
+    for (son=el->fson; son!=NULL; son=son->nsibling) {
+        newson = deepDup(son);
+        if (newson == NULL) continue;
+        newson->father = newel;
+        newson->psibling = last;
+        if (last) last->nsibling = newson;
+        else newel->fson = newson;
+        newel->lson = newson;
+        last = newson;
+    }
+
+    return newel;
+}
+
+typedef struct {
+    int nels;
+    double sum;         /* of the drawn coordinates, in order */
+} SumData;
+
+static void sumCoords(SumData *sd, const MsvgCoord *x, const MsvgCoord *y,
+                      int n, int stride)
+{
+    int i;
+
+    for (i=0; i<n*stride; i+=stride)
+        sd->sum = sd->sum * 0.5 + x[i] + 2 * y[i];
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SumData *sd;
+    MsvgElement *newel;
+    MsvgPackedPath *pp;
+
+    sd = (SumData *)udata;
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    sd->nels++;
+    switch (newel->eid) {
+        case EID_POLYGON :
+            sumCoords(sd, newel->ppolygonattr->points,
+                      newel->ppolygonattr->points + 1,
+                      newel->ppolygonattr->npoints, 2);
+            break;
+        case EID_PATH :
+            pp = MsvgGetPackedPath(newel);
+            if (pp) sumCoords(sd, pp->x, pp->y, pp->npoints, 1);
+            break;
+        case EID_TEXT :
+            sd->sum = sd->sum * 0.5 + newel->ptextattr->x + 2 * newel->ptextattr->y;
+            if (newel->fcontent) sd->sum += newel->fcontent->len;
+            break;
+        default :
+            break;
+    }
+    MsvgDeleteElement(newel);
+}
+
+static void drawnSum(MsvgElement *el, SumData *sd)
+{
+    MsvgElement *root;
+
+    // a subtree is drawn in a tree of its own
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    MsvgInsertSonElement(el, root);
+    sd->nels = 0;
+    sd->sum = 0;
+    MsvgSerCookedTree(root, sufn, sd, 0);
+    MsvgPruneElement(el);
+    MsvgDeleteElement(root);
+}
+
+static void bufn(MsvgElement *el, void *udata)
+{
+    MsvgRawAttribute *pattr;
+    MsvgPackedPath *pp;
+    long *nbytes;
+
+    // the payloads not shared with another element
+    nbytes = (long *)udata;
+    if (el->frattr && el->frattr->nrefs == 1) {
+        for (pattr=el->frattr; pattr!=NULL; pattr=pattr->nrattr)
+            *nbytes += strlen(pattr->key) + strlen(pattr->value) + 2;
+    }
+    if (el->fcontent && el->fcontent->nrefs == 1)
+        *nbytes += el->fcontent->len + 1;
+    if (el->eid == EID_POLYGON && el->ppolygonattr->nrefs == NULL)
+        *nbytes += el->ppolygonattr->npoints * 2 * sizeof(MsvgCoord);
+    if (el->eid == EID_PATH) {
+        pp = el->ppathattr->pp;
+        if (pp && pp->nrefs == 1)
+            *nbytes += pp->npoints * (2 * sizeof(MsvgCoord) + 1);
+    }
+}
+
+static double timeDups(MsvgElement *el, int deep, SumData *sd, long *nbytes)
+{
+    MsvgElement *copy[NDUPS];
+    clock_t t0;
+    double t;
+    int i;
+
+    t0 = clock();
+    for (i=0; i<NDUPS; i++)
+        copy[i] = deep ? deepDup(el) : MsvgDupElement(el, 1);
+    t = (double)(clock() - t0) / CLOCKS_PER_SEC / NDUPS;
+
+    *nbytes = 0;
+    MsvgWalkTree(copy[0], bufn, nbytes);
+    drawnSum(copy[NDUPS-1], sd);
+    for (i=0; i<NDUPS; i++) MsvgDeleteElement(copy[i]);
+
+    return t;
+}
+
+static int countRawAttributes(MsvgElement *el)
+{
+    MsvgRawAttribute *pattr;
+    int n = 0;
+
+    for (pattr=el->frattr; pattr!=NULL; pattr=pattr->nrattr) n++;
+
+    return n;
+}
+
+static int checkWrites(void)
+{
+    MsvgElement *root, *src, *dup, *poly, *pdup;
+    MsvgSubPath *sp;
+    int nfails = 0;
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    // a path with raw attributes, path-data not scanned yet and content
+    src = MsvgNewElement(EID_PATH, root);
+    MsvgAddRawAttribute(src, "d", "M0 0 L10 0 L10 10 Z");
+    MsvgAddRawAttribute(src, "fill", "red");
+    src->ppathattr->d = strdup("M0 0 L10 0 L10 10 Z");
+    MsvgAddContent(src, 3, "abc");
+    dup = MsvgDupElement(src, 0);
+    if (dup == NULL) return 1;
+    if (dup->frattr != src->frattr || src->frattr->nrefs != 2 ||
+        dup->fcontent != src->fcontent || src->fcontent->nrefs != 2 ||
+        dup->ppathattr->pp == NULL || dup->ppathattr->pp != src->ppathattr->pp ||
+        src->ppathattr->pp->nrefs != 2 || src->ppathattr->d != NULL) nfails++;
+
+    // every write gets its own copy
+    MsvgAddRawAttribute(dup, "stroke", "blue");
+    if (countRawAttributes(src) != 2 || countRawAttributes(dup) != 3 ||
+        src->frattr->nrefs != 1 || MsvgFindRawAttribute(src, "stroke")) nfails++;
+    MsvgDelRawAttribute(src, "fill");
+    if (countRawAttributes(src) != 1 || !MsvgFindRawAttribute(dup, "fill"))
+        nfails++;
+    MsvgAddContent(dup, 2, "de");
+    if (strcmp(src->fcontent->s, "abc") != 0 || strcmp(dup->fcontent->s, "abcde") != 0 ||
+        src->fcontent->nrefs != 1) nfails++;
+    sp = MsvgGetSubPath(dup);
+    if (sp) sp->spp[1].x = 20;
+    MsvgElementChanged(dup);
+    if (MsvgGetPackedPath(dup)->x[1] != 20 || MsvgGetPackedPath(src)->x[1] != 10 ||
+        src->ppathattr->pp->nrefs != 1) nfails++;
+
+    // a copy of subpaths set by program has them packed
+    pdup = MsvgDupElement(dup, 0);
+    if (pdup == NULL || pdup->ppathattr->sp != NULL ||
+        MsvgGetPackedPath(pdup)->x[1] != 20) nfails++;
+    if (pdup) MsvgDeleteElement(pdup);
+
+    // the points, the source is deleted first
+    poly = MsvgNewElement(EID_POLYGON, root);
+    MsvgAllocPointsToPolygonElement(poly, 2);
+    poly->ppolygonattr->points[2] = 5;
+    pdup = MsvgDupElement(poly, 0);
+    if (pdup == NULL || pdup->ppolygonattr->points != poly->ppolygonattr->points ||
+        *(poly->ppolygonattr->nrefs) != 2) nfails++;
+    if (pdup) {
+        MsvgDeleteElement(poly);
+        if (pdup->ppolygonattr->points[2] != 5 || *(pdup->ppolygonattr->nrefs) != 1)
+            nfails++;
+        MsvgUnshareGeometry(pdup);
+        pdup->ppolygonattr->points[2] = 6;
+        MsvgDeleteElement(pdup);
+    }
+
+    MsvgDeleteElement(dup);
+    MsvgDeleteElement(root);
+    printf("  writes:    %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int checkStops(void)
+{
+    MsvgElement *root, *grad, *stop, *copy;
+    int nfails = 0, n = 0;
+
+    root = buildTemplate(1);
+    MsvgNormalizeRawGradients(root);
+
+    // the inherited stops share the raw attributes of the referenced ones
+    grad = root->fson->fson;
+    for (stop=grad->fson; stop!=NULL; stop=stop->nsibling) n++;
+    for (copy=grad->nsibling; copy!=NULL; copy=copy->nsibling) {
+        if (copy->fson == NULL || copy->fson->frattr != grad->fson->frattr)
+            nfails++;
+    }
+    if (n != NSTOPS || grad->fson->frattr->nrefs != NGRADS + 1) nfails++;
+
+    MsvgDeleteElement(root);
+    printf("  stops:     %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int checkText(void)
+{
+    MsvgElement *root, *font, *el, *text, *group, *path;
+    MsvgBFont *bfont;
+    MsvgPackedPath *pp;
+    int nfails = 0, n = 0;
+
+    // a font with a glyph and a text drawing it four times
+    root = MsvgNewElement(EID_SVG, NULL);
+    font = MsvgNewElement(EID_FONT, root);
+    MsvgAddRawAttribute(font, "horiz-adv-x", "500");
+    el = MsvgNewElement(EID_FONTFACE, font);
+    MsvgAddRawAttribute(el, "font-family", "cow");
+    MsvgAddRawAttribute(el, "units-per-em", "1000");
+    el = MsvgNewElement(EID_MISSINGGLYPH, font);
+    MsvgAddRawAttribute(el, "d", "M0 0L500 0L500 700Z");
+    el = MsvgNewElement(EID_GLYPH, font);
+    MsvgAddRawAttribute(el, "unicode", "a");
+    MsvgAddRawAttribute(el, "d", "M0 0L400 0L400 500L0 500Z");
+    text = MsvgNewElement(EID_TEXT, root);
+    MsvgAddRawAttribute(text, "x", "10");
+    MsvgAddRawAttribute(text, "y", "100");
+    MsvgAddRawAttribute(text, "font-size", "10");
+    MsvgAddContent(text, 5, "aaaba");
+    MsvgRaw2CookedTree(root);
+
+    bfont = MsvgNewBFont(font);
+    group = bfont ? MsvgTextToPathGroup(text, bfont) : NULL;
+    if (group == NULL) {
+        nfails++;
+    } else {
+        pp = MsvgGetPackedPath(group->fson);
+        for (path=group->fson; path!=NULL; path=path->nsibling, n++) {
+            // placed with a translation, every char 5 px after the former
+            if (path->pctx->tmatrix.e != 10 + 5 * n ||
+                path->pctx->tmatrix.f != 100) nfails++;
+            if (n != 3 && MsvgGetPackedPath(path) != pp) nfails++;
+        }
+        if (n != 5 || pp == NULL || pp->nrefs != 4 || pp->x[1] != 4 ||
+            pp->y[2] != -5) nfails++;
+        MsvgDeleteElement(group);
+    }
+    if (bfont) MsvgDestroyBFont(bfont);
+
+    MsvgDeleteElement(root);
+    printf("  text:      %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root, *tpl;
+    SumData sd0, sd1, sd2;
+    double t1, t2;
+    long b1, b2;
+    int error, n = 2000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tcow [-n=nshapes] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        printf("===== %s\n", argv[0]);
+        MsvgRaw2CookedTree(root);
+        tpl = root;
+    } else {
+        root = buildTemplate(n);
+        printf("===== template of %d shapes\n", n * 3);
+        MsvgRaw2CookedTree(root);
+        tpl = MsvgFindIdCookedTree(root, "template");
+    }
+    MsvgPruneElement(tpl);
+
+    // the copies draw the same than the template
+    drawnSum(tpl, &sd0);
+    t1 = timeDups(tpl, 1, &sd1, &b1);
+    t2 = timeDups(tpl, 0, &sd2, &b2);
+    printf("  deep copy:     %g s, %ld payload bytes\n", t1, b1);
+    printf("  copy on write: %g s, %ld payload bytes\n", t2, b2);
+    if (sd1.nels != sd0.nels || sd1.sum != sd0.sum ||
+        sd2.nels != sd0.nels || sd2.sum != sd0.sum) nfails++;
+    printf("  copies:    %d fails\n", nfails);
+
+    if (argc == 0) {
+        nfails += checkWrites();
+        nfails += checkStops();
+        nfails += checkText();
+    }
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(tpl);
+    if (tpl != root) MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,534 @@
+/* tctree.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NLOOPS 20
+#define NIDS 1000
+
+static MsvgElement *buildRefMap(int n)
+{
+    MsvgElement *root, *defs, *grad, *stop, *mark, *row, *g, *el;
+    char s[40];
+    int i, j;
+
+    // a n x n grid of cells grouped by rows, every cell a group with id,
+    // a rect filled with a gradient and a mark used from the defs, and two
+    // groups in a reference cycle
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = n * 100;
+    root->psvgattr->vb_height = n * 100;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    root->pctx->stroke = 0X000000;
+
+    defs = MsvgNewElement(EID_DEFS, root);
+    grad = MsvgNewElement(EID_LINEARGRADIENT, defs);
+    MsvgSetElementId(grad, "grad");
+    grad->plgradattr->x2 = 1;
+    stop = MsvgNewElement(EID_STOP, grad);
+    stop->pstopattr->scolor = 0XFFFF00;
+    stop = MsvgNewElement(EID_STOP, grad);
+    stop->pstopattr->offset = 1;
+    stop->pstopattr->scolor = 0X0000FF;
+    mark = MsvgNewElement(EID_G, defs);
+    MsvgSetElementId(mark, "mark");
+    el = MsvgNewElement(EID_CIRCLE, mark);
+    el->pcircleattr->r = 10;
+    el = MsvgNewElement(EID_POLYGON, mark);
+    el->ppolygonattr->npoints = 3;
+    el->ppolygonattr->points = (MsvgCoord *)malloc(sizeof(MsvgCoord) * 6);
+    for (i=0; i<6; i++) el->ppolygonattr->points[i] = (i * 7) % 10;
+    el->pctx->fill = 0X00FF00;
+
+    g = MsvgNewElement(EID_G, defs);
+    MsvgSetElementId(g, "cycle1");
+    el = MsvgNewElement(EID_RECT, g);
+    el->prectattr->width = 10;
+    el = MsvgNewElement(EID_USE, g);
+    el->puseattr->refel = strdup("cycle2");
+    g = MsvgNewElement(EID_G, defs);
+    MsvgSetElementId(g, "cycle2");
+    el = MsvgNewElement(EID_USE, g);
+    el->puseattr->refel = strdup("cycle1");
+
+    for (i=0; i<n; i++) {
+        row = MsvgNewElement(EID_G, root);
+        TMSetTranslation(&(row->pctx->tmatrix), i*100, 0);
+        for (j=0; j<n; j++) {
+            g = MsvgNewElement(EID_G, row);
+            sprintf(s, "cell%d_%d", i, j);
+            MsvgSetElementId(g, s);
+            TMSetTranslation(&(g->pctx->tmatrix), 0, j*100);
+
+            el = MsvgNewElement(EID_RECT, g);
+            el->prectattr->x = 5;
+            el->prectattr->y = 5;
+            el->prectattr->width = 90;
+            el->prectattr->height = 90;
+            if ((i + j) % 2) {
+                el->pctx->fill = IRI_COLOR;
+                el->pctx->fill_iri = strdup("grad");
+            } else {
+                el->pctx->fill = 0XBBBBBB;
+            }
+
+            el = MsvgNewElement(EID_USE, g);
+            el->puseattr->refel = strdup("mark");
+            el->puseattr->x = 70;
+            el->puseattr->y = 30;
+            el->pctx->fill = 0XFF0000;
+        }
+    }
+
+    // a use of the cycle draws nothing
+    el = MsvgNewElement(EID_USE, root);
+    el->puseattr->refel = strdup("cycle1");
+
+    return root;
+}
+
+static int sameCoords(const MsvgCoord *c1, const MsvgCoord *c2, int n)
+{
+    if (n < 1) return 1;
+    if (c1 == NULL || c2 == NULL) return c1 == c2;
+    return memcmp(c1, c2, sizeof(MsvgCoord) * n) == 0;
+}
+
+static int samePacked(const MsvgPackedPath *pp1, const MsvgPackedPath *pp2)
+{
+    if (pp1 == NULL || pp2 == NULL) return pp1 == pp2;
+
+    return pp1->nsubpaths == pp2->nsubpaths && pp1->npoints == pp2->npoints &&
+           sameCoords(pp1->x, pp2->x, pp1->npoints) &&
+           sameCoords(pp1->y, pp2->y, pp1->npoints) &&
+           memcmp(pp1->cmd, pp2->cmd, pp1->npoints) == 0 &&
+           memcmp(pp1->fpoint, pp2->fpoint, sizeof(int) * (pp1->nsubpaths + 1)) == 0 &&
+           memcmp(pp1->closed, pp2->closed, pp1->nsubpaths) == 0;
+}
+
+static int sameElement(MsvgElement *el1, MsvgElement *el2)
+{
+    if (el1->eid != el2->eid) return 0;
+    if (el1->id == NULL || el2->id == NULL) {
+        if (el1->id != el2->id) return 0;
+    } else if (strcmp(el1->id, el2->id) != 0) return 0;
+
+    switch (el1->eid) {
+        case EID_RECT :
+            return memcmp(el1->prectattr, el2->prectattr,
+                          sizeof(MsvgRectAttributes)) == 0;
+        case EID_CIRCLE :
+            return memcmp(el1->pcircleattr, el2->pcircleattr,
+                          sizeof(MsvgCircleAttributes)) == 0;
+        case EID_ELLIPSE :
+            return memcmp(el1->pellipseattr, el2->pellipseattr,
+                          sizeof(MsvgEllipseAttributes)) == 0;
+        case EID_LINE :
+            return memcmp(el1->plineattr, el2->plineattr,
+                          sizeof(MsvgLineAttributes)) == 0;
+        case EID_POLYLINE :
+            return el1->ppolylineattr->npoints == el2->ppolylineattr->npoints &&
+                   sameCoords(el1->ppolylineattr->points, el2->ppolylineattr->points,
+                              el1->ppolylineattr->npoints * 2);
+        case EID_POLYGON :
+            return el1->ppolygonattr->npoints == el2->ppolygonattr->npoints &&
+                   sameCoords(el1->ppolygonattr->points, el2->ppolygonattr->points,
+                              el1->ppolygonattr->npoints * 2);
+        case EID_PATH :
+            return samePacked(MsvgGetPackedPath(el1), MsvgGetPackedPath(el2));
+        case EID_TEXT :
+            if (memcmp(el1->ptextattr, el2->ptextattr,
+                       sizeof(MsvgTextAttributes)) != 0) return 0;
+            if (el1->fcontent == NULL || el2->fcontent == NULL)
+                return el1->fcontent == el2->fcontent;
+            return strcmp(el1->fcontent->s, el2->fcontent->s) == 0;
+        default :
+            return 1;
+    }
+}
+
+/* the serialized elements of the linked tree, the compact and the expanded
+   ones are compared with them */
+
+typedef struct {
+    MsvgElement *el;
+    MsvgPaintCtx pctx;
+} SerItem;
+
+typedef struct {
+    int nitems;
+    SerItem *item;
+    int pos;
+    int bpsptr;         /* compare the paint servers pointers */
+    int nfails;
+} SerData;
+
+static void cntfn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SerData *sd;
+
+    sd = (SerData *)udata;
+    if (sd->item) {
+        sd->item[sd->nitems].el = el;
+        sd->item[sd->nitems].pctx = *pctx;
+    }
+    sd->nitems++;
+}
+
+static int sameMatrix(const TMatrix *t1, const TMatrix *t2)
+{
+    return t1->a == t2->a && t1->b == t2->b && t1->c == t2->c &&
+           t1->d == t2->d && t1->e == t2->e && t1->f == t2->f;
+}
+
+static void cmpfn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SerData *sd;
+    SerItem *it;
+    MsvgElement *newel, *newel2;
+
+    sd = (SerData *)udata;
+    if (sd->pos >= sd->nitems) {
+        sd->nfails++;
+        return;
+    }
+    it = &(sd->item[sd->pos++]);
+
+    if (!sameElement(it->el, el)) sd->nfails++;
+    if (!MsvgSamePaintState(&(it->pctx), pctx)) sd->nfails++;
+    if (!sameMatrix(&(it->pctx.tmatrix), &(pctx->tmatrix))) sd->nfails++;
+    if ((it->pctx.fill_bps == NULL) != (pctx->fill_bps == NULL) ||
+        (it->pctx.stroke_bps == NULL) != (pctx->stroke_bps == NULL)) sd->nfails++;
+    if (sd->bpsptr && (it->pctx.fill_bps != pctx->fill_bps ||
+        it->pctx.stroke_bps != pctx->stroke_bps)) sd->nfails++;
+
+    // a renderer can transform it
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    newel2 = MsvgTransformCookedElement(it->el, &(it->pctx), 0);
+    if ((newel == NULL) != (newel2 == NULL)) sd->nfails++;
+    if (newel) MsvgDeleteElement(newel);
+    if (newel2) MsvgDeleteElement(newel2);
+}
+
+static int checkSer(SerData *sd, MsvgElement *expanded, MsvgCTree *ct)
+{
+    int nfails = 0;
+
+    // the compact tree shares the paint servers of the linked one
+    sd->pos = sd->nfails = 0;
+    sd->bpsptr = 1;
+    MsvgSerCTree(ct, cmpfn, sd, 1);
+    if (sd->pos != sd->nitems) sd->nfails++;
+    nfails += sd->nfails;
+
+    sd->pos = sd->nfails = 0;
+    sd->bpsptr = 0;
+    MsvgSerCookedTree(expanded, cmpfn, sd, 1);
+    if (sd->pos != sd->nitems) sd->nfails++;
+    nfails += sd->nfails;
+
+    return nfails;
+}
+
+static int sameCounts(const MsvgTreeCounts *tc1, const MsvgTreeCounts *tc2)
+{
+    int i;
+
+    for (i=0; i<=EID_LAST; i++) {
+        if (tc1->nelem[i] != tc2->nelem[i]) return 0;
+    }
+
+    return tc1->totelem == tc2->totelem && tc1->totelwid == tc2->totelwid;
+}
+
+/* every element with id in preorder, the compact nodes have the same order */
+
+typedef struct {
+    int nels;
+    MsvgElement **els;
+    int nids;
+    int npctxs;
+    long pctxmem;       /* memory used by the paint contexts */
+} IdData;
+
+static int strSize(const char *s)
+{
+    return s ? strlen(s) + 1 : 0;
+}
+
+static void idfn(MsvgElement *el, void *udata)
+{
+    IdData *id;
+
+    id = (IdData *)udata;
+    if (id->els) id->els[id->nels] = el;
+    id->nels++;
+    if (el->id) id->nids++;
+    if (el->pctx) {
+        id->npctxs++;
+        id->pctxmem += sizeof(MsvgPaintCtx) + strSize(el->pctx->fill_iri) +
+                       strSize(el->pctx->stroke_iri) +
+                       strSize(el->pctx->sfont_family);
+    }
+}
+
+static int checkStyles(MsvgCTree *ct, IdData *id)
+{
+    MsvgPaintCtx *p1, *p2;
+    int i, j, nfails = 0;
+
+    if (id->nels != ct->nnodes) return 1;
+
+    for (i=0; i<id->nels; i++) {
+        if (id->els[i]->eid != ct->node[i].eid) nfails++;
+        if (id->els[i]->pctx &&
+            ct->node[i].pmask != MsvgPaintCtxFieldsSet(id->els[i]->pctx)) nfails++;
+        if ((ct->node[i].pctx >= 0) != ((ct->node[i].pmask & ~PCTX_TMATRIX) != 0))
+            nfails++;
+        if ((ct->node[i].tmatrix >= 0) != ((ct->node[i].pmask & PCTX_TMATRIX) != 0))
+            nfails++;
+    }
+
+    // the interned styles are all different, only some in big trees
+    for (i=0; i<ct->npctxs && i<NIDS; i++) {
+        for (j=i+1; j<ct->npctxs && j<NIDS; j++) {
+            p1 = &(ct->pctx[i]);
+            p2 = &(ct->pctx[j]);
+            if (MsvgSamePaintState(p1, p2) && p1->fill_iri == p2->fill_iri &&
+                p1->stroke_iri == p2->stroke_iri &&
+                p1->sfont_family == p2->sfont_family &&
+                p1->ifont_family == p2->ifont_family &&
+                p1->font_style == p2->font_style &&
+                p1->font_weight == p2->font_weight &&
+                p1->font_size == p2->font_size) nfails++;
+        }
+    }
+
+    return nfails;
+}
+
+static int checkIds(MsvgElement *root, MsvgCTree *ct, IdData *id)
+{
+    MsvgElement *el;
+    int i, k, nid, step, nfails = 0;
+
+    if (id->nels != ct->nnodes) return 1;
+
+    // both are linear searches, only some ids are checked in big trees
+    step = id->nids / NIDS + 1;
+    for (i=0, nid=0; i<id->nels; i++) {
+        if (id->els[i]->id == NULL) continue;
+        if (nid++ % step) continue;
+        el = MsvgFindIdCookedTree(root, id->els[i]->id);
+        k = MsvgFindIdCTree(ct, id->els[i]->id);
+        if (el == NULL) {
+            if (k >= 0) nfails++;
+        } else if (k < 0 || id->els[k] != el) {
+            nfails++;
+        }
+    }
+    if (MsvgFindIdCTree(ct, "not an id") >= 0) nfails++;
+
+    return nfails;
+}
+
+static int checkLinks(MsvgCTree *ct)
+{
+    MsvgCNode *n;
+    int i, son, nfails = 0;
+
+    // the sons of every node are its subtree
+    for (i=0; i<ct->nnodes; i++) {
+        n = &(ct->node[i]);
+        if (n->end <= i || n->end > ct->nnodes) nfails++;
+        son = n->end > i + 1 ? i + 1 : -1;
+        for (; son>=0; son=ct->node[son].nsibling) {
+            if (ct->node[son].father != i) nfails++;
+            if (ct->node[son].end > n->end) nfails++;
+            if (ct->node[son].nsibling >= 0 &&
+                ct->node[son].nsibling != ct->node[son].end) nfails++;
+        }
+    }
+
+    return nfails;
+}
+
+static void nopfn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    (*(int *)udata)++;
+}
+
+static void timeSweeps(MsvgElement *root, MsvgCTree *ct, IdData *id)
+{
+    MsvgTreeCounts tc;
+    clock_t t0;
+    double t[6];
+    int i, j, k, n = 0;
+
+    // without id index the linked tree is searched too
+    t0 = clock();
+    for (i=0; i<NLOOPS; i++) MsvgSerCookedTree(root, nopfn, &n, 0);
+    t[0] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    t0 = clock();
+    for (i=0; i<NLOOPS; i++) MsvgSerCTree(ct, nopfn, &n, 0);
+    t[1] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    t0 = clock();
+    for (i=0; i<NLOOPS; i++) MsvgCalcCountsCookedTree(root, &tc);
+    t[2] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    t0 = clock();
+    for (i=0; i<NLOOPS; i++) MsvgCalcCountsCTree(ct, &tc);
+    t[3] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    // the last id, a whole sweep
+    for (k=id->nels-1; k>0 && id->els[k]->id==NULL; k--);
+    t[4] = t[5] = 0;
+    if (k > 0 && root->fson) {
+        t0 = clock();
+        for (j=0; j<NLOOPS; j++) MsvgFindIdCookedTree(root->fson, id->els[k]->id);
+        t[4] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+        t0 = clock();
+        for (j=0; j<NLOOPS; j++) MsvgFindIdCTree(ct, id->els[k]->id);
+        t[5] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    }
+    printf("  serialization: %g s linked, %g s compact\n", t[0]/NLOOPS, t[1]/NLOOPS);
+    printf("  counts:        %g s linked, %g s compact\n", t[2]/NLOOPS, t[3]/NLOOPS);
+    printf("  id scan:       %g s linked, %g s compact\n", t[4]/NLOOPS, t[5]/NLOOPS);
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root, *expanded;
+    MsvgCTree *ct;
+    MsvgTreeCounts tc1, tc2, tc3;
+    SerData sd;
+    IdData id;
+    long mem;
+    int error, n = 200, nfails = 0, nf;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tctree [-n=cells] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildRefMap(n);
+        printf("===== %d x %d cells\n", n, n);
+    }
+
+    ct = MsvgCompactTree(root);
+    if (ct == NULL) {
+        printf("Error compacting the tree\n");
+        MsvgDeleteElement(root);
+        return 0;
+    }
+    memset(&id, 0, sizeof(IdData));
+    MsvgWalkTree(root, idfn, &id);
+    id.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (id.nels + 1));
+    if (id.els == NULL) {
+        printf("Out of memory\n");
+        return 0;
+    }
+    id.nels = id.nids = id.npctxs = 0;
+    id.pctxmem = 0;
+    MsvgWalkTree(root, idfn, &id);
+
+    mem = sizeof(MsvgCTree) + (long)ct->nnodes * sizeof(MsvgCNode) +
+          (long)ct->npctxs * sizeof(MsvgPaintCtx) +
+          (long)ct->nmatrices * sizeof(TMatrix) + ct->strsize + ct->datasize;
+    printf("  %d nodes, max depth %d, %ld bytes (%d by node)\n", ct->nnodes,
+           ct->maxdepth, mem, (int)(mem / ct->nnodes));
+    // the compact nodes have the indexes and the mask
+    printf("  paint contexts: %d, %ld bytes in the tree, %d styles and %d "
+           "matrices, %ld bytes compact\n", id.npctxs, id.pctxmem, ct->npctxs,
+           ct->nmatrices, (long)ct->npctxs * sizeof(MsvgPaintCtx) +
+           (long)ct->nmatrices * sizeof(TMatrix) + (long)ct->nnodes * 3 * sizeof(int));
+
+    nf = checkLinks(ct);
+    printf("  links:         %d fails\n", nf);
+    nfails += nf;
+
+    nf = checkStyles(ct, &id);
+    printf("  styles:        %d fails\n", nf);
+    nfails += nf;
+
+    expanded = MsvgExpandTree(ct);
+    if (expanded == NULL) {
+        printf("Error expanding the tree\n");
+        MsvgDestroyCTree(ct);
+        MsvgDeleteElement(root);
+        return 0;
+    }
+
+    MsvgCalcCountsCookedTree(root, &tc1);
+    MsvgCalcCountsCTree(ct, &tc2);
+    MsvgCalcCountsCookedTree(expanded, &tc3);
+    nf = !sameCounts(&tc1, &tc2) + !sameCounts(&tc1, &tc3);
+    printf("  counts:        %d fails\n", nf);
+    nfails += nf;
+
+    memset(&sd, 0, sizeof(SerData));
+    MsvgSerCookedTree(root, cntfn, &sd, 1);
+    sd.item = (SerItem *)malloc(sizeof(SerItem) * (sd.nitems + 1));
+    if (sd.item == NULL) {
+        printf("Out of memory\n");
+        return 0;
+    }
+    sd.nitems = 0;
+    MsvgSerCookedTree(root, cntfn, &sd, 1);
+
+    nf = checkSer(&sd, expanded, ct);
+    printf("  serialization: %d fails (%d elements)\n", nf, sd.nitems);
+    nfails += nf;
+
+    nf = checkIds(root, ct, &id);
+    printf("  ids:           %d fails (%d ids)\n", nf, id.nids);
+    nfails += nf;
+
+    timeSweeps(root, ct, &id);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    free(sd.item);
+    free(id.els);
+    MsvgDeleteElement(expanded);
+    MsvgDestroyCTree(ct);
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
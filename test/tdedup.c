@@ -0,0 +1,322 @@
+/* tdedup.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define ICON "M10 2C14 2 18 6 18 10C18 14 14 18 10 18C6 18 2 14 2 10C2 6 6 2 10 2Z" \
+             "M7 7L13 7L13 13L7 13Z M9 4Q10 1 11 4T13 4"
+#define STAR "10,0 12,7 20,7 14,11 16,19 10,14 4,19 6,11 0,7 8,7"
+
+static MsvgElement *buildTiles(int n)
+{
+    MsvgElement *root, *g, *el;
+    char s[100];
+    int i, j;
+
+    // a raw tree of n x n tiles, every tile a group placed with a transform
+    // with the same icon and star and a path of its own
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    sprintf(s, "0 0 %d %d", n * 20, n * 20);
+    MsvgAddRawAttribute(root, "viewBox", s);
+
+    for (i=0; i<n; i++) {
+        for (j=0; j<n; j++) {
+            g = MsvgNewElement(EID_G, root);
+            sprintf(s, "translate(%d %d)", i * 20, j * 20);
+            MsvgAddRawAttribute(g, "transform", s);
+            el = MsvgNewElement(EID_PATH, g);
+            MsvgAddRawAttribute(el, "d", ICON);
+            el = MsvgNewElement(EID_POLYGON, g);
+            MsvgAddRawAttribute(el, "points", STAR);
+            el = MsvgNewElement(EID_PATH, g);
+            sprintf(s, "M0 0 L%d %d L0 19", i, j);
+            MsvgAddRawAttribute(el, "d", s);
+        }
+    }
+
+    return root;
+}
+
+typedef struct {
+    int ngeoms;
+    double bytes;       /* every shared buffer counted once */
+} MemData;
+
+static void mufn(MsvgElement *el, void *udata)
+{
+    MemData *md;
+    MsvgPackedPath *pp;
+    MsvgPolylineAttributes *pa;
+
+    md = (MemData *)udata;
+    switch (el->eid) {
+        case EID_PATH :
+        case EID_GLYPH :
+        case EID_MISSINGGLYPH :
+            pp = MsvgGetPackedPath(el);
+            if (pp == NULL) return;
+            md->ngeoms++;
+            md->bytes += (double)(sizeof(MsvgPackedPath) +
+                         pp->npoints * (2 * sizeof(MsvgCoord) + 1) +
+                         (pp->nsubpaths + 1) * sizeof(int) + pp->nsubpaths) /
+                         pp->nrefs;
+            break;
+        case EID_POLYLINE :
+        case EID_POLYGON :
+            // the same layout
+            pa = (el->eid == EID_POLYLINE) ? el->ppolylineattr :
+                 (MsvgPolylineAttributes *)el->ppolygonattr;
+            if (pa->points == NULL) return;
+            md->ngeoms++;
+            if (pa->nrefs)
+                md->bytes += (double)(pa->npoints * 2 * sizeof(MsvgCoord) +
+                             sizeof(int)) / *(pa->nrefs);
+            else
+                md->bytes += pa->npoints * 2 * sizeof(MsvgCoord);
+            break;
+        default :
+            break;
+    }
+}
+
+static double geomBytes(MsvgElement *root, int *ngeoms)
+{
+    MemData md;
+
+    md.ngeoms = 0;
+    md.bytes = 0;
+    MsvgWalkTree(root, mufn, &md);
+    if (ngeoms) *ngeoms = md.ngeoms;
+
+    return md.bytes;
+}
+
+typedef struct {
+    int nels;
+    double sum;         /* of the drawn coordinates, in order */
+} SumData;
+
+static void sumCoords(SumData *sd, const MsvgCoord *x, const MsvgCoord *y,
+                      int n, int stride)
+{
+    int i;
+
+    for (i=0; i<n*stride; i+=stride)
+        sd->sum = sd->sum * 0.5 + x[i] + 2 * y[i];
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SumData *sd;
+    MsvgElement *newel;
+    MsvgPackedPath *pp;
+
+    sd = (SumData *)udata;
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    sd->nels++;
+    switch (newel->eid) {
+        case EID_POLYLINE :
+            sumCoords(sd, newel->ppolylineattr->points,
+                      newel->ppolylineattr->points + 1,
+                      newel->ppolylineattr->npoints, 2);
+            break;
+        case EID_POLYGON :
+            sumCoords(sd, newel->ppolygonattr->points,
+                      newel->ppolygonattr->points + 1,
+                      newel->ppolygonattr->npoints, 2);
+            break;
+        case EID_PATH :
+            pp = MsvgGetPackedPath(newel);
+            if (pp) sumCoords(sd, pp->x, pp->y, pp->npoints, 1);
+            break;
+        default :
+            break;
+    }
+    MsvgDeleteElement(newel);
+}
+
+static void drawnSum(MsvgElement *root, SumData *sd)
+{
+    sd->nels = 0;
+    sd->sum = 0;
+    MsvgSerCookedTree(root, sufn, sd, 0);
+}
+
+static MsvgElement *newPolygon(MsvgElement *father, double x)
+{
+    MsvgElement *el;
+
+    el = MsvgNewElement(EID_POLYGON, father);
+    MsvgAllocPointsToPolygonElement(el, 3);
+    el->ppolygonattr->points[0] = x;
+    el->ppolygonattr->points[2] = x + 10;
+    el->ppolygonattr->points[5] = 10;
+
+    return el;
+}
+
+static int checkCow(void)
+{
+    MsvgElement *root, *g, *p1, *p2, *p3, *a1, *a2, *a3;
+    MsvgPackedPath *pp;
+    MsvgSubPath *sp;
+    int nfails = 0;
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    // three polygons and three paths, two of each the same
+    p1 = newPolygon(root, 0);
+    p2 = newPolygon(root, 0);
+    p3 = newPolygon(root, 5);
+    a1 = MsvgNewElement(EID_PATH, root);
+    a1->ppathattr->pp = MsvgScanPackedPath("M0 0 L10 0 L10 10 Z");
+    a2 = MsvgNewElement(EID_PATH, root);
+    a2->ppathattr->pp = MsvgScanPackedPath("M0 0 L10 0 L10 10 Z");
+    a3 = MsvgNewElement(EID_PATH, root);
+    a3->ppathattr->pp = MsvgScanPackedPath("M0 0 L10 0 L10 10 L0 10 Z");
+    if (MsvgDedupGeometry(root) != 2) nfails++;
+    if (p1->ppolygonattr->points != p2->ppolygonattr->points ||
+        p1->ppolygonattr->nrefs == NULL || *(p1->ppolygonattr->nrefs) != 2 ||
+        p3->ppolygonattr->nrefs != NULL) nfails++;
+    if (a1->ppathattr->pp != a2->ppathattr->pp || a1->ppathattr->pp->nrefs != 2 ||
+        a3->ppathattr->pp->nrefs != 1) nfails++;
+    // nothing more to share
+    if (MsvgDedupGeometry(root) != 0) nfails++;
+
+    // a copy written in place
+    if (!MsvgUnshareGeometry(p2)) nfails++;
+    p2->ppolygonattr->points[0] = 99;
+    if (p1->ppolygonattr->points[0] != 0 || p2->ppolygonattr->nrefs != NULL ||
+        *(p1->ppolygonattr->nrefs) != 1) nfails++;
+    // the last one owns it again
+    if (!MsvgUnshareGeometry(p1) || p1->ppolygonattr->nrefs != NULL) nfails++;
+
+    // points allocated again and deleted elements
+    p2->ppolygonattr->points[0] = 0;
+    MsvgDedupGeometry(root);
+    MsvgAllocPointsToPolygonElement(p2, 4);
+    if (p1->ppolygonattr->points[2] != 10 || *(p1->ppolygonattr->nrefs) != 1)
+        nfails++;
+    MsvgAllocPointsToPolygonElement(p2, 3);
+    p2->ppolygonattr->points[2] = 10;
+    p2->ppolygonattr->points[5] = 10;
+    if (MsvgDedupGeometry(root) != 1) nfails++;
+    MsvgDeleteElement(p1);
+    if (p2->ppolygonattr->points[2] != 10 || *(p2->ppolygonattr->nrefs) != 1)
+        nfails++;
+
+    // a path changed through its subpaths
+    sp = MsvgGetSubPath(a2);
+    if (sp) sp->spp[1].x = 20;
+    MsvgElementChanged(a2);
+    pp = MsvgGetPackedPath(a2);
+    if (pp == NULL || pp->x[1] != 20 || pp->nrefs != 1 ||
+        a1->ppathattr->pp->x[1] != 10 || a1->ppathattr->pp->nrefs != 1) nfails++;
+    // and a deleted one
+    sp = MsvgGetSubPath(a2);
+    if (sp) sp->spp[1].x = 10;
+    MsvgElementChanged(a2);
+    MsvgDeleteElement(a2);
+    if (a1->ppathattr->pp->nrefs != 1) nfails++;
+
+    // the optimized elements get their own points
+    g = MsvgNewElement(EID_G, root);
+    TMSetTranslation(&(g->pctx->tmatrix), 100, 0);
+    p1 = newPolygon(g, 0);
+    a2 = MsvgNewElement(EID_PATH, g);
+    a2->ppathattr->pp = MsvgScanPackedPath("M0 0 L10 0 L10 10 Z");
+    if (MsvgDedupGeometry(root) != 2) nfails++;
+    MsvgOptimizeCookedTree(root);
+    if (p1->ppolygonattr->points[0] != 100 || p2->ppolygonattr->points[0] != 0 ||
+        a2->ppathattr->pp->x[0] != 100 || a1->ppathattr->pp->x[0] != 0 ||
+        a1->ppathattr->pp->nrefs != 1) nfails++;
+
+    MsvgDeleteElement(root);
+    printf("  copy on write: %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    SumData sd1, sd2;
+    clock_t t0;
+    double b1, b2, t;
+    int error, n = 100, ngeoms, nshared, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tdedup [-n=tiles] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildTiles(n);
+        printf("===== %d x %d tiles\n", n, n);
+    }
+    MsvgRaw2CookedTree(root);
+
+    b1 = geomBytes(root, &ngeoms);
+    drawnSum(root, &sd1);
+
+    t0 = clock();
+    nshared = MsvgDedupGeometry(root);
+    t = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    b2 = geomBytes(root, NULL);
+    printf("  %d of %d geometries shared in %g s\n", nshared, ngeoms, t);
+    printf("  geometry memory: %.0f bytes, %.0f bytes deduplicated (%.1f%%)\n",
+           b1, b2, b1 > 0 ? b2 * 100 / b1 : 100);
+
+    // the same drawing, and nothing more to share
+    drawnSum(root, &sd2);
+    if (sd1.nels != sd2.nels || sd1.sum != sd2.sum) nfails++;
+    if (MsvgDedupGeometry(root) != 0) nfails++;
+    // the icon and the star of every tile but the first
+    if (argc == 0 && nshared != 2 * (n * n - 1)) nfails++;
+    printf("  shared geometry: %d fails\n", nfails);
+
+    if (argc == 0) nfails += checkCow();
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
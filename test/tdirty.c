@@ -0,0 +1,360 @@
+/* tdirty.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "msvg.h"
+#include "tgrid.h"
+
+#define NBATCHS 200
+
+/* the world bboxes of the elements before the changes */
+
+typedef struct {
+    MsvgElement *el;        /* can be deleted, it is only compared */
+    int isgroup;
+    MsvgBox box;
+    int found;
+} Snap;
+
+typedef struct {
+    int nsnaps;
+    Snap *snap;
+    int nels;
+    MsvgElement **els;
+    MsvgBox dirty;
+    int nfails;
+} TestData;
+
+static void cntfn(MsvgElement *el, void *udata)
+{
+    TestData *td;
+
+    td = (TestData *)udata;
+    if (el->father == NULL) return;
+    if (td->snap && el->wbbox_ok) {
+        td->snap[td->nsnaps].el = el;
+        td->snap[td->nsnaps].isgroup = el->eid == EID_G;
+        td->snap[td->nsnaps].box = el->wbbox;
+        td->snap[td->nsnaps].found = 0;
+    }
+    if (el->wbbox_ok) td->nsnaps++;
+    if (td->els) td->els[td->nels] = el;
+    td->nels++;
+}
+
+static int cmpSnap(const void *p1, const void *p2)
+{
+    const Snap *s1 = (const Snap *)p1, *s2 = (const Snap *)p2;
+
+    if (s1->el < s2->el) return -1;
+    if (s1->el > s2->el) return 1;
+    return 0;
+}
+
+static int takeSnapshot(MsvgElement *root, TestData *td)
+{
+    // exact boxes, they don't change the journal
+    MsvgCalcCookedWorldBBoxes(root);
+
+    td->nsnaps = td->nels = 0;
+    td->snap = NULL;
+    td->els = NULL;
+    MsvgWalkTree(root, cntfn, td);
+    td->snap = (Snap *)malloc(sizeof(Snap) * (td->nsnaps + 1));
+    td->els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (td->nels + 1));
+    if (td->snap == NULL || td->els == NULL) return 0;
+
+    td->nsnaps = td->nels = 0;
+    MsvgWalkTree(root, cntfn, td);
+    qsort(td->snap, td->nsnaps, sizeof(Snap), cmpSnap);
+
+    return 1;
+}
+
+static int inside(const MsvgBox *box, const MsvgBox *dirty)
+{
+    if (box->gminx > box->gmaxx) return 1; // empty box
+    return box->gminx >= dirty->gminx - 1e-6 && box->gmaxx <= dirty->gmaxx + 1e-6 &&
+           box->gminy >= dirty->gminy - 1e-6 && box->gmaxy <= dirty->gmaxy + 1e-6;
+}
+
+static int sameBox(const MsvgBox *b1, const MsvgBox *b2)
+{
+    return b1->gminx == b2->gminx && b1->gmaxx == b2->gmaxx &&
+           b1->gminy == b2->gminy && b1->gmaxy == b2->gmaxy;
+}
+
+static void chkfn(MsvgElement *el, void *udata)
+{
+    TestData *td;
+    Snap key, *s;
+
+    // a changed or new box must be in the dirty box, the groups boxes
+    // change with the sons ones
+    td = (TestData *)udata;
+    if (!el->wbbox_ok || el->father == NULL) return;
+    if (el->eid == EID_G) return;
+    key.el = el;
+    s = bsearch(&key, td->snap, td->nsnaps, sizeof(Snap), cmpSnap);
+    if (s) s->found = 1;
+    if (s && sameBox(&(s->box), &(el->wbbox))) return;
+    if (!inside(&(el->wbbox), &(td->dirty))) td->nfails++;
+    if (s && !inside(&(s->box), &(td->dirty))) td->nfails++;
+}
+
+static int checkDirty(MsvgElement *root, TestData *td)
+{
+    int i;
+
+    MsvgCalcCookedWorldBBoxes(root);
+    MsvgWalkTree(root, chkfn, td);
+
+    // and the deleted ones too
+    for (i=0; i<td->nsnaps; i++) {
+        if (td->snap[i].found || td->snap[i].isgroup) continue;
+        if (!inside(&(td->snap[i].box), &(td->dirty))) td->nfails++;
+    }
+
+    return td->nfails;
+}
+
+static void mutate(MsvgElement *el)
+{
+    MsvgElement *newel;
+    TMatrix t, t2;
+
+    switch (rand() % 4) {
+        case 0 :
+            if (el->pctx == NULL) break;
+            TMSetTranslation(&t, rand() % 21 - 10, rand() % 21 - 10);
+            TMMpy(&t2, &t, &(el->pctx->tmatrix));
+            MsvgSetElementTMatrix(el, &t2);
+            break;
+        case 1 :
+            if (el->pctx == NULL) break;
+            el->pctx->stroke = 0X0000FF;
+            el->pctx->stroke_width = rand() % 8 + 1;
+            MsvgElementChanged(el);
+            break;
+        case 2 :
+            if (el->fson) break;
+            MsvgDeleteElement(el);
+            break;
+        default :
+            if (el->fson) break;
+            newel = MsvgDupElement(el, 0);
+            if (newel == NULL) break;
+            MsvgSetElementId(newel, NULL);
+            if (newel->pctx) TMSetTranslation(&(newel->pctx->tmatrix), 7, 7);
+            MsvgInsertNSiblingElement(newel, el);
+            break;
+    }
+}
+
+static int runBatchs(MsvgElement *root, double *area)
+{
+    TestData td;
+    MsvgChangeJournal *jn;
+    MsvgBox world;
+    int i, j, nmut, nfails = 0;
+
+    world = root->psvgattr->journal->world;
+    *area = 0;
+
+    for (i=0; i<NBATCHS; i++) {
+        if (!takeSnapshot(root, &td)) return 1;
+        // the snapshot boxes are the journal ones
+        MsvgGetDirtyBox(root, NULL);
+
+        nmut = rand() % 3 + 1;
+        for (j=0; j<nmut && td.nels>nmut; j++) {
+            // a deleted element can't be mutated again
+            mutate(td.els[rand() % (td.nels / nmut) + j * (td.nels / nmut)]);
+        }
+
+        jn = root->psvgattr->journal;
+        td.nfails = 0;
+        // a change of an element that draws nothing is not dirty
+        if (!MsvgGetDirtyBox(root, &(td.dirty))) {
+            td.dirty.gminx = td.dirty.gminy = 1e9;
+            td.dirty.gmaxx = td.dirty.gmaxy = -1e9;
+        } else {
+            *area += (td.dirty.gmaxx - td.dirty.gminx) *
+                     (td.dirty.gmaxy - td.dirty.gminy);
+        }
+        if (jn->nchanges != 0) nfails++;
+        nfails += checkDirty(root, &td);
+
+        free(td.snap);
+        free(td.els);
+    }
+
+    *area /= NBATCHS * (world.gmaxx - world.gminx) * (world.gmaxy - world.gminy);
+
+    return nfails;
+}
+
+static int checkRecords(MsvgElement *root)
+{
+    MsvgChangeJournal *jn;
+    MsvgElement *cell, *rect, *newel;
+    MsvgBox box, oldbox;
+    int nfails = 0;
+
+    jn = root->psvgattr->journal;
+    MsvgGetDirtyBox(root, NULL);
+
+    // a moved rect records its old and new boxes
+    cell = root->fson->fson;
+    rect = cell->fson;
+    oldbox = rect->wbbox;
+    rect->prectattr->x += 10;
+    MsvgElementChanged(rect);
+    if (jn->nchanges != 1 || jn->change[0].el != rect ||
+        jn->change[0].type != CHANGE_MODIFIED || jn->change[0].wholetree ||
+        !sameBox(&(jn->change[0].oldbox), &oldbox) ||
+        jn->change[0].newbox.gminx != oldbox.gminx + 10) nfails++;
+
+    // an inserted element and a deleted one
+    newel = MsvgDupElement(rect, 0);
+    MsvgInsertSonElement(newel, cell->nsibling);
+    oldbox = cell->fson->nsibling->wbbox;
+    MsvgDeleteElement(cell->fson->nsibling);
+    if (jn->nchanges != 3 || jn->change[1].type != CHANGE_INSERTED ||
+        jn->change[1].el != newel || jn->change[2].type != CHANGE_REMOVED ||
+        !sameBox(&(jn->change[2].oldbox), &oldbox)) nfails++;
+
+    if (!MsvgGetDirtyBox(root, &box)) nfails++;
+    if (box.gmaxx > 200 || box.gmaxy > 200) nfails++;
+    if (MsvgGetDirtyBox(root, &box)) nfails++;
+
+    // a new view makes all the tree dirty
+    MsvgSetElementTMatrix(root, &(root->pctx->tmatrix));
+    if (jn->nchanges != 1 || !jn->change[0].wholetree) nfails++;
+    if (!MsvgGetDirtyBox(root, &box)) nfails++;
+    if (!sameBox(&box, &(jn->world))) nfails++;
+
+    printf("  records:        %d fails\n", nfails);
+
+    return nfails;
+}
+
+static void jnfn(MsvgElement *el, void *udata)
+{
+    MsvgChangeJournal *jn;
+    int *nfails, i;
+
+    // all the elements are changed by the optimizer
+    if (el->father == NULL) return;
+    jn = MsvgFindFirstFather(el)->psvgattr->journal;
+    if (jn->wholetree) return;
+    for (i=0; i<jn->nchanges; i++)
+        if (jn->change[i].el == el) return;
+    nfails = (int *)udata;
+    (*nfails)++;
+}
+
+static int checkOptimized(void)
+{
+    MsvgElement *root, *row, *cell;
+    char id[20];
+    int nfails = 0;
+
+    // the cells have an id, so the optimizer keeps them and changes them
+    // and their sons in place, none is left at the origin
+    root = buildGridMap(3, TGRID_ROWS);
+    for (row=root->fson; row!=NULL; row=row->nsibling) {
+        for (cell=row->fson; cell!=NULL; cell=cell->nsibling) {
+            sprintf(id, "c%p", (void *)cell);
+            MsvgSetElementId(cell, id);
+            cell->pctx->tmatrix.e += 10;
+        }
+    }
+    MsvgBuildChangeJournal(root);
+    MsvgGetDirtyBox(root, NULL);
+
+    if (MsvgOptimizeCookedTree(root) == 0) nfails++;
+    MsvgWalkTree(root, jnfn, &nfails);
+
+    MsvgDeleteElement(root);
+    printf("  optimized:      %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    double area;
+    int error, n = 30, nfails = 0, nf;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 2) {
+        printf("Usage: tdirty [-n=cells] [file]\n");
+        return 0;
+    }
+
+    srand(1);
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildGridMap(n, TGRID_ROWS);
+        printf("===== %d x %d cells\n", n, n);
+    }
+
+    if (!MsvgBuildChangeJournal(root)) {
+        printf("Error building the journal\n");
+        MsvgDeleteElement(root);
+        return 0;
+    }
+
+    if (argc == 0) {
+        nfails += checkRecords(root);
+        nfails += checkOptimized();
+    }
+
+    nf = runBatchs(root, &area);
+    printf("  random changes: %d fails, dirty area %.4f of the tree\n", nf, area);
+    nfails += nf;
+
+    MsvgBuildRTree(root);
+    nf = runBatchs(root, &area);
+    printf("  with R-tree:    %d fails, dirty area %.4f of the tree\n", nf, area);
+    nfails += nf;
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
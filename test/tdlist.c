@@ -0,0 +1,200 @@
+/* tdlist.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "msvg.h"
+
+typedef struct {
+    int nels;       // num of elements drawn
+    double sumx;    // sum of x coordinates, to check something is done
+} UserData;
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    MsvgElement *newel;
+    UserData *ud;
+
+    // do the same work a renderer do for each element
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    MsvgDeleteElement(newel);
+
+    ud = (UserData *)udata;
+    ud->nels += 1;
+}
+
+static void dlufn(MsvgDisplayList *dl, MsvgDLRecord *rec,
+                  MsvgPaintCtx *pctx, void *udata)
+{
+    UserData *ud;
+
+    // the points are transformed, like a renderer needs them
+    ud = (UserData *)udata;
+    ud->nels += 1;
+    if (rec->npoints > 0) ud->sumx += MsvgDLRecordPoints(dl, rec)[0].x;
+}
+
+typedef struct {
+    TMatrix view;   // view of the replay
+    int identity;
+    int nfails;
+} CheckData;
+
+static void chkfn(MsvgDisplayList *dl, MsvgDLRecord *rec,
+                  MsvgPaintCtx *pctx, void *udata)
+{
+    CheckData *cd;
+    MsvgSubPathPoint *p;
+    double x, y;
+    int i;
+
+    // the points are transformed once in a replay, or not at all
+    cd = (CheckData *)udata;
+    p = MsvgDLRecordPoints(dl, rec);
+    if (MsvgDLRecordPoints(dl, rec) != p) cd->nfails++;
+    if (cd->identity && p != &(dl->point[rec->fpoint])) cd->nfails++;
+    for (i=0; i<rec->npoints; i++) {
+        x = dl->point[rec->fpoint+i].x;
+        y = dl->point[rec->fpoint+i].y;
+        TMTransformCoord(&x, &y, &(cd->view));
+        if (fabs(x - p[i].x) > 1e-9 || fabs(y - p[i].y) > 1e-9 ||
+            p[i].cmd != dl->point[rec->fpoint+i].cmd) cd->nfails++;
+    }
+}
+
+static int checkReplay(MsvgDisplayList *dl)
+{
+    CheckData cd;
+
+    cd.nfails = 0;
+    cd.identity = 1;
+    TMSetIdentity(&(cd.view));
+    MsvgReplayDisplayList(dl, NULL, chkfn, &cd);
+    cd.identity = 0;
+    TMSetRotation(&(cd.view), 30, 10, 10);
+    MsvgReplayDisplayList(dl, &(cd.view), chkfn, &cd);
+    TMSetScaling(&(cd.view), 2, 3);
+    MsvgReplayDisplayList(dl, &(cd.view), chkfn, &cd);
+    printf("  checked points     %d fails\n", cd.nfails);
+
+    return cd.nfails;
+}
+
+static void printDisplayList(MsvgDisplayList *dl)
+{
+    MsvgDLRecord *rec;
+    int i;
+
+    for (i=0; i<dl->nrecords; i++) {
+        rec = &(dl->record[i]);
+        printf("  %-9s pctx %3d points %5d subpaths %3d bbox %g %g %g %g\n",
+               MsvgFindElementName(rec->eid), rec->ipctx, rec->npoints,
+               rec->nsubpaths, rec->bbox.gminx, rec->bbox.gmaxx,
+               rec->bbox.gminy, rec->bbox.gmaxy);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    MsvgDisplayList *dl;
+    UserData ud;
+    TMatrix view, tsave;
+    clock_t t0;
+    double tser, tdl;
+    int error, i, nloops = 100, printdl = 0, nfails;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            nloops = atoi(&(argv[0][3]));
+        else if (strcmp(argv[0], "-p") == 0)
+            printdl = 1;
+        argv++;
+        argc--;
+    }
+
+    if (argc < 1 || nloops < 1) {
+        printf("Usage: tdlist [-p] [-n=nloops] file\n");
+        return 0;
+    }
+
+    root = MsvgReadSvgFile(argv[0], &error);
+
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, argv[0]);
+        return 0;
+    }
+
+    MsvgRaw2CookedTree(root);
+
+    t0 = clock();
+    dl = MsvgBuildDisplayList(root);
+    if (dl == NULL) {
+        printf("Error building the display list\n");
+        MsvgDeleteElement(root);
+        return 0;
+    }
+    printf("===== Display list built in %g s\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+    printf("  records            %d\n", dl->nrecords);
+    printf("  subpaths           %d\n", dl->nsubpaths);
+    printf("  points             %d\n", dl->npoints);
+    printf("  paint contexts     %d\n", dl->npctxs);
+    if (printdl) printDisplayList(dl);
+
+    // the renderers change the root matrix to the view matrix for every draw
+    printf("===== Serialize and transform, %d loops\n", nloops);
+    ud.nels = 0;
+    tsave = root->pctx->tmatrix;
+    t0 = clock();
+    for (i=0; i<nloops; i++) {
+        TMSetRotation(&view, i, 100, 100);
+        TMMpy(&(root->pctx->tmatrix), &view, &tsave);
+        MsvgSerCookedTree(root, sufn, &ud, 1);
+    }
+    tser = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("  elements           %d\n", ud.nels / nloops);
+    printf("  time               %g s\n", tser);
+    root->pctx->tmatrix = tsave;
+
+    printf("===== Replay display list, %d loops\n", nloops);
+    ud.nels = 0;
+    ud.sumx = 0;
+    t0 = clock();
+    for (i=0; i<nloops; i++) {
+        TMSetRotation(&view, i, 100, 100);
+        MsvgReplayDisplayList(dl, &view, dlufn, &ud);
+    }
+    tdl = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("  records            %d\n", ud.nels / nloops);
+    printf("  time               %g s\n", tdl);
+    if (tdl > 0) printf("  speedup            %.1f\n", tser / tdl);
+
+    nfails = checkReplay(dl);
+
+    MsvgDestroyDisplayList(dl);
+    MsvgDeleteElement(root);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
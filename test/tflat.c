@@ -0,0 +1,267 @@
+/* tflat.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define FNAME "msvgt8.svg"
+
+static clock_t t0;
+
+static void startTime(void)
+{
+    t0 = clock();
+}
+
+static void printTime(const char *s, long nels)
+{
+    double t;
+
+    t = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("  %-16s %8.3f s", s, t);
+    if (nels > 0 && t > 0) printf(", %.3g els/s", nels / t);
+    printf("\n");
+}
+
+typedef struct {
+    long nels;
+    long ndesc;         /* in order, the desc number the next one must have */
+    int order_ok;
+} WalkData;
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    WalkData *wd;
+
+    wd = (WalkData *)udata;
+    wd->nels++;
+    if (el->eid != EID_DESC) return;
+    if (el->fcontent == NULL || atol(el->fcontent->s) != wd->ndesc)
+        wd->order_ok = 0;
+    wd->ndesc++;
+}
+
+static long walk(MsvgElement *el, int *order_ok)
+{
+    WalkData wd;
+
+    wd.nels = 0;
+    wd.ndesc = 0;
+    wd.order_ok = 1;
+    MsvgWalkTree(el, wufn, &wd);
+    if (order_ok) *order_ok = wd.order_ok;
+
+    return wd.nels;
+}
+
+static void addDesc(MsvgElement *father, long i)
+{
+    MsvgElement *el;
+    char s[20];
+
+    el = MsvgNewElement(EID_DESC, father);
+    if (el == NULL) return;
+    sprintf(s, "%ld", i);
+    MsvgAddContent(el, strlen(s), s);
+}
+
+static int checkFlat(long n)
+{
+    MsvgElement *root, *el, *dup;
+    MsvgTreeCounts tc;
+    long i, nels;
+    int order_ok, nfails = 0;
+
+    printf("===== %ld siblings\n", n);
+
+    // every element is appended after the last son
+    startTime();
+    root = MsvgNewElement(EID_SVG, NULL);
+    for (i=0; i<n; i++)
+        addDesc(root, i);
+    MsvgAddRawAttribute(root->lson, "id", "last");
+    printTime("build", n);
+
+    startTime();
+    nels = walk(root, &order_ok);
+    printTime("walk", nels);
+    if (nels != n + 1 || !order_ok) nfails++;
+
+    // the walks starting in a son go on by its next siblings
+    startTime();
+    MsvgCalcCountsRawTree(root, &tc);
+    if (tc.nelem[EID_DESC] != n || tc.totelwid != 1) nfails++;
+    el = MsvgFindIdRawTree(root->fson, "last");
+    if (el != root->lson) nfails++;
+    printTime("count and find", 2 * n);
+
+    startTime();
+    MsvgRaw2CookedTree(root);
+    printTime("cook", n);
+    MsvgCalcCountsCookedTree(root->fson, &tc);
+    if (tc.nelem[EID_DESC] != n || tc.totelwid != 1) nfails++;
+    if (MsvgFindIdCookedTree(root, "last") != root->lson ||
+        MsvgFindIdCookedTree(root->fson, "last") != root->lson) nfails++;
+
+    startTime();
+    dup = MsvgDupElement(root, 1);
+    printTime("duplicate", n);
+    if (dup == NULL) {
+        nfails++;
+    } else {
+        nels = walk(dup, &order_ok);
+        if (nels != n + 1 || !order_ok) nfails++;
+        startTime();
+        MsvgDeleteElement(dup);
+        printTime("delete", n);
+    }
+
+    MsvgDeleteElement(root);
+
+    printf("  flat tree: %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int checkDeep(long n)
+{
+    MsvgElement *root, *el, *dup;
+    MsvgTreeCounts tc;
+    long i, nels;
+    int order_ok, nfails = 0;
+
+    printf("===== %ld nested groups\n", n);
+
+    startTime();
+    root = MsvgNewElement(EID_SVG, NULL);
+    el = root;
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_G, el);
+        addDesc(el, i);
+    }
+    MsvgAddRawAttribute(el, "id", "last");
+    printTime("build", n * 2);
+
+    startTime();
+    nels = walk(root, &order_ok);
+    printTime("walk", nels);
+    if (nels != n * 2 + 1 || !order_ok) nfails++;
+
+    MsvgCalcCountsRawTree(root, &tc);
+    if (tc.nelem[EID_G] != n || tc.totelwid != 1) nfails++;
+    if (MsvgFindIdRawTree(root, "last") != el) nfails++;
+
+    MsvgRaw2CookedTree(root);
+    if (MsvgFindIdCookedTree(root->fson, "last") != el) nfails++;
+
+    dup = MsvgDupElement(root, 1);
+    if (dup == NULL) {
+        nfails++;
+    } else {
+        nels = walk(dup, &order_ok);
+        if (nels != n * 2 + 1 || !order_ok) nfails++;
+        MsvgDeleteElement(dup);
+    }
+
+    startTime();
+    MsvgDeleteElement(root);
+    printTime("delete", n * 2);
+
+    printf("  deep tree: %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int checkFile(long n)
+{
+    MsvgElement *root, *el;
+    MsvgTreeCounts tc;
+    char s[40];
+    long i;
+    int error, nfails = 0;
+
+    printf("===== %ld elements written to %s and read\n", n, FNAME);
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_RECT, root);
+        sprintf(s, "%ld", i % 1000);
+        MsvgAddRawAttribute(el, "x", s);
+        MsvgAddRawAttribute(el, "width", "1");
+        MsvgAddRawAttribute(el, "height", "1");
+    }
+
+    startTime();
+    if (!MsvgWriteSvgFile(root, FNAME)) nfails++;
+    printTime("write", n);
+    MsvgDeleteElement(root);
+
+    startTime();
+    root = MsvgReadSvgFile(FNAME, &error);
+    printTime("read", n);
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, FNAME);
+        return nfails + 1;
+    }
+
+    MsvgRaw2CookedTree(root);
+    MsvgCalcCountsCookedTree(root, &tc);
+    if (tc.nelem[EID_RECT] != n) nfails++;
+    el = root->lson;
+    if (el == NULL || el->eid != EID_RECT ||
+        el->prectattr->x != (n - 1) % 1000) nfails++;
+
+    MsvgDeleteElement(root);
+
+    printf("  flat file: %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    long n = 10000000, nd = 100000, nf = 500000;
+    int nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atol(&(argv[0][3]));
+        else if (strncmp(argv[0], "-d=", 3) == 0)
+            nd = atol(&(argv[0][3]));
+        else if (strncmp(argv[0], "-f=", 3) == 0)
+            nf = atol(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1 || nd < 1 || nf < 1) {
+        printf("Usage: tflat [-n=siblings] [-d=depth] [-f=elements]\n");
+        return 0;
+    }
+
+    nfails += checkFlat(n);
+    nfails += checkDeep(nd);
+    nfails += checkFile(nf);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
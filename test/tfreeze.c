@@ -0,0 +1,403 @@
+/* tfreeze.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "msvg.h"
+
+#define NPROBES 10
+
+static MsvgElement *buildTiles(int n)
+{
+    MsvgElement *root, *defs, *grad, *g, *el;
+    char s[100];
+    int i, j;
+
+    // a raw tree of n x n tiles with gradients, EID_USE elements and text
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    sprintf(s, "0 0 %d %d", n * 20, n * 20);
+    MsvgAddRawAttribute(root, "viewBox", s);
+
+    defs = MsvgNewElement(EID_DEFS, root);
+    grad = MsvgNewElement(EID_LINEARGRADIENT, defs);
+    MsvgAddRawAttribute(grad, "id", "lg");
+    el = MsvgNewElement(EID_STOP, grad);
+    MsvgAddRawAttribute(el, "offset", "0");
+    MsvgAddRawAttribute(el, "stop-color", "red");
+    el = MsvgNewElement(EID_STOP, grad);
+    MsvgAddRawAttribute(el, "offset", "1");
+    MsvgAddRawAttribute(el, "stop-color", "blue");
+    grad = MsvgNewElement(EID_RADIALGRADIENT, defs);
+    MsvgAddRawAttribute(grad, "id", "rg");
+    el = MsvgNewElement(EID_STOP, grad);
+    MsvgAddRawAttribute(el, "offset", "0");
+    MsvgAddRawAttribute(el, "stop-color", "yellow");
+    el = MsvgNewElement(EID_STOP, grad);
+    MsvgAddRawAttribute(el, "offset", "1");
+    MsvgAddRawAttribute(el, "stop-color", "green");
+    g = MsvgNewElement(EID_G, defs);
+    MsvgAddRawAttribute(g, "id", "icon");
+    el = MsvgNewElement(EID_PATH, g);
+    MsvgAddRawAttribute(el, "d", "M2 2 L8 2 L5 8 Z");
+    MsvgAddRawAttribute(el, "fill", "url(#rg)");
+
+    for (i=0; i<n; i++) {
+        for (j=0; j<n; j++) {
+            g = MsvgNewElement(EID_G, root);
+            sprintf(s, "translate(%d %d)", i * 20, j * 20);
+            MsvgAddRawAttribute(g, "transform", s);
+            el = MsvgNewElement(EID_PATH, g);
+            sprintf(s, "M0 0 L%d 0 L10 10 Z", 10 + i % 5);
+            MsvgAddRawAttribute(el, "d", s);
+            MsvgAddRawAttribute(el, "fill", "url(#lg)");
+            el = MsvgNewElement(EID_POLYGON, g);
+            MsvgAddRawAttribute(el, "points", "10,10 19,10 19,19");
+            MsvgAddRawAttribute(el, "stroke", "url(#rg)");
+            el = MsvgNewElement(EID_USE, g);
+            MsvgAddRawAttribute(el, "xlink:href", "#icon");
+            MsvgAddRawAttribute(el, "x", "10");
+            el = MsvgNewElement(EID_TEXT, g);
+            MsvgAddRawAttribute(el, "y", "18");
+            MsvgAddContent(el, 4, "tile");
+        }
+    }
+
+    return root;
+}
+
+/* the state of an element the readers could store in the tree */
+
+typedef struct {
+    MsvgElement *el;
+    int wbbox_ok;
+    MsvgBox wbbox;
+    int cpctx_ok;
+    MsvgPaintCtx *cpctx;
+    void *sp, *d, *pp;      /* path-data */
+    int ppnrefs;
+    MsvgBPServer *bps;      /* compiled gradient */
+    int bpsrefs, bpspinned;
+    int rnrefs, cnrefs;     /* raw attributes and content */
+} ElState;
+
+typedef struct {
+    int nels, maxels;
+    ElState *st;
+} TreeState;
+
+static void stfn(MsvgElement *el, void *udata)
+{
+    TreeState *ts;
+    ElState *s;
+
+    ts = (TreeState *)udata;
+    if (ts->nels >= ts->maxels) return;
+    s = &(ts->st[ts->nels++]);
+    memset(s, 0, sizeof(ElState));
+    s->el = el;
+    s->wbbox_ok = el->wbbox_ok;
+    if (el->wbbox_ok) s->wbbox = el->wbbox;
+    s->cpctx_ok = el->cpctx_ok;
+    s->cpctx = el->cpctx;
+    switch (el->eid) {
+        case EID_PATH :
+            s->sp = el->ppathattr->sp;
+            s->d = el->ppathattr->d;
+            s->pp = el->ppathattr->pp;
+            if (el->ppathattr->pp) s->ppnrefs = el->ppathattr->pp->nrefs;
+            break;
+        case EID_GLYPH :
+        case EID_MISSINGGLYPH :
+            s->sp = el->pglyphattr->sp;
+            s->d = el->pglyphattr->d;
+            s->pp = el->pglyphattr->pp;
+            if (el->pglyphattr->pp) s->ppnrefs = el->pglyphattr->pp->nrefs;
+            break;
+        case EID_LINEARGRADIENT :
+            s->bps = el->plgradattr->bps;
+            break;
+        case EID_RADIALGRADIENT :
+            s->bps = el->prgradattr->bps;
+            break;
+        default :
+            break;
+    }
+    if (s->bps) {
+        s->bpsrefs = s->bps->refcount;
+        s->bpspinned = s->bps->pinned;
+    }
+    if (el->frattr) s->rnrefs = el->frattr->nrefs;
+    if (el->fcontent) s->cnrefs = el->fcontent->nrefs;
+}
+
+static int snapshot(MsvgElement *root, TreeState *ts)
+{
+    MsvgTreeCounts tc;
+
+    MsvgCalcCountsCookedTree(root, &tc);
+    ts->maxels = tc.totelem + 1;
+    ts->st = (ElState *)malloc(sizeof(ElState) * ts->maxels);
+    if (ts->st == NULL) return 0;
+    ts->nels = 0;
+    MsvgWalkTree(root, stfn, ts);
+
+    return 1;
+}
+
+static int sameState(TreeState *ts1, TreeState *ts2)
+{
+    if (ts1->nels != ts2->nels) return 0;
+    return memcmp(ts1->st, ts2->st, sizeof(ElState) * ts1->nels) == 0;
+}
+
+typedef struct {
+    int nels;
+    double sum;         /* of the drawn coordinates, in order */
+} SumData;
+
+static void sumCoords(SumData *sd, const MsvgCoord *x, const MsvgCoord *y,
+                      int n, int stride)
+{
+    int i;
+
+    for (i=0; i<n*stride; i+=stride)
+        sd->sum = sd->sum * 0.5 + x[i] + 2 * y[i];
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SumData *sd;
+    MsvgElement *newel;
+    MsvgPackedPath *pp;
+
+    sd = (SumData *)udata;
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    sd->nels++;
+    switch (newel->eid) {
+        case EID_POLYGON :
+            sumCoords(sd, newel->ppolygonattr->points,
+                      newel->ppolygonattr->points + 1,
+                      newel->ppolygonattr->npoints, 2);
+            break;
+        case EID_PATH :
+            pp = MsvgGetPackedPath(newel);
+            if (pp) sumCoords(sd, pp->x, pp->y, pp->npoints, 1);
+            break;
+        case EID_TEXT :
+            sd->sum = sd->sum * 0.5 + newel->ptextattr->x + 2 * newel->ptextattr->y;
+            break;
+        default :
+            break;
+    }
+    if (newel->pctx->fill_bps) sd->sum += newel->pctx->fill_bps->type;
+    MsvgDeleteElement(newel);
+}
+
+static void sbufn(MsvgSerItem *item, int nitems, void *udata)
+{
+    int i;
+
+    for (i=0; i<nitems; i++) sufn(item[i].el, &(item[i].pctx), udata);
+}
+
+static void readTree(MsvgElement *root, const TMatrix *view, SumData *sd)
+{
+    MsvgDisplayList *dl;
+    MsvgBox clip;
+    SumData sd2;
+    double minx, maxx, miny, maxy, x, y;
+    int i, j;
+
+    // what a renderer, a hit test and a measure do
+    sd->nels = 0;
+    sd->sum = 0;
+    MsvgSerCookedTreeView(root, sufn, sd, 1, NULL, view);
+    memset(&sd2, 0, sizeof(SumData));
+    MsvgSerCookedTreeBatchView(root, sbufn, &sd2, 1, 16, NULL, view);
+    if (sd2.nels != sd->nels || sd2.sum != sd->sum) sd->nels = -1;
+
+    if (!MsvgGetCookedDims(root, &minx, &maxx, &miny, &maxy)) return;
+    clip.gminx = minx;
+    clip.gmaxx = (minx + maxx) / 2;
+    clip.gminy = miny;
+    clip.gmaxy = (miny + maxy) / 2;
+    MsvgSerCookedTreeView(root, sufn, &sd2, 1, &clip, view);
+
+    for (i=0; i<NPROBES; i++) {
+        for (j=0; j<NPROBES; j++) {
+            x = minx + (maxx - minx) * (i + 0.5) / NPROBES;
+            y = miny + (maxy - miny) * (j + 0.5) / NPROBES;
+            MsvgHitTest(root, x, y, 1);
+            MsvgRTreeNearest(root, x, y, NULL);
+        }
+    }
+
+    dl = MsvgBuildDisplayList(root);
+    if (dl) MsvgDestroyDisplayList(dl);
+}
+
+static int checkView(MsvgElement *root)
+{
+    SumData sd1, sd2;
+    TMatrix view, tsave;
+    int nfails = 0;
+
+    // the view is the same as changing the root matrix, without changing it
+    TMSetRotation(&view, 30, 100, 50);
+    tsave = root->pctx->tmatrix;
+    readTree(root, &view, &sd1);
+    if (memcmp(&tsave, &(root->pctx->tmatrix), sizeof(TMatrix)) != 0) nfails++;
+
+    TMMpy(&(root->pctx->tmatrix), &view, &tsave);
+    readTree(root, NULL, &sd2);
+    root->pctx->tmatrix = tsave;
+    if (sd1.nels < 0 || sd1.nels != sd2.nels || sd1.sum != sd2.sum) nfails++;
+    printf("  view:      %d fails\n", nfails);
+
+    return nfails;
+}
+
+static MsvgElement *loadTree(char *fname, int n)
+{
+    MsvgElement *root;
+    int error;
+
+    if (fname) {
+        root = MsvgReadSvgFile(fname, &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, fname);
+            return NULL;
+        }
+    } else {
+        root = buildTiles(n);
+    }
+    MsvgRaw2CookedTree(root);
+
+    return root;
+}
+
+static int checkThaw(void)
+{
+    MsvgElement *root, *grad;
+    MsvgBPServer *bps, *copy[4];
+    int i, nfails = 0;
+
+    // the copies and references taken while frozen outlive the thaw and
+    // the cached server, that is freed by a change of the gradient, the
+    // ones taken before are released while frozen
+    root = loadTree(NULL, 2);
+    grad = root->fson->fson;
+    copy[3] = MsvgNewBPServer(grad);
+    if (!MsvgFreezeTree(root)) nfails++;
+    bps = MsvgGetBPServer(grad);
+    copy[0] = MsvgNewBPServer(grad);
+    copy[1] = MsvgSpecializeBPServer(bps, NULL, NULL);
+    copy[2] = MsvgRefBPServer(bps);
+    if (copy[3]) MsvgDestroyBPServer(copy[3]);
+    MsvgThawTree(root);
+    if (bps->pinned || bps->refcount != 1) nfails++;
+
+    grad->fson->pstopattr->scolor = 0X00FF00;
+    MsvgElementChanged(grad->fson);
+    if (grad->plgradattr->bps != NULL) nfails++;
+    for (i=0; i<3; i++) {
+        if (copy[i] == NULL || copy[i]->blg.stops.nstops != 2 ||
+            copy[i]->blg.stops.scolor[0] != 0XFF0000 ||
+            copy[i]->blg.stops.scolor[1] != 0X0000FF) nfails++;
+        if (copy[i]) MsvgDestroyBPServer(copy[i]);
+    }
+
+    MsvgDeleteElement(root);
+    printf("  thaw:      %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root, *ref;
+    TreeState ts1, ts2;
+    SumData sd1, sd2;
+    TMatrix view;
+    char *fname = NULL;
+    int i, n = 30, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tfreeze [-n=tiles] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) fname = argv[0];
+    if (fname)
+        printf("===== %s\n", fname);
+    else
+        printf("===== %d x %d tiles\n", n, n);
+
+    // a reference tree drawn as usual
+    ref = loadTree(fname, n);
+    if (ref == NULL) return 0;
+    TMSetScaling(&view, 2, 3);
+    readTree(ref, &view, &sd1);
+    nfails += checkView(ref);
+    MsvgDeleteElement(ref);
+
+    // the readers don't change a frozen tree, that is read by the first
+    // time, and it is drawn the same
+    root = loadTree(fname, n);
+    if (root == NULL) return 0;
+    MsvgBuildRTree(root);
+    MsvgBuildPaintCtxCache(root);
+    if (!MsvgFreezeTree(root)) nfails++;
+    if (!snapshot(root, &ts1)) return 0;
+    readTree(root, &view, &sd2);
+    readTree(root, NULL, &sd2);
+    readTree(root, &view, &sd2);
+    if (!snapshot(root, &ts2)) return 0;
+    if (!sameState(&ts1, &ts2)) nfails++;
+    free(ts2.st);
+    if (sd1.nels < 0 || sd1.nels != sd2.nels || sd1.sum != sd2.sum) nfails++;
+    printf("  frozen:    %d elements drawn, %d fails\n", sd2.nels, nfails);
+
+    // the paint servers are unpinned after thawing it
+    MsvgThawTree(root);
+    if (root->psvgattr->frozen) nfails++;
+    if (!snapshot(root, &ts2)) return 0;
+    for (i=0; i<ts1.nels; i++) {
+        if (ts1.st[i].bps && (!ts1.st[i].bpspinned || ts2.st[i].bpspinned ||
+            ts2.st[i].bpsrefs != ts1.st[i].bpsrefs)) nfails++;
+    }
+    free(ts1.st);
+    free(ts2.st);
+    if (fname == NULL) nfails += checkThaw();
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
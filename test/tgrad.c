@@ -0,0 +1,248 @@
+/* tgrad.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NSTOPS 16
+
+typedef struct {
+    int nels;
+    int nfails;
+    MsvgBPServer *shared;
+} GradData;
+
+static MsvgElement *buildTree(int n, MsvgElement **grad)
+{
+    MsvgElement *root, *defs, *el;
+    int i;
+
+    // n rects filled with a linear gradient of NSTOPS stops, more than
+    // the old fixed limit
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 1000;
+    root->psvgattr->vb_height = 1000;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    defs = MsvgNewElement(EID_DEFS, root);
+    *grad = MsvgNewElement(EID_LINEARGRADIENT, defs);
+    (*grad)->id = strdup("grad");
+    for (i=0; i<NSTOPS; i++) {
+        el = MsvgNewElement(EID_STOP, *grad);
+        el->pstopattr->offset = (double)i / (NSTOPS - 1);
+        el->pstopattr->sopacity = 1;
+        el->pstopattr->scolor = i * 0X101010;
+    }
+
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_RECT, root);
+        el->prectattr->x = i % 100 * 10;
+        el->prectattr->y = i / 100 % 100 * 10;
+        el->prectattr->width = 8 + i % 3;
+        el->prectattr->height = 8;
+        el->pctx->fill = IRI_COLOR;
+        el->pctx->fill_iri = strdup("grad");
+    }
+
+    return root;
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    GradData *gd;
+    MsvgElement *newel;
+    MsvgBPServer *bps;
+    MsvgBox bbox;
+    double x1;
+
+    gd = (GradData *)udata;
+    gd->nels++;
+
+    // every element gets the same compiled server
+    if (pctx->fill_bps != gd->shared) {
+        gd->nfails++;
+        return;
+    }
+
+    // and a specialized copy for its bbox, that doesn't change it
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    bps = newel->pctx->fill_bps;
+    MsvgGetCookedBoundingBox(el, &bbox, 1);
+    x1 = bbox.gminx;
+    if (bps == NULL || bps == gd->shared) gd->nfails++;
+    else if (bps->blg.gradunits != GRADUNIT_USER || bps->blg.x1 != x1) gd->nfails++;
+    else if (bps->blg.stops.offset != gd->shared->blg.stops.offset) gd->nfails++;
+    if (gd->shared->blg.gradunits != GRADUNIT_BBOX) gd->nfails++;
+    MsvgDeleteElement(newel);
+}
+
+static int checkStops(MsvgBPServer *bps, int nstops)
+{
+    int i;
+
+    if (bps == NULL || bps->type != BPSERVER_LINEARGRADIENT) return 1;
+    if (bps->blg.stops.nstops != nstops) return 1;
+    for (i=0; i<NSTOPS; i++) {
+        if (bps->blg.stops.offset[i] != (double)i / (NSTOPS - 1)) return 1;
+        if (bps->blg.stops.scolor[i] != i * 0X101010) return 1;
+    }
+
+    return 0;
+}
+
+static int serialize(MsvgElement *root, MsvgElement *grad, int n)
+{
+    GradData gd;
+    clock_t t0;
+
+    gd.nels = 0;
+    gd.nfails = 0;
+    gd.shared = MsvgGetBPServer(grad);
+
+    t0 = clock();
+    MsvgSerCookedTree(root, sufn, &gd, 1);
+    printf("  %d elements serialized and transformed in %g s\n", gd.nels,
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    if (gd.nels != n) gd.nfails++;
+    // all the copies have been released
+    if (gd.shared->refcount != 1) gd.nfails++;
+    // and the cache is still the same
+    if (MsvgGetBPServer(grad) != gd.shared) gd.nfails++;
+
+    return gd.nfails;
+}
+
+static int checkChanges(MsvgElement *root, MsvgElement *grad)
+{
+    MsvgBPServer *old, *copy, *bps;
+    MsvgElement *stop;
+    int nfails = 0;
+
+    old = MsvgGetBPServer(grad);
+    copy = MsvgNewBPServer(grad);
+    if (copy == NULL || copy == old || old->refcount != 2) nfails++;
+
+    // a changed stop recompiles the gradient, the copy keeps the old stops
+    stop = grad->fson;
+    stop->pstopattr->offset = 0.25;
+    MsvgElementChanged(stop);
+    bps = MsvgGetBPServer(grad);
+    if (bps == NULL || bps->blg.stops.offset[0] != 0.25) nfails++;
+    if (copy == NULL || copy->blg.stops.offset[0] != 0) nfails++;
+    if (copy) MsvgDestroyBPServer(copy);
+    stop->pstopattr->offset = 0;
+    MsvgElementChanged(stop);
+
+    // a new stop too
+    stop = MsvgNewElement(EID_STOP, NULL);
+    stop->pstopattr->offset = 1;
+    stop->pstopattr->sopacity = 1;
+    MsvgInsertSonElement(stop, grad);
+    if (checkStops(MsvgGetBPServer(grad), NSTOPS+1)) nfails++;
+
+    // and a deleted one
+    MsvgDeleteElement(stop);
+    if (checkStops(MsvgGetBPServer(grad), NSTOPS)) nfails++;
+
+    // a changed gradient
+    grad->plgradattr->x2 = 0.5;
+    MsvgElementChanged(grad);
+    bps = MsvgGetBPServer(grad);
+    if (bps == NULL || bps->blg.x2 != 0.5) nfails++;
+
+    printf("  after changes: %d fails\n", nfails);
+
+    return nfails;
+}
+
+static void fufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    GradData *gd;
+    MsvgElement *newel;
+
+    gd = (GradData *)udata;
+    gd->nels++;
+    if (pctx->fill_bps == NULL && pctx->stroke_bps == NULL) return;
+
+    // the shared servers are not changed by the specialized copies
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel) MsvgDeleteElement(newel);
+    if (pctx->fill_bps && pctx->fill_bps->refcount != 1) gd->nfails++;
+    if (pctx->stroke_bps && pctx->stroke_bps->refcount != 1) gd->nfails++;
+}
+
+static int checkFile(MsvgElement *root)
+{
+    GradData gd1, gd2;
+
+    gd1.nels = gd1.nfails = 0;
+    gd2.nels = gd2.nfails = 0;
+    MsvgSerCookedTree(root, fufn, &gd1, 1);
+    MsvgSerCookedTree(root, fufn, &gd2, 1);
+    printf("  %d elements serialized twice\n", gd1.nels);
+
+    return gd1.nfails + gd2.nfails + (gd1.nels != gd2.nels);
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root, *grad;
+    int error, n = 10000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tgrad [-n=nshapes] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+        nfails += checkFile(root);
+    } else {
+        root = buildTree(n, &grad);
+        printf("===== %d shapes sharing a gradient of %d stops\n", n, NSTOPS);
+        if (checkStops(MsvgGetBPServer(grad), NSTOPS)) nfails++;
+        nfails += serialize(root, grad, n);
+        nfails += serialize(root, grad, n);
+        nfails += checkChanges(root, grad);
+    }
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+/* tgrid.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include "msvg.h"
+#include "tgrid.h"
+
+/* the grid fixture shared by the tests of the spatial queries */
+
+MsvgElement *buildGridMap(int n, int flags)
+{
+    MsvgElement *root, *row, *g, *el;
+    int i, j;
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_min_x = 0;
+    root->psvgattr->vb_min_y = 0;
+    root->psvgattr->vb_width = n * 100;
+    root->psvgattr->vb_height = n * 100;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    root->pctx->stroke = 0X000000;
+
+    for (i=0; i<n; i++) {
+        row = root;
+        if (flags & TGRID_ROWS) {
+            row = MsvgNewElement(EID_G, root);
+            TMSetTranslation(&(row->pctx->tmatrix), i*100, 0);
+        }
+        for (j=0; j<n; j++) {
+            g = MsvgNewElement(EID_G, row);
+            if (flags & TGRID_ROWS)
+                TMSetTranslation(&(g->pctx->tmatrix), 0, j*100);
+            else
+                TMSetTranslation(&(g->pctx->tmatrix), i*100, j*100);
+
+            el = MsvgNewElement(EID_RECT, g);
+            el->prectattr->x = 5;
+            el->prectattr->y = 5;
+            el->prectattr->width = 90;
+            el->prectattr->height = 90;
+            el->pctx->fill = 0XBBBBBB;
+
+            el = MsvgNewElement(EID_CIRCLE, g);
+            el->pcircleattr->cx = 70;
+            el->pcircleattr->cy = 30;
+            el->pcircleattr->r = 20;
+            el->pctx->fill = 0XFF0000;
+
+            if (flags & TGRID_PATH) {
+                el = MsvgNewElement(EID_PATH, g);
+                el->ppathattr->sp = MsvgNewSubPath(4);
+                MsvgAddPointToSubPath(el->ppathattr->sp, 'M', 60, 60);
+                MsvgAddPointToSubPath(el->ppathattr->sp, 'L', 90, 60);
+                MsvgAddPointToSubPath(el->ppathattr->sp, 'L', 75, 90);
+                el->ppathattr->sp->closed = 1;
+                el->pctx->fill = 0X0000FF;
+                el->pctx->stroke_width = 3;
+            }
+
+            if (flags & (TGRID_LINE | TGRID_ROTLINE)) {
+                el = MsvgNewElement(EID_LINE, g);
+                el->plineattr->x1 = 10;
+                el->plineattr->y1 = 90;
+                el->plineattr->x2 = 50;
+                el->plineattr->y2 = 60;
+                if (flags & TGRID_ROTLINE)
+                    TMSetRotation(&(el->pctx->tmatrix), 30, 30, 75);
+            }
+        }
+    }
+
+    return root;
+}
@@ -0,0 +1,28 @@
+/* tgrid.h
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#ifndef __TGRID_H_INCLUDED__
+#define __TGRID_H_INCLUDED__
+
+/* a cooked tree of n x n cells of 100 x 100, every cell a group with a
+   grey rect covering it and a red circle over the rect, more elements
+   can be added to the cells with the flags */
+
+#define TGRID_ROWS      0x01    /* the cells grouped by rows */
+#define TGRID_PATH      0x02    /* a blue triangle path */
+#define TGRID_LINE      0x04    /* a line over all the others */
+#define TGRID_ROTLINE   0x08    /* and rotated */
+
+MsvgElement *buildGridMap(int n, int flags);
+
+#endif
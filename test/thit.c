@@ -0,0 +1,192 @@
+/* thit.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "msvg.h"
+#include "tgrid.h"
+
+#define NPICKS 10000
+
+static int checkMap(MsvgElement *root, int n, double tol)
+{
+    MsvgElement *el;
+    int i, j, nfails = 0;
+
+    for (i=0; i<n; i+=7) {
+        for (j=0; j<n; j+=5) {
+            el = MsvgHitTest(root, i*100+50, j*100+80, tol);
+            if (el == NULL || el->eid != EID_RECT) nfails++;
+            el = MsvgHitTest(root, i*100+70, j*100+30, tol);
+            if (el == NULL || el->eid != EID_CIRCLE) nfails++;
+            el = MsvgHitTest(root, i*100+30, j*100+75, tol);
+            if (el == NULL || el->eid != EID_LINE) nfails++;
+            el = MsvgHitTest(root, i*100+98, j*100+98, tol);
+            if (el != NULL) nfails++;
+        }
+    }
+
+    return nfails;
+}
+
+static int checkPolygon(void)
+{
+    // a star, the center is inside with nonzero and outside with evenodd
+    MsvgCoord star[10] = {50, 0, 79, 90, 2, 35, 98, 35, 21, 90};
+    int nfails = 0;
+
+    if (!MsvgInsidePolygonTest(5, star, 50, 50, FILLRULE_NONZERO)) nfails++;
+    if (MsvgInsidePolygonTest(5, star, 50, 50, FILLRULE_EVENODD)) nfails++;
+    if (!MsvgInsidePolygonTest(5, star, 50, 20, FILLRULE_EVENODD)) nfails++;
+    if (MsvgInsidePolygonTest(5, star, 5, 80, FILLRULE_NONZERO)) nfails++;
+
+    return nfails;
+}
+
+static int checkZoom(void)
+{
+    MsvgElement *root, *el;
+    double x, y;
+    int nfails = 0;
+
+    // a point inside a small circle, but outside its polygon with three
+    // points every quarter, the curve is flattened finer with a zoom
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 10;
+    root->psvgattr->vb_height = 10;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    el = MsvgNewElement(EID_CIRCLE, root);
+    el->pcircleattr->cx = 5;
+    el->pcircleattr->cy = 5;
+    el->pcircleattr->r = 1;
+    el->pctx->fill = 0XFF0000;
+    x = 5 + 0.97 * cos(M_PI / 8);
+    y = 5 + 0.97 * sin(M_PI / 8);
+
+    if (MsvgHitTest(root, x, y, 0) != NULL) nfails++;
+    TMSetScaling(&(root->pctx->tmatrix), 100, 100);
+    if (MsvgHitTest(root, x, y, 0) != el) nfails++;
+
+    MsvgDeleteElement(root);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root, **hits;
+    MsvgBox box;
+    double tol = 0.5, *px, *py;
+    clock_t t0;
+    int error, i, n = 183, nhits, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-t=", 3) == 0)
+            tol = atof(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1 || tol < 0) {
+        printf("Usage: thit [-n=cells] [-t=tolerance] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+    } else {
+        root = buildGridMap(n, TGRID_ROWS | TGRID_LINE);
+    }
+
+    nfails += checkPolygon();
+    nfails += checkZoom();
+
+    t0 = clock();
+    MsvgCalcCookedWorldBBoxes(root);
+    printf("===== world bboxes calculated in %g s\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+    box = root->wbbox;
+    if (box.gminx > box.gmaxx) {
+        printf("Nothing to pick\n");
+        MsvgDeleteElement(root);
+        return 0;
+    }
+
+    px = (double *)malloc(sizeof(double) * NPICKS);
+    py = (double *)malloc(sizeof(double) * NPICKS);
+    hits = (MsvgElement **)malloc(sizeof(MsvgElement *) * NPICKS);
+    if (px == NULL || py == NULL || hits == NULL) {
+        printf("Out of memory\n");
+        return 0;
+    }
+    srand(1);
+    for (i=0; i<NPICKS; i++) {
+        px[i] = box.gminx + (box.gmaxx - box.gminx) * rand() / RAND_MAX;
+        py[i] = box.gminy + (box.gmaxy - box.gminy) * rand() / RAND_MAX;
+    }
+
+    if (argc == 0) nfails += checkMap(root, n, tol);
+
+    nhits = 0;
+    t0 = clock();
+    for (i=0; i<NPICKS; i++) {
+        hits[i] = MsvgHitTest(root, px[i], py[i], tol);
+        if (hits[i]) nhits++;
+    }
+    printf("===== MsvgHitTest with world bboxes, %d picks\n", NPICKS);
+    printf("  hits               %d\n", nhits);
+    printf("  time per pick      %g us\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / NPICKS);
+
+    t0 = clock();
+    MsvgBuildRTree(root);
+    printf("===== spatial index built in %g s\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    if (argc == 0) nfails += checkMap(root, n, tol);
+
+    nhits = 0;
+    t0 = clock();
+    for (i=0; i<NPICKS; i++) {
+        if (MsvgHitTest(root, px[i], py[i], tol) != hits[i]) nfails++;
+        if (hits[i]) nhits++;
+    }
+    printf("===== MsvgHitTest with spatial index, %d picks\n", NPICKS);
+    printf("  hits               %d\n", nhits);
+    printf("  time per pick      %g us\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / NPICKS);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    free(px);
+    free(py);
+    free(hits);
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
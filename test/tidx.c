@@ -0,0 +1,297 @@
+/* tidx.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NSERS 20
+
+static MsvgElement *buildTree(int n)
+{
+    MsvgElement *root, *row = NULL, *g, *el;
+    char s[20];
+    int i;
+
+    // n groups in rows of 100, some with id, with a rect with id and a
+    // circle without
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 1000;
+    root->psvgattr->vb_height = 1000;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    for (i=0; i<n; i++) {
+        if (i % 100 == 0) row = MsvgNewElement(EID_G, root);
+        g = MsvgNewElement(EID_G, row);
+        if (i % 10 == 0) {
+            sprintf(s, "g%d", i);
+            g->id = strdup(s);
+        }
+        el = MsvgNewElement(EID_RECT, g);
+        sprintf(s, "r%d", i);
+        el->id = strdup(s);
+        el->prectattr->x = i % 100 * 10;
+        el->prectattr->y = i / 100 % 100 * 10;
+        el->prectattr->width = 8;
+        el->prectattr->height = 8;
+        el = MsvgNewElement(EID_CIRCLE, g);
+        el->pcircleattr->cx = i % 100 * 10;
+        el->pcircleattr->cy = i / 100 % 100 * 10;
+        el->pcircleattr->r = 3;
+    }
+
+    return root;
+}
+
+typedef struct {
+    MsvgTableId *tid;
+    int nids;
+    int nfails;
+} CheckData;
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    CheckData *cd;
+
+    cd = (CheckData *)udata;
+    if (el->eid == EID_SVG || el->id == NULL) return;
+
+    cd->nids++;
+    if (MsvgFindIdTableId(cd->tid, el->id) != el) cd->nfails++;
+}
+
+static int checkIndex(MsvgElement *root)
+{
+    CheckData cd;
+
+    // every id in the tree is found and there are no more
+    cd.tid = root->psvgattr->idindex;
+    if (cd.tid == NULL) return 1;
+    cd.nids = 0;
+    cd.nfails = 0;
+    MsvgWalkTree(root, wufn, &cd);
+    if (cd.nids != cd.tid->nelem) cd.nfails++;
+
+    return cd.nfails;
+}
+
+static int notFound(MsvgElement *root, const char *id)
+{
+    char s[20];
+
+    strcpy(s, id);
+    return MsvgFindIdCookedTree(root, s) != NULL;
+}
+
+static int checkChanges(MsvgElement *root, int n)
+{
+    MsvgElement *el, *newel, *src, **rows;
+    char s[20];
+    int i, nfails = 0;
+
+    rows = (MsvgElement **)calloc(n / 10 + 1, sizeof(MsvgElement *));
+    if (rows == NULL) return 1;
+
+    // delete a tenth of the groups, with their ids
+    for (i=0; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL) {
+            nfails++;
+            continue;
+        }
+        rows[i/10] = el->father->father;
+        MsvgDeleteElement(el->father);
+        nfails += notFound(root, s);
+        sprintf(s, "g%d", i);
+        nfails += notFound(root, s);
+    }
+    nfails += checkIndex(root);
+    printf("  after deletions:  %d fails\n", nfails);
+
+    // insert them again
+    for (i=0; i<n; i+=10) {
+        if (rows[i/10] == NULL) continue;
+        newel = MsvgNewElement(EID_RECT, NULL);
+        sprintf(s, "r%d", i);
+        newel->id = strdup(s);
+        MsvgInsertSonElement(newel, rows[i/10]);
+        if (MsvgFindIdCookedTree(root, s) != newel) nfails++;
+    }
+    nfails += checkIndex(root);
+    printf("  after insertions: %d fails\n", nfails);
+
+    // replace some elements by copies with other ids
+    for (i=1; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL) {
+            nfails++;
+            continue;
+        }
+        newel = MsvgDupElement(el, 0);
+        free(newel->id);
+        sprintf(s, "n%d", i);
+        newel->id = strdup(s);
+        MsvgReplaceElement(el, newel);
+        MsvgDeleteElement(el);
+        if (MsvgFindIdCookedTree(root, s) != newel) nfails++;
+        sprintf(s, "r%d", i);
+        nfails += notFound(root, s);
+    }
+    nfails += checkIndex(root);
+    printf("  after replaces:   %d fails\n", nfails);
+
+    // and rename or remove some ids
+    for (i=2; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL) {
+            nfails++;
+            continue;
+        }
+        if (i % 20 == 2) {
+            MsvgSetElementId(el, NULL);
+        } else {
+            sprintf(s, "m%d", i);
+            MsvgSetElementId(el, s);
+            if (MsvgFindIdCookedTree(root, s) != el) nfails++;
+        }
+        sprintf(s, "r%d", i);
+        nfails += notFound(root, s);
+    }
+    nfails += checkIndex(root);
+    printf("  after id changes: %d fails\n", nfails);
+
+    // the copied attributes carry their id to the index
+    src = MsvgNewElement(EID_RECT, NULL);
+    for (i=4; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL) {
+            nfails++;
+            continue;
+        }
+        sprintf(s, "c%d", i);
+        MsvgSetElementId(src, s);
+        if (!MsvgCopyCookedAttributes(el, src)) nfails++;
+        if (MsvgFindIdCookedTree(root, s) != el) nfails++;
+        sprintf(s, "r%d", i);
+        nfails += notFound(root, s);
+    }
+    MsvgDeleteElement(src);
+    nfails += checkIndex(root);
+    printf("  after copies:     %d fails\n", nfails);
+
+    // the ids changed directly leave the index stale, with its own copies
+    // of the old ids, until it is built again
+    for (i=3; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL) {
+            nfails++;
+            continue;
+        }
+        free(el->id);
+        sprintf(s, "d%d", i);
+        el->id = strdup(s);
+        if (MsvgFindIdCookedTree(root, s) != NULL) nfails++;
+    }
+    if (!MsvgBuildIdIndex(root)) nfails++;
+    for (i=3; i<n; i+=10) {
+        sprintf(s, "r%d", i);
+        nfails += notFound(root, s);
+        sprintf(s, "d%d", i);
+        el = MsvgFindIdCookedTree(root, s);
+        if (el == NULL || strcmp(el->id, s) != 0) nfails++;
+    }
+    nfails += checkIndex(root);
+    printf("  after rebuilding: %d fails\n", nfails);
+
+    free(rows);
+
+    return nfails;
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    int *nels;
+
+    nels = (int *)udata;
+    (*nels)++;
+}
+
+static void timeSer(MsvgElement *root, const char *s)
+{
+    clock_t t0;
+    int i, nels = 0;
+
+    t0 = clock();
+    for (i=0; i<NSERS; i++) {
+        MsvgSerCookedTree(root, sufn, &nels, 0);
+    }
+    printf("  %s: %d elements, %g s per serialization\n", s, nels / NSERS,
+           (double)(clock() - t0) / CLOCKS_PER_SEC / NSERS);
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, n = 100000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tidx [-n=ngroups] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        // the id index is built here
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+        nfails += checkIndex(root);
+    } else {
+        root = buildTree(n);
+        printf("===== %d groups with ids\n", n);
+        timeSer(root, "without id index");
+        MsvgBuildIdIndex(root);
+        timeSer(root, "with id index   ");
+        nfails += checkIndex(root);
+        nfails += checkChanges(root, n);
+    }
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/* titer.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "msvg.h"
+
+typedef struct {
+    int nels;
+    int maxels;
+    MsvgElement **els;
+    TMatrix *tm;
+} ElList;
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    ElList *ell;
+
+    ell = (ElList *)udata;
+    if (ell->nels < ell->maxels) {
+        ell->els[ell->nels] = el;
+        ell->tm[ell->nels] = pctx->tmatrix;
+    }
+    ell->nels++;
+}
+
+static MsvgElement *buildDeepTree(int depth)
+{
+    MsvgElement *root, *top, *g, *el;
+    int i;
+
+    // built from the bottom, so the insertions don't walk the whole depth
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 100;
+    root->psvgattr->vb_height = 100;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    top = NULL;
+    for (i=0; i<depth; i++) {
+        g = MsvgNewElement(EID_G, NULL);
+        g->pctx->tmatrix.e = 0.001;
+        el = MsvgNewElement(EID_RECT, g);
+        el->prectattr->width = 10;
+        el->prectattr->height = 10;
+        if (top) MsvgInsertSonElement(top, g);
+        el = MsvgNewElement(EID_CIRCLE, g);
+        el->pcircleattr->r = 10;
+        top = g;
+    }
+    if (top) MsvgInsertSonElement(top, root);
+
+    return root;
+}
+
+static int compare(MsvgElement *root, int genbps)
+{
+    ElList ell;
+    MsvgSerIter it1, it2;
+    MsvgPaintCtx *pctx;
+    MsvgElement *el1, *el2;
+    int i, nfails = 0;
+
+    ell.nels = 0;
+    ell.maxels = 0;
+    ell.els = NULL;
+    ell.tm = NULL;
+    MsvgSerCookedTree(root, sufn, &ell, genbps);
+
+    ell.maxels = ell.nels;
+    ell.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (ell.maxels + 1));
+    ell.tm = (TMatrix *)malloc(sizeof(TMatrix) * (ell.maxels + 1));
+    if (ell.els == NULL || ell.tm == NULL) return 1;
+    ell.nels = 0;
+    MsvgSerCookedTree(root, sufn, &ell, genbps);
+
+    // two iterators interleaved, like two time-sliced renderers
+    MsvgSerIterBegin(&it1, root, genbps, NULL);
+    MsvgSerIterBegin(&it2, root, genbps, NULL);
+    for (i=0; i<ell.nels; i++) {
+        el1 = MsvgSerIterNext(&it1, &pctx);
+        if (el1 != ell.els[i]) nfails++;
+        else if (memcmp(&(pctx->tmatrix), &(ell.tm[i]), sizeof(TMatrix))) nfails++;
+        el2 = MsvgSerIterNext(&it2, NULL);
+        if (el2 != ell.els[i]) nfails++;
+    }
+    if (MsvgSerIterNext(&it1, NULL) != NULL) nfails++;
+    if (MsvgSerIterNext(&it2, NULL) != NULL) nfails++;
+    MsvgSerIterEnd(&it1);
+    MsvgSerIterEnd(&it2);
+
+    printf("  genbps %d: %d elements, %d fails\n", genbps, ell.nels, nfails);
+
+    free(ell.els);
+    free(ell.tm);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, depth = 50000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-d=", 3) == 0)
+            depth = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (depth < 1) {
+        printf("Usage: titer [-d=depth] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildDeepTree(depth);
+        printf("===== tree with %d nested groups\n", depth);
+    }
+
+    nfails += compare(root, 0);
+    nfails += compare(root, 1);
+
+    printf("%s\n", nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
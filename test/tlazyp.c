@@ -0,0 +1,199 @@
+/* tlazyp.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NCOOKS 10
+
+static MsvgElement *buildFont(int n)
+{
+    MsvgElement *root, *defs, *font, *el;
+    char s[200];
+    int i;
+
+    // a raw tree with a font of n glyphs in defs, never drawn, and a path
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    MsvgAddRawAttribute(root, "viewBox", "0 0 1000 1000");
+    defs = MsvgNewElement(EID_DEFS, root);
+    font = MsvgNewElement(EID_FONT, defs);
+    el = MsvgNewElement(EID_MISSINGGLYPH, font);
+    MsvgAddRawAttribute(el, "d", "M0 0L500 0L500 700L0 700Z");
+
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_GLYPH, font);
+        sprintf(s, "&#x%x;", i + 0x100);
+        MsvgAddRawAttribute(el, "unicode", s);
+        sprintf(s, "M%d 0C10 20 30 40 50 60Q70 80 90 100c1 2 3 4 5 6s7 8 9 10"
+                "l11 12h13v14z m20 20 L30 30 H40 V50 a10 10 0 0 1 20 20 z", i % 100);
+        MsvgAddRawAttribute(el, "d", s);
+    }
+
+    el = MsvgNewElement(EID_PATH, root);
+    MsvgAddRawAttribute(el, "d", "M100 100 L900 100 L500 900 Z");
+
+    return root;
+}
+
+static int sameSubPath(const MsvgSubPath *sp1, const MsvgSubPath *sp2)
+{
+    int i;
+
+    while (sp1 && sp2) {
+        if (sp1->npoints != sp2->npoints || sp1->closed != sp2->closed)
+            return 0;
+        for (i=0; i<sp1->npoints; i++) {
+            if (sp1->spp[i].x != sp2->spp[i].x || sp1->spp[i].y != sp2->spp[i].y ||
+                sp1->spp[i].cmd != sp2->spp[i].cmd) return 0;
+        }
+        sp1 = sp1->next;
+        sp2 = sp2->next;
+    }
+
+    return sp1 == sp2;
+}
+
+static MsvgPackedPath *packedOf(MsvgElement *el)
+{
+    if (el->eid == EID_PATH) return el->ppathattr->pp;
+    return el->pglyphattr->pp;
+}
+
+static MsvgSubPath *subPathOf(MsvgElement *el)
+{
+    if (el->eid == EID_PATH) return el->ppathattr->sp;
+    return el->pglyphattr->sp;
+}
+
+typedef struct {
+    int npaths;
+    int nfails;
+} CheckData;
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    CheckData *cd;
+    MsvgSubPath *sp, *sp2, *rsp;
+    MsvgPackedPath *pp;
+    MsvgElement *dup;
+    char *d;
+
+    cd = (CheckData *)udata;
+    if (el->eid != EID_PATH && el->eid != EID_GLYPH &&
+        el->eid != EID_MISSINGGLYPH) return;
+    d = MsvgFindRawAttribute(el, "d");
+    if (d == NULL) return;
+    cd->npaths++;
+
+    // a copy of a path not scanned yet is scanned too
+    dup = MsvgDupElement(el, 0);
+    if (dup == NULL) {
+        cd->nfails++;
+        return;
+    }
+
+    // the same than the eager scanning, the copies to read don't change
+    // the element and the subpaths that can be changed drop the packed path
+    sp = MsvgScanPath(d);
+    pp = MsvgGetPackedPath(el);
+    sp2 = subPathOf(el);
+    rsp = MsvgReadSubPath(el);
+    if (!sameSubPath(rsp, sp)) cd->nfails++;
+    if (packedOf(el) != pp || subPathOf(el) != sp2) cd->nfails++;
+    MsvgDestroySubPath(rsp);
+    if (!sameSubPath(MsvgGetSubPath(dup), sp)) cd->nfails++;
+    if (packedOf(dup) != NULL) cd->nfails++;
+    if (sp) MsvgDestroySubPath(sp);
+    MsvgDeleteElement(dup);
+}
+
+static double timeCook(MsvgElement *root, int force, int *nscans)
+{
+    MsvgElement *copy;
+    clock_t t0;
+    double t = 0;
+    int i;
+
+    for (i=0; i<NCOOKS; i++) {
+        copy = MsvgDupElement(root, 1);
+        if (copy == NULL) return 0;
+        t0 = clock();
+        MsvgRaw2CookedTree(copy);
+        if (force) *nscans = MsvgForcePathScan(copy);
+        t += (double)(clock() - t0) / CLOCKS_PER_SEC;
+        MsvgDeleteElement(copy);
+    }
+
+    return t / NCOOKS;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    CheckData cd;
+    double t1, t2;
+    int error, n = 5000, nscans = 0, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tlazyp [-n=nglyphs] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildFont(n);
+        printf("===== %d glyphs\n", n);
+    }
+
+    t1 = timeCook(root, 1, &nscans);
+    t2 = timeCook(root, 0, NULL);
+    printf("  cook with scanning: %g s, without it: %g s (%d paths)\n",
+           t1, t2, nscans);
+
+    MsvgRaw2CookedTree(root);
+    cd.npaths = cd.nfails = 0;
+    MsvgWalkTree(root, wufn, &cd);
+    if (cd.npaths != nscans) cd.nfails++;
+    // all scanned now
+    if (MsvgForcePathScan(root) != 0) cd.nfails++;
+    printf("  scanned paths:      %d fails\n", cd.nfails);
+    nfails += cd.nfails;
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+/* toptim.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define TESTFILE "msvgt7.svg"
+
+#define RW 256
+#define RH 256
+#define CTOL 16     // max difference in a color channel
+#define NTOL 64     // max pixels out of CTOL, the edges can move a bit
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    MsvgElement *newel;
+    int *nels;
+
+    // do the same work a renderer do for each element
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    MsvgDeleteElement(newel);
+
+    nels = (int *)udata;
+    *nels += 1;
+}
+
+static void testSerialize(MsvgElement *root, int nloops)
+{
+    MsvgTreeCounts tc;
+    double minx, maxx, miny, maxy;
+    clock_t t0;
+    int i, nels = 0;
+
+    MsvgCalcCountsCookedTree(root, &tc);
+    printf("  elements in tree   %d\n", tc.totelem);
+    printf("  groups in tree     %d\n", tc.nelem[EID_G]);
+
+    if (MsvgGetCookedDims(root, &minx, &maxx, &miny, &maxy))
+        printf("  dims               %g %g %g %g\n", minx, maxx, miny, maxy);
+
+    t0 = clock();
+    for (i=0; i<nloops; i++)
+        MsvgSerCookedTree(root, sufn, &nels, 0);
+    printf("  serialized els     %d\n", nels / nloops);
+    printf("  time %d loops     %g s\n", nloops,
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+}
+
+static uint32_t *renderTree(MsvgElement *root)
+{
+    MsvgRenderMode rm;
+    uint32_t *pix;
+
+    pix = (uint32_t *)malloc(RW * RH * sizeof(uint32_t));
+    if (pix == NULL) return NULL;
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_PAR;
+    rm.adj = MSVGRENDER_CENTER;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+    MsvgRenderToBuffer(root, &rm, pix, RW, RH, RW);
+
+    return pix;
+}
+
+static int chanDiff(uint32_t p1, uint32_t p2)
+{
+    int i, d, maxd = 0;
+
+    for (i=0; i<32; i+=8) {
+        d = (int)((p1 >> i) & 0xFF) - (int)((p2 >> i) & 0xFF);
+        if (d < 0) d = -d;
+        if (d > maxd) maxd = d;
+    }
+
+    return maxd;
+}
+
+static int cmpRenders(uint32_t *ref, MsvgElement *root, const char *s)
+{
+    uint32_t *pix;
+    int i, nout = 0, nfails = 0;
+
+    pix = renderTree(root);
+    if (ref == NULL || pix == NULL) {
+        nfails++;
+    } else {
+        for (i=0; i<RW*RH; i++)
+            if (chanDiff(ref[i], pix[i]) > CTOL) nout++;
+        if (nout > NTOL) nfails++;
+    }
+    printf("  %-26s %d pixels differ, %d fails\n", s, nout, nfails);
+
+    if (pix) free(pix);
+    return nfails;
+}
+
+static MsvgElement *newEl(MsvgElement *father, enum EID eid, const char *attr)
+{
+    MsvgElement *el;
+    char s[200], *key, *value, *next;
+
+    // attr is a list of key=value separated by ';'
+    el = MsvgNewElement(eid, father);
+    strcpy(s, attr);
+    key = s;
+    while (key && *key) {
+        next = strchr(key, ';');
+        if (next) *next++ = '\0';
+        value = strchr(key, '=');
+        if (value) {
+            *value++ = '\0';
+            MsvgAddRawAttribute(el, key, value);
+        }
+        key = next;
+    }
+
+    return el;
+}
+
+static MsvgElement *buildCases(void)
+{
+    MsvgElement *root, *defs, *grad, *g;
+
+    root = newEl(NULL, EID_SVG, "viewBox=0 0 200 200");
+    defs = newEl(root, EID_DEFS, "");
+    grad = newEl(defs, EID_LINEARGRADIENT,
+                 "id=grad;gradientUnits=userSpaceOnUse;x1=0;y1=0;x2=50;y2=0");
+    newEl(grad, EID_STOP, "offset=0;stop-color=#000000");
+    newEl(grad, EID_STOP, "offset=1;stop-color=#FFFFFF");
+
+    // a group referenced by a use element, it can't be changed
+    g = newEl(root, EID_G, "id=icon;transform=translate(10 10);fill=#FF0000");
+    newEl(g, EID_RECT, "id=iconrect;x=0;y=0;width=30;height=30;"
+          "transform=scale(2 1)");
+    newEl(root, EID_USE, "xlink:href=#icon;x=100;y=0");
+
+    // a group pushed to its sons and removed, the sons are baked
+    g = newEl(root, EID_G, "transform=translate(20 100);fill=#0000FF");
+    newEl(g, EID_RECT, "id=baked;x=0;y=0;width=30;height=30;"
+          "transform=scale(2 1)");
+    newEl(g, EID_CIRCLE, "cx=60;cy=50;r=10;stroke=#00FF00;stroke-width=4");
+
+    // gradients in user space are not baked, an invisible circle is deleted
+    newEl(root, EID_RECT, "id=iri;x=0;y=0;width=50;height=40;fill=url(#grad);"
+          "transform=translate(120 120)");
+    newEl(root, EID_CIRCLE, "id=hidden;cx=10;cy=190;r=5;fill=none");
+
+    return root;
+}
+
+static int isTranslation(MsvgElement *el, double x, double y)
+{
+    TMatrix *t;
+
+    if (el == NULL || el->pctx == NULL) return 0;
+    t = &(el->pctx->tmatrix);
+    return t->a == 1 && t->b == 0 && t->c == 0 && t->d == 1 &&
+           t->e == x && t->f == y;
+}
+
+static int checkCases(void)
+{
+    MsvgElement *root, *el;
+    uint32_t *ref;
+    int nfails = 0;
+
+    root = buildCases();
+    MsvgRaw2CookedTree(root);
+    ref = renderTree(root);
+    MsvgBuildPaintCtxCache(root);
+
+    if (MsvgOptimizeCookedTree(root) < 3) nfails++;
+
+    // the referenced group and its son are as they were
+    el = MsvgFindIdCookedTree(root, "icon");
+    if (!isTranslation(el, 10, 10)) nfails++;
+    el = MsvgFindIdCookedTree(root, "iconrect");
+    if (el == NULL || el->pctx->tmatrix.a != 2 ||
+        el->prectattr->width != 30) nfails++;
+    // the son of the removed group is baked
+    el = MsvgFindIdCookedTree(root, "baked");
+    if (el == NULL || el->father != root || !isTranslation(el, 0, 0) ||
+        el->prectattr->x != 20 || el->prectattr->width != 60) nfails++;
+    // the one painted with a gradient keeps its matrix
+    el = MsvgFindIdCookedTree(root, "iri");
+    if (!isTranslation(el, 120, 120) || el->prectattr->x != 0) nfails++;
+    if (MsvgFindIdCookedTree(root, "hidden") != NULL) nfails++;
+    printf("  cases:                     %d fails\n", nfails);
+
+    nfails += cmpRenders(ref, root, "cases cached render:");
+    MsvgDestroyPaintCtxCache(root);
+    nfails += cmpRenders(ref, root, "cases render:");
+
+    free(ref);
+    MsvgDeleteElement(root);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    uint32_t *ref;
+    int error, nloops = 100, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            nloops = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (nloops < 1) {
+        printf("Usage: toptim [-n=nloops] [file]\n");
+        return 0;
+    }
+
+    if (argc == 0) {
+        printf("===== Optimizing cases\n");
+        nfails = checkCases();
+        printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+        return nfails ? 0 : 1;
+    }
+
+    root = MsvgReadSvgFile(argv[0], &error);
+
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, argv[0]);
+        return 0;
+    }
+
+    MsvgRaw2CookedTree(root);
+    MsvgDelAllTreeRawAttributes(root);
+
+    printf("===== Original cooked tree\n");
+    testSerialize(root, nloops);
+    ref = renderTree(root);
+
+    // the optimizer must invalidate the cached paint contexts it changes
+    MsvgBuildPaintCtxCache(root);
+    nfails += cmpRenders(ref, root, "cached render:");
+
+    printf("===== Optimizing cooked tree\n");
+    printf("  changes done       %d\n", MsvgOptimizeCookedTree(root));
+
+    printf("===== Optimized cooked tree\n");
+    testSerialize(root, nloops);
+    nfails += cmpRenders(ref, root, "cached render:");
+    MsvgDestroyPaintCtxCache(root);
+    nfails += cmpRenders(ref, root, "render:");
+    if (ref) free(ref);
+
+    printf("===== Cooked to Raw =====\n");
+    MsvgCooked2RawTree(root);
+    printf("===== Writing %s =====\n", TESTFILE);
+    if (!MsvgWriteSvgFile(root, TESTFILE)) {
+        printf("Error writing %s\n", TESTFILE);
+    }
+
+    MsvgDeleteElement(root);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/* tpackp.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NFLATS 10
+
+static MsvgElement *buildPaths(int n)
+{
+    MsvgElement *root, *el;
+    char s[200];
+    int i;
+
+    // a raw tree with n paths of three subpaths
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    MsvgAddRawAttribute(root, "viewBox", "0 0 1000 1000");
+
+    for (i=0; i<n; i++) {
+        el = MsvgNewElement(EID_PATH, root);
+        sprintf(s, "M%d 0C10 20 30 40 50 60Q70 80 90 100l11 12h13v14z"
+                "m20 20 L30 30 H40 V50 z M5 5 s7 8 9 10 t 4 4", i % 1000);
+        MsvgAddRawAttribute(el, "d", s);
+    }
+
+    return root;
+}
+
+static int sameSubPath(MsvgSubPath *sp1, MsvgSubPath *sp2)
+{
+    int i;
+
+    while (sp1 && sp2) {
+        if (sp1->npoints != sp2->npoints || sp1->closed != sp2->closed)
+            return 0;
+        for (i=0; i<sp1->npoints; i++) {
+            if (sp1->spp[i].x != sp2->spp[i].x || sp1->spp[i].y != sp2->spp[i].y ||
+                sp1->spp[i].cmd != sp2->spp[i].cmd) return 0;
+        }
+        sp1 = sp1->next;
+        sp2 = sp2->next;
+    }
+
+    return sp1 == sp2;
+}
+
+typedef struct {
+    int npaths;
+    int nsubpaths;
+    int npoints;
+    long lmem;          /* memory used by linked lists of subpaths */
+    long pmem;          /* memory used by packed paths */
+    int nels;
+    MsvgElement **els;  /* copies of the paths, for flattening */
+    int nfails;
+} TestData;
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    TestData *td;
+    MsvgPackedPath *pp, *pp2;
+    MsvgSubPath *sp, *sp2, *aux;
+    MsvgElement *path;
+    int maxpoints;
+
+    td = (TestData *)udata;
+    if (el->eid != EID_PATH && el->eid != EID_GLYPH &&
+        el->eid != EID_MISSINGGLYPH) return;
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL) return;
+
+    td->npaths++;
+    td->nsubpaths += pp->nsubpaths;
+    td->npoints += pp->npoints;
+    td->pmem += sizeof(MsvgPackedPath) + pp->npoints * (2 * sizeof(MsvgCoord) + 1) +
+                (pp->nsubpaths + 1) * sizeof(int) + pp->nsubpaths;
+
+    // the linked list scanned at once is the same, and packs to the same
+    sp = MsvgScanPath(MsvgFindRawAttribute(el, "d"));
+    for (aux=sp; aux!=NULL; aux=aux->next) {
+        // grown point by point from the default capacity
+        maxpoints = 32;
+        while (maxpoints < aux->npoints) maxpoints *= 2;
+        td->lmem += sizeof(MsvgSubPath) + maxpoints * sizeof(MsvgSubPathPoint);
+    }
+    sp2 = MsvgUnpackPath(pp);
+    if (!sameSubPath(sp, sp2)) td->nfails++;
+    pp2 = MsvgPackSubPath(sp);
+    if (pp2 == NULL || pp2->nsubpaths != pp->nsubpaths ||
+        pp2->npoints != pp->npoints ||
+        memcmp(pp2->x, pp->x, sizeof(MsvgCoord) * pp->npoints) != 0 ||
+        memcmp(pp2->y, pp->y, sizeof(MsvgCoord) * pp->npoints) != 0 ||
+        memcmp(pp2->cmd, pp->cmd, pp->npoints) != 0 ||
+        memcmp(pp2->fpoint, pp->fpoint, sizeof(int) * (pp->nsubpaths + 1)) != 0 ||
+        memcmp(pp2->closed, pp->closed, pp->nsubpaths) != 0) td->nfails++;
+    if (sp) MsvgDestroySubPath(sp);
+    if (sp2) MsvgDestroySubPath(sp2);
+
+    // a path with a copy of the packed path, glyphs too
+    if (td->els && pp2) {
+        path = MsvgNewElement(EID_PATH, NULL);
+        path->ppathattr->pp = pp2;
+        td->els[td->nels++] = path;
+    } else if (pp2) {
+        MsvgDestroyPackedPath(pp2);
+    }
+}
+
+static double timeFlatten(TestData *td)
+{
+    MsvgElement *group;
+    clock_t t0;
+    int i, j;
+
+    t0 = clock();
+    for (j=0; j<NFLATS; j++) {
+        for (i=0; i<td->nels; i++) {
+            group = MsvgPathToPolyGroup(td->els[i], 1);
+            if (group) MsvgDeleteElement(group);
+        }
+    }
+
+    return (double)(clock() - t0) / CLOCKS_PER_SEC / NFLATS;
+}
+
+static int checkChanges(void)
+{
+    MsvgElement *root, *el, *dup;
+    MsvgSubPath *sp;
+    MsvgPackedPath *pp;
+    int nfails = 0;
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    // subpaths built by program are packed when needed
+    el = MsvgNewElement(EID_PATH, root);
+    el->ppathattr->sp = MsvgNewSubPath(4);
+    MsvgAddPointToSubPath(el->ppathattr->sp, 'M', 10, 10);
+    MsvgAddPointToSubPath(el->ppathattr->sp, 'L', 20, 10);
+    MsvgAddPointToSubPath(el->ppathattr->sp, 'L', 20, 20);
+    el->ppathattr->sp->closed = 1;
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL || pp->nsubpaths != 1 || pp->npoints != 3 || !pp->closed[0] ||
+        pp->x[1] != 20) nfails++;
+
+    // and packed again after a change
+    el->ppathattr->sp->spp[1].x = 30;
+    MsvgElementChanged(el);
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL || pp->x[1] != 30) nfails++;
+
+    // a copy has the same points
+    dup = MsvgDupElement(el, 0);
+    pp = dup ? MsvgGetPackedPath(dup) : NULL;
+    if (pp == NULL || pp->x[1] != 30 || pp->y[2] != 20) nfails++;
+    if (dup) MsvgDeleteElement(dup);
+
+    // a scanned path changed through the compatible subpaths
+    el = MsvgNewElement(EID_PATH, root);
+    el->ppathattr->pp = MsvgScanPackedPath("M0 0 L5 5 L10 0 M20 20 L30 30");
+    sp = MsvgGetSubPath(el);
+    if (sp == NULL || MsvgCountSubPaths(sp) != 2 || sp->next->spp[1].x != 30)
+        nfails++;
+    if (sp) sp->next->spp[1].x = 40;
+    pp = MsvgGetPackedPath(el);
+    if (pp == NULL || pp->fpoint[1] != 3 || pp->x[4] != 40) nfails++;
+
+    MsvgDeleteElement(root);
+    printf("  changes:   %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    TestData td;
+    double t;
+    int i, error, n = 10000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1) {
+        printf("Usage: tpackp [-n=npaths] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildPaths(n);
+        printf("===== %d paths\n", n);
+    }
+    MsvgRaw2CookedTree(root);
+
+    memset(&td, 0, sizeof(TestData));
+    MsvgWalkTree(root, wufn, &td);
+    td.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (td.npaths + 1));
+    if (td.els == NULL) {
+        printf("Out of memory\n");
+        return 0;
+    }
+    td.npaths = td.nsubpaths = td.npoints = td.nfails = 0;
+    td.lmem = td.pmem = 0;
+    MsvgWalkTree(root, wufn, &td);
+
+    printf("  %d paths, %d subpaths, %d points\n", td.npaths, td.nsubpaths,
+           td.npoints);
+    printf("  memory:    %ld bytes in lists, %ld bytes packed\n", td.lmem, td.pmem);
+    printf("  packed:    %d fails\n", td.nfails);
+    nfails += td.nfails;
+
+    t = timeFlatten(&td);
+    printf("  flattened: %g s\n", t);
+
+    if (argc == 0) nfails += checkChanges();
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    for (i=0; i<td.nels; i++) MsvgDeleteElement(td.els[i]);
+    free(td.els);
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/* tpatch.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NPATCHS 100
+#define TMPFILE "tpatch.svg"
+
+static MsvgElement *buildTree(int n)
+{
+    MsvgElement *root, *row = NULL, *g, *el;
+    char s[20];
+    int i;
+
+    // n groups with id in rows of 100, with a rect and a circle with id
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 1000;
+    root->psvgattr->vb_height = 1000;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+
+    for (i=0; i<n; i++) {
+        if (i % 100 == 0) row = MsvgNewElement(EID_G, root);
+        g = MsvgNewElement(EID_G, row);
+        sprintf(s, "g%d", i);
+        g->id = strdup(s);
+        el = MsvgNewElement(EID_RECT, g);
+        sprintf(s, "r%d", i);
+        el->id = strdup(s);
+        el->prectattr->x = i % 100 * 10;
+        el->prectattr->y = i / 100 % 100 * 10;
+        el->prectattr->width = 8;
+        el->prectattr->height = 8;
+        el->pctx->fill = 0X00FF00;
+        el = MsvgNewElement(EID_CIRCLE, g);
+        sprintf(s, "c%d", i);
+        el->id = strdup(s);
+        el->pcircleattr->cx = i % 100 * 10 + 4;
+        el->pcircleattr->cy = i / 100 % 100 * 10 + 4;
+        el->pcircleattr->r = 3;
+    }
+
+    return root;
+}
+
+static MsvgElement *find(MsvgElement *root, const char *id)
+{
+    char s[41];
+
+    strcpy(s, id);
+    return MsvgFindIdCookedTree(root, s);
+}
+
+static int apply(MsvgElement *root, const char *patch, int nops, int experror)
+{
+    int error, applied;
+
+    applied = MsvgApplyPatch(root, patch, -1, &error);
+    if (applied != nops || error != experror) {
+        printf("  applied %d (%d), error %d (%d): %s\n", applied, nops,
+               error, experror, patch);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the caches are compared with the values calculated without them */
+
+typedef struct {
+    MsvgTableId *tid;
+    int nids;
+    int nindexed;
+    int nfails;
+} CheckData;
+
+static MsvgPaintCtx *refPctx(MsvgElement *el)
+{
+    MsvgPaintCtx *des;
+    MsvgElement *fath;
+
+    des = MsvgNewPaintCtx(el->pctx);
+    if (des == NULL) return NULL;
+    if (el->father == NULL) TMSetIdentity(&(des->tmatrix));
+    for (fath=el->father; fath!=NULL; fath=fath->father) {
+        if (fath->pctx && fath->father) {
+            MsvgProcPaintCtxInheritance(des, fath->pctx);
+        } else if (fath->pctx) {
+            TMatrix t = des->tmatrix;
+            MsvgProcPaintCtxInheritance(des, fath->pctx);
+            des->tmatrix = t;
+        }
+    }
+    MsvgProcPaintCtxDefaults(des);
+
+    return des;
+}
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    CheckData *cd;
+    const MsvgPaintCtx *cpctx;
+    MsvgPaintCtx *ref;
+
+    cd = (CheckData *)udata;
+    if (el->eid == EID_SVG) return;
+
+    if (el->id) {
+        cd->nids++;
+        if (MsvgFindIdTableId(cd->tid, el->id) != el) cd->nfails++;
+    }
+
+    if (el->eid != EID_G) cd->nindexed++;
+
+    if (el->pctx) {
+        cpctx = MsvgGetCachedPaintCtx(el);
+        ref = refPctx(el);
+        if (cpctx == NULL || ref == NULL || !MsvgSamePaintState(cpctx, ref) ||
+            fabs(cpctx->tmatrix.e - ref->tmatrix.e) > 1e-9 ||
+            fabs(cpctx->tmatrix.f - ref->tmatrix.f) > 1e-9) cd->nfails++;
+        if (ref) MsvgDestroyPaintCtx(ref);
+    }
+}
+
+static int checkCaches(MsvgElement *root, int chkrtree)
+{
+    CheckData cd;
+
+    cd.tid = root->psvgattr->idindex;
+    if (cd.tid == NULL) return 1;
+    cd.nids = cd.nindexed = cd.nfails = 0;
+    MsvgWalkTree(root, wufn, &cd);
+    if (cd.nids != cd.tid->nelem) cd.nfails++;
+    if (chkrtree && cd.nindexed != MsvgRTreeCount(root)) cd.nfails++;
+
+    return cd.nfails;
+}
+
+static int checkOperations(MsvgElement *root)
+{
+    MsvgElement *el, *g;
+    MsvgBox box;
+    int nfails = 0;
+
+    // set attributes of an element built by program, the others are kept
+    nfails += apply(root, "<patch><set ref=\"r5\" fill=\"#FF0000\" x=\"55\"/></patch>", 1, 0);
+    el = find(root, "r5");
+    if (el == NULL || el->pctx->fill != 0XFF0000 || el->prectattr->x != 55 ||
+        el->prectattr->width != 8) nfails++;
+
+    // the style attribute, and a removed attribute gets the default value
+    nfails += apply(root, "<patch><set ref=\"r5\" style=\"stroke:#0000FF; stroke-width:2\"/>"
+                    "<set ref=\"r5\" fill=\"\"/></patch>", 2, 0);
+    if (el == NULL || el->pctx->stroke != 0X0000FF || el->pctx->stroke_width != 2 ||
+        el->pctx->fill != NODEFINED_COLOR) nfails++;
+
+    // a new transform in a group
+    nfails += apply(root, "<patch><set ref=\"g6\" transform=\"translate(1000,0)\"/></patch>", 1, 0);
+    box.gminx = box.gmaxx = 1064;
+    box.gminy = box.gmaxy = 4;
+    if (MsvgRTreeSearch(root, &box, NULL, NULL) != 2) nfails++;
+
+    // a renamed id
+    nfails += apply(root, "<patch><set ref=\"c7\" id=\"x7\"/></patch>", 1, 0);
+    if (find(root, "c7") != NULL || find(root, "x7") == NULL) nfails++;
+    printf("  set:     %d fails\n", nfails);
+
+    // a replaced subtree, with its ids
+    nfails += apply(root, "<patch><replace ref=\"g8\"><g id=\"n8\">"
+                    "<circle id=\"nc8\" cx=\"85\" cy=\"5\" r=\"2\"/>"
+                    "<text id=\"t8\" x=\"80\" y=\"9\">eight</text>"
+                    "</g></replace></patch>", 1, 0);
+    if (find(root, "g8") || find(root, "r8") || find(root, "c8")) nfails++;
+    g = find(root, "n8");
+    el = find(root, "nc8");
+    if (g == NULL || el == NULL || el->father != g || el->pcircleattr->r != 2) nfails++;
+    el = find(root, "t8");
+    if (el == NULL || el->fcontent == NULL || strcmp(el->fcontent->s, "eight") != 0)
+        nfails++;
+    if (g && (g->psibling != find(root, "g7") || g->nsibling != find(root, "g9")))
+        nfails++;
+    printf("  replace: %d fails\n", nfails);
+
+    // inserted elements, in order
+    nfails += apply(root, "<patch>"
+                    "<insert ref=\"r9\" where=\"before\"><rect id=\"b1\"/><rect id=\"b2\"/></insert>"
+                    "<insert ref=\"r9\" where=\"after\"><rect id=\"a1\"/><rect id=\"a2\"/></insert>"
+                    "<insert ref=\"g9\"><circle id=\"i1\" r=\"1\"/></insert>"
+                    "</patch>", 3, 0);
+    g = find(root, "g9");
+    el = g ? g->fson : NULL;
+    if (el == NULL || el != find(root, "b1") || el->nsibling != find(root, "b2") ||
+        el->nsibling->nsibling != find(root, "r9") ||
+        el->nsibling->nsibling->nsibling != find(root, "a1") ||
+        el->nsibling->nsibling->nsibling->nsibling != find(root, "a2") ||
+        el->nsibling->nsibling->nsibling->nsibling->nsibling != find(root, "c9") ||
+        el->nsibling->nsibling->nsibling->nsibling->nsibling->nsibling !=
+        find(root, "i1")) nfails++;
+    printf("  insert:  %d fails\n", nfails);
+
+    // deleted elements
+    nfails += apply(root, "<patch><delete ref=\"g10\"/><delete ref=\"r11\"/></patch>", 2, 0);
+    if (find(root, "g10") || find(root, "r10") || find(root, "r11")) nfails++;
+    printf("  delete:  %d fails\n", nfails);
+
+    // wrong operations are skipped, a bad patch stops
+    nfails += apply(root, "<patch><delete ref=\"none\"/><move ref=\"r12\"/>"
+                    "<insert ref=\"r12\"><circle/></insert><delete ref=\"r12\"/></patch>", 2, -4);
+    if (find(root, "r12")) nfails++;
+    nfails += apply(root, "<patch><delete ref=\"r13\"/><delete ref=\"r14\"></patch>", 1, 7);
+    if (find(root, "r13") || find(root, "r14") == NULL) nfails++;
+    printf("  errors:  %d fails\n", nfails);
+
+    nfails += checkCaches(root, 1);
+    printf("  caches:  %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int timePatchs(int n)
+{
+    MsvgElement *root, *root2;
+    clock_t t0;
+    char s[200];
+    double t1, t2;
+    int i, j, error, nfails = 0;
+
+    // a full reading of the file against small patches
+    root = buildTree(n);
+    MsvgCooked2RawTree(root);
+    error = !MsvgWriteSvgFile(root, TMPFILE);
+    MsvgDeleteElement(root);
+    if (error) return 1;
+
+    t0 = clock();
+    root2 = MsvgReadSvgFile(TMPFILE, &error);
+    if (root2 == NULL) return 1;
+    MsvgRaw2CookedTree(root2);
+    t1 = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    remove(TMPFILE);
+
+    MsvgBuildRTree(root2);
+    MsvgBuildPaintCtxCache(root2);
+    t0 = clock();
+    for (i=0; i<NPATCHS; i++) {
+        j = (i * 7919) % n;
+        sprintf(s, "<patch><set ref=\"r%d\" fill=\"#%06X\" y=\"%d\"/>"
+                "<insert ref=\"g%d\"><circle cx=\"1\" cy=\"1\" r=\"1\"/></insert>"
+                "</patch>", j, i, i, j);
+        if (MsvgApplyPatch(root2, s, -1, &error) != 2 || error) nfails++;
+    }
+    t2 = (double)(clock() - t0) / CLOCKS_PER_SEC / NPATCHS;
+    printf("  read and cook: %g s, a patch: %g s\n", t1, t2);
+
+    nfails += checkCaches(root2, 1);
+    MsvgDeleteElement(root2);
+
+    return nfails;
+}
+
+static void setfn(MsvgElement *el, void *udata)
+{
+    char *s;
+
+    s = (char *)udata;
+    // the root is not found by id
+    if (el->id == NULL || el->pctx == NULL || el->father == NULL) return;
+    if (strlen(s) + strlen(el->id) > 100000) return;
+
+    strcat(s, "<set ref=\"");
+    strcat(s, el->id);
+    strcat(s, "\" fill=\"#123456\"/>");
+}
+
+static void chkfn(MsvgElement *el, void *udata)
+{
+    int *nfails;
+
+    nfails = (int *)udata;
+    // the root is not found by id
+    if (el->id == NULL || el->pctx == NULL || el->father == NULL) return;
+    if (el->pctx->fill != 0X123456) (*nfails)++;
+}
+
+static int checkFile(MsvgElement *root)
+{
+    char *s;
+    int error, nfails = 0;
+
+    // the same fill for all the elements with id
+    s = malloc(100100);
+    if (s == NULL) return 1;
+    strcpy(s, "<patch>");
+    MsvgWalkTree(root, setfn, s);
+    strcat(s, "</patch>");
+
+    MsvgApplyPatch(root, s, -1, &error);
+    if (error) nfails++;
+    MsvgWalkTree(root, chkfn, &nfails);
+    nfails += checkCaches(root, 0);
+    free(s);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, n = 10000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 20) {
+        printf("Usage: tpatch [-n=ngroups] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        MsvgBuildIdIndex(root);
+        MsvgBuildRTree(root);
+        MsvgBuildPaintCtxCache(root);
+        printf("===== %s\n", argv[0]);
+        nfails += checkFile(root);
+    } else {
+        root = buildTree(n);
+        MsvgBuildIdIndex(root);
+        MsvgBuildRTree(root);
+        MsvgBuildPaintCtxCache(root);
+        printf("===== %d groups with ids\n", n);
+        nfails += checkOperations(root);
+        nfails += timePatchs(n);
+    }
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+/* tpctx.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NSERS 10
+
+static MsvgElement *buildTree(int n, int depth)
+{
+    MsvgElement *root, *row, *g, *el;
+    int i, j, k;
+
+    // n rows of n cells, every cell a chain of "depth" nested groups with
+    // a rect and a circle at the bottom, the styles are set at any level
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = n * 100;
+    root->psvgattr->vb_height = n * 100;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    root->pctx->stroke = 0X000000;
+
+    for (i=0; i<n; i++) {
+        row = MsvgNewElement(EID_G, root);
+        TMSetTranslation(&(row->pctx->tmatrix), i*100, 0);
+        if (i % 3 == 0) row->pctx->fill = 0X00FF00;
+        for (j=0; j<n; j++) {
+            g = MsvgNewElement(EID_G, row);
+            TMSetTranslation(&(g->pctx->tmatrix), 0, j*100);
+            if (j % 4 == 0) g->pctx->stroke_width = 3;
+            for (k=0; k<depth; k++) {
+                g = MsvgNewElement(EID_G, g);
+                TMSetScaling(&(g->pctx->tmatrix), 0.9, 0.9);
+                if (k == 1) g->pctx->fill_opacity = 0.5;
+            }
+            el = MsvgNewElement(EID_RECT, g);
+            el->prectattr->width = 90;
+            el->prectattr->height = 90;
+            if (j % 5 == 0) el->pctx->fill = 0XBBBBBB;
+            el = MsvgNewElement(EID_CIRCLE, g);
+            el->pcircleattr->cx = 70;
+            el->pcircleattr->cy = 30;
+            el->pcircleattr->r = 20;
+            el->pctx->font_size = 20;
+        }
+    }
+
+    return root;
+}
+
+static MsvgPaintCtx *refPctx(MsvgElement *el)
+{
+    MsvgPaintCtx *des;
+    MsvgElement *fath;
+
+    // the computed paint context without cache, with the world matrix
+    des = MsvgNewPaintCtx(el->pctx);
+    if (des == NULL) return NULL;
+    if (el->father == NULL) TMSetIdentity(&(des->tmatrix));
+    for (fath=el->father; fath!=NULL; fath=fath->father) {
+        if (fath->pctx && fath->father) {
+            MsvgProcPaintCtxInheritance(des, fath->pctx);
+        } else if (fath->pctx) {
+            // the root matrix is not included
+            TMatrix t = des->tmatrix;
+            MsvgProcPaintCtxInheritance(des, fath->pctx);
+            des->tmatrix = t;
+        }
+    }
+    MsvgProcPaintCtxDefaults(des);
+
+    return des;
+}
+
+static int sameMatrix(const TMatrix *t1, const TMatrix *t2)
+{
+    return fabs(t1->a - t2->a) < 1e-9 && fabs(t1->b - t2->b) < 1e-9 &&
+           fabs(t1->c - t2->c) < 1e-9 && fabs(t1->d - t2->d) < 1e-9 &&
+           fabs(t1->e - t2->e) < 1e-6 && fabs(t1->f - t2->f) < 1e-6;
+}
+
+static void wufn(MsvgElement *el, void *udata)
+{
+    int *nfails;
+    const MsvgPaintCtx *cpctx;
+    MsvgPaintCtx *ref;
+
+    nfails = (int *)udata;
+    if (el->pctx == NULL) return;
+
+    cpctx = MsvgGetCachedPaintCtx(el);
+    ref = refPctx(el);
+    if (cpctx == NULL || ref == NULL) {
+        (*nfails)++;
+    } else if (!MsvgSamePaintState(cpctx, ref) ||
+               !sameMatrix(&(cpctx->tmatrix), &(ref->tmatrix))) {
+        (*nfails)++;
+    }
+    if (ref) MsvgDestroyPaintCtx(ref);
+}
+
+static int checkCache(MsvgElement *root, const char *s)
+{
+    int nfails = 0;
+
+    MsvgWalkTree(root, wufn, &nfails);
+    printf("  %-22s %d fails\n", s, nfails);
+
+    return nfails;
+}
+
+typedef struct {
+    int nels;
+    int maxels;
+    MsvgElement **els;
+    MsvgPaintCtx *pctx;
+    int stored;
+    int nfails;
+} SerData;
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    SerData *sd;
+    MsvgPaintCtx aux;
+
+    sd = (SerData *)udata;
+
+    // the strings can be freed after the call, they are not compared
+    aux = *pctx;
+    aux.fill_iri = aux.stroke_iri = aux.sfont_family = NULL;
+
+    if (sd->nels < sd->maxels) {
+        if (!sd->stored) {
+            // first serialization, stored
+            sd->els[sd->nels] = el;
+            sd->pctx[sd->nels] = aux;
+        } else if (sd->els[sd->nels] != el ||
+                   !MsvgSamePaintState(&(sd->pctx[sd->nels]), &aux) ||
+                   !sameMatrix(&(sd->pctx[sd->nels].tmatrix), &(aux.tmatrix))) {
+            sd->nfails++;
+        }
+    }
+    sd->nels++;
+}
+
+static double timeSer(MsvgElement *root, SerData *sd)
+{
+    clock_t t0;
+    int i;
+
+    t0 = clock();
+    for (i=0; i<NSERS; i++) {
+        sd->nels = 0;
+        MsvgSerCookedTree(root, sufn, sd, 0);
+        sd->stored = 1;
+    }
+
+    return (double)(clock() - t0) / CLOCKS_PER_SEC / NSERS;
+}
+
+typedef struct {
+    int nels;
+    MsvgElement **els;
+} ElList;
+
+static void lufn(MsvgElement *el, void *udata)
+{
+    ElList *ell;
+
+    ell = (ElList *)udata;
+    if (el->pctx == NULL) return;
+    if (ell->els) ell->els[ell->nels] = el;
+    ell->nels++;
+}
+
+static double timeQueries(ElList *ell)
+{
+    MsvgPaintCtx *pctx;
+    clock_t t0;
+    int i;
+
+    // random access, in reverse order
+    t0 = clock();
+    for (i=ell->nels-1; i>=0; i--) {
+        pctx = MsvgBuildPaintCtxInherited(ell->els[i]);
+        if (pctx) MsvgDestroyPaintCtx(pctx);
+    }
+
+    return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+static int checkChanges(MsvgElement *root)
+{
+    MsvgElement *row, *g, *cell;
+    TMatrix t;
+    int nfails = 0;
+
+    // a style change at a row
+    row = root->fson->nsibling;
+    row->pctx->fill = 0X0000FF;
+    MsvgElementChanged(row);
+    nfails += checkCache(root, "after a style change:");
+
+    // a moved cell
+    cell = row->fson;
+    MsvgPruneElement(cell);
+    MsvgInsertSonElement(cell, root->fson);
+    nfails += checkCache(root, "after a move:");
+
+    // a new matrix in a group inside a cell
+    g = cell->fson;
+    TMSetRotation(&t, 30, 0, 0);
+    MsvgSetElementTMatrix(g, &t);
+    nfails += checkCache(root, "after a new matrix:");
+
+    // a new view doesn't invalidate the cache, a root style change does
+    TMSetScaling(&t, 2, 2);
+    MsvgSetElementTMatrix(root, &t);
+    if (!root->fson->fson->cpctx_ok) nfails++;
+    nfails += checkCache(root, "after a new view:");
+    root->pctx->stroke = 0XFF0000;
+    MsvgElementChanged(root);
+    if (root->fson->fson->cpctx_ok) nfails++;
+    nfails += checkCache(root, "after a root change:");
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    ElList ell;
+    SerData sd;
+    double t1, t2;
+    int error, n = 100, depth = 10, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-d=", 3) == 0)
+            depth = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 1 || depth < 0) {
+        printf("Usage: tpctx [-n=cells] [-d=depth] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        TMSetIdentity(&(root->pctx->tmatrix));
+        printf("===== %s\n", argv[0]);
+    } else {
+        root = buildTree(n, depth);
+        printf("===== %d x %d cells of %d nested groups\n", n, n, depth);
+    }
+
+    ell.nels = 0;
+    ell.els = NULL;
+    MsvgWalkTree(root, lufn, &ell);
+    ell.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (ell.nels + 1));
+    sd.maxels = ell.nels;
+    sd.els = (MsvgElement **)malloc(sizeof(MsvgElement *) * (sd.maxels + 1));
+    sd.pctx = (MsvgPaintCtx *)malloc(sizeof(MsvgPaintCtx) * (sd.maxels + 1));
+    if (ell.els == NULL || sd.els == NULL || sd.pctx == NULL) {
+        printf("Out of memory\n");
+        return 0;
+    }
+    ell.nels = 0;
+    MsvgWalkTree(root, lufn, &ell);
+    sd.stored = 0;
+    sd.nfails = 0;
+
+    t1 = timeQueries(&ell);
+    t2 = timeSer(root, &sd);
+    printf("  without cache: %d queries in %g s, %g s per serialization\n",
+           ell.nels, t1, t2);
+
+    MsvgBuildPaintCtxCache(root);
+    nfails += checkCache(root, "after building:");
+
+    t1 = timeQueries(&ell);
+    t2 = timeSer(root, &sd);
+    printf("  with cache:    %d queries in %g s, %g s per serialization\n",
+           ell.nels, t1, t2);
+    nfails += sd.nfails;
+    printf("  serialized     %d fails\n", sd.nfails);
+
+    if (argc == 0) nfails += checkChanges(root);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    free(ell.els);
+    free(sd.els);
+    free(sd.pctx);
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+/* tprec.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "msvg.h"
+
+#define NSTEPS 100000
+
+#define RW 256
+#define RH 256
+#define CTOL 8      // max difference in a color channel
+
+typedef struct {
+    FILE *f;            /* dump to write, or reference dump to read */
+    int reading;
+    long ncoords;
+    double maxdev;      /* maximum deviation from the reference */
+    double maxval;      /* maximum magnitude of the coordinates */
+    int nfails;         /* the reference has other geometry */
+} PrecData;
+
+static void coord(PrecData *pd, double v)
+{
+    double ref;
+
+    pd->ncoords++;
+    if (fabs(v) > pd->maxval) pd->maxval = fabs(v);
+
+    if (!pd->reading) {
+        fprintf(pd->f, "%.17g\n", v);
+        return;
+    }
+
+    if (fscanf(pd->f, "%lf", &ref) != 1) {
+        pd->nfails++;
+        return;
+    }
+    if (fabs(v - ref) > pd->maxdev) pd->maxdev = fabs(v - ref);
+}
+
+static void coordArray(PrecData *pd, const MsvgCoord *x, const MsvgCoord *y,
+                       int n, int stride)
+{
+    int i;
+
+    for (i=0; i<n*stride; i+=stride) {
+        coord(pd, x[i]);
+        coord(pd, y[i]);
+    }
+}
+
+static void geometry(PrecData *pd, MsvgElement *el)
+{
+    MsvgPackedPath *pp;
+
+    switch (el->eid) {
+        case EID_RECT :
+            coord(pd, el->prectattr->x);
+            coord(pd, el->prectattr->y);
+            coord(pd, el->prectattr->width);
+            coord(pd, el->prectattr->height);
+            break;
+        case EID_CIRCLE :
+            coord(pd, el->pcircleattr->cx);
+            coord(pd, el->pcircleattr->cy);
+            coord(pd, el->pcircleattr->r);
+            break;
+        case EID_ELLIPSE :
+            coord(pd, el->pellipseattr->cx);
+            coord(pd, el->pellipseattr->cy);
+            coord(pd, el->pellipseattr->rx_x);
+            coord(pd, el->pellipseattr->rx_y);
+            coord(pd, el->pellipseattr->ry_x);
+            coord(pd, el->pellipseattr->ry_y);
+            break;
+        case EID_LINE :
+            coord(pd, el->plineattr->x1);
+            coord(pd, el->plineattr->y1);
+            coord(pd, el->plineattr->x2);
+            coord(pd, el->plineattr->y2);
+            break;
+        case EID_POLYLINE :
+            coordArray(pd, el->ppolylineattr->points, el->ppolylineattr->points + 1,
+                       el->ppolylineattr->npoints, 2);
+            break;
+        case EID_POLYGON :
+            coordArray(pd, el->ppolygonattr->points, el->ppolygonattr->points + 1,
+                       el->ppolygonattr->npoints, 2);
+            break;
+        case EID_PATH :
+        case EID_GLYPH :
+        case EID_MISSINGGLYPH :
+            pp = MsvgGetPackedPath(el);
+            if (pp) coordArray(pd, pp->x, pp->y, pp->npoints, 1);
+            break;
+        case EID_TEXT :
+            coord(pd, el->ptextattr->x);
+            coord(pd, el->ptextattr->y);
+            break;
+        default :
+            break;
+    }
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    MsvgElement *newel;
+
+    // the geometry a renderer draws, in px
+    newel = MsvgTransformCookedElement(el, pctx, 0);
+    if (newel == NULL) return;
+    geometry((PrecData *)udata, newel);
+    MsvgDeleteElement(newel);
+}
+
+static void gufn(MsvgElement *el, void *udata)
+{
+    // the glyph outlines, in font units
+    if (el->eid == EID_GLYPH || el->eid == EID_MISSINGGLYPH)
+        geometry((PrecData *)udata, el);
+}
+
+static int checkSteps(void)
+{
+    MsvgElement *root, *el, *poly;
+    MsvgPackedPath *pp;
+    MsvgCoord eps, p[4];
+    TMatrix t;
+    char *d, *s;
+    double x, y, dev;
+    int i, nfails = 0;
+
+    eps = 1;
+    while ((MsvgCoord)(1 + eps / 2) != 1) eps /= 2;
+
+    // a long relative path doesn't accumulate rounding errors
+    d = malloc(NSTEPS * 16 + 20);
+    if (d == NULL) return 1;
+    s = d + sprintf(d, "M0.3 0.7");
+    x = 0.3;
+    y = 0.7;
+    for (i=0; i<NSTEPS; i++) {
+        s += sprintf(s, "l0.1 %s0.3", (i % 3) ? "" : "-");
+        x += 0.1;
+        y += (i % 3) ? 0.3 : -0.3;
+    }
+    root = MsvgNewElement(EID_SVG, NULL);
+    el = MsvgNewElement(EID_PATH, root);
+    MsvgAddRawAttribute(el, "d", d);
+    poly = MsvgNewElement(EID_POLYGON, root);
+    MsvgAddRawAttribute(poly, "points", "0.1,0.2 1e5,-3.7");
+    MsvgRaw2CookedTree(root);
+    pp = MsvgGetPackedPath(el);
+    dev = 1;
+    if (pp && pp->npoints == NSTEPS + 1)
+        dev = fabs(pp->x[NSTEPS] - x) + fabs(pp->y[NSTEPS] - y);
+    if (dev > 2 * eps * (fabs(x) + fabs(y))) nfails++;
+    printf("  %d relative steps: deviation %g\n", NSTEPS, dev);
+    free(d);
+
+    // the stored coordinates are the read ones rounded
+    el = poly;
+    if (el->ppolygonattr->npoints != 2 ||
+        el->ppolygonattr->points[0] != (MsvgCoord)0.1 ||
+        el->ppolygonattr->points[3] != (MsvgCoord)-3.7) nfails++;
+
+    // and transformed in double, rounded at the end
+    TMSetRotation(&t, 30, 10, 10);
+    p[0] = 0.1;
+    p[1] = 0.2;
+    p[2] = 1e5;
+    p[3] = -3.7;
+    TMTransformCoordArray(el->ppolygonattr->points, el->ppolygonattr->points + 1,
+                          2, 2, &t);
+    for (i=0; i<2; i++) {
+        x = p[i*2];
+        y = p[i*2+1];
+        TMTransformCoord(&x, &y, &t);
+        if (el->ppolygonattr->points[i*2] != (MsvgCoord)x ||
+            el->ppolygonattr->points[i*2+1] != (MsvgCoord)y) nfails++;
+    }
+    MsvgDeleteElement(root);
+
+    printf("  rounding:  %d fails\n", nfails);
+
+    return nfails;
+}
+
+static int checkRender(PrecData *pd, MsvgElement *root, int maxpix)
+{
+    MsvgRenderMode rm;
+    uint32_t *pix, ref;
+    int i, j, d, maxd = 0, nout = 0, nfails = 0;
+
+    // the drawing rendered, the pixels with a bigger difference in a color
+    // channel than CTOL, edge pixels rounded the other way, are counted
+    pix = (uint32_t *)malloc(RW * RH * sizeof(uint32_t));
+    if (pix == NULL) return 1;
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_PAR;
+    rm.adj = MSVGRENDER_CENTER;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+    MsvgRenderToBuffer(root, &rm, pix, RW, RH, RW);
+
+    for (i=0; i<RW*RH; i++) {
+        if (!pd->reading) {
+            fprintf(pd->f, "%08x\n", (unsigned int)pix[i]);
+            continue;
+        }
+        if (fscanf(pd->f, "%x", &ref) != 1) {
+            nfails++;
+            break;
+        }
+        for (j=0; j<32; j+=8) {
+            d = (int)((pix[i] >> j) & 0xFF) - (int)((ref >> j) & 0xFF);
+            if (d < 0) d = -d;
+            if (d > maxd) maxd = d;
+            if (d > CTOL) break;
+        }
+        if (j < 32) nout++;
+    }
+    free(pix);
+
+    printf("  render:  %dx%d px", RW, RH);
+    if (pd->reading) printf(", max channel difference %d, %d px over %d",
+                            maxd, nout, CTOL);
+    printf("\n");
+
+    if (nout > maxpix) nfails++;
+
+    return nfails;
+}
+
+static void report(PrecData *pd, const char *s, const char *units)
+{
+    printf("  %s %ld coords, max %g %s", s, pd->ncoords, pd->maxval, units);
+    if (pd->reading) printf(", max deviation %g %s", pd->maxdev, units);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    PrecData pdw, pdg;
+    char *fname = NULL;
+    double tol = 1e-5;
+    int error, reading = 0, maxpix = 16, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-w=", 3) == 0) {
+            fname = &(argv[0][3]);
+            reading = 0;
+        } else if (strncmp(argv[0], "-r=", 3) == 0) {
+            fname = &(argv[0][3]);
+            reading = 1;
+        } else if (strncmp(argv[0], "-t=", 3) == 0)
+            tol = atof(&(argv[0][3]));
+        else if (strncmp(argv[0], "-p=", 3) == 0)
+            maxpix = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if ((fname && argc < 1) || tol <= 0 || maxpix < 0) {
+        printf("Usage: tprec [-w=dump | -r=dump [-t=reltol] [-p=maxpixels]] "
+               "[file]\n");
+        return 0;
+    }
+
+    printf("===== %s precision coordinates, %d bytes\n",
+           sizeof(MsvgCoord) == sizeof(float) ? "single" : "double",
+           (int)sizeof(MsvgCoord));
+
+    if (argc < 1) {
+        nfails += checkSteps();
+        printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+        return nfails ? 0 : 1;
+    }
+
+    root = MsvgReadSvgFile(argv[0], &error);
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, argv[0]);
+        return 0;
+    }
+    MsvgRaw2CookedTree(root);
+    printf("===== %s\n", argv[0]);
+
+    memset(&pdw, 0, sizeof(PrecData));
+    memset(&pdg, 0, sizeof(PrecData));
+    if (fname) {
+        pdw.f = fopen(fname, reading ? "r" : "w");
+        if (pdw.f == NULL) {
+            printf("Error opening %s\n", fname);
+            MsvgDeleteElement(root);
+            return 0;
+        }
+        pdw.reading = reading;
+        pdg = pdw;
+    }
+
+    MsvgSerCookedTree(root, sufn, &pdw, 0);
+    pdg.f = pdw.f;
+    MsvgWalkTree(root, gufn, &pdg);
+
+    report(&pdw, "drawn: ", "px");
+    report(&pdg, "glyphs:", "units");
+
+    if (fname) {
+        nfails += checkRender(&pdw, root, maxpix);
+        if (reading && fscanf(pdw.f, "%*s") != EOF) nfails++;
+        fclose(pdw.f);
+    }
+
+    // the deviation is relative to the size of the drawing
+    nfails += pdw.nfails + pdg.nfails;
+    if (pdw.maxdev > tol * pdw.maxval) nfails++;
+    if (pdg.maxdev > tol * pdg.maxval) nfails++;
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}
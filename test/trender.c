@@ -0,0 +1,209 @@
+/* trender.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msvg.h"
+
+#define W 100
+#define H 100
+
+static MsvgElement *newEl(MsvgElement *father, enum EID eid, const char *attr)
+{
+    MsvgElement *el;
+    char s[200], *key, *value, *next;
+
+    // attr is a list of key=value separated by ';'
+    el = MsvgNewElement(eid, father);
+    strcpy(s, attr);
+    key = s;
+    while (key && *key) {
+        next = strchr(key, ';');
+        if (next) *next++ = '\0';
+        value = strchr(key, '=');
+        if (value) {
+            *value++ = '\0';
+            MsvgAddRawAttribute(el, key, value);
+        }
+        key = next;
+    }
+
+    return el;
+}
+
+static MsvgElement *buildTest(void)
+{
+    MsvgElement *root, *defs, *grad;
+
+    root = newEl(NULL, EID_SVG, "viewBox=0 0 100 100");
+    defs = newEl(root, EID_DEFS, "");
+    grad = newEl(defs, EID_LINEARGRADIENT,
+                 "id=grad;gradientUnits=userSpaceOnUse;x1=60;y1=0;x2=90;y2=0");
+    newEl(grad, EID_STOP, "offset=0;stop-color=#000000");
+    newEl(grad, EID_STOP, "offset=1;stop-color=#FFFFFF");
+
+    // pixel aligned, half pixel edge, two rings with the same orientation,
+    // a gradient, a transparent rect and a stroke
+    newEl(root, EID_RECT, "x=10;y=10;width=20;height=20;fill=#FF0000");
+    newEl(root, EID_RECT, "x=40.5;y=10;width=10;height=20;fill=#FF0000");
+    newEl(root, EID_PATH, "fill=#0000FF;"
+          "d=M10 40 L40 40 L40 70 L10 70 Z M20 50 L30 50 L30 60 L20 60 Z");
+    newEl(root, EID_PATH, "fill=#0000FF;fill-rule=evenodd;"
+          "d=M50 40 L80 40 L80 70 L50 70 Z M60 50 L70 50 L70 60 L60 60 Z");
+    newEl(root, EID_RECT, "x=60;y=10;width=30;height=20;fill=url(#grad)");
+    newEl(root, EID_RECT, "x=10;y=75;width=20;height=10;fill=#0000FF;"
+          "fill-opacity=0.5");
+    newEl(root, EID_LINE, "x1=0;y1=95;x2=100;y2=95;stroke=#00FF00;"
+          "stroke-width=2");
+
+    return root;
+}
+
+static int near(int v, int ref, int tol)
+{
+    return v >= ref - tol && v <= ref + tol;
+}
+
+static int checkPixels(void)
+{
+    MsvgElement *root;
+    MsvgRenderMode rm;
+    uint32_t *pix, p;
+    int ret, nfails = 0;
+
+    root = buildTest();
+    MsvgRaw2CookedTree(root);
+
+    pix = (uint32_t *)malloc(W * H * sizeof(uint32_t));
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_SCOORD;
+    rm.adj = MSVGRENDER_LEFT;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+    ret = MsvgRenderToBuffer(root, &rm, pix, W, H, W);
+    if (ret != 0) {
+        printf("  MsvgRenderToBuffer returned %d\n", ret);
+        nfails++;
+    }
+
+    #define PIX(x, y) pix[(y) * W + (x)]
+    // exact edges
+    if (PIX(10, 10) != 0xFFFF0000 || PIX(29, 29) != 0xFFFF0000 ||
+        PIX(9, 10) != 0xFFFFFFFF || PIX(30, 29) != 0xFFFFFFFF) nfails++;
+    // half covered pixel
+    p = PIX(40, 20);
+    if ((p >> 16) != 0xFFFF || !near((p >> 8) & 0xFF, 128, 2)) nfails++;
+    if (PIX(41, 20) != 0xFFFF0000) nfails++;
+    // fill rules
+    if (PIX(25, 55) != 0xFF0000FF || PIX(15, 45) != 0xFF0000FF) nfails++;
+    if (PIX(65, 55) != 0xFFFFFFFF || PIX(55, 45) != 0xFF0000FF) nfails++;
+    // gradient ends and middle
+    if (!near(PIX(60, 20) & 0xFF, 4, 4) || !near(PIX(89, 20) & 0xFF, 251, 4) ||
+        !near(PIX(75, 20) & 0xFF, 128, 6)) nfails++;
+    // opacity
+    p = PIX(15, 80);
+    if (!near((p >> 16) & 0xFF, 127, 1) || (p & 0xFF) != 0xFF) nfails++;
+    // stroke, one pixel each side
+    if (PIX(50, 94) != 0xFF00FF00 || PIX(50, 95) != 0xFF00FF00 ||
+        PIX(50, 93) != 0xFFFFFFFF || PIX(50, 96) != 0xFFFFFFFF) nfails++;
+
+    // the errors, and no background
+    if (MsvgRenderToBuffer(NULL, &rm, pix, W, H, W) != -1) nfails++;
+    rm.mode = 7;
+    if (MsvgRenderToBuffer(root, &rm, pix, W, H, W) != -5) nfails++;
+    rm.mode = MSVGRENDER_FIT;
+    rm.bg = NO_COLOR;
+    memset(pix, 0, W * H * sizeof(uint32_t));
+    MsvgRenderToBuffer(root, &rm, pix, W, H, W);
+    if (PIX(0, 0) != 0 || PIX(10, 10) != 0xFFFF0000) nfails++;
+    // half covered transparent pixel, straight alpha
+    p = PIX(40, 20);
+    if (!near(p >> 24, 128, 2) || (p & 0xFFFFFF) != 0xFF0000) nfails++;
+
+    free(pix);
+    MsvgDeleteElement(root);
+    printf("  pixels: %d fails\n", nfails);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    MsvgRenderMode rm;
+    uint32_t *pix;
+    clock_t t0;
+    int error, w = 1024, h = 768, nloops = 10, i, ret = 0, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-w=", 3) == 0)
+            w = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-h=", 3) == 0)
+            h = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-n=", 3) == 0)
+            nloops = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (w < 1 || h < 1 || nloops < 1) {
+        printf("Usage: trender [-w=width] [-h=height] [-n=nloops] [file]\n");
+        return 0;
+    }
+
+    if (argc == 0) {
+        nfails = checkPixels();
+        printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+        return nfails ? 0 : 1;
+    }
+
+    root = MsvgReadSvgFile(argv[0], &error);
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, argv[0]);
+        return 0;
+    }
+    MsvgRaw2CookedTree(root);
+    printf("===== %s\n", argv[0]);
+
+    pix = (uint32_t *)malloc((size_t)w * h * sizeof(uint32_t));
+    if (pix == NULL) return 0;
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_PAR;
+    rm.adj = MSVGRENDER_CENTER;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+
+    t0 = clock();
+    for (i=0; i<nloops; i++)
+        ret = MsvgRenderToBuffer(root, &rm, pix, w, h, w);
+    printf("  %d x %d rendered %d times in %g s\n", w, h, nloops,
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+    if (ret != 0) {
+        printf("  MsvgRenderToBuffer returned %d\n", ret);
+        nfails++;
+    }
+
+    free(pix);
+    MsvgDeleteElement(root);
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
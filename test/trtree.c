@@ -0,0 +1,350 @@
+/* trtree.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "msvg.h"
+#include "tgrid.h"
+
+typedef struct {
+    int nels;
+    int maxels;
+    MsvgElement **els;
+} ElList;
+
+static void addel(ElList *ell, MsvgElement *el)
+{
+    MsvgElement **p;
+
+    if (ell->nels >= ell->maxels) {
+        ell->maxels = (ell->maxels > 0) ? ell->maxels * 2 : 1024;
+        p = realloc(ell->els, ell->maxels * sizeof(MsvgElement *));
+        if (p == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+        ell->els = p;
+    }
+    ell->els[ell->nels++] = el;
+}
+
+static void rtufn(MsvgElement *el, void *udata)
+{
+    addel((ElList *)udata, el);
+}
+
+static void collect(MsvgElement *el, ElList *ell)
+{
+    MsvgElement *pel;
+
+    // the elements the spatial index must have
+    for (pel=el->fson; pel!=NULL; pel=pel->nsibling) {
+        if (pel->eid == EID_G)
+            collect(pel, ell);
+        else if (pel->eid != EID_DEFS && pel->wbbox_ok &&
+                 pel->wbbox.gminx <= pel->wbbox.gmaxx)
+            addel(ell, pel);
+    }
+}
+
+static int intersect(const MsvgBox *b1, const MsvgBox *b2)
+{
+    if (b1->gmaxx < b2->gminx || b1->gminx > b2->gmaxx) return 0;
+    if (b1->gmaxy < b2->gminy || b1->gminy > b2->gmaxy) return 0;
+    return 1;
+}
+
+static double distbox(const MsvgBox *box, double x, double y)
+{
+    double dx = 0, dy = 0;
+
+    if (x < box->gminx) dx = box->gminx - x;
+    else if (x > box->gmaxx) dx = x - box->gmaxx;
+    if (y < box->gminy) dy = box->gminy - y;
+    else if (y > box->gmaxy) dy = y - box->gmaxy;
+
+    return sqrt(dx*dx + dy*dy);
+}
+
+static int linearSearch(ElList *all, const MsvgBox *box, ElList *ell)
+{
+    int i;
+
+    for (i=0; i<all->nels; i++)
+        if (intersect(&(all->els[i]->wbbox), box)) addel(ell, all->els[i]);
+
+    return ell->nels;
+}
+
+static double linearNearest(ElList *all, double x, double y)
+{
+    double d, dmin = 1e300;
+    int i;
+
+    for (i=0; i<all->nels; i++) {
+        d = distbox(&(all->els[i]->wbbox), x, y);
+        if (d < dmin) dmin = d;
+    }
+
+    return dmin;
+}
+
+static int cmpels(const void *a, const void *b)
+{
+    MsvgElement *e1 = *(MsvgElement **)a;
+    MsvgElement *e2 = *(MsvgElement **)b;
+
+    if (e1 < e2) return -1;
+    if (e1 > e2) return 1;
+    return 0;
+}
+
+static int sameList(ElList *l1, ElList *l2)
+{
+    if (l1->nels != l2->nels) return 0;
+    if (l1->nels == 0) return 1;
+    qsort(l1->els, l1->nels, sizeof(MsvgElement *), cmpels);
+    qsort(l2->els, l2->nels, sizeof(MsvgElement *), cmpels);
+    return memcmp(l1->els, l2->els, l1->nels * sizeof(MsvgElement *)) == 0;
+}
+
+static void randomBox(MsvgBox *box, const MsvgBox *world, double size)
+{
+    double w, h;
+
+    w = world->gmaxx - world->gminx;
+    h = world->gmaxy - world->gminy;
+    box->gminx = world->gminx + w * rand() / RAND_MAX;
+    box->gminy = world->gminy + h * rand() / RAND_MAX;
+    box->gmaxx = box->gminx + size;
+    box->gmaxy = box->gminy + size;
+}
+
+static int checkQueries(MsvgElement *root, int nqueries, double size)
+{
+    ElList all = {0, 0, NULL}, l1 = {0, 0, NULL}, l2 = {0, 0, NULL};
+    MsvgElement *el;
+    MsvgBox box;
+    double d;
+    int i, nfails = 0;
+
+    // the index is checked against the world bboxes calculated again
+    for (i=0; i<nqueries; i++) {
+        randomBox(&box, &(root->wbbox), size);
+        l1.nels = 0;
+        MsvgRTreeSearch(root, &box, rtufn, &l1);
+        l2.nels = 0;
+        if (all.els == NULL) {
+            MsvgCalcCookedWorldBBoxes(root);
+            collect(root, &all);
+            if (MsvgRTreeCount(root) != all.nels) nfails++;
+        }
+        linearSearch(&all, &box, &l2);
+        if (!sameList(&l1, &l2)) nfails++;
+        d = 1e300;
+        el = MsvgRTreeNearest(root, box.gminx, box.gminy, &d);
+        if (el && fabs(d - distbox(&(el->wbbox), box.gminx, box.gminy)) > 1e-9)
+            nfails++;
+        if (all.nels > 0 &&
+            fabs(d - linearNearest(&all, box.gminx, box.gminy)) > 1e-9)
+            nfails++;
+    }
+
+    if (all.els) free(all.els);
+    if (l1.els) free(l1.els);
+    if (l2.els) free(l2.els);
+
+    return nfails;
+}
+
+static int modifyTree(MsvgElement *root, int nchanges)
+{
+    MsvgElement *g, *newg, *el;
+    TMatrix t;
+    int i, nfails = 0;
+
+    for (i=0; i<nchanges; i++) {
+        // delete a group
+        g = root->fson;
+        while (g && rand() % 8) g = g->nsibling;
+        if (g) MsvgDeleteElement(g);
+
+        // duplicate a group with other position
+        g = root->fson;
+        if (g == NULL || g->pctx == NULL) continue;
+        newg = MsvgDupElement(g, 1);
+        if (newg == NULL) continue;
+        TMSetTranslation(&(newg->pctx->tmatrix), -200 + rand() % 400,
+                         -200 + rand() % 400);
+        if (i % 2)
+            MsvgInsertPSiblingElement(newg, g);
+        else
+            MsvgInsertNSiblingElement(newg, g);
+
+        // re-transform a group and a leaf
+        g = g->nsibling;
+        if (g == NULL || g->pctx == NULL) continue;
+        TMSetRotation(&t, rand() % 360, 50, 50);
+        TMMpy(&t, &(g->pctx->tmatrix), &t);
+        MsvgSetElementTMatrix(g, &t);
+        el = g->fson;
+        if (el) {
+            TMSetScaling(&t, 2, 2);
+            MsvgSetElementTMatrix(el, &t);
+        }
+
+        // replace a leaf
+        el = root->fson;
+        while (el && el->fson) el = el->fson;
+        if (el && el != root && el->pctx) {
+            newg = MsvgDupElement(el, 0);
+            if (newg == NULL) continue;
+            newg->pctx->tmatrix.e += 1000;
+            MsvgReplaceElement(el, newg);
+            MsvgDeleteElement(el);
+        }
+    }
+
+    // check the sibling links
+    for (g=root->fson; g!=NULL; g=g->nsibling) {
+        if (g->nsibling && g->nsibling->psibling != g) nfails++;
+        if (g->father != root) nfails++;
+    }
+
+    return nfails;
+}
+
+static int testTree(MsvgElement *root, int nqueries)
+{
+    ElList all = {0, 0, NULL}, ell = {0, 0, NULL};
+    MsvgBox box;
+    double size, d;
+    clock_t t0;
+    int i, nfound, nlinear, nfails = 0;
+
+    MsvgCalcCookedWorldBBoxes(root);
+    collect(root, &all);
+
+    t0 = clock();
+    if (!MsvgBuildRTree(root)) {
+        printf("Error building the spatial index\n");
+        return 1;
+    }
+    printf("  elements indexed   %d\n", MsvgRTreeCount(root));
+    printf("  build time         %g s\n", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    // queries of two cells size, less for the linear scans
+    size = 200;
+    nlinear = (nqueries >= 100) ? nqueries / 100 : 1;
+
+    srand(1);
+    nfound = 0;
+    t0 = clock();
+    for (i=0; i<nqueries; i++) {
+        randomBox(&box, &(root->wbbox), size);
+        nfound += MsvgRTreeSearch(root, &box, NULL, NULL);
+    }
+    printf("  rtree search       %g us, %g found\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / nqueries,
+           (double)nfound / nqueries);
+
+    srand(1);
+    nfound = 0;
+    t0 = clock();
+    for (i=0; i<nlinear; i++) {
+        randomBox(&box, &(root->wbbox), size);
+        ell.nels = 0;
+        nfound += linearSearch(&all, &box, &ell);
+    }
+    printf("  linear search      %g us, %g found\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / nlinear,
+           (double)nfound / nlinear);
+
+    srand(2);
+    t0 = clock();
+    for (i=0; i<nqueries; i++) {
+        randomBox(&box, &(root->wbbox), 0);
+        if (MsvgRTreeNearest(root, box.gminx, box.gminy, &d)) nfound++;
+    }
+    printf("  rtree nearest      %g us\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / nqueries);
+
+    srand(2);
+    t0 = clock();
+    for (i=0; i<nlinear; i++) {
+        randomBox(&box, &(root->wbbox), 0);
+        d = linearNearest(&all, box.gminx, box.gminy);
+    }
+    printf("  linear nearest     %g us\n",
+           (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / nlinear);
+
+    nfails += checkQueries(root, 100, size * 5);
+    nfails += modifyTree(root, 50);
+    nfails += checkQueries(root, 100, size * 5);
+    printf("  checks after modifying the tree, %d fails\n", nfails);
+
+    free(all.els);
+    if (ell.els) free(ell.els);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int sizes[3] = {32, 100, 316};
+    int error, i, nqueries = 10000, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            nqueries = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (nqueries < 1) {
+        printf("Usage: trtree [-n=nqueries] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+        nfails += testTree(root, nqueries);
+        MsvgDeleteElement(root);
+    } else {
+        for (i=0; i<3; i++) {
+            root = buildGridMap(sizes[i], TGRID_ROWS | TGRID_ROTLINE);
+            printf("===== map of %d x %d cells\n", sizes[i], sizes[i]);
+            nfails += testTree(root, nqueries);
+            MsvgDeleteElement(root);
+        }
+    }
+
+    printf("%s\n", nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/* tsermem.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ * It must be linked with the GNU ld option
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup
+ * to count the memory allocations done by the library
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "msvg.h"
+
+/* max allocations allowed by serialization, the cooked tree has an id
+   index so no id table is built */
+
+#define MAX_SER_ALLOCS 0
+
+static long nallocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size)
+{
+    nallocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    nallocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    nallocs++;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    nallocs++;
+    return __real_strdup(s);
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    int *nels;
+
+    nels = (int *)udata;
+    *nels += 1;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, genbps, nels;
+    long nallocs0;
+    int result = 1;
+
+    if (argc < 2) {
+        printf("Usage: tsermem file\n");
+        return 0;
+    }
+
+    root = MsvgReadSvgFile(argv[1], &error);
+
+    if (root == NULL) {
+        printf("Error %d reading %s\n", error, argv[1]);
+        return 0;
+    }
+
+    MsvgRaw2CookedTree(root);
+
+    // the content referenced by EID_USE elements is compiled here, not
+    // in every serialization, and the gradients are compiled the first
+    // time they are used
+    MsvgBuildUseCache(root);
+    MsvgSerCookedTree(root, sufn, &nels, 1);
+
+    for (genbps=0; genbps<2; genbps++) {
+        nels = 0;
+        nallocs0 = nallocs;
+        MsvgSerCookedTree(root, sufn, &nels, genbps);
+        nallocs0 = nallocs - nallocs0;
+        printf("genbps %d: %d elements serialized, %ld allocations\n",
+               genbps, nels, nallocs0);
+        if (nallocs0 > MAX_SER_ALLOCS) result = 0;
+    }
+
+    printf("%s\n", result ? "PASS" : "FAIL");
+
+    MsvgDeleteElement(root);
+
+    return result;
+}
@@ -0,0 +1,315 @@
+/* ttiled.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "msvg.h"
+
+static MsvgElement *newEl(MsvgElement *father, enum EID eid, const char *attr)
+{
+    MsvgElement *el;
+    char s[300], *key, *value, *next;
+
+    // attr is a list of key=value separated by ';'
+    el = MsvgNewElement(eid, father);
+    strcpy(s, attr);
+    key = s;
+    while (key && *key) {
+        next = strchr(key, ';');
+        if (next) *next++ = '\0';
+        value = strchr(key, '=');
+        if (value) {
+            *value++ = '\0';
+            MsvgAddRawAttribute(el, key, value);
+        }
+        key = next;
+    }
+
+    return el;
+}
+
+static MsvgElement *buildTest(int n)
+{
+    MsvgElement *root, *defs, *grad, *g;
+    char s[300];
+    int i, x, y;
+
+    root = newEl(NULL, EID_SVG, "viewBox=0 0 600 400");
+    defs = newEl(root, EID_DEFS, "");
+    grad = newEl(defs, EID_LINEARGRADIENT, "id=lgrad;x1=0;y1=0;x2=1;y2=1");
+    newEl(grad, EID_STOP, "offset=0;stop-color=#FF0000");
+    newEl(grad, EID_STOP, "offset=1;stop-color=#0000FF;stop-opacity=0.3");
+    grad = newEl(defs, EID_RADIALGRADIENT, "id=rgrad");
+    newEl(grad, EID_STOP, "offset=0.2;stop-color=#FFFF00");
+    newEl(grad, EID_STOP, "offset=1;stop-color=#008000");
+
+    // out of every side of the buffer, covering it whole and cut at the
+    // right, left, top and bottom
+    newEl(root, EID_RECT, "x=-100;y=-100;width=10000;height=10000;"
+          "fill=#E0E0E0");
+    newEl(root, EID_RECT, "x=550;y=20;width=500;height=60;fill=url(#lgrad)");
+    newEl(root, EID_RECT, "x=-300;y=100;width=330.3;height=60;fill=#804000");
+    newEl(root, EID_CIRCLE, "cx=300;cy=-20;r=70;fill=url(#rgrad)");
+    newEl(root, EID_ELLIPSE, "cx=300;cy=420;rx=150;ry=40;fill=#000080;"
+          "fill-opacity=0.5;stroke=#FF00FF;stroke-width=7");
+
+    // shapes across the tiles, some of them rotated
+    for (i=0; i<n; i++) {
+        x = (i * 137) % 600;
+        y = (i * 71) % 400;
+        g = newEl(root, EID_G, "");
+        sprintf(s, "rotate(%d %d %d)", (i * 23) % 360, x, y);
+        if (i % 3 == 0) MsvgAddRawAttribute(g, "transform", s);
+        switch (i % 5) {
+            case 0 :
+                sprintf(s, "x=%d.25;y=%d.5;width=%d;height=%d;fill=#%06X;"
+                        "fill-opacity=0.7", x, y, 20 + i % 90, 10 + i % 70,
+                        (i * 0x3579B) & 0xFFFFFF);
+                newEl(g, EID_RECT, s);
+                break;
+            case 1 :
+                sprintf(s, "cx=%d;cy=%d;r=%d;fill=url(#%s);stroke=#000000;"
+                        "stroke-width=%d.5", x, y, 10 + i % 50,
+                        (i & 1) ? "lgrad" : "rgrad", i % 6);
+                newEl(g, EID_CIRCLE, s);
+                break;
+            case 2 :
+                sprintf(s, "points=%d,%d %d,%d %d,%d %d,%d %d,%d;"
+                        "fill=#%06X;fill-rule=evenodd", x, y - 40, x + 30,
+                        y + 30, x - 40, y - 10, x + 40, y - 10, x - 30, y + 30,
+                        (i * 0x2468A) & 0xFFFFFF);
+                newEl(g, EID_POLYGON, s);
+                break;
+            case 3 :
+                sprintf(s, "points=%d,%d %d,%d %d,%d %d,%d;fill=none;"
+                        "stroke=#%06X;stroke-width=%d;stroke-opacity=0.6",
+                        x, y, x + 150, y + 20, x + 10, y + 90, x + 200, y + 130,
+                        (i * 0x13579) & 0xFFFFFF, 1 + i % 15);
+                newEl(g, EID_POLYLINE, s);
+                break;
+            default :
+                sprintf(s, "d=M%d %d C%d %d %d %d %d %d Q%d %d %d %d Z;"
+                        "fill=#%06X;stroke=url(#lgrad);stroke-width=3",
+                        x, y, x + 200, y - 100, x - 150, y + 150, x + 80,
+                        y + 60, x + 20, y + 200, x - 60, y + 20,
+                        (i * 0x55555) & 0xFFFFFF);
+                newEl(g, EID_PATH, s);
+                break;
+        }
+    }
+
+    return root;
+}
+
+static double wallTime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int samePixels(const uint32_t *p1, const uint32_t *p2, int w, int h,
+                      int stride)
+{
+    int y;
+
+    for (y=0; y<h; y++)
+        if (memcmp(&(p1[(long)y*stride]), &(p2[(long)y*stride]),
+                   w * sizeof(uint32_t)) != 0) return 0;
+
+    return 1;
+}
+
+static int checkTiled(MsvgElement *root, const MsvgRenderMode *rm, int w,
+                      int h, int stride, int maxthreads)
+{
+    uint32_t *pix1, *pix2;
+    long i, size;
+    int ret, nthreads, nfails = 0;
+
+    size = (long)stride * h;
+    pix1 = (uint32_t *)malloc(size * sizeof(uint32_t));
+    pix2 = (uint32_t *)malloc(size * sizeof(uint32_t));
+    if (pix1 == NULL || pix2 == NULL) return 1;
+
+    // a pattern under, to check the pixels not painted and out of the stride
+    for (i=0; i<size; i++)
+        pix1[i] = (uint32_t)(i * 2654435761u);
+    memcpy(pix2, pix1, size * sizeof(uint32_t));
+    ret = MsvgRenderToBuffer(root, rm, pix1, w, h, stride);
+    if (ret != 0) nfails++;
+
+    for (nthreads=1; nthreads<=maxthreads; nthreads++) {
+        for (i=0; i<size; i++)
+            pix2[i] = (uint32_t)(i * 2654435761u);
+        if (MsvgRenderToBufferTiled(root, rm, pix2, w, h, stride,
+                                    nthreads) != ret) nfails++;
+        if (memcmp(pix1, pix2, size * sizeof(uint32_t)) != 0) {
+            printf("  %d x %d, %d threads: not the same pixels\n", w, h,
+                   nthreads);
+            nfails++;
+        }
+    }
+
+    free(pix1);
+    free(pix2);
+
+    return nfails;
+}
+
+static int checkTest(int n, int maxthreads)
+{
+    MsvgElement *root;
+    MsvgRenderMode rm;
+    uint32_t pix[4];
+    int nfails = 0;
+
+    root = buildTest(n);
+    MsvgRaw2CookedTree(root);
+
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_PAR;
+    rm.adj = MSVGRENDER_CENTER;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+    nfails += checkTiled(root, &rm, 600, 400, 600, maxthreads);
+    // tiles cut at the right and the bottom, and a bigger stride
+    nfails += checkTiled(root, &rm, 517, 389, 530, maxthreads);
+    // more than a tile by row
+    rm.mode = MSVGRENDER_FIT;
+    nfails += checkTiled(root, &rm, 2500, 250, 2500, maxthreads);
+    rm.mode = MSVGRENDER_PAR;
+    // rotated and zoomed, no background
+    rm.rotang = 33;
+    rm.zoom = 1.7;
+    rm.xdespl = -40.3;
+    rm.bg = NO_COLOR;
+    nfails += checkTiled(root, &rm, 700, 300, 700, maxthreads);
+    // smaller than a tile
+    rm.mode = MSVGRENDER_FIT;
+    nfails += checkTiled(root, &rm, 61, 37, 61, maxthreads);
+
+    // the errors
+    if (MsvgRenderToBufferTiled(NULL, &rm, pix, 2, 2, 2, 1) != -1) nfails++;
+    if (MsvgRenderToBufferTiled(root, &rm, pix, 2, 2, 2, 0) != -5) nfails++;
+    rm.adj = 7;
+    if (MsvgRenderToBufferTiled(root, &rm, pix, 2, 2, 2, 1) != -5) nfails++;
+
+    MsvgDeleteElement(root);
+    printf("  %d shapes, 1 to %d threads: %d fails\n", n, maxthreads, nfails);
+
+    return nfails;
+}
+
+static int timeFile(MsvgElement *root, int w, int h, int maxthreads, int nloops)
+{
+    MsvgRenderMode rm;
+    uint32_t *pix1, *pix2;
+    double t, t1 = 0;
+    int i, ret = 0, nthreads, nfails = 0;
+
+    pix1 = (uint32_t *)malloc((size_t)w * h * sizeof(uint32_t));
+    pix2 = (uint32_t *)malloc((size_t)w * h * sizeof(uint32_t));
+    if (pix1 == NULL || pix2 == NULL) return 1;
+    memset(&rm, 0, sizeof(rm));
+    rm.mode = MSVGRENDER_PAR;
+    rm.adj = MSVGRENDER_CENTER;
+    rm.zoom = 1;
+    rm.bg = 0xFFFFFF;
+
+    t = wallTime();
+    for (i=0; i<nloops; i++)
+        ret = MsvgRenderToBuffer(root, &rm, pix1, w, h, w);
+    t = (wallTime() - t) / nloops;
+    printf("  %d x %d MsvgRenderToBuffer      %8.4f s\n", w, h, t);
+    if (ret != 0) {
+        printf("  MsvgRenderToBuffer returned %d\n", ret);
+        nfails++;
+    }
+
+    for (nthreads=1; nthreads<=maxthreads; nthreads*=2) {
+        t = wallTime();
+        for (i=0; i<nloops; i++)
+            if (MsvgRenderToBufferTiled(root, &rm, pix2, w, h, w,
+                                        nthreads) != ret) nfails++;
+        t = (wallTime() - t) / nloops;
+        if (nthreads == 1) t1 = t;
+        printf("  %d x %d tiled, %2d threads %8.4f s, %.2fx\n", w, h, nthreads,
+               t, t > 0 ? t1 / t : 0);
+        if (!samePixels(pix1, pix2, w, h, w)) {
+            printf("  %d threads: not the same pixels\n", nthreads);
+            nfails++;
+        }
+    }
+
+    free(pix1);
+    free(pix2);
+
+    return nfails;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, n = 300, w = 1024, h = 768, maxthreads = 4, nloops = 1;
+    int nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            n = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-w=", 3) == 0)
+            w = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-h=", 3) == 0)
+            h = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-t=", 3) == 0)
+            maxthreads = atoi(&(argv[0][3]));
+        else if (strncmp(argv[0], "-l=", 3) == 0)
+            nloops = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (n < 0 || w < 1 || h < 1 || maxthreads < 1 || nloops < 1) {
+        printf("Usage: ttiled [-n=shapes] [-w=width] [-h=height] "
+               "[-t=maxthreads] [-l=nloops] [file]\n");
+        return 0;
+    }
+
+    if (argc == 0) {
+        printf("===== test tree\n");
+        nfails = checkTest(n, maxthreads);
+    } else {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+        nfails = timeFile(root, w, h, maxthreads, nloops);
+        MsvgDeleteElement(root);
+    }
+
+    printf("%d fails\n%s\n", nfails, nfails ? "FAIL" : "PASS");
+
+    return nfails ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+/* tuse.c
+ *
+ * libmsvg, a minimal library to read and write svg files
+ *
+ * Copyright (C) 2026 Mariano Alvarez Fernandez
+ * (malfer at telefonica.net)
+ *
+ * This is a test file of the libmsvg library.
+ * libmsvg test files are in the Public Domain, this apply only to test
+ * files, the library itself is under the terms of the Expat license
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "msvg.h"
+
+#define NSYMBOLS 8
+
+typedef struct {
+    MsvgElement *el;
+    rgbcolor fill;
+    TMatrix t;
+} RefItem;
+
+typedef struct {
+    int nitems;
+    int maxitems;
+    RefItem *item;
+    int pos;
+    int nfails;
+} RefList;
+
+/* the reference expansion, a recursive walk creating the instances */
+
+static void refWalk(MsvgElement *root, MsvgElement *el, rgbcolor fill,
+                    const TMatrix *t, RefList *rl)
+{
+    MsvgElement *son, *refel;
+    TMatrix t2, t3, uset;
+
+    if (el->pctx == NULL) return; // EID_DEFS
+
+    if (el->pctx->fill != NODEFINED_COLOR && el->pctx->fill != INHERIT_COLOR)
+        fill = el->pctx->fill;
+    TMMpy(&t2, t, &(el->pctx->tmatrix));
+
+    switch (el->eid) {
+        case EID_SVG :
+        case EID_G :
+            for (son=el->fson; son!=NULL; son=son->nsibling)
+                refWalk(root, son, fill, &t2, rl);
+            break;
+        case EID_USE :
+            refel = MsvgFindIdCookedTree(root, el->puseattr->refel);
+            if (refel == NULL) break;
+            TMSetTranslation(&uset, el->puseattr->x, el->puseattr->y);
+            TMMpy(&t3, &t2, &uset);
+            refWalk(root, refel, fill, &t3, rl);
+            break;
+        case EID_RECT :
+        case EID_CIRCLE :
+        case EID_ELLIPSE :
+        case EID_LINE :
+        case EID_POLYLINE :
+        case EID_POLYGON :
+        case EID_PATH :
+        case EID_TEXT :
+            if (rl->nitems < rl->maxitems) {
+                rl->item[rl->nitems].el = el;
+                rl->item[rl->nitems].fill = (fill == NODEFINED_COLOR) ?
+                                            BLACK_COLOR : fill;
+                rl->item[rl->nitems].t = t2;
+            }
+            rl->nitems++;
+            break;
+        default :
+            break;
+    }
+}
+
+static int sameMatrix(const TMatrix *t1, const TMatrix *t2)
+{
+    // the instances multiply the matrices in other order
+    if (fabs(t1->a - t2->a) > 1e-9 || fabs(t1->b - t2->b) > 1e-9) return 0;
+    if (fabs(t1->c - t2->c) > 1e-9 || fabs(t1->d - t2->d) > 1e-9) return 0;
+    if (fabs(t1->e - t2->e) > 1e-6 || fabs(t1->f - t2->f) > 1e-6) return 0;
+    return 1;
+}
+
+static void sufn(MsvgElement *el, MsvgPaintCtx *pctx, void *udata)
+{
+    RefList *rl;
+    RefItem *ri;
+
+    rl = (RefList *)udata;
+    if (rl->pos >= rl->nitems) {
+        rl->nfails++;
+        return;
+    }
+    ri = &(rl->item[rl->pos]);
+    if (el != ri->el || pctx->fill != ri->fill ||
+        !sameMatrix(&(pctx->tmatrix), &(ri->t))) rl->nfails++;
+    rl->pos++;
+}
+
+static int compare(MsvgElement *root, const char *label)
+{
+    RefList rl;
+    TMatrix t;
+
+    TMSetIdentity(&t);
+    rl.nitems = 0;
+    rl.maxitems = 0;
+    rl.item = NULL;
+    refWalk(root, root, NODEFINED_COLOR, &t, &rl);
+    rl.maxitems = rl.nitems;
+    rl.item = (RefItem *)malloc(sizeof(RefItem) * (rl.maxitems + 1));
+    if (rl.item == NULL) return 1;
+    rl.nitems = 0;
+    refWalk(root, root, NODEFINED_COLOR, &t, &rl);
+
+    rl.pos = 0;
+    rl.nfails = 0;
+    MsvgSerCookedTree(root, sufn, &rl, 0);
+    if (rl.pos != rl.nitems) rl.nfails++;
+
+    printf("  %-24s %d elements, %d fails\n", label, rl.nitems, rl.nfails);
+    free(rl.item);
+
+    return rl.nfails;
+}
+
+static MsvgElement *newRect(MsvgElement *father, double x, rgbcolor fill)
+{
+    MsvgElement *el;
+
+    el = MsvgNewElement(EID_RECT, father);
+    el->prectattr->x = x;
+    el->prectattr->width = 4;
+    el->prectattr->height = 4;
+    el->pctx->fill = fill;
+
+    return el;
+}
+
+static MsvgElement *newUse(MsvgElement *father, char *refel, double x, double y)
+{
+    MsvgElement *el;
+
+    el = MsvgNewElement(EID_USE, father);
+    el->puseattr->refel = strdup(refel);
+    el->puseattr->x = x;
+    el->puseattr->y = y;
+
+    return el;
+}
+
+static MsvgElement *buildIcons(int nuses)
+{
+    MsvgElement *root, *defs, *g, *el;
+    char id[20];
+    int i;
+
+    // a few symbols, some using others, and a lot of instances with the
+    // fill inherited from the EID_USE elements
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->vb_width = 1000;
+    root->psvgattr->vb_height = 1000;
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    root->pctx->fill = 0X000000;
+
+    defs = MsvgNewElement(EID_DEFS, root);
+    for (i=0; i<NSYMBOLS; i++) {
+        g = MsvgNewElement(EID_G, defs);
+        sprintf(id, "sym%d", i);
+        g->id = strdup(id);
+        TMSetScaling(&(g->pctx->tmatrix), 1.5, 0.5);
+        newRect(g, 0, NODEFINED_COLOR);
+        el = MsvgNewElement(EID_CIRCLE, g);
+        el->pcircleattr->r = 3;
+        el->pctx->fill = 0XFF0000;
+        newRect(g, 6, INHERIT_COLOR);
+        if (i > 0) {
+            sprintf(id, "sym%d", i-1);
+            el = newUse(g, id, 10, 10);
+            TMSetRotation(&(el->pctx->tmatrix), 30, 0, 0);
+        }
+    }
+
+    g = MsvgNewElement(EID_G, root);
+    TMSetTranslation(&(g->pctx->tmatrix), 3, 7);
+    for (i=0; i<nuses; i++) {
+        sprintf(id, "sym%d", i % NSYMBOLS);
+        el = newUse(g, id, (i % 100) * 10, (i / 100) * 10);
+        el->pctx->fill = (i % 3) ? 0X00FF00 : NODEFINED_COLOR;
+    }
+
+    return root;
+}
+
+static int countSer(MsvgElement *root)
+{
+    MsvgSerIter it;
+    int n = 0;
+
+    if (!MsvgSerIterBegin(&it, root, 0, NULL)) return -1;
+    while (MsvgSerIterNext(&it, NULL) != NULL) n++;
+    MsvgSerIterEnd(&it);
+
+    return n;
+}
+
+static int checkCycles(void)
+{
+    MsvgElement *root, *defs, *a, *b, *c;
+    int n, nfails = 0;
+
+    // a and b reference each other, c references a and has a rect,
+    // the self group is in the drawing and references itself
+
+    root = MsvgNewElement(EID_SVG, NULL);
+    root->psvgattr->tree_type = COOKED_SVGTREE;
+    defs = MsvgNewElement(EID_DEFS, root);
+    a = MsvgNewElement(EID_G, defs);
+    a->id = strdup("a");
+    newRect(a, 0, NODEFINED_COLOR);
+    newUse(a, "b", 0, 0);
+    b = MsvgNewElement(EID_G, defs);
+    b->id = strdup("b");
+    newRect(b, 0, NODEFINED_COLOR);
+    newUse(b, "a", 0, 0);
+    c = MsvgNewElement(EID_G, defs);
+    c->id = strdup("c");
+    newRect(c, 0, NODEFINED_COLOR);
+    newUse(c, "a", 0, 0);
+
+    newUse(root, "a", 0, 0);
+    newUse(root, "b", 0, 0);
+    newUse(root, "c", 0, 0);
+    c = MsvgNewElement(EID_G, root);
+    c->id = strdup("self");
+    newRect(c, 0, NODEFINED_COLOR);
+    newUse(c, "self", 0, 0);
+
+    // only the c rect and the self rect are drawn
+    n = countSer(root);
+    if (n != 2) nfails++;
+    printf("  reference cycles         %d elements, %d fails\n", n, nfails);
+
+    MsvgDeleteElement(root);
+
+    return nfails;
+}
+
+static int checkChanges(MsvgElement *root)
+{
+    MsvgElement *sym, *el;
+    int n1, n2, nfails = 0;
+
+    // the cache must follow the changes made through the manipulation
+    // functions
+    n1 = countSer(root);
+    sym = MsvgFindIdCookedTree(root, "sym0");
+    el = newRect(NULL, 20, NODEFINED_COLOR);
+    MsvgInsertSonElement(el, sym);
+    nfails += compare(root, "after insertion");
+    n2 = countSer(root);
+    if (n2 <= n1) nfails++;
+
+    sym->fson->pctx->fill = 0X0000FF;
+    MsvgElementChanged(sym->fson);
+    nfails += compare(root, "after a change");
+
+    MsvgDeleteElement(el);
+    nfails += compare(root, "after deletion");
+    if (countSer(root) != n1) nfails++;
+
+    return nfails;
+}
+
+static double timeSer(MsvgElement *root, int nreps)
+{
+    clock_t t0;
+    int i;
+
+    t0 = clock();
+    for (i=0; i<nreps; i++) countSer(root);
+
+    return (double)(clock() - t0) / CLOCKS_PER_SEC / nreps;
+}
+
+int main(int argc, char **argv)
+{
+    MsvgElement *root;
+    int error, nuses = 10000, nreps = 20, nfails = 0;
+
+    if (argc > 0) {
+        argv++;
+        argc--;
+    }
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (strncmp(argv[0], "-n=", 3) == 0)
+            nuses = atoi(&(argv[0][3]));
+        argv++;
+        argc--;
+    }
+
+    if (nuses < 1) {
+        printf("Usage: tuse [-n=nuses] [file]\n");
+        return 0;
+    }
+
+    if (argc > 0) {
+        root = MsvgReadSvgFile(argv[0], &error);
+        if (root == NULL) {
+            printf("Error %d reading %s\n", error, argv[0]);
+            return 0;
+        }
+        MsvgRaw2CookedTree(root);
+        printf("===== %s\n", argv[0]);
+        nreps = 1;
+    } else {
+        root = buildIcons(nuses);
+        printf("===== %d uses of %d symbols\n", nuses, NSYMBOLS);
+    }
+
+    nfails += compare(root, "compiled per render");
+    printf("  time per render          %g ms\n", timeSer(root, nreps) * 1000);
+
+    MsvgBuildUseCache(root);
+    nfails += compare(root, "cached in the tree");
+    printf("  time per render          %g ms\n", timeSer(root, nreps) * 1000);
+
+    if (argc == 0) {
+        nfails += checkChanges(root);
+        nfails += checkCycles();
+    }
+
+    printf("%s\n", nfails ? "FAIL" : "PASS");
+
+    MsvgDeleteElement(root);
+
+    return nfails ? 0 : 1;
+}